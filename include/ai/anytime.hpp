@@ -0,0 +1,170 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+
+#include <memory>
+#include <chrono>
+#include <optional>
+
+#include <lib/intdef>
+
+#include <config.hpp>
+#include <engine.hpp>
+#include <rules/tetromino.hpp>
+#include <rules/attack_table.hpp>
+#include <rules/spin.hpp>
+#include <rules/field.hpp>
+#include <rules/board.hpp>
+
+#include <ai/bot.hpp>
+#include <ai/features.hpp>
+#include <ai/movegen.hpp>
+
+/**
+ * @brief Iterative deepening search over the placements of the tetromino in
+ * play and the queue shown, that answers within a time budget.
+ *
+ * `think()` first scores every placement of the tetromino in play and of the
+ * held one as the bot does, which is already an answer, then searches one
+ * more tetromino of the queue per iteration. A line is worth what it sent,
+ * plus the board it ends on; from each state only the `width` best
+ * placements by that score are searched. The answer is the best placement
+ * of the last iteration finished.
+ *
+ * The deadline is read from `steady_clock` before each state, which costs
+ * little next to expanding one. Once it has passed the iteration stops; the
+ * first placement it searches is the previous answer, so if that one was
+ * finished the answer is the best of those finished. Only the placements of
+ * the tetromino in play are made whatever the budget, so there is always a
+ * valid move shortly after the deadline.
+ *
+ * Iterations share a transposition table: the placements from a state, and
+ * the value of a state searched to a depth, by a hash of what they depend
+ * on. It is kept across calls, so once a placement found is played the next
+ * search starts from what the previous one searched below it.
+ *
+ * Simulates on boards only, with the rules of the engine it is given.
+ * Needs the standard 10 x (20 + 4) field.
+ */
+class anytime_search {
+public:
+    // Placements searched from each state, best first by their own score.
+    static constexpr u32 width = 6;
+    // States the table holds before the next `think()` clears it.
+    static constexpr std::size_t table_capacity = 1 << 14;
+
+    struct result {
+        // Hold first, then play `_M_placement`.
+        bool _M_hold;
+        placement _M_placement;
+        f32 _M_value;
+
+        // Tetrominoes looked at by the answer, and states expanded in the call.
+        u32 _M_depth;
+        u64 _M_expanded;
+    };
+
+    anytime_search(const user_config& __uconf, eval_weights __w = eval_weights{})
+    : _M_user_config(__uconf), _M_weights(__w),
+      _M_attack_table(attack_tables::create(__uconf.game.attack_table)),
+      _M_spin_table(spin_tables::create(__uconf.game.spin_table)) {
+        // Rehashing a full table would cost a deadline its margin.
+        _M_expansions.reserve(table_capacity);
+        _M_values.reserve(table_capacity);
+    }
+
+private:
+    // State at the spawn of a tetromino, the sequence is `_M_pieces`.
+    struct state {
+        boards::standard _M_board;
+        attack_info _M_attack_info;
+
+        // Indices in `_M_pieces` of the held tetromino and the one in play.
+        u32 _M_hold, _M_next;
+        bool _M_holdable;
+    };
+
+    // A placement from a state, and the state after it.
+    struct child {
+        bool _M_hold = false;
+        // Index of the placement among those generated.
+        u32 _M_index = 0;
+
+        // Scores of what it sent, and of the board after it.
+        f32 _M_sent = 0, _M_board = 0;
+
+        state _M_state;
+    };
+
+    // Children of a state, best first.
+    using expansion = std::vector<child>;
+
+    user_config _M_user_config;
+    eval_weights _M_weights;
+
+    std::unique_ptr<Iattack_table> _M_attack_table;
+    std::unique_ptr<Ispin_table> _M_spin_table;
+
+    // Of the current `think()`.
+    const engine* _M_engine = nullptr;
+    std::chrono::steady_clock::time_point _M_deadline;
+    bool _M_stopped = false;
+    u64 _M_expanded = 0;
+
+    // The held tetromino (INVALID if none), the one in play, then the queue.
+    std::vector<tetromino> _M_pieces;
+
+    // Placements of the root, without and with hold.
+    std::vector<placement> _M_root_placements[2];
+
+    // Field of the state expanded, for spin checks, and all its children.
+    field _M_scratch;
+    expansion _M_all;
+    feature_batch _M_batch;
+    std::vector<board_features> _M_features;
+
+    // The transposition table: children by `_M_key(s, 0)`, values by `_M_key(s, depth)`.
+    std::unordered_map<u64, expansion> _M_expansions;
+    std::unordered_map<u64, f32> _M_values;
+
+    bool _M_has_next(const state& __s) const { return __s._M_next < _M_pieces.size(); }
+
+    // What the placements from `__s` depend on, and for a depth above 0 the
+    // tetrominoes the search to that depth sees.
+    u64 _M_key(const state& __s, u32 __depth) const;
+
+    // Children of `__s` through `__ps`, on `__f` which holds its board.
+    void _M_children(
+        const state& __s, const field& __f, bool __hold,
+        const std::vector<placement>& __ps, expansion& __out
+    );
+
+    // Placements of `__s` from where its tetrominoes spawn, at most `width`.
+    const expansion& _M_expand(const state& __s);
+
+    // Best value of `__depth` placements from `__s`, 0 if stopped.
+    f32 _M_value(const state& __s, u32 __depth);
+
+    bool _M_expired() {
+        if (!_M_stopped && std::chrono::steady_clock::now() >= _M_deadline) _M_stopped = true;
+        return _M_stopped;
+    }
+
+public:
+    /**
+     * @brief Picks a placement for the current state of `__e` within `__budget`.
+     *
+     * @return nullopt if the game is over or nothing can be placed.
+     */
+    std::optional<result> think(const engine& __e, std::chrono::nanoseconds __budget);
+
+    // Forgets the transposition table, as for a new game.
+    void clear() {
+        _M_expansions.clear();
+        _M_values.clear();
+    }
+
+    const eval_weights& weights() const { return _M_weights; }
+    void set_weights(const eval_weights& __w) { _M_weights = __w; clear(); }
+};
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <vector>
+
+#include <memory>
+#include <optional>
+
+#include <lib/intdef>
+
+#include <config.hpp>
+#include <engine.hpp>
+#include <rules/tetromino.hpp>
+#include <rules/attack_table.hpp>
+#include <rules/spin.hpp>
+#include <rules/field.hpp>
+
+#include <ai/features.hpp>
+#include <ai/movegen.hpp>
+
+// Weights of the board evaluation, the score is their dot product with
+// the features of the board after a placement.
+struct eval_weights {
+    f32 _M_aggregate_height = -0.2f;
+    f32 _M_max_height = -0.3f;
+    f32 _M_holes = -4.0f;
+    f32 _M_covered = -0.4f;
+    f32 _M_bumpiness = -0.4f;
+    f32 _M_well_depth = 0.3f;
+    f32 _M_row_transitions = -0.5f;
+    f32 _M_column_transitions = -0.8f;
+    f32 _M_tslots = 1.5f;
+
+    f32 _M_attack = 2.0f;
+    f32 _M_b2b = 1.5f;
+    // Lines cleared without attack.
+    f32 _M_wasted_clear = -1.0f;
+};
+
+/**
+ * @brief A one piece look-ahead player.
+ *
+ * Scores every placement of the current and hold tetromino by the
+ * features of the resulting board, and picks the best one.
+ * Needs the standard 10 x (20 + 4) field.
+ */
+class bot {
+public:
+    // Placement chosen by `think()`, `_M_hold` means hold first.
+    struct decision {
+        bool _M_hold;
+        placement _M_placement;
+        f32 _M_score;
+    };
+
+    bot(const user_config& __uconf, eval_weights __w = eval_weights{})
+    : _M_user_config(__uconf), _M_weights(__w),
+      _M_attack_table(attack_tables::create(__uconf.game.attack_table)),
+      _M_spin_table(spin_tables::create(__uconf.game.spin_table)) { }
+
+private:
+    user_config _M_user_config;
+    eval_weights _M_weights;
+
+    std::unique_ptr<Iattack_table> _M_attack_table;
+    std::unique_ptr<Ispin_table> _M_spin_table;
+
+    feature_batch _M_batch;
+    std::vector<board_features> _M_features;
+
+    struct outcome {
+        u32 _M_lines, _M_attack;
+        attack_info _M_attack_info;
+    };
+    std::vector<outcome> _M_outcomes;
+
+    void _M_evaluate(
+        const engine& __e, const std::vector<placement>& __ps,
+        bool __hold, std::optional<decision>& __best
+    );
+
+public:
+    /**
+     * @brief Picks a placement for the current state of `__e`.
+     *
+     * @return nullopt if the game is over or nothing can be placed.
+     */
+    std::optional<decision> think(const engine& __e);
+
+    // Part of the score from the board after a placement.
+    static f32 board_score(const eval_weights& __w, const board_features& __ft);
+
+    // Part of the score from what the placement cleared and sent.
+    static f32 clear_score(const eval_weights& __w, u32 __lines, u32 __attack, const attack_info& __atk);
+
+    const eval_weights& weights() const { return _M_weights; }
+    void set_weights(const eval_weights& __w) { _M_weights = __w; }
+};
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cstddef>
+
+#include <lib/intdef>
+
+/*
+ * Feature kernel shared by every instruction set.
+ *
+ * `_V` provides the vector operations on u16 lanes. Each translation unit
+ * defines its own `_V` in an anonymous namespace, so instantiations built
+ * with different target flags never merge at link time. For the same
+ * reason this header must not call any non-template function.
+ *
+ * Required operations of `_V`:
+ *   reg, lanes, load, store, set1, zero,
+ *   and_, or_, xor_, andnot (~a & b), shl, shr (by runtime count),
+ *   add, subs (saturating), min, max, cmpgt (all ones if a > b).
+ */
+
+namespace features::detail {
+
+// Output order, one u16 row of `stride` lanes per value.
+enum feature_index : std::size_t {
+    HEIGHTS = 0,
+    MAX_HEIGHT = HEIGHTS + 10,
+    AGGREGATE_HEIGHT, HOLES, COVERED, BUMPINESS,
+    WELL_DEPTH, WELL_COLUMN,
+    ROW_TRANSITIONS, COLUMN_TRANSITIONS, TSLOTS,
+    COUNT
+};
+
+// Kernels of each instruction set, return false if not built in.
+bool kernel_scalar(const u16* __rows, std::size_t __stride, std::size_t __end, u16* __out);
+bool kernel_sse2(const u16* __rows, std::size_t __stride, std::size_t __end, u16* __out);
+bool kernel_avx2(const u16* __rows, std::size_t __stride, std::size_t __end, u16* __out);
+
+template <typename _V>
+inline typename _V::reg popcount(typename _V::reg __x) {
+    using V = _V;
+    __x = V::subs(__x, V::and_(V::shr(__x, 1), V::set1(0x5555)));
+    __x = V::add(V::and_(__x, V::set1(0x3333)), V::and_(V::shr(__x, 2), V::set1(0x3333)));
+    __x = V::and_(V::add(__x, V::shr(__x, 4)), V::set1(0x0F0F));
+    return V::and_(V::add(__x, V::shr(__x, 8)), V::set1(0x001F));
+}
+
+/**
+ * Extracts features of lanes [__begin, __end), `__end - __begin` must be
+ * a multiple of `_V::lanes`. Board size is fixed to 10 x 24.
+ */
+template <typename _V>
+void feature_kernel(
+    const u16* __rows, std::size_t __stride,
+    std::size_t __begin, std::size_t __end, u16* __out
+) {
+    using V = _V;
+    using reg = typename V::reg;
+
+    constexpr u32 W = 10, H = 24, PLANES = 5;
+
+    const reg __full = V::set1((1u << W) - 1);
+    // Row with walls: field at bits [1, W], walls at bit 0 and W + 1.
+    const reg __walls = V::set1(1u | (1u << (W + 1)));
+    const reg __inner = V::set1(((1u << W) - 1) << 1);
+
+    for (std::size_t __b = __begin; __b < __end; __b += V::lanes) {
+        reg __r[H], __cover[H + 1];
+
+        for (u32 __y = 0; __y < H; ++__y)
+            __r[__y] = V::and_(V::load(__rows + __y * __stride + __b), __full);
+
+        // __cover[y] has bit c if column c has a block at or above y.
+        __cover[H] = V::zero();
+        for (u32 __y = H; __y > 0; --__y)
+            __cover[__y - 1] = V::or_(__cover[__y], __r[__y - 1]);
+
+        // Column heights as bit-sliced counters of __cover.
+        reg __plane[PLANES];
+        for (u32 __k = 0; __k < PLANES; ++__k) __plane[__k] = V::zero();
+
+        reg __holes = V::zero(), __covered = V::zero(),
+            __row_t = V::zero(), __col_t = V::zero(), __tslots = V::zero();
+        reg __hole_below = V::zero(), __prev = __full;
+
+        reg __e[H + 2];
+        for (u32 __y = 0; __y < H; ++__y)
+            __e[__y] = V::or_(V::shl(__r[__y], 1), __walls);
+        __e[H] = __e[H + 1] = __walls;
+
+        for (u32 __y = 0; __y < H; ++__y) {
+            reg __carry = __cover[__y];
+            for (u32 __k = 0; __k < PLANES; ++__k) {
+                reg __c = V::and_(__plane[__k], __carry);
+                __plane[__k] = V::xor_(__plane[__k], __carry);
+                __carry = __c;
+            }
+
+            reg __hole = V::andnot(__r[__y], __cover[__y + 1]);
+            __holes = V::add(__holes, popcount<V>(__hole));
+
+            __covered = V::add(__covered, popcount<V>(V::and_(__r[__y], __hole_below)));
+            __hole_below = V::or_(__hole_below, __hole);
+
+            __col_t = V::add(__col_t, popcount<V>(V::xor_(__r[__y], __prev)));
+            __prev = __r[__y];
+
+            // Only rows below the highest block.
+            reg __used = V::cmpgt(__cover[__y], V::zero());
+            reg __t = V::xor_(__e[__y], V::shr(__e[__y], 1));
+            __row_t = V::add(__row_t, V::and_(__used, popcount<V>(V::and_(__t, V::set1((1u << (W + 1)) - 1)))));
+
+            // Center empty with both sides filled, then three empty cells,
+            // then a roof on either side with the center open.
+            reg __a = __e[__y], __m = __e[__y + 1], __c = __e[__y + 2];
+            reg __slot = V::andnot(__a, V::and_(V::shl(__a, 1), V::shr(__a, 1)));
+            __slot = V::andnot(V::or_(__m, V::or_(V::shl(__m, 1), V::shr(__m, 1))), __slot);
+            __slot = V::and_(__slot, V::andnot(__c, V::or_(V::shl(__c, 1), V::shr(__c, 1))));
+            __tslots = V::add(__tslots, popcount<V>(V::and_(__slot, __inner)));
+        }
+        // Top of each column.
+        __col_t = V::add(__col_t, popcount<V>(__prev));
+
+        reg __h[W];
+        reg __max = V::zero(), __sum = V::zero();
+        for (u32 __x = 0; __x < W; ++__x) {
+            __h[__x] = V::zero();
+            for (u32 __k = 0; __k < PLANES; ++__k) {
+                reg __bit = V::and_(V::shr(__plane[__k], __x), V::set1(1));
+                __h[__x] = V::or_(__h[__x], V::shl(__bit, __k));
+            }
+
+            V::store(__out + (HEIGHTS + __x) * __stride + __b, __h[__x]);
+            __max = V::max(__max, __h[__x]);
+            __sum = V::add(__sum, __h[__x]);
+        }
+
+        reg __bump = V::zero();
+        for (u32 __x = 0; __x + 1 < W; ++__x) {
+            reg __d = V::subs(V::max(__h[__x], __h[__x + 1]), V::min(__h[__x], __h[__x + 1]));
+            __bump = V::add(__bump, __d);
+        }
+
+        // Walls are higher than any column.
+        reg __well = V::zero(), __well_x = V::zero();
+        const reg __wall = V::set1(H + 1);
+        for (u32 __x = 0; __x < W; ++__x) {
+            reg __l = __x == 0 ? __wall : __h[__x - 1];
+            reg __r2 = __x + 1 == W ? __wall : __h[__x + 1];
+            reg __d = V::subs(V::min(__l, __r2), __h[__x]);
+
+            reg __better = V::cmpgt(__d, __well);
+            __well = V::max(__well, __d);
+            __well_x = V::or_(V::and_(__better, V::set1(__x)), V::andnot(__better, __well_x));
+        }
+
+        V::store(__out + MAX_HEIGHT * __stride + __b, __max);
+        V::store(__out + AGGREGATE_HEIGHT * __stride + __b, __sum);
+        V::store(__out + HOLES * __stride + __b, __holes);
+        V::store(__out + COVERED * __stride + __b, __covered);
+        V::store(__out + BUMPINESS * __stride + __b, __bump);
+        V::store(__out + WELL_DEPTH * __stride + __b, __well);
+        V::store(__out + WELL_COLUMN * __stride + __b, __well_x);
+        V::store(__out + ROW_TRANSITIONS * __stride + __b, __row_t);
+        V::store(__out + COLUMN_TRANSITIONS * __stride + __b, __col_t);
+        V::store(__out + TSLOTS * __stride + __b, __tslots);
+    }
+}
+
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include <algorithm>
+
+#include <cstddef>
+
+#include <lib/intdef>
+
+#include <rules/board.hpp>
+
+/*
+ * Board features used to score placements.
+ *
+ * Features are extracted from `boards::standard` occupancy only,
+ * for many boards at once. Boards are stored as structure of arrays
+ * (row `y` of every board is contiguous), so each vector lane holds
+ * the same row of a different board.
+ */
+
+struct board_features {
+    // Height of each column, see `field::column_heights()`.
+    std::array<u8, boards::standard::width()> _M_heights;
+
+    u16 _M_max_height;
+    u16 _M_aggregate_height;
+    // Empty cells with a block somewhere above them.
+    u16 _M_holes;
+    // Blocks with a hole somewhere below them.
+    u16 _M_covered;
+    // Sum of height differences between adjacent columns.
+    u16 _M_bumpiness;
+    // Deepest well, and its column.
+    u16 _M_well_depth;
+    u16 _M_well_column;
+    // Filled/empty changes along rows (walls are filled),
+    // counted on rows below the highest block.
+    u16 _M_row_transitions;
+    // Filled/empty changes along columns (floor is filled).
+    u16 _M_column_transitions;
+    // Three wide gaps under a roof, with a single cell opening below.
+    u16 _M_tslots;
+};
+
+namespace features {
+
+enum class isa {
+    scalar, sse2, avx2
+};
+
+// Instruction set used by `extract()` on this machine.
+isa detect();
+
+// Number of u16 values each board has in the structure of arrays output.
+inline constexpr std::size_t output_count = boards::standard::width() + 10;
+
+/**
+ * @brief Extracts features of `__count` boards.
+ *
+ * @param __rows Row `y` of board `b` is `__rows[y * __stride + b]`.
+ * @param __stride Distance between rows, a multiple of 16 and at least `__count`.
+ * Lanes between `__count` and `__stride` are read but not reported.
+ * @param __out Receives `__count` results.
+ * @param __scratch `output_count * __stride` values, where the features of
+ * every lane are computed before they are copied to `__out`.
+ * @param __isa Instruction set to use, clamped to what the machine supports.
+ */
+void extract(
+    const u16* __rows, std::size_t __stride, std::size_t __count,
+    board_features* __out, u16* __scratch, isa __isa = detect()
+);
+
+}
+
+/**
+ * @brief Collects candidate boards and extracts their features at once.
+ *
+ * Typical usage is a move generator pushing the board after each
+ * candidate placement, then scoring the results in one call.
+ */
+class feature_batch {
+public:
+    feature_batch(std::size_t __capacity = 64) { reserve(__capacity); }
+
+private:
+    // Structure of arrays, `_M_stride` lanes per row.
+    std::vector<u16> _M_rows;
+    // For `features::extract()`, sized with the stride so scoring does not allocate.
+    std::vector<u16> _M_scratch;
+    std::size_t _M_stride = 0, _M_size = 0;
+
+public:
+    void reserve(std::size_t __capacity) {
+        std::size_t __stride = (__capacity + 15) / 16 * 16;
+        if (__stride <= _M_stride) return;
+
+        std::vector<u16> __rows(__stride * boards::standard::height(), 0);
+        for (u32 __y = 0; __y < boards::standard::height(); ++__y)
+            std::copy_n(_M_rows.begin() + __y * _M_stride, _M_size, __rows.begin() + __y * __stride);
+
+        _M_rows = std::move(__rows);
+        _M_scratch.resize(features::output_count * __stride);
+        _M_stride = __stride;
+    }
+
+    void clear() { _M_size = 0; }
+
+    // Returns the index of the pushed board.
+    std::size_t push(const boards::standard& __b) {
+        if (_M_size == _M_stride) reserve(_M_stride * 2);
+
+        for (u32 __y = 0; __y < boards::standard::height(); ++__y)
+            _M_rows[__y * _M_stride + _M_size] = __b.rows()[__y];
+
+        return _M_size++;
+    }
+
+    void extract(std::vector<board_features>& __out, features::isa __isa = features::detect()) {
+        __out.resize(_M_size);
+        features::extract(_M_rows.data(), _M_stride, _M_size, __out.data(), _M_scratch.data(), __isa);
+    }
+
+    std::size_t size() const { return _M_size; }
+    bool empty() const { return _M_size == 0; }
+};
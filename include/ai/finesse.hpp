@@ -0,0 +1,100 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <optional>
+
+#include <lib/intdef>
+
+#include <config.hpp>
+#include <rules/tetromino.hpp>
+#include <rules/field.hpp>
+
+#include <ai/movegen.hpp>
+
+class engine;
+
+namespace finesse {
+
+using control_key = placement::control_key;
+
+// Keys of one placement, from its spawn, the final DROP included.
+struct result {
+    u32 _M_minimal, _M_used;
+
+    bool fault() const { return _M_used > _M_minimal; }
+    u32 extra() const { return fault() ? _M_used - _M_minimal : 0; }
+};
+
+// Finesse of the placements of a game so far.
+struct tally {
+    u32 _M_placements = 0, _M_faults = 0, _M_extra_keys = 0;
+
+    void add(const result& __r) {
+        _M_placements++;
+        _M_faults += __r.fault();
+        _M_extra_keys += __r.extra();
+    }
+
+    // Share of placements without a fault, 1 before the first one.
+    f64 rate() const
+    { return _M_placements ? 1 - (f64)_M_faults / _M_placements : 1; }
+};
+
+/**
+ * @brief Fewest keys to put the tetromino in play of an engine where a hard
+ * drop would put it now, counted from its spawn.
+ *
+ * Placements covering the same cells are the same, so the two directions
+ * of I, S and Z and the four of O are interchangeable.
+ *
+ * The shortest inputs from spawn to every resting place on the empty field
+ * are searched once per tetromino, when the checker is built. On the actual
+ * board, the inputs for the placement are played first: if they end on the
+ * same cells, their length is the answer, as finesse is usually counted,
+ * even where a kick off the stack would save a key. Otherwise the way is
+ * blocked, or the tetromino was tucked or spun in, and `movegen::generate()`
+ * searches the actual board.
+ */
+class checker {
+public:
+    // Empty field inputs longer than that are searched on the actual board.
+    static constexpr u32 max_inputs = 16;
+
+    // For the rules, field size and spawn of `__e`.
+    explicit checker(const engine& __e);
+
+private:
+    // Shortest inputs to a resting place on the empty field, DROP excluded.
+    struct way {
+        u32 _M_size = 0;
+        std::array<control_key, max_inputs> _M_keys;
+        bool _M_valid = false;
+    };
+
+    // Columns start up to `_S_margin` cells left of the field.
+    static constexpr i32 _S_margin = 4;
+
+    u32 _M_columns;
+    // Indexed by type, direction and column.
+    std::vector<way> _M_ways;
+
+    way& _M_way(mino_type __t, u32 __d, i32 __x)
+    { return _M_ways[((u32)__t * 4 + __d) * _M_columns + __x + _S_margin]; }
+
+    const way* _M_find(mino_type __t, u32 __d, i32 __x) const {
+        if (__x + _S_margin < 0 || __x + _S_margin >= (i32)_M_columns) return nullptr;
+
+        const way& __w = _M_ways[((u32)__t * 4 + __d) * _M_columns + __x + _S_margin];
+        return __w._M_valid ? &__w : nullptr;
+    }
+
+public:
+    /**
+     * @return Fewest keys, the DROP included, or nullopt if there is no
+     *         tetromino in play or it can not get there from its spawn.
+     */
+    std::optional<u32> minimal(const engine& __e) const;
+};
+
+}
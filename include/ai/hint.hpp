@@ -0,0 +1,155 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <optional>
+#include <random>
+
+#include <lib/intdef>
+
+#include <config.hpp>
+#include <engine.hpp>
+#include <rules/bag.hpp>
+#include <rules/tetromino.hpp>
+
+#include <ai/bot.hpp>
+#include <ai/features.hpp>
+
+/**
+ * @brief Best placement of the tetromino in play, searched on a background
+ * thread for the hint shown in game.
+ *
+ * `request()` hands over the state of an engine and cancels the search in
+ * progress, which checks for it between placements. The search is a beam
+ * search over the tetromino in play or the held one, then the queue shown:
+ * every placement of the first, then the `beam` best lines at each deeper
+ * tetromino. A line is worth what it sent, scored as the bot does, plus the
+ * board it ends on. After each tetromino the best first placement so far is
+ * published, so `latest()` has one soon after a request and better ones
+ * until the queue shown is used up or the time budget is spent.
+ *
+ * States expanded by a search are kept for the next one: once the player
+ * places the tetromino where one of the lines did, the new search starts
+ * from that line's expansions instead of generating them again.
+ *
+ * Needs the standard 10 x (20 + 4) field, and is not for puzzles.
+ */
+class hint_search {
+public:
+    static constexpr u32 beam = 8;
+
+    struct result {
+        // Request this answers, see `request()`.
+        u64 _M_request;
+        // Hold first, then put `_M_mino` at (_M_x, _M_y).
+        bool _M_hold;
+        tetromino _M_mino;
+        i32 _M_x, _M_y;
+        // Tetrominoes looked at.
+        u32 _M_depth;
+    };
+
+    hint_search(
+        const user_config& __uconf, bags::types __bag_type,
+        eval_weights __w = eval_weights{},
+        std::chrono::milliseconds __budget = std::chrono::milliseconds(100)
+    );
+
+    ~hint_search();
+
+    hint_search(const hint_search&) = delete;
+    hint_search& operator=(const hint_search&) = delete;
+
+private:
+    // A placement from a state, and the state after it.
+    struct child {
+        bool _M_hold = false;
+        tetromino _M_mino = tetromino::INVALID;
+        i32 _M_x = 0, _M_y = 0;
+
+        // Scores of what it sent, and of the board after it.
+        f32 _M_sent = 0, _M_board = 0;
+
+        // At the spawn of the next tetromino, which may be held.
+        engine::save_data _M_state;
+    };
+
+    // The `beam` best children of a state, best first.
+    using expansion = std::vector<child>;
+
+    // A line of placements from the state searched.
+    struct line {
+        std::shared_ptr<const expansion> _M_from;
+        u32 _M_index = 0;
+
+        // What the line sent, and that plus the board it ends on.
+        f32 _M_sent = 0, _M_value = 0;
+
+        // First placement of the line.
+        bool _M_hold = false;
+        tetromino _M_mino = tetromino::INVALID;
+        i32 _M_x = 0, _M_y = 0;
+
+        const engine::save_data& state() const { return (*_M_from)[_M_index]._M_state; }
+    };
+
+    user_config _M_user_config;
+    eval_weights _M_weights;
+    std::chrono::milliseconds _M_budget;
+
+    // Played on by the search only.
+    std::mt19937 _M_rand;
+    engine _M_engine;
+    feature_batch _M_batch;
+    std::vector<board_features> _M_features;
+    std::vector<child> _M_children;
+
+    // Expansions of this search and of the previous one, by `_S_key()`.
+    std::unordered_map<u64, std::shared_ptr<const expansion>> _M_cache, _M_previous;
+
+    std::thread _M_thread;
+    mutable std::mutex _M_mutex;
+    std::condition_variable _M_wake;
+    bool _M_stop = false;
+
+    // Last request, a search whose request is older gives up.
+    std::atomic<u64> _M_request = 0;
+    // State of the request not taken yet, and whether it may hold.
+    std::optional<engine::save_data> _M_pending;
+    bool _M_pending_holdable = true;
+    std::optional<result> _M_result;
+
+    static u64 _S_key(const engine::save_data& __dt, bool __holdable);
+
+    bool _M_current(u64 __request) const
+    { return _M_request.load(std::memory_order_relaxed) == __request; }
+
+    // The `beam` best placements from `__s`, nullptr if cancelled.
+    std::shared_ptr<const expansion> _M_expand(const engine::save_data& __s, bool __holdable, u64 __request);
+
+    void _M_search(const engine::save_data& __root, bool __holdable, u64 __request);
+    void _M_publish(const line& __best, u64 __request, u32 __depth);
+    void _M_run();
+
+public:
+    /**
+     * @brief Searches the state of `__e` from now on, dropping the search in
+     * progress. Copies the state, the engine may change right after.
+     *
+     * @return Number of the request, to match with `result::_M_request`.
+     */
+    u64 request(const engine& __e);
+
+    // Drops the search in progress, `latest()` is empty until the next request.
+    void cancel();
+
+    // Best placement found for the last request so far, nullopt if none yet.
+    std::optional<result> latest() const;
+};
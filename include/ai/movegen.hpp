@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <utility>
+
+#include <lib/intdef>
+
+#include <config.hpp>
+#include <rules/tetromino.hpp>
+#include <rules/kick_table.hpp>
+#include <rules/field.hpp>
+
+class engine;
+
+/**
+ * @brief A final resting position of a tetromino, and how to get there.
+ */
+struct placement {
+    using control_key = user_config::control_config::KEYS;
+
+    tetromino _M_mino;
+    i32 _M_x, _M_y;
+
+    // Whether the last move was a rotation, and the kick it used
+    // (-1 if no kick was needed). Spin detection needs both.
+    bool _M_rotated;
+    i32 _M_kick_index;
+
+    // Keys from the spawn position, the final DROP included.
+    std::vector<control_key> _M_inputs;
+};
+
+namespace movegen {
+
+/**
+ * @brief Finds every placement of `__t` reachable from (__x, __y).
+ *
+ * Breadth first search over moves, rotations and soft drops, so the inputs
+ * of each placement are as short as the search can find. Placements that
+ * end at the same position differ only if one of them ends with a rotation.
+ *
+ * @param __inf_soft_drop Soft drop goes all the way down, as in `engine::down()`.
+ */
+std::vector<placement> generate(
+    const field& __f, const Ikick_table& __kicks,
+    const tetromino& __t, i32 __x, i32 __y,
+    bool __inf_soft_drop
+);
+
+// Same, on a board of the standard size without its field, for searches
+// that play ahead on boards of their own.
+std::vector<placement> generate(
+    const boards::standard& __b, const Ikick_table& __kicks,
+    const tetromino& __t, i32 __x, i32 __y,
+    bool __inf_soft_drop
+);
+
+// Where `__e` would spawn `__t` on `__b`, extended spawn included.
+std::pair<i32, i32> spawn_position(const engine& __e, const boards::standard& __b, const tetromino& __t);
+
+/**
+ * @brief Placements of the tetromino in play in `__e`, or with `__hold`,
+ * of the one a hold would bring in.
+ *
+ * The hold placements start where `engine::hold()` would spawn the
+ * tetromino; there are none if hold is not available now.
+ */
+std::vector<placement> generate(const engine& __e, bool __hold);
+
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <memory>
+#include <filesystem>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include <lib/intdef>
+
+#include <engine.hpp>
+#include <session.hpp>
+#include <rules/bag.hpp>
+
+#include <util/trace.hpp>
+
+/**
+ * @brief Saves the session of an engine to a file, from a background thread.
+ *
+ * `capture()` copies the engine state into a snapshot, on the caller's
+ * thread, and hands it to the writer thread, which serializes it and
+ * replaces the file (see `session::save()`). The caller never waits for the
+ * disk: while a save is still being written, `capture()` skips.
+ *
+ * There are two snapshots, one the caller fills and one the writer reads,
+ * swapped under the lock when a capture is handed over. Both keep their
+ * storage, so a capture is a copy without allocations once warm.
+ */
+class autosaver {
+    std::filesystem::path _M_path;
+
+    // Filled by `capture()`, and read by the writer.
+    std::unique_ptr<session> _M_front, _M_back;
+
+    std::mutex _M_mutex;
+    std::condition_variable _M_cv;
+    // `_M_back` holds a capture not written yet.
+    bool _M_pending = false;
+    bool _M_stop = false;
+    // Handed over and not written yet, read without the lock by `capture()`.
+    std::atomic<bool> _M_busy = false;
+    std::atomic<u64> _M_saved = 0, _M_failed = 0;
+
+    std::thread _M_writer;
+
+    void _M_run() {
+        std::unique_lock __lock(_M_mutex);
+
+        while (true) {
+            _M_cv.wait(__lock, [this] { return _M_pending || _M_stop; });
+            if (!_M_pending) break;
+
+            __lock.unlock();
+            bool __ok = _M_back->save(_M_path);
+            __lock.lock();
+
+            (__ok ? _M_saved : _M_failed)++;
+            _M_pending = false;
+            _M_busy.store(false, std::memory_order_release);
+            _M_cv.notify_all();
+        }
+    }
+
+public:
+    autosaver(std::filesystem::path __path, bags::types __bag, session::game_mode __mode)
+    : _M_path(std::move(__path)),
+      _M_front(std::make_unique<session>()), _M_back(std::make_unique<session>()) {
+        _M_front->_M_bag = _M_back->_M_bag = __bag;
+        _M_front->_M_mode = _M_back->_M_mode = __mode;
+        _M_writer = std::thread(&autosaver::_M_run, this);
+    }
+
+    // Writes the capture handed over last, if any, before returning.
+    ~autosaver() {
+        {
+            std::lock_guard __lock(_M_mutex);
+            _M_stop = true;
+        }
+        _M_cv.notify_all();
+        _M_writer.join();
+    }
+
+    autosaver(const autosaver&) = delete;
+    autosaver& operator=(const autosaver&) = delete;
+
+    /**
+     * @brief Takes the session of `__e` and hands it to the writer.
+     *
+     * @return false if the last save is still being written, nothing is taken then.
+     */
+    bool capture(const engine& __e) {
+        if (_M_busy.load(std::memory_order_acquire)) return false;
+
+        {
+            TRACE_SPAN("autosave capture");
+            __e.save_session(_M_front->_M_data);
+        }
+
+        {
+            std::lock_guard __lock(_M_mutex);
+            std::swap(_M_front, _M_back);
+            _M_pending = true;
+            _M_busy.store(true, std::memory_order_release);
+        }
+        _M_cv.notify_one();
+
+        return true;
+    }
+
+    // Waits until the capture handed over last is written.
+    void wait() {
+        std::unique_lock __lock(_M_mutex);
+        _M_cv.wait(__lock, [this] { return !_M_pending; });
+    }
+
+    // Saves `__e` now, waiting for the save in progress and for this one.
+    void save(const engine& __e) {
+        wait();
+        capture(__e);
+        wait();
+    }
+
+    // Deletes the file, once the save in progress is written.
+    void remove() {
+        wait();
+
+        std::error_code __ec;
+        std::filesystem::remove(_M_path, __ec);
+    }
+
+    const std::filesystem::path& path() const { return _M_path; }
+
+    u64 saved() const { return _M_saved.load(std::memory_order_relaxed); }
+    u64 failed() const { return _M_failed.load(std::memory_order_relaxed); }
+};
@@ -0,0 +1,268 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include <memory>
+#include <random>
+#include <type_traits>
+
+#include <lib/intdef>
+
+#include <config.hpp>
+#include <engine.hpp>
+#include <rules/tetromino.hpp>
+#include <rules/attack_table.hpp>
+#include <rules/kick_table.hpp>
+#include <rules/spin.hpp>
+#include <rules/bag.hpp>
+#include <rules/board.hpp>
+
+/*
+ * State of one game of a `batch_engine`, written by `step()` and `observe()`.
+ *
+ * Plain data, so a buffer of observations can be handed to other languages
+ * (e.g. viewed as a numpy structured array) without conversion.
+ */
+struct batch_observation {
+    // Occupancy, row 0 is the bottom, bit x is column x.
+    std::array<u16, boards::standard::height()> _M_rows;
+
+    // Current tetromino, `mino_type` and direction, and its position.
+    u8 _M_current, _M_direction;
+    i8 _M_x, _M_y;
+    // Y position of its ghost.
+    i8 _M_ghost_y;
+
+    // Held tetromino, `mino_type::INVALID` if none.
+    u8 _M_hold;
+    u8 _M_holdable;
+
+    // First tetrominoes of the queue, `mino_type::INVALID` past its end.
+    std::array<u8, 7> _M_queue;
+
+    u8 _M_over;
+
+    // What the last step did: whether it dropped a tetromino, and the
+    // lines, attack and spin of that drop (0 otherwise).
+    u8 _M_dropped;
+    u8 _M_lines;
+    u8 _M_spin;
+    u16 _M_attack;
+
+    i16 _M_combo, _M_b2b;
+};
+
+static_assert(std::is_trivially_copyable_v<batch_observation>);
+
+/**
+ * @brief Rules of many games at once, stepped in lockstep.
+ *
+ * Same rules as `engine` (and the same sequences for the same seeds),
+ * for the standard 10 x (20 + 4) field, without rendering, undo, puzzle
+ * mode or attack history. Games share the rules, each has its own seed.
+ *
+ * State is kept as structure of arrays: row `y` of every board is
+ * contiguous (see `rows()`), as are positions, pieces, attack and stats.
+ * `step()` takes one action per game and runs each phase (moves,
+ * rotations with kicks, drops, line clears, attack, spawns) over all the
+ * games that take part in it, instead of one game at a time.
+ */
+class batch_engine {
+public:
+    using control_key = engine::control_key;
+
+    /**
+     * @param __count Number of games.
+     * @param __seed Game `g` starts with seed `__seed + g`.
+     */
+    batch_engine(
+        std::size_t __count, u32 __seed,
+        user_config __uconf = user_config{},
+        bags::types __bag_type = bags::types::bag7
+    );
+
+private:
+    static constexpr u32 _S_width = boards::standard::width();
+    static constexpr u32 _S_height = boards::standard::height();
+    static constexpr u16 _S_full_row = boards::standard::full_row;
+
+    // Bits of a row padded with walls: column x is bit x + 8,
+    // the 8 bits below and everything above the field are set.
+    static constexpr u64 _S_walls = 0xFFull | ~0ull << (8 + _S_width);
+
+    user_config _M_user_config;
+
+    std::size_t _M_count, _M_stride;
+    // Length of every queue, see `engine::_M_get_next()`.
+    u32 _M_queue_size;
+
+    std::unique_ptr<Iattack_table> _M_attack_table;
+
+    // Row masks of each `mino_type` and direction, index `type * 4 + direction`.
+    std::array<std::array<u8, 4>, 28> _M_shapes;
+    // Lowest row of each shape with a block.
+    std::array<u8, 28> _M_bottoms;
+    std::array<u8, 7> _M_sizes;
+
+    // Kicks of each `mino_type`, direction and rotation (cw, 180, ccw),
+    // as ranges of `_M_kicks`.
+    std::vector<std::pair<i8, i8>> _M_kicks;
+    std::array<std::pair<u16, u16>, 7 * 4 * 3> _M_kick_ranges;
+    u32 _M_max_kicks = 0;
+
+    /* Per game state, index `g` (rows: `y * _M_stride + g`) */
+
+    std::vector<u16> _M_rows;
+    // No block at or above this row, to skip the empty rows when dropping.
+    std::vector<u8> _M_top;
+
+    std::vector<u8> _M_type, _M_direction;
+    std::vector<i32> _M_x, _M_y;
+
+    std::vector<u8> _M_hold, _M_holdable;
+    // `_M_queue_size` entries per game.
+    std::vector<u8> _M_queue;
+    std::vector<bag_generator> _M_bags;
+
+    std::vector<u8> _M_over;
+
+    std::vector<u8> _M_last_spin;
+    std::vector<i32> _M_kick_index;
+
+    std::vector<u8> _M_atk_type, _M_atk_spin, _M_atk_pc;
+    std::vector<i32> _M_combo, _M_btb;
+
+    // 64 bits, as `engine::stats_data`.
+    std::vector<u64> _M_lines, _M_attack, _M_place_count, _M_input_count, _M_topouts;
+
+    /* Scratch of `step()`, sized once */
+
+    // Games taking part in the current phase.
+    std::vector<u32> _M_sel;
+    std::vector<u32> _M_next_sel;
+    // Candidate position of each game, and whether it collides.
+    std::vector<u8> _M_cand_dir;
+    // Kicks of a rotating game, index of `_M_kick_ranges`.
+    std::vector<u16> _M_cand_kicks;
+    std::vector<i32> _M_cand_x, _M_cand_y;
+    std::vector<u8> _M_hit;
+
+    std::vector<u8> _M_step_dropped, _M_step_lines, _M_step_spin;
+    std::vector<u16> _M_step_attack;
+
+private:
+    static u32 _S_shape(u32 __type, u32 __direction) { return __type * 4 + __direction; }
+
+    // Row `__y` of game `__g` padded with walls, rows out of the field are full.
+    u64 _M_walled_row(std::size_t __g, i32 __y) const {
+        if (__y < 0 || __y >= (i32)_S_height) return ~0ull;
+        return (u64)_M_rows[__y * _M_stride + __g] << 8 | _S_walls;
+    }
+
+    bool _M_collides(std::size_t __g, u32 __shape, i32 __x, i32 __y) const {
+        if (__x < -8 || __x > 48) return true;
+
+        const auto& __m = _M_shapes[__shape];
+        for (u32 __i = 0; __i < 4; ++__i)
+            if (__m[__i] && (_M_walled_row(__g, __y - __i) & (u64)__m[__i] << (__x + 8)))
+                return true;
+
+        return false;
+    }
+
+    bool _M_filled(std::size_t __g, i32 __x, i32 __y) const
+    { return (_M_walled_row(__g, __y) >> (__x + 8)) & 1; }
+
+    // Tests the candidate of every game in `_M_sel` into `_M_hit`.
+    void _M_collide_selected();
+
+    i32 _M_drop_distance(std::size_t __g) const;
+    spin_type _M_spin(std::size_t __g, bool __immobile) const;
+
+    void _M_move(const u8* __actions);
+    void _M_rotate(const u8* __actions);
+    void _M_hold_piece(std::size_t __g);
+    void _M_drop(const u8* __actions);
+
+    // Pops the next tetromino of game `__g` from its queue.
+    u8 _M_next(std::size_t __g);
+    // Spawns the next tetromino of every game in `_M_sel`.
+    void _M_spawn_selected();
+    // Spawns the current tetromino of game `__g`, for holds and restarts.
+    // Returns false if the game topped out.
+    bool _M_spawn(std::size_t __g);
+    // Moves the tetromino up for extended spawn, or ends the game, or
+    // clears the field in marathon.
+    bool _M_spawn_blocked(std::size_t __g);
+
+    void _M_restart(std::size_t __g);
+
+public:
+    std::size_t size() const { return _M_count; }
+    const user_config& config() const { return _M_user_config; }
+
+    /**
+     * @brief Applies `__actions[g]` (a `control_key`) to every game `g`.
+     *
+     * Games that are over ignore their action, as `engine::apply()` does;
+     * UNDO, REDO, EARLIER and LATER do nothing. If `__out` is not null, it receives the
+     * observation of every game, see `observe()`.
+     */
+    void step(const u8* __actions, batch_observation* __out = nullptr);
+
+    // Writes the observation of every game into `__out[0, size())`.
+    void observe(batch_observation* __out) const;
+
+    // Starts game `__g` again with seed `__seed`.
+    void reset(std::size_t __g, u32 __seed);
+
+    // Pushes garbage rows into game `__g`, see `field::put_garbage()`.
+    // `__hole` must be a column of the field.
+    void garbage(std::size_t __g, u32 __cnt, u32 __hole);
+
+    /**
+     * @brief Boards as structure of arrays, row `y` of game `g` is
+     * `rows()[y * stride() + g]`.
+     *
+     * This is the layout `features::extract()` takes, so the features of
+     * every board can be extracted in place.
+     */
+    const u16* rows() const { return _M_rows.data(); }
+    // A multiple of 16, lanes past `size()` are empty boards.
+    std::size_t stride() const { return _M_stride; }
+
+    mino_type current(std::size_t __g) const { return static_cast<mino_type>(_M_type[__g]); }
+    u32 direction(std::size_t __g) const { return _M_direction[__g]; }
+    i32 x(std::size_t __g) const { return _M_x[__g]; }
+    i32 y(std::size_t __g) const { return _M_y[__g]; }
+    i32 ghost_y(std::size_t __g) const { return _M_y[__g] - _M_drop_distance(__g); }
+
+    mino_type held(std::size_t __g) const { return static_cast<mino_type>(_M_hold[__g]); }
+    bool holdable(std::size_t __g) const { return _M_holdable[__g]; }
+
+    // `queue_size()` tetrominoes, front first.
+    const u8* queue(std::size_t __g) const { return _M_queue.data() + __g * _M_queue_size; }
+    u32 queue_size() const { return _M_queue_size; }
+
+    bool is_over(std::size_t __g) const { return _M_over[__g]; }
+
+    attack_info last_attack(std::size_t __g) const {
+        return {
+            static_cast<attack_type>(_M_atk_type[__g]), _M_combo[__g], _M_btb[__g],
+            static_cast<spin_type>(_M_atk_spin[__g]), (bool)_M_atk_pc[__g]
+        };
+    }
+
+    engine::stats_data stats(std::size_t __g) const {
+        // Back-to-back and combo of the stats are copied from the attack at
+        // each drop, and start at 0 where the attack starts at -1.
+        bool __placed = _M_place_count[__g] > 0;
+
+        return {
+            _M_lines[__g], _M_attack[__g],
+            __placed ? (u32)_M_btb[__g] : 0, __placed ? (u32)_M_combo[__g] : 0,
+            _M_place_count[__g], _M_input_count[__g], _M_topouts[__g]
+        };
+    }
+};
@@ -4,14 +4,18 @@
 
 #include <lib/intdef>
 
+#include <key_code.hpp>
+
 #include <rules/attack_table.hpp>
 #include <rules/kick_table.hpp>
 #include <rules/spin.hpp>
 
 // configuration about game.
 struct user_config {
+    // Marathon is zen without an end: topping out clears the field and
+    // the game goes on, counting it in the stats.
     enum class game_mode {
-        zen, puzzle, custom
+        zen, puzzle, custom, marathon
     };
 
     struct hold_config {
@@ -22,6 +26,8 @@ struct user_config {
     struct field_config {
         // needs extra height for spawn mino and garbage.
         // default extra height is 4.
+        // 10 x (20 + 4) uses a fixed-size board specialization,
+        // any other size falls back to a dynamic board.
         u32 width = 10, height = 20, extra_height = 4;
     } field;
 
@@ -34,24 +40,28 @@ struct user_config {
     struct control_config {
         enum class KEYS : i32 {
             LEFT, RIGHT, DOWN, ROTATE_CW, ROTATE_CCW, ROTATE_180,
-            DROP, HOLD, RESET, QUIT, UNDO, REDO
+            DROP, HOLD, RESET, QUIT, UNDO, REDO,
+            // Through the undo history in the order it was played, across branches.
+            EARLIER, LATER
         };
         
         // Map of control keys.
         std::map<i32, KEYS> key_map = {
-            { KEY_LEFT,  KEYS::LEFT       },
-            { KEY_RIGHT, KEYS::RIGHT      },
-            { KEY_DOWN,  KEYS::DOWN       },
-            { KEY_UP,    KEYS::ROTATE_CW  },
-            { 'z',       KEYS::ROTATE_CCW },
-            { 'a',       KEYS::ROTATE_180 },
-            { ' ',       KEYS::DROP       },
-            { 'c',       KEYS::HOLD       },
-            { 'r',       KEYS::RESET      },
+            { key_code::left,   KEYS::LEFT       },
+            { key_code::right,  KEYS::RIGHT      },
+            { key_code::down,   KEYS::DOWN       },
+            { key_code::up,     KEYS::ROTATE_CW  },
+            { 'z',              KEYS::ROTATE_CCW },
+            { 'a',              KEYS::ROTATE_180 },
+            { ' ',              KEYS::DROP       },
+            { 'c',              KEYS::HOLD       },
+            { 'r',              KEYS::RESET      },
             // ESC in ascii = 27
-            { 27,        KEYS::QUIT       },
-            { 'u',       KEYS::UNDO       },
-            { 'i',       KEYS::REDO       }
+            { key_code::escape, KEYS::QUIT       },
+            { 'u',              KEYS::UNDO       },
+            { 'i',              KEYS::REDO       },
+            { '[',              KEYS::EARLIER    },
+            { ']',              KEYS::LATER      }
         };
 
         bool inf_soft_drop = true;
@@ -0,0 +1,1188 @@
+#pragma once
+
+#include <list>
+#include <vector>
+#include <string>
+
+#include <memory>
+#include <functional>
+#include <random>
+#include <optional>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+#include <lib/intdef>
+
+#include <config.hpp>
+#include <rules/tetromino.hpp>
+#include <rules/attack_table.hpp>
+#include <rules/kick_table.hpp>
+#include <rules/spin.hpp>
+#include <rules/bag.hpp>
+#include <rules/field.hpp>
+
+#include <util/ring.hpp>
+#include <util/intern_pool.hpp>
+#include <util/history_tree.hpp>
+#include <util/trace.hpp>
+#include <util/hash.hpp>
+
+/**
+ * @brief Rules of a single game, without any rendering.
+ *
+ * Holds the field, the current, held and queued tetrominoes, attack and
+ * statistics, and the undo history. `game` draws an engine in the terminal,
+ * headless tools (exporter, bots) drive it directly through `apply()`.
+ */
+class engine {
+public:
+    using control_key = user_config::control_config::KEYS;
+
+    using puzzle_function = std::function<bool (
+        // Field
+        const field&,
+        // Last placed tetromino
+        tetromino,
+        // Last placed tetromino position
+        i32, i32,
+        // Current attack info
+        attack_info
+    )>;
+
+    // Counters are 64 bits so that marathons of billions of inputs do not
+    // wrap; back-to-back and combo are those of `attack_info`.
+    struct stats_data {
+        u64 _M_lines = 0;
+        u64 _M_attack = 0;
+        u32 _M_b2b = 0;
+        u32 _M_combo = 0;
+        u64 _M_place_count = 0;
+        u64 _M_input_count = 0;
+        // Fields cleared after topping out, in marathon.
+        u64 _M_topouts = 0;
+    };
+
+    enum class spawn_result {
+        ok,
+        // No room to spawn, the game is over.
+        topped_out,
+        // Puzzle queue ran out, the puzzle restarts.
+        puzzle_end
+    };
+
+    // What happened in a `drop()`.
+    struct drop_result {
+        // Placed tetromino and its position.
+        tetromino _M_mino;
+        i32 _M_x, _M_y;
+
+        u32 _M_lines;
+        u32 _M_attack;
+        spin_type _M_spin;
+        attack_info _M_attack_info;
+
+        // Spawn of the next tetromino.
+        spawn_result _M_spawn;
+
+        // `checksum()` after this drop, 0 if not tracked.
+        u64 _M_checksum;
+    };
+
+    /* For undo/redo */
+
+    struct save_data {
+        field _M_field;
+        std::optional<tetromino> _M_current;
+        std::optional<tetromino> _M_hold;
+        std::list<tetromino> _M_queue;
+        attack_info _M_attack_info;
+        // Clear of the placement that led here, if any.
+        std::optional<attack_event> _M_attack_event;
+        bag_save_data _M_bag_data;
+        std::mt19937 _M_rand;
+        stats_data _M_stats;
+        u64 _M_checksum;
+    };
+
+    /**
+     * @brief Undo history of a game: a `history_tree` of the states at the
+     * spawn of each tetromino, branching when a tetromino is placed after
+     * an undo.
+     *
+     * States are kept small. The field is kept as ids of rows interned in a
+     * pool that every node shares, so a node costs its row ids, and only the
+     * rows that no other node has take room of their own. Generators are
+     * interned too, and a node whose generators did not change since its
+     * parent shares them without comparing to the others.
+     */
+    class undo_tree {
+    public:
+        using node_id = u32;
+        static constexpr node_id npos = -1;
+
+        static constexpr std::size_t default_capacity = 1024;
+
+        // A state as the tree keeps it, see `save_data`.
+        struct snapshot {
+            // Ids in the row pool, the bottom row first; cells as `row()` gives them.
+            std::vector<intern_pool::id_type> _M_rows;
+            std::optional<tetromino> _M_current;
+            std::optional<tetromino> _M_hold;
+            std::vector<tetromino> _M_queue;
+            attack_info _M_attack_info;
+            // Clear of the placement that led here, if any.
+            std::optional<attack_event> _M_attack_event;
+
+            // Ids in the generator pool.
+            intern_pool::id_type _M_bag_rand = intern_pool::npos, _M_rand = intern_pool::npos;
+            std::vector<tetromino> _M_bag_queue;
+            u32 _M_bag_current = 0;
+            u64 _M_bag_refills = 0;
+
+            stats_data _M_stats;
+            u64 _M_checksum = 0;
+        };
+
+        using tree_type = history_tree<snapshot>;
+
+    private:
+        static_assert(std::is_trivially_copyable_v<std::mt19937>);
+
+        tree_type _M_tree;
+        intern_pool _M_rows, _M_rands { sizeof(std::mt19937) };
+        // A row being interned.
+        std::vector<u8> _M_row;
+
+        auto _M_release() {
+            return [this] (snapshot& __s) {
+                for (auto __id : __s._M_rows) _M_rows.release(__id);
+                _M_rands.release(__s._M_bag_rand);
+                _M_rands.release(__s._M_rand);
+            };
+        }
+
+        // Same as the parent's, or interned.
+        intern_pool::id_type _M_intern_rand(intern_pool::id_type __parent, const std::mt19937& __r) {
+            if (__parent != intern_pool::npos && _M_rands.equals(__parent, &__r)) return _M_rands.retain(__parent);
+            return _M_rands.intern(&__r);
+        }
+
+    public:
+        explicit undo_tree(std::size_t __capacity = default_capacity) : _M_tree(__capacity) { }
+
+        std::size_t size() const { return _M_tree.size(); }
+        std::size_t capacity() const { return _M_tree.capacity(); }
+        bool empty() const { return _M_tree.empty(); }
+
+        const tree_type& tree() const { return _M_tree; }
+        node_id current() const { return _M_tree.current(); }
+        snapshot& current_snapshot() { return _M_tree.value(_M_tree.current()); }
+
+        // Distinct rows and generators kept.
+        std::size_t row_count() const { return _M_rows.size(); }
+        std::size_t rand_count() const { return _M_rands.size(); }
+
+        // Cells of a row: block type, and attribute in the high bits.
+        const u8* row(intern_pool::id_type __id) const { return reinterpret_cast<const u8*>(_M_rows.data(__id)); }
+        u32 row_size() const { return _M_rows.value_size(); }
+
+        std::mt19937 rand(intern_pool::id_type __id) const {
+            std::mt19937 __r;
+            std::memcpy(&__r, _M_rands.data(__id), sizeof(__r));
+            return __r;
+        }
+
+        bool undo() { return _M_tree.undo(); }
+        bool redo() { return _M_tree.redo(); }
+        bool jump(node_id __id) { return _M_tree.jump(__id); }
+        void set_redo(node_id __id, node_id __child) { _M_tree.set_redo(__id, __child); }
+
+        void clear() { _M_tree.clear(_M_release()); }
+
+        // Drops nodes as a push would until at most `__capacity` are left.
+        void set_capacity(std::size_t __capacity) { _M_tree.set_capacity(__capacity, _M_release()); }
+
+        /**
+         * @brief Pushes `__s` as a child of the current node, without its
+         * attack event; see `history_tree::push()`.
+         */
+        void push(const save_data& __s) {
+            const field& __f = __s._M_field;
+
+            if (_M_rows.value_size() != __f.width()) {
+                clear();
+                _M_rows = intern_pool(__f.width());
+            }
+
+            // A placement changes at most 4 rows and a clear adds empty
+            // ones, a few more leave room for garbage: so that a full tree
+            // does not grow the pool.
+            if (_M_tree.empty()) _M_rows.reserve(__f.height() + 8 * _M_tree.capacity());
+
+            intern_pool::id_type __bag_rand = intern_pool::npos, __rand = intern_pool::npos;
+            if (!_M_tree.empty()) {
+                const snapshot& __p = current_snapshot();
+                __bag_rand = __p._M_bag_rand;
+                __rand = __p._M_rand;
+            }
+
+            snapshot& __n = _M_tree.push(_M_release());
+
+            _M_row.resize(__f.width());
+            __n._M_rows.resize(__f.height());
+
+            for (u32 __y = 0; __y < __f.height(); ++__y) {
+                for (u32 __x = 0; __x < __f.width(); ++__x) {
+                    auto [__b, __attr] = __f.data()[__y][__x];
+                    _M_row[__x] = static_cast<u8>(__b) | static_cast<u8>(__attr) << 4;
+                }
+                __n._M_rows[__y] = _M_rows.intern(_M_row.data());
+            }
+
+            __n._M_current = __s._M_current;
+            __n._M_hold = __s._M_hold;
+            __n._M_queue.assign(__s._M_queue.begin(), __s._M_queue.end());
+            __n._M_attack_info = __s._M_attack_info;
+            __n._M_attack_event = std::nullopt;
+
+            __n._M_bag_rand = _M_intern_rand(__bag_rand, __s._M_bag_data._M_rand);
+            __n._M_bag_queue = __s._M_bag_data._M_queue;
+            __n._M_bag_current = __s._M_bag_data._M_current;
+            __n._M_bag_refills = __s._M_bag_data._M_refills;
+            __n._M_rand = _M_intern_rand(__rand, __s._M_rand);
+
+            __n._M_stats = __s._M_stats;
+            __n._M_checksum = __s._M_checksum;
+        }
+
+        // State of node `__id` into `__out`, whose field has the size of the game's.
+        void restore(node_id __id, save_data& __out) const {
+            const snapshot& __n = _M_tree.value(__id);
+            field& __f = __out._M_field;
+
+            for (u32 __y = 0; __y < __f.height(); ++__y) {
+                const u8* __r = row(__n._M_rows[__y]);
+                for (u32 __x = 0; __x < __f.width(); ++__x)
+                    __f.set_cell(__x, __y, static_cast<block_type>(__r[__x] & 0xf), static_cast<block_attribute>(__r[__x] >> 4));
+            }
+
+            __out._M_current = __n._M_current;
+            __out._M_hold = __n._M_hold;
+            __out._M_queue.assign(__n._M_queue.begin(), __n._M_queue.end());
+            __out._M_attack_info = __n._M_attack_info;
+            __out._M_attack_event = __n._M_attack_event;
+
+            std::memcpy(&__out._M_bag_data._M_rand, _M_rands.data(__n._M_bag_rand), sizeof(std::mt19937));
+            __out._M_bag_data._M_queue = __n._M_bag_queue;
+            __out._M_bag_data._M_current = __n._M_bag_current;
+            __out._M_bag_data._M_refills = __n._M_bag_refills;
+            std::memcpy(&__out._M_rand, _M_rands.data(__n._M_rand), sizeof(std::mt19937));
+
+            __out._M_stats = __n._M_stats;
+            __out._M_checksum = __n._M_checksum;
+        }
+    };
+
+    using history_type = undo_tree;
+
+    // Last line clears, newest last.
+    using attack_history_type = ring<attack_event, 64>;
+
+    /**
+     * @brief Whole state of a game, with its undo history and attack texts,
+     * as `save_session()` takes it and `load_session()` restores it.
+     *
+     * `_M_state` is the state at this moment, as a snapshot would take it,
+     * plus the position of the tetromino in play.
+     */
+    struct session_data {
+        save_data _M_state;
+        i32 _M_x = 0, _M_y = 0;
+        bool _M_holdable = true, _M_over = false;
+        bool _M_is_last_spin = false;
+        u32 _M_kick_index = 0;
+
+        history_type _M_history;
+        attack_history_type _M_attack_history;
+    };
+
+    /* ------------- */
+
+public:
+    engine(
+        std::mt19937& __rand,
+        user_config __uconf = user_config{},
+        bags::types __bag_type = bags::types::bag7,
+        field::layout __layout = field::layout::automatic
+    ) : _M_user_config(__uconf), _M_rand(__rand),
+        _M_bag(__rand, bags::create(__bag_type)) {
+        _M_field = field(
+            __uconf.field.width, __uconf.field.height + __uconf.field.extra_height,
+            __layout
+        );
+        // Nodes are restored cell by cell, into a field of this shape.
+        _M_history_state._M_field = _M_field;
+
+        _M_attack_table = attack_tables::create(__uconf.game.attack_table);
+        _M_kick_table = kick_tables::create(__uconf.game.kick_table);
+        _M_spin_table = spin_tables::create(__uconf.game.spin_table);
+
+        reset();
+    }
+
+private:
+    field _M_field;
+
+    user_config _M_user_config;
+
+    std::mt19937& _M_rand;
+
+    bag_generator _M_bag;
+
+    std::unique_ptr<Iattack_table> _M_attack_table;
+    std::unique_ptr<Ikick_table> _M_kick_table;
+    std::unique_ptr<Ispin_table> _M_spin_table;
+
+    std::optional<tetromino> _M_current, _M_hold;
+    std::list<tetromino> _M_queue;
+    // Nodes popped from `_M_queue`, spliced back on push so that the
+    // queue does not allocate once it has reached its length.
+    std::list<tetromino> _M_queue_pool;
+    bool _M_holdable = true;
+    // This value can be negative because of mino shape.
+    i32 _M_current_x = 0, _M_current_y = 0;
+
+    // The ghost only depends on the piece, its column and the field,
+    // so it is recomputed only when one of them changes.
+    struct ghost_cache {
+        mino_type _M_type = mino_type::INVALID;
+        u32 _M_direction = 0;
+        i32 _M_x = 0;
+        u64 _M_version = 0;
+        // Every height in [_M_y, _M_top] descends to _M_y.
+        i32 _M_y = 0, _M_top = -1;
+    };
+    mutable ghost_cache _M_ghost;
+
+    attack_info _M_attack_info = {
+        attack_type::SINGLE, 0, -1, spin_type::NONE, false
+    };
+    // Check if the last input was a spin.
+    bool _M_is_last_spin = false;
+    // index of test in kick table if the last input was a spin.
+    u32 _M_kick_index = 0;
+
+    stats_data _M_stats;
+
+    attack_history_type _M_attack_history;
+
+    history_type _M_history;
+    // State taken for a push, or restored from a node.
+    save_data _M_history_state;
+    // Nodes from a jump target up to where the jump turns.
+    std::vector<history_type::node_id> _M_history_path;
+    // Headless drivers that never undo can skip the snapshot per tetromino.
+    bool _M_keep_history = true;
+
+    bool _M_over = false;
+
+    // Rolling hash of the state after each placement, see `checksum()`.
+    bool _M_track_checksum = false;
+    u64 _M_checksum = 0;
+
+    /* For puzzle */
+
+    std::string _M_puzzle_sequence;
+    std::vector<tetromino> _M_puzzle_queue;
+    bool _M_solved = false;
+    u32 _M_solved_count = 0;
+
+    puzzle_function _M_puzzle_func = nullptr;
+
+    /* ---------  */
+
+    void _M_queue_push(const tetromino& __t) {
+        if (_M_queue_pool.empty()) {
+            _M_queue.push_back(__t);
+            return;
+        }
+
+        _M_queue_pool.front() = __t;
+        _M_queue.splice(_M_queue.end(), _M_queue_pool, _M_queue_pool.begin());
+    }
+
+    void _M_queue_pop()
+    { _M_queue_pool.splice(_M_queue_pool.end(), _M_queue, _M_queue.begin()); }
+
+    void _M_queue_clear()
+    { _M_queue_pool.splice(_M_queue_pool.end(), _M_queue); }
+
+    tetromino _M_get_next() {
+        if (_M_user_config.game.mode == user_config::game_mode::puzzle) {
+            if (_M_queue.empty()) {
+                if (_M_hold.has_value()) {
+                    tetromino __hold = *_M_hold;
+                    _M_hold.reset();
+                    _M_holdable = false;
+                    return __hold;
+                } else return tetromino::INVALID;
+            } else {
+                tetromino __next = _M_queue.front();
+                _M_queue_pop();
+                return __next;
+            }
+        }
+
+        while (_M_queue.size() <= std::max(_M_user_config.game.next_queue_size, 3u))
+            _M_queue_push(_M_bag.next());
+
+        tetromino __next = _M_queue.front();
+        _M_queue_pop();
+        return __next;
+    }
+
+    bool _M_is_in_collision(
+        i32 __x, i32 __y, const tetromino& __t
+    ) const { return collides(_M_field, __x, __y, __t); }
+
+    // Lowest y reachable by dropping `__t` straight down from (__x, __y),
+    // or nullopt if some column below it is covered by an overhang.
+    std::optional<i32> _M_ghost_from_heights(
+        i32 __x, i32 __y, const tetromino& __t
+    ) const {
+        const auto& __heights = _M_field.column_heights();
+        std::optional<i32> __ghost;
+
+        for (u32 __j = 0; __j < __t.size(); ++__j) {
+            // Lowest block of the tetromino in this column.
+            i32 __bottom = -1;
+            for (u32 __i = 0; __i < __t.size(); ++__i)
+                if (__t.data()[__i][__j] != 0) __bottom = __i;
+
+            if (__bottom < 0) continue;
+            if (__x + (i32)__j < 0 || __x + __j >= __heights.size()) return std::nullopt;
+
+            i32 __h = __heights[__x + __j];
+            if (__y - __bottom < __h) return std::nullopt;
+
+            __ghost = std::max(__ghost.value_or(__h + __bottom), __h + __bottom);
+        }
+
+        return __ghost;
+    }
+
+    // Distance from the current position to the ghost position.
+    i32 _M_drop_distance() const {
+        auto& __c = _M_ghost;
+
+        bool __hit =
+            __c._M_type == _M_current->type() &&
+            __c._M_direction == _M_current->direction() &&
+            __c._M_x == _M_current_x &&
+            __c._M_version == _M_field.version() &&
+            __c._M_y <= _M_current_y && _M_current_y <= __c._M_top;
+
+        if (!__hit) {
+            auto __y = _M_ghost_from_heights(_M_current_x, _M_current_y, *_M_current);
+
+            if (!__y) {
+                __y = _M_current_y;
+                while (!_M_is_in_collision(_M_current_x, *__y - 1, *_M_current))
+                    *__y -= 1;
+            }
+
+            __c = {
+                _M_current->type(), _M_current->direction(),
+                _M_current_x, _M_field.version(),
+                *__y, _M_current_y
+            };
+        }
+
+        return _M_current_y - __c._M_y;
+    }
+
+    // For spin check.
+    bool _M_is_immobile() const {
+        return
+            _M_is_in_collision(_M_current_x - 1, _M_current_y, *_M_current) &&
+            _M_is_in_collision(_M_current_x + 1, _M_current_y, *_M_current) &&
+            _M_is_in_collision(_M_current_x, _M_current_y + 1, *_M_current) &&
+            _M_is_in_collision(_M_current_x, _M_current_y - 1, *_M_current);
+    }
+
+    void _M_load(const save_data& __dt) {
+        _M_field = __dt._M_field;
+        _M_current = __dt._M_current;
+        _M_hold = __dt._M_hold;
+        _M_queue = __dt._M_queue;
+        _M_attack_info = __dt._M_attack_info;
+        _M_bag.load(__dt._M_bag_data);
+        _M_rand = __dt._M_rand;
+        _M_stats = __dt._M_stats;
+        _M_checksum = __dt._M_checksum;
+
+        std::tie(_M_current_x, _M_current_y) = spawn_position(*_M_current);
+    }
+
+    void _M_load_node(history_type::node_id __id) {
+        _M_history.restore(__id, _M_history_state);
+        _M_load(_M_history_state);
+    }
+
+    // Hash of the state right after a placement, chained to the previous checksum.
+    // The field is hashed by occupancy, the random sequence by bag position.
+    u64 _M_next_checksum() const {
+        state_hash __h(_M_checksum);
+
+        std::visit([&] (const auto& __b) { __h.add_bytes(__b.rows(), __b.bytes()); }, _M_field.board());
+
+        __h.add((u64)(_M_current ? _M_current->type() : mino_type::INVALID) |
+                (u64)(_M_current ? _M_current->direction() : 0) << 8 |
+                (u64)(_M_hold ? _M_hold->type() : mino_type::INVALID) << 16 |
+                (u64)_M_holdable << 24 | (u64)_M_over << 25);
+        __h.add((u64)(u32)_M_current_x << 32 | (u32)_M_current_y);
+
+        u64 __queue = 0;
+        for (const auto& __t : _M_queue) __queue = __queue << 3 | static_cast<u64>(__t.type());
+        __h.add(__queue ^ (u64)_M_queue.size() << 58);
+
+        __h.add(_M_bag.refills() << 8 | _M_bag.index());
+
+        __h.add((u64)_M_attack_info._M_type | (u64)_M_attack_info._M_spin << 8 |
+                (u64)_M_attack_info._M_pc << 16);
+        __h.add((u64)(u32)_M_attack_info._M_combo << 32 | (u32)_M_attack_info._M_btb);
+
+        // Packed as when the counters were 32 bits, so that the checksums
+        // recorded in replays still match.
+        __h.add((u64)_M_stats._M_lines << 32 | _M_stats._M_attack);
+        __h.add((u64)_M_stats._M_b2b << 32 | _M_stats._M_combo);
+        __h.add((u64)_M_stats._M_place_count << 32 | _M_stats._M_input_count);
+
+        return __h.value();
+    }
+
+public:
+    /**
+     * @brief Whether tetromino `__t` at (__x, __y) overlaps a block or a wall.
+     */
+    static bool collides(const field& __f, i32 __x, i32 __y, const tetromino& __t) {
+        if (__t == tetromino::INVALID) return true;
+
+        return __f.collides(__x, __y, __t);
+    }
+
+    /**
+     * @brief Rotates `__t` at (__x, __y), using the first kick that fits.
+     *
+     * @return Index of the kick used (-1 if no kick was needed),
+     *         or nullopt if no kick fits. Arguments are unchanged on failure.
+     */
+    static std::optional<i32> rotate_with_kicks(
+        const field& __f, const Ikick_table& __kicks,
+        tetromino& __mino, i32& __x, i32& __y, rotation __r
+    ) {
+        tetromino __t = __mino;
+        __t.rotate(__r);
+
+        const auto& __table =
+            __kicks.get(__t, __mino.direction(), __t.direction());
+
+        i32 __idx = -1;
+        std::pair<i32, i32> __p = { 0, 0 };
+        auto& [__px, __py] = __p;
+        do {
+            if (__idx != -1)
+                __p = __table[__idx];
+
+            if (!collides(__f, __x + __px, __y + __py, __t)) {
+                __mino = __t;
+                __x += __px;
+                __y += __py;
+                return __idx;
+            }
+
+            __idx++;
+        } while ((u32)__idx < __table.size());
+
+        return std::nullopt;
+    }
+
+    /**
+     * @brief Attack info after clearing `__lines` lines.
+     *
+     * Combo and back-to-back continue from `__prev`, or reset if nothing was cleared.
+     */
+    static attack_info next_attack_info(
+        attack_info __prev, u32 __lines, spin_type __sp, bool __pc, bool __pc_b2b
+    ) {
+        attack_info __atk = __prev;
+
+        if (__lines > 0) {
+            __atk._M_pc = __pc;
+            __atk._M_type = static_cast<attack_type>(__lines - 1);
+            __atk._M_combo++;
+            __atk._M_spin = __sp;
+            if (__atk._M_spin == spin_type::NONE &&
+                __atk._M_type != attack_type::QUAD && !(
+                    __pc_b2b && __atk._M_pc
+                ))
+                __atk._M_btb = -1;
+            else __atk._M_btb++;
+        } else {
+            __atk._M_pc = false;
+            __atk._M_type = attack_type::SINGLE;
+            __atk._M_combo = 0;
+            __atk._M_spin = spin_type::NONE;
+        }
+
+        return __atk;
+    }
+
+    // Position a tetromino spawns at, before extended spawn is applied.
+    std::pair<i32, i32> spawn_position(const tetromino& __t) const {
+        return {
+            (i32)_M_field.width() / 2 - (i32)(__t.size() + 1) / 2,
+            (i32)_M_user_config.spawn.base_height
+        };
+    }
+
+    /**
+     * @brief Prepares the queue and hold for a new game.
+     *
+     * Call `spawn()` afterwards to bring in the first tetromino.
+     */
+    void begin() {
+        _M_queue_clear();
+
+        if (_M_user_config.game.mode == user_config::game_mode::puzzle) {
+            if (_M_puzzle_func == nullptr)
+                throw std::runtime_error("Puzzle function is not set.");
+            if (_M_puzzle_sequence.empty())
+                throw std::runtime_error("Puzzle sequence is not set.");
+
+            if (_M_puzzle_queue.empty())
+                _M_puzzle_queue = *tetromino::gen(_M_puzzle_sequence, _M_rand);
+            _M_queue.assign(_M_puzzle_queue.begin(), _M_puzzle_queue.end());
+        } else {
+            while (_M_queue.size() < std::max(_M_user_config.game.next_queue_size, 3u))
+                _M_queue_push(_M_bag.next());
+        }
+
+        _M_hold = std::nullopt;
+        _M_holdable = _M_user_config.hold.enabled;
+        _M_over = false;
+    }
+
+    bool left() {
+        if (_M_is_in_collision(_M_current_x - 1, _M_current_y, *_M_current)) return false;
+
+        _M_current_x -= 1;
+        _M_is_last_spin = false;
+
+        return true;
+    }
+
+    bool right() {
+        if (_M_is_in_collision(_M_current_x + 1, _M_current_y, *_M_current)) return false;
+
+        _M_current_x += 1;
+        _M_is_last_spin = false;
+
+        return true;
+    }
+
+    bool down() {
+        if (_M_is_in_collision(_M_current_x, _M_current_y - 1, *_M_current)) return false;
+
+        if (_M_user_config.control.inf_soft_drop)
+            _M_current_y -= _M_drop_distance();
+        else
+            _M_current_y -= 1;
+
+        _M_is_last_spin = false;
+
+        return true;
+    }
+
+    bool down_once() {
+        bool __cur = _M_user_config.control.inf_soft_drop;
+        _M_user_config.control.inf_soft_drop = false;
+
+        bool __r = down();
+
+        _M_user_config.control.inf_soft_drop = __cur;
+
+        return __r;
+    }
+
+    bool rotate(rotation __r) {
+        if (!_M_current) return false;
+
+        TRACE_SPAN("kicks");
+
+        auto __idx = rotate_with_kicks(
+            _M_field, *_M_kick_table,
+            *_M_current, _M_current_x, _M_current_y, __r
+        );
+
+        if (!__idx) return false;
+
+        _M_is_last_spin = true;
+        _M_kick_index = *__idx;
+
+        return true;
+    }
+
+    std::optional<drop_result> drop() {
+        if (!_M_current) return std::nullopt;
+
+        TRACE_SPAN("drop");
+
+        if (i32 __d = _M_drop_distance(); __d > 0) {
+            _M_current_y -= __d;
+            _M_is_last_spin = false;
+        }
+
+        bool __imm = _M_is_immobile();
+
+        _M_field.put_mino(_M_current_x, _M_current_y, *_M_current);
+
+        spin_type __sp = spin_type::NONE;
+        if (_M_is_last_spin) {
+            TRACE_SPAN("spin");
+
+            __sp = _M_spin_table->get({
+                *_M_current, _M_current_x, _M_current_y,
+                _M_kick_index, __imm,
+                _M_field
+            });
+        }
+
+        u32 __lines = _M_field.proceed_lines();
+        u32 __atk = 0;
+
+        _M_attack_info = next_attack_info(
+            _M_attack_info, __lines, __sp,
+            __lines > 0 && _M_field.is_empty(),
+            _M_user_config.game.enable_pc_b2b
+        );
+
+        if (__lines > 0) {
+            TRACE_SPAN("attack");
+
+            __atk = _M_attack_table->get(_M_attack_info);
+
+            _M_attack_history.push_back(attack_event::of(_M_attack_info, _M_current->to_char()));
+
+            _M_stats._M_lines += __lines;
+            _M_stats._M_attack += __atk;
+        }
+
+        _M_stats._M_b2b = _M_attack_info._M_btb;
+        _M_stats._M_combo = _M_attack_info._M_combo;
+        _M_stats._M_place_count++;
+
+        if (_M_user_config.game.mode == user_config::game_mode::puzzle) {
+            if (_M_puzzle_func) {
+                if (_M_puzzle_func(
+                    _M_field, *_M_current, _M_current_x, _M_current_y,
+                    _M_attack_info
+                )) _M_solved = true;
+            }
+        }
+
+        drop_result __res = {
+            *_M_current, _M_current_x, _M_current_y,
+            __lines, __atk, __sp, _M_attack_info,
+            spawn_result::ok, 0
+        };
+
+        __res._M_spawn = spawn();
+
+        // The spawn pushed the state this placement led to.
+        bool __pushed = _M_keep_history && __res._M_spawn == spawn_result::ok;
+        if (__pushed && __lines > 0)
+            _M_history.current_snapshot()._M_attack_event = _M_attack_history.back();
+
+        if (_M_track_checksum) {
+            _M_checksum = _M_next_checksum();
+            __res._M_checksum = _M_checksum;
+
+            if (__pushed) _M_history.current_snapshot()._M_checksum = _M_checksum;
+        }
+
+        return __res;
+    }
+
+    spawn_result spawn(bool __new = true, bool __hold = false) {
+        if (__new)
+            _M_current = _M_get_next();
+
+        if (_M_user_config.game.mode == user_config::game_mode::puzzle) {
+            if (_M_current == tetromino::INVALID) {
+                if (_M_solved) {
+                    _M_puzzle_queue = *tetromino::gen(_M_puzzle_sequence, _M_rand);
+
+                    _M_solved_count++;
+                    _M_solved = false;
+                }
+
+                _M_queue.assign(_M_puzzle_queue.begin(), _M_puzzle_queue.end());
+
+                return spawn_result::puzzle_end;
+            }
+        }
+
+        std::tie(_M_current_x, _M_current_y) = spawn_position(*_M_current);
+
+        if (_M_is_in_collision(_M_current_x, _M_current_y, *_M_current)) {
+            u32 __i = 0;
+
+            if (_M_user_config.spawn.extended) {
+                for (; __i < _M_user_config.spawn.extended_height; ++__i) {
+                    if (!_M_is_in_collision(_M_current_x, _M_current_y + __i, *_M_current))
+                        break;
+                }
+            }
+
+            if (!_M_user_config.spawn.extended || __i >= _M_user_config.spawn.extended_height) {
+                if (_M_user_config.game.mode != user_config::game_mode::marathon) {
+                    _M_over = true;
+                    return spawn_result::topped_out;
+                }
+
+                // An empty field always has room.
+                _M_field.clear();
+                _M_stats._M_topouts++;
+                __i = 0;
+            }
+
+            _M_current_y += __i;
+        }
+
+        if (!__hold)
+            _M_holdable = true;
+
+        if (!__hold && _M_keep_history) {
+            TRACE_SPAN("snapshot");
+
+            // Taken into a state that keeps its storage, then interned.
+            save_state(_M_history_state);
+            _M_history.push(_M_history_state);
+        }
+
+        return spawn_result::ok;
+    }
+
+    // Returns nullopt if hold is not available now.
+    std::optional<spawn_result> hold() {
+        if (!_M_user_config.hold.enabled) return std::nullopt;
+        if (!_M_holdable) return std::nullopt;
+
+        spawn_result __r;
+
+        if (_M_hold) {
+            swap(_M_current, _M_hold);
+            __r = spawn(false, true);
+        }
+        else {
+            if (_M_queue.empty()) return std::nullopt;
+
+            _M_hold = _M_current;
+            __r = spawn(true, true);
+        }
+
+        _M_hold->set_direction(0);
+
+        if (!_M_user_config.hold.infinite)
+            _M_holdable = false;
+
+        return __r;
+    }
+
+    void garbage(u32 __cnt, i32 __hole = -1)
+    { _M_field.put_garbage(__cnt, __hole); }
+
+    void reset() {
+        _M_field.clear();
+        _M_bag.reset();
+
+        _M_queue_clear();
+        _M_current = std::nullopt;
+        _M_hold = std::nullopt;
+
+        _M_history.clear();
+
+        _M_attack_info = {
+            attack_type::SINGLE, 0, -1, spin_type::NONE, false
+        };
+        _M_is_last_spin = false;
+
+        _M_stats = {};
+
+        _M_attack_history.clear();
+
+        _M_over = false;
+        _M_checksum = 0;
+    }
+
+    /**
+     * @brief Seeds the random generator and the bag with `__seed`.
+     *
+     * The bag keeps its own copy of the generator, so seeding the generator
+     * passed to the constructor is not enough. Call `reset()`, `begin()` and
+     * `spawn()` afterwards; the game is then the same as a new engine
+     * constructed with a generator seeded with `__seed`.
+     */
+    void seed(u32 __seed) {
+        _M_rand.seed(__seed);
+        _M_bag.seed(_M_rand);
+    }
+
+    /**
+     * @brief Copies the whole state into `__out`.
+     *
+     * Assigns over what `__out` held, so once it has held a session of the
+     * same size, taking another one does not allocate.
+     */
+    void save_session(session_data& __out) const {
+        save_state(__out._M_state);
+
+        __out._M_x = _M_current_x;
+        __out._M_y = _M_current_y;
+        __out._M_holdable = _M_holdable;
+        __out._M_over = _M_over;
+        __out._M_is_last_spin = _M_is_last_spin;
+        __out._M_kick_index = _M_kick_index;
+
+        __out._M_history = _M_history;
+        __out._M_attack_history = _M_attack_history;
+    }
+
+    // Continues the game saved in `__in`, which must have the same rules.
+    void load_session(const session_data& __in) {
+        _M_load(__in._M_state);
+
+        _M_current_x = __in._M_x;
+        _M_current_y = __in._M_y;
+        _M_holdable = __in._M_holdable;
+        _M_over = __in._M_over;
+        _M_is_last_spin = __in._M_is_last_spin;
+        _M_kick_index = __in._M_kick_index;
+
+        // The session's tree, with as many nodes as this engine keeps.
+        std::size_t __capacity = _M_history.capacity();
+        _M_history = __in._M_history;
+        _M_history.set_capacity(__capacity);
+        _M_attack_history = __in._M_attack_history;
+    }
+
+    /**
+     * @brief Copies the state at this moment into `__out`, as a snapshot for
+     * undo takes it: without the position of the tetromino in play, the undo
+     * history or the attack texts. Much smaller than a `session_data`.
+     */
+    void save_state(save_data& __out) const {
+        __out._M_field = _M_field;
+        __out._M_current = _M_current;
+        __out._M_hold = _M_hold;
+        __out._M_queue = _M_queue;
+        __out._M_attack_info = _M_attack_info;
+        __out._M_attack_event = std::nullopt;
+        _M_bag.save(__out._M_bag_data);
+        __out._M_rand = _M_rand;
+        __out._M_stats = _M_stats;
+        __out._M_checksum = _M_checksum;
+    }
+
+    // Continues from `__dt`, with the tetromino in play at its spawn position.
+    // Leaves the undo history and the attack texts as they are.
+    void load_state(const save_data& __dt, bool __holdable = true) {
+        _M_load(__dt);
+
+        _M_holdable = __holdable;
+        _M_over = false;
+        _M_is_last_spin = false;
+        _M_kick_index = 0;
+    }
+
+    // Returns false if there is nothing to undo.
+    bool undo() {
+        if (!_M_keep_history) return false;
+
+        auto __from = _M_history.current();
+        if (!_M_history.undo()) return false;
+
+        if (_M_history.tree().value(__from)._M_attack_event.has_value())
+            _M_attack_history.pop_back();
+        _M_load_node(_M_history.current());
+
+        return true;
+    }
+
+    // Returns false if there is nothing to redo.
+    bool redo() {
+        if (!_M_keep_history || !_M_history.redo()) return false;
+
+        if (const auto& __atk = _M_history.current_snapshot()._M_attack_event)
+            _M_attack_history.push_back(*__atk);
+        _M_load_node(_M_history.current());
+
+        return true;
+    }
+
+    /**
+     * @brief Goes to node `__id` of `history()`, on any branch, as the
+     * undos and redos through their last common state would.
+     *
+     * @return false if there is no such node.
+     */
+    bool jump(history_type::node_id __id) {
+        if (!_M_keep_history || !_M_history.tree().contains(__id)) return false;
+
+        const auto& __t = _M_history.tree();
+        auto __from = _M_history.current();
+        auto __common = __t.common_ancestor(__from, __id);
+
+        for (auto __n = __from; __n != __common; __n = __t.at(__n)._M_parent)
+            if (__t.value(__n)._M_attack_event) _M_attack_history.pop_back();
+
+        // Clears on the way down, oldest first.
+        _M_history_path.clear();
+        for (auto __n = __id; __n != __common; __n = __t.at(__n)._M_parent) _M_history_path.push_back(__n);
+
+        for (auto __it = _M_history_path.rbegin(); __it != _M_history_path.rend(); ++__it)
+            if (const auto& __atk = __t.value(*__it)._M_attack_event) _M_attack_history.push_back(*__atk);
+
+        _M_history.jump(__id);
+        _M_load_node(__id);
+
+        return true;
+    }
+
+    // Goes to the state pushed right before the current one, whatever its branch.
+    bool earlier() {
+        if (!_M_keep_history || _M_history.empty()) return false;
+        return jump(_M_history.tree().earlier(_M_history.current()));
+    }
+
+    // Goes to the state pushed right after the current one, whatever its branch.
+    bool later() {
+        if (!_M_keep_history || _M_history.empty()) return false;
+        return jump(_M_history.tree().later(_M_history.current()));
+    }
+
+    /**
+     * @brief Sets how many states the undo history keeps, see
+     * `undo_tree::default_capacity`. Drops the oldest if there are more.
+     */
+    void set_history_capacity(std::size_t __capacity) { _M_history.set_capacity(__capacity); }
+
+    /**
+     * @brief Applies a control key, for headless drivers.
+     *
+     * RESET starts a new game right away, also once the game is over,
+     * and QUIT ends the game.
+     *
+     * @return The result if the key dropped a tetromino.
+     */
+    std::optional<drop_result> apply(control_key __key) {
+        if (__key == control_key::RESET) {
+            reset(); begin(); spawn();
+            return std::nullopt;
+        }
+
+        if (_M_over) return std::nullopt;
+
+        TRACE_SPAN("apply");
+
+        std::optional<drop_result> __res;
+
+        switch (__key) {
+            case control_key::LEFT: left(); break;
+            case control_key::RIGHT: right(); break;
+            case control_key::DOWN: down(); break;
+            case control_key::ROTATE_CW: rotate(rotation::cw); break;
+            case control_key::ROTATE_CCW: rotate(rotation::ccw); break;
+            case control_key::ROTATE_180: rotate(rotation::_180); break;
+            case control_key::DROP: __res = drop(); break;
+            case control_key::HOLD: hold(); break;
+            case control_key::QUIT: _M_over = true; break;
+            case control_key::UNDO: undo(); break;
+            case control_key::REDO: redo(); break;
+            case control_key::EARLIER: earlier(); break;
+            case control_key::LATER: later(); break;
+            default: break;
+        }
+
+        count_input();
+
+        return __res;
+    }
+
+    void count_input() { _M_stats._M_input_count++; }
+
+    // Y position of the ghost of the current tetromino.
+    i32 ghost_y() const {
+        if (!_M_current) return _M_current_y;
+
+        return _M_current_y - _M_drop_distance();
+    }
+
+    const field& get_field() const { return _M_field; }
+    const user_config& config() const { return _M_user_config; }
+    const Ikick_table& kick_table() const { return *_M_kick_table; }
+
+    const std::optional<tetromino>& current() const { return _M_current; }
+    const std::optional<tetromino>& held() const { return _M_hold; }
+    const std::list<tetromino>& queue() const { return _M_queue; }
+    bool holdable() const { return _M_holdable; }
+    i32 x() const { return _M_current_x; }
+    i32 y() const { return _M_current_y; }
+
+    const attack_info& last_attack() const { return _M_attack_info; }
+    const stats_data& stats() const { return _M_stats; }
+    const attack_history_type& attack_history() const { return _M_attack_history; }
+    const history_type& history() const { return _M_history; }
+
+    // Topped out or quit.
+    bool is_over() const { return _M_over; }
+
+    /**
+     * @brief Enables or disables the state checksum, disabled by default.
+     *
+     * While enabled, every placement chains a hash of the whole state
+     * (field, pieces, queue, bag position, attack info and stats) into
+     * `checksum()`. Two runs of the same inputs have the same checksum
+     * after every placement, the first placement where they differ is
+     * where the runs diverged.
+     */
+    void track_checksum(bool __track) { _M_track_checksum = __track; }
+
+    // Checksum after the last placement, 0 before the first one.
+    u64 checksum() const { return _M_checksum; }
+
+    /**
+     * @brief Enables or disables the undo history, enabled by default.
+     *
+     * While disabled no snapshot is taken on spawn, and undo/redo do nothing.
+     */
+    void keep_history(bool __keep) {
+        _M_keep_history = __keep;
+        if (!__keep) _M_history.clear();
+    }
+
+    u32 solved_count() const { return _M_solved_count; }
+
+    void set_puzzle_function(puzzle_function __func) { _M_puzzle_func = __func; }
+    void set_puzzle_sequence(const std::string& __seq) {
+        _M_puzzle_sequence = __seq;
+
+        auto __test = tetromino::gen(__seq, _M_rand);
+
+        if (!__test)
+            throw std::runtime_error("Invalid puzzle sequence: " + __seq);
+    }
+};
@@ -5,6 +5,8 @@
 
 #include <filesystem>
 
+#include <cstdlib>
+
 #include <lib/intdef>
 
 /* static */ class env {
@@ -33,6 +35,19 @@ public:
     static inline std::filesystem::path exec_dir() { return exec_path().parent_path(); }
     static inline const std::vector<std::string>& arguments() { return _S_arguments; }
 
+    // Directory for state kept between runs, per user: `$XDG_STATE_HOME/tetrinal`,
+    // or `~/.local/state/tetrinal`. Empty if neither is known. Not created.
+    static inline std::filesystem::path state_dir() {
+        // Relative values are to be ignored, as the XDG spec says.
+        if (const char* __xdg = std::getenv("XDG_STATE_HOME"); __xdg && __xdg[0] == '/')
+            return std::filesystem::path(__xdg) / "tetrinal";
+
+        if (const char* __home = std::getenv("HOME"); __home && __home[0])
+            return std::filesystem::path(__home) / ".local" / "state" / "tetrinal";
+
+        return {};
+    }
+
     static inline std::pair<i32, char**> raw()
     { return { _S_raw_argument_count, _S_raw_arguments }; };
 };
\ No newline at end of file
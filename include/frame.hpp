@@ -0,0 +1,105 @@
+#pragma once
+
+#include <vector>
+#include <optional>
+#include <string_view>
+
+#include <lib/intdef>
+
+#include <engine.hpp>
+#include <perf_stats.hpp>
+#include <rules/tetromino.hpp>
+#include <rules/field.hpp>
+#include <ai/finesse.hpp>
+#include <util/alloc_counter.hpp>
+
+/**
+ * @brief Everything the screen shows at one moment, copied out of the game
+ * so that it can be drawn on another thread.
+ *
+ * `take()` fills the engine part, the game fills the rest. Both assign over
+ * the previous contents, so taking a frame into a slot that already held
+ * one does not allocate.
+ */
+struct frame {
+    struct cell {
+        block_type _M_block = block_type::EMPTY;
+        block_attribute _M_attr = block_attribute::NORMAL;
+
+        bool operator==(const cell&) const = default;
+    };
+
+    // Field cells, row 0 at the bottom, as `field::data()`.
+    u32 _M_width = 0, _M_height = 0;
+    std::vector<cell> _M_cells;
+
+    std::optional<tetromino> _M_current;
+    i32 _M_x = 0, _M_y = 0, _M_ghost_y = 0;
+
+    // Where the hint would put a tetromino, drawn as a second ghost. It is
+    // not the one in play when the hint is to hold first.
+    std::optional<tetromino> _M_hint;
+    i32 _M_hint_x = 0, _M_hint_y = 0;
+
+    std::vector<tetromino> _M_next;
+    std::optional<tetromino> _M_hold;
+
+    engine::stats_data _M_stats;
+    bool _M_puzzle = false;
+    u32 _M_solved = 0;
+
+    perf_stats::pace _M_rolling, _M_lifetime;
+    finesse::tally _M_finesse;
+
+    // Message of the meta box, empty if none.
+    std::string_view _M_meta;
+    // Seconds left before the game starts, 0 once it runs.
+    u32 _M_countdown = 0;
+    // Topped out or quit: the field is grayed and the game is over.
+    bool _M_over = false;
+    // Inputs applied so far, to tell which frames show a new one.
+    u64 _M_action = 0;
+
+#ifdef DEBUG
+    // Undo history: order of the push of the current state, states kept.
+    u64 _M_history_node = 0, _M_history_size = 0;
+    alloc_counter::counts _M_alloc_frame, _M_alloc_input;
+#endif
+
+    const cell& at(u32 __x, u32 __y) const { return _M_cells[__y * _M_width + __x]; }
+
+    // Copies the field, tetrominoes, queue and stats of `__e`.
+    void take(const engine& __e, u32 __next_size) {
+        const field& __f = __e.get_field();
+        const auto& __data = __f.data();
+
+        _M_width = __f.width();
+        _M_height = __f.height();
+        _M_cells.resize((size_t)_M_width * _M_height);
+
+        for (u32 __y = 0; __y < _M_height; ++__y)
+            for (u32 __x = 0; __x < _M_width; ++__x)
+                _M_cells[__y * _M_width + __x] = { __data[__y][__x].first, __data[__y][__x].second };
+
+        _M_current = __e.current();
+        _M_x = __e.x();
+        _M_y = __e.y();
+        _M_ghost_y = __e.ghost_y();
+
+        _M_next.clear();
+        for (const auto& __t : __e.queue()) {
+            if (_M_next.size() >= __next_size) break;
+            _M_next.push_back(__t);
+        }
+
+        _M_hold = __e.held();
+        _M_stats = __e.stats();
+        _M_solved = __e.solved_count();
+
+#ifdef DEBUG
+        const auto& __h = __e.history();
+        _M_history_node = __h.empty() ? 0 : __h.tree().at(__h.current())._M_serial;
+        _M_history_size = __h.size();
+#endif
+    }
+};
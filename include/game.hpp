@@ -15,22 +15,40 @@
 #include <optional>
 
 #include <cstddef>
-
-#include <ncurses.h>
+#include <cstdio>
 
 #include <lib/intdef>
 
 #include <config.hpp>
+#include <engine.hpp>
+#include <frame.hpp>
+#include <input.hpp>
+#include <renderer.hpp>
+#include <replay.hpp>
+#include <session.hpp>
+#include <autosave.hpp>
+#include <perf_stats.hpp>
 #include <rules/tetromino.hpp>
-#include <rules/attack_table.hpp>
-#include <rules/kick_table.hpp>
-#include <rules/spin.hpp>
-#include <rules/bag.hpp>
 #include <rules/field.hpp>
-
-#include <util/conv.hpp>
-#include <util/buffer.hpp>
-
+#include <ai/finesse.hpp>
+#include <ai/bot.hpp>
+#include <ai/anytime.hpp>
+#include <ai/hint.hpp>
+
+#include <util/alloc_counter.hpp>
+#include <util/snapshot_channel.hpp>
+#include <util/hash.hpp>
+#include <util/trace.hpp>
+
+/**
+ * @brief Runs the rules on the caller's thread and shows them through a
+ * `renderer`, which draws on its own thread.
+ *
+ * After every input and every frame, what the screen shows is copied into
+ * a `frame` and published; the game never waits for the terminal. Keys are
+ * read with `read_key()`, straight from the terminal, which only the render
+ * thread writes to between `start()` and `close()`.
+ */
 class game {
 public:
     using clock_type = std::chrono::high_resolution_clock;
@@ -38,16 +56,7 @@ public:
 
     using control_key = user_config::control_config::KEYS;
 
-    using puzzle_function = std::function<bool (
-        // Field
-        const field&,
-        // Last placed tetromino
-        tetromino,
-        // Last placed tetromino position
-        i32, i32,
-        // Current attack info
-        attack_info
-    )>;
+    using puzzle_function = engine::puzzle_function;
 
 public:
     game(
@@ -55,555 +64,284 @@ public:
         user_config __uconf = user_config{},
         block_color::types __color = block_color::types::bright,
         bags::types __bag_type = bags::types::bag7
-    ) : _M_user_config(__uconf), _M_rand(__rand),
-        _M_bag(__rand, bags::create(__bag_type)),
-        _M_color(block_color::create(__color)) {
-        _M_field = field(__uconf.field.width, __uconf.field.height + __uconf.field.extra_height);
-
-        _M_attack_table = attack_tables::create(__uconf.game.attack_table);
-        _M_kick_table = kick_tables::create(__uconf.game.kick_table);
-        _M_spin_table = spin_tables::create(__uconf.game.spin_table);
-
-        _M_init();
+    ) : _M_engine(__rand, __uconf, __bag_type), _M_user_config(__uconf),
+        _M_bag_type(__bag_type), _M_renderer(__uconf, __color),
+        _M_finesse(_M_engine) {
+        _M_perf.keep_series(false);
         reset();
     }
 
-    ~game() {
-        if (_M_windows._M_field) delwin(_M_windows._M_field);
-        if (_M_windows._M_next) delwin(_M_windows._M_next);
-        if (_M_windows._M_hold) delwin(_M_windows._M_hold);
-        if (_M_windows._M_stats) delwin(_M_windows._M_stats);
-        if (_M_windows._M_msg) delwin(_M_windows._M_msg);
-        if (_M_windows._M_meta) delwin(_M_windows._M_meta);
-    }
-
 private:
-    field _M_field;
+    engine _M_engine;
 
     user_config _M_user_config;
+    bags::types _M_bag_type;
 
-    std::mt19937& _M_rand;
-
-    bag_generator _M_bag;
-    std::unique_ptr<Iblock_color> _M_color;
+    // Keys are read here, the frames are drawn on the render thread.
+    key_reader _M_keys;
+    snapshot_channel<frame> _M_frames;
+    renderer _M_renderer;
 
-    std::unique_ptr<Iattack_table> _M_attack_table;
-    std::unique_ptr<Ikick_table> _M_kick_table;
-    std::unique_ptr<Ispin_table> _M_spin_table;
-
-    std::optional<tetromino> _M_current, _M_hold;
-    std::list<tetromino> _M_queue;
-    bool _M_holdable = true;
-    // This value can be negative because of mino shape.
-    i32 _M_current_x = 0, _M_current_y = 0;
-    i32 _M_ghost_x = 0, _M_ghost_y = 0;
-
-    attack_info _M_attack_info = {
-        attack_type::SINGLE, 0, -1, spin_type::NONE, false
-    };
-    // Check if the last input was a spin.
-    bool _M_is_last_spin = false;
-    // index of test in kick table if the last input was a spin.
-    u32 _M_kick_index = 0;
-
-    struct stats_data {
-        u32 _M_lines = 0;
-        u32 _M_attack = 0;
-        u32 _M_b2b = 0;
-        u32 _M_combo = 0;
-        u32 _M_place_count = 0;
-        u32 _M_input_count = 0;
-    } _M_stats;
-
-    std::vector<std::string> _M_attack_history;
-
-    struct {
-        WINDOW* _M_field = nullptr;
-        WINDOW* _M_next = nullptr;
-        WINDOW* _M_hold = nullptr;
-        WINDOW* _M_stats = nullptr;
-        WINDOW* _M_msg = nullptr;
-        WINDOW* _M_meta = nullptr;
-    } _M_windows;
-
-    std::array<bool, 4> _M_refresh_marked = { false, };
-    
     bool _M_running = false;
-    time_type _M_start_time, _M_last_fps_time;
+    // Topped out or quit, shown until the game is closed.
+    bool _M_over = false;
+    time_type _M_start_time, _M_last_pace_time;
 
     bool _M_restart_req = false;
     // If value is negative, it follows the default restart countdown;
     // otherwise it uses the specified countdown value.
     i32 _M_restart_countdown = -1;
 
-    u32 _M_frame_count = 0;
+    perf_stats _M_perf;
+    // Keys pressed since the last placement. Counted here rather than taken
+    // from the engine, whose count goes back on undo.
+    u32 _M_perf_keys = 0;
+    // Inputs applied, see `frame::_M_action`.
+    u64 _M_actions = 0;
+
+    // Pace shown in the stats panel, updated every second and on placement.
+    perf_stats::pace _M_rolling, _M_lifetime;
+
+    finesse::checker _M_finesse;
+    finesse::tally _M_finesse_tally;
+    // Keys sent to the tetromino in play since it spawned.
+    u32 _M_finesse_keys = 0;
+
+    // Plays by itself if set, one key per frame.
+    std::unique_ptr<anytime_search> _M_bot;
+    // Time the bot thinks per placement, within a frame.
+    inline static constexpr auto _S_bot_budget = std::chrono::milliseconds(5);
+    // Keys of the placement the bot chose, from `_M_bot_next` on.
+    std::vector<control_key> _M_bot_keys;
+    std::size_t _M_bot_next = 0;
+
+    // Searches the hint in the background if set.
+    std::unique_ptr<hint_search> _M_hint;
+    // Request of the state shown, and what that state was: a new search
+    // starts when a tetromino is placed or held, not when it moves.
+    u64 _M_hint_request = 0;
+    u64 _M_hint_state = 0;
+
+#ifdef DEBUG
+    // Heap allocations of the last frame and of the last input, shown in
+    // the stats panel when built with the allocation counter.
+    alloc_counter::counts _M_alloc_mark, _M_alloc_frame, _M_alloc_input;
+#endif
 
     /* For meta data */
     std::array<std::string_view, 4> _M_meta_data {
         "nothing to undo",
         "nothing to redo",
-        "undo buffer full",
-        "Perfect Clear!"
+        "Perfect Clear!",
+        "finesse fault"
     };
     u32 _M_meta_idx = 0;
     // -1 means no meta data is being displayed.
     // Otherwise, it is the index of the meta data being displayed.
     // This value decreases by 1 every frame.
     i32 _M_meta_time = -1;
-    bool _M_meta_drawn = false;
-    /* ------------- */
-
-    /* For undo/redo */
-
-    struct save_data {
-        field _M_field;
-        std::optional<tetromino> _M_current;
-        std::optional<tetromino> _M_hold;
-        std::list<tetromino> _M_queue;
-        attack_info _M_attack_info;
-        std::optional<std::string> _M_attck_string;
-        bag_save_data _M_bag_data;
-        std::mt19937 _M_rand;
-        stats_data _M_stats;
-    };
-
-    buffer<save_data, 20> _M_save_buffer;
-
     /* ------------- */
 
-    /* For puzzle */
-
-    std::string _M_puzzle_sequence;
-    std::vector<tetromino> _M_puzzle_queue;
-    bool _M_solved = false;
-    u32 _M_solved_count = 0;
+    // Keys applied so far, if recording.
+    std::optional<replay> _M_replay;
 
-    puzzle_function _M_puzzle_func = nullptr;
-
-    /* ---------  */
+    // Saves the session every `_S_autosave_interval`, if enabled.
+    std::unique_ptr<autosaver> _M_autosave;
+    time_type _M_last_autosave_time;
+    inline static constexpr auto _S_autosave_interval = std::chrono::seconds(5);
 
     u32 _S_frame_duration = 1000 / 60;
 
-    inline static constexpr u16 _S_color_interval = 16;
-    inline static constexpr u16 _S_color_start = 30;
-    inline static constexpr u16 _S_normal_color = _S_color_start;
-    inline static constexpr u16 _S_guide_color = _S_color_start + _S_color_interval;
-    inline static constexpr u16 _S_locked_color = _S_guide_color + _S_color_interval;
-    inline static constexpr u16 _S_gray_color = _S_locked_color + _S_color_interval;
-
-    using rgb_t = std::tuple<u16, u16, u16>;
-
-    // normal = color * (4/5)
-    inline static rgb_t _S_normal_coloring(rgb_t __c) {
-        auto [__r, __g, __b] = __c;
-        __r -= __r / 5;
-        __g -= __g / 5;
-        __b -= __b / 5;
-        return {__r, __g, __b};
-    }
-
-    // guide = color * (5/10)
-    inline static rgb_t _S_guide_coloring(rgb_t __c) {
-        auto [__r, __g, __b] = __c;
-        __r = __r / 2;
-        __g = __g / 2;
-        __b = __b / 2;
-        return {__r, __g, __b};
-    }
-    
-    // locked = color
-    inline static rgb_t _S_locked_coloring(rgb_t __c)
-    { return __c; }
-
-    // gray = grayscale(color)
-    // TODO : grayscale issue
-    inline static rgb_t _S_gray_coloring(rgb_t __c) {
-        auto [__r, __g, __b] = __c;
-        u8 __gray = (u8)std::rint(
-            std::pow(
-                0.2126 * std::pow(__r, 2.2) +
-                0.7152 * std::pow(__g, 2.2) +
-                0.0722 * std::pow(__b, 2.2),
-                1.0 / 2.2
-            ) * 76
-        );
-        return {__gray, __gray, __gray};
-    }
-
-    inline static rgb_t _M_convert_base(rgb_t __color, u16 __from, u16 __to) {
-        auto [__r, __g, __b] = __color;
-        return {
-            static_cast<u16>((u32)__r * __to / __from),
-            static_cast<u16>((u32)__g * __to / __from),
-            static_cast<u16>((u32)__b * __to / __from)
-        };
-    }
-
-    template <typename _UnaryOp>
-    inline static bool _M_init_color(u16 __idx, rgb_t __value, _UnaryOp __op) {
-        auto [__r, __g, __b] = _M_convert_base(__op(__value), 255u, 1000u);
-        return
-            init_color(__idx, __r, __g, __b) == OK &&
-            init_pair(__idx, __idx, __idx) == OK;
-    }
-
-    void _M_init() {
-        for (u8 __i = 0; __i < 9u; __i++) {
-            auto __color = _M_color->color(static_cast<block_type>(__i));
-            _M_init_color(_S_normal_color + __i, __color, _S_normal_coloring);
-            _M_init_color(_S_guide_color  + __i, __color, _S_guide_coloring );
-            _M_init_color(_S_locked_color + __i, __color, _S_locked_coloring);
-            // _M_init_color(_S_gray_color   + __i, __color, _S_gray_coloring  );
-        }
-
-        // Use single gray color instead of grayscale.
-        _M_init_color(_S_gray_color, {76, 76, 76}, _S_locked_coloring);
-
-        i32 __left_space_width = 30,
-            __width = __left_space_width + _M_field.width() * 2 + 4;
-        i32 __next_left_pos = __left_space_width + _M_field.width() * 2 + 4,
-            __next_height = _M_user_config.game.next_queue_size * 4 + 2;
-
-        _M_windows._M_field = newwin(
-            _M_field.height() + 2, _M_field.width() * 2 + 2,
-            1, __left_space_width + 1
-        );
-        _M_windows._M_next = newwin(
-            __next_height, 10,
-            1, __next_left_pos
-        );
-        _M_windows._M_hold = newwin(6, 10, 1, __left_space_width - 10);
-        _M_windows._M_stats = newwin(15, __left_space_width, 12, 0);
-        _M_windows._M_msg = newwin(1, __width, 0, 0);
-        _M_windows._M_meta = newwin(3, __left_space_width, 8, 0);
-
-        _M_refresh_marked = { true, true, true, true };
-    }
-
-    tetromino _M_get_next() {
-        if (_M_user_config.game.mode == user_config::game_mode::puzzle) {
-            if (_M_queue.empty()) {
-                if (_M_hold.has_value()) {
-                    tetromino __hold = *_M_hold;
-                    _M_hold.reset();
-                    _M_holdable = false;
-                    _M_draw_hold();
-                    return __hold;
-                } else return tetromino::INVALID;
-            } else {
-                tetromino __next = _M_queue.front();
-                _M_queue.pop_front();
-                return __next;
+    // Copies what the screen shows into a frame and hands it to the render thread.
+    void _M_publish(u32 __countdown = 0) {
+        TRACE_SPAN("publish");
+
+        frame& __f = _M_frames.back();
+
+        __f.take(_M_engine, _M_user_config.game.next_queue_size);
+        __f._M_puzzle = _M_user_config.game.mode == user_config::game_mode::puzzle;
+        __f._M_rolling = _M_rolling;
+        __f._M_lifetime = _M_lifetime;
+        __f._M_finesse = _M_finesse_tally;
+        __f._M_meta = _M_meta_time > 0 ? _M_meta_data[_M_meta_idx] : std::string_view();
+        __f._M_countdown = __countdown;
+        __f._M_over = _M_over;
+        __f._M_action = _M_actions;
+
+        __f._M_hint.reset();
+        if (_M_hint && _M_running) {
+            auto __r = _M_hint->latest();
+            if (__r && __r->_M_request == _M_hint_request) {
+                __f._M_hint = __r->_M_mino;
+                __f._M_hint_x = __r->_M_x;
+                __f._M_hint_y = __r->_M_y;
             }
         }
 
-        while (_M_queue.size() <= std::max(_M_user_config.game.next_queue_size, 3u))
-            _M_queue.push_back(_M_bag.next());
+#ifdef DEBUG
+        __f._M_alloc_frame = _M_alloc_frame;
+        __f._M_alloc_input = _M_alloc_input;
+#endif
 
-        tetromino __next = _M_queue.front();
-        _M_queue.pop_front();
-        return __next;
+        _M_frames.publish();
     }
 
-    void _M_draw_mino(
-        WINDOW* __win,
-        const tetromino& __t,
-        u32 __y, u32 __x,
-        bool __revision, bool __erase = false, bool __ghost = false,
-        bool __current = false
-    ) {
-        u32 __px = __t.type() == mino_type::O ? 2 : 1,
-            __py = __t.type() == mino_type::I ? 1 : 2;
-        
-        u32 __tx = __revision ? std::min(__t.size(), 3u) : __t.size();
-            
-        if (!__revision) __px = 0, __py = 0;
-
-        auto __attr =
-            __ghost ? COLOR_PAIR(_S_guide_color + static_cast<u8>(__t.type())) :
-            __current ? COLOR_PAIR(_S_locked_color + static_cast<u8>(__t.type())) :
-            COLOR_PAIR(_S_normal_color + static_cast<u8>(__t.type()));
-        
-        for (u32 __j = 0; __j < __t.size(); ++__j) {
-            u32 __cx = __px + __x, __cy = __py + __y + __j;
-            wmove(__win, __cy, __cx);
-            
-            for (u32 __k = 0; __k < __tx; ++__k) {
-                if (__t.data()[__j][__k] == 0) continue;
-                
-                wmove(__win, __cy, __cx + __k * 2);
-                if (!__erase) wattron(__win, __attr);
-                wprintw(__win, "  ");
-                if (!__erase) wattroff(__win, __attr);
-            }
-        }
+    void _M_update_pace() {
+        const auto __now = perf_stats::clock_type::now();
+        _M_lifetime = _M_perf.lifetime(__now);
+        _M_rolling = _M_perf.rolling(__now);
     }
 
+    // Counts the placement made by the last input, if any.
+    void _M_record_placement(const engine::stats_data& __before) {
+        const auto& __stats = _M_engine.stats();
+        if (__stats._M_place_count <= __before._M_place_count) return;
 
-    // Draw field after tetromino is placed or garbage is added.
-    void _M_draw_field(bool __gray = false) {
-        wclear(_M_windows._M_field);
-        box(_M_windows._M_field, 0, 0);
-
-        const auto& __dt = _M_field.data();
-
-        u32 y = 1;
-        auto __it = __dt.rbegin();
-        for (; __it != __dt.rend(); ++__it, ++y) {
-            wmove(_M_windows._M_field, y, 1);
-
-            for (const auto& [cell, attr] : *__it) {
-                if (cell == block_type::EMPTY) {
-                    wprintw(_M_windows._M_field, "  ");
-                } else {
-                    chtype __attr = 0;
-                    
-                    switch (attr) {
-                        case block_attribute::NORMAL:
-                            __attr = COLOR_PAIR(
-                                (__gray ? _S_gray_color : _S_normal_color +
-                                static_cast<u8>(cell)));
-                            break;
-                        case block_attribute::GUIDE:
-                            __attr = COLOR_PAIR(_S_guide_color + static_cast<u8>(cell));
-                            break;
-                        case block_attribute::LOCKED:
-                            __attr = COLOR_PAIR(_S_locked_color + static_cast<u8>(cell));
-                            break;
-                    }
-
-                    wattron(_M_windows._M_field, __attr);
-                    wprintw(_M_windows._M_field, "  ");
-                    wattroff(_M_windows._M_field, __attr);
-                }
-            }
-        }
-
-        if (!__gray) {
-            _M_draw_ghost_mino();
-            _M_draw_current_mino();
-        }
-
-        _M_refresh_marked[0] = true;
-
-        _M_draw_stats();
+        _M_perf.place(__stats._M_attack - __before._M_attack, _M_perf_keys);
+        _M_perf_keys = 0;
+        _M_update_pace();
     }
 
-    void _M_draw_next() {
-        wclear(_M_windows._M_next);
-        box(_M_windows._M_next, 0, 0);
-
-        mvwprintw(_M_windows._M_next, 0, 3, "Next");
-
-        auto iter = _M_queue.begin();
-        u32 __size = std::min<u32>(_M_user_config.game.next_queue_size, _M_queue.size());
-        for (u32 __i = 0; __i < __size; ++__i, ++iter)
-            _M_draw_mino(_M_windows._M_next, *iter, __i * 4, 1, true);
+    // Handles a spawn that did not bring in a tetromino.
+    // Returns false if the game can not go on.
+    bool _M_after_spawn(engine::spawn_result __r) {
+        switch (__r) {
+            case engine::spawn_result::ok: return true;
+            case engine::spawn_result::topped_out: gameover(); return false;
+            case engine::spawn_result::puzzle_end:
+                _M_restart_req = true;
+                return false;
+        }
 
-        _M_refresh_marked[1] = true;
+        return true;
     }
 
-    void _M_draw_hold() {
-        wclear(_M_windows._M_hold);
-        box(_M_windows._M_hold, 0, 0);
+    void _M_start(u32 __countdown) {
+        _M_engine.begin();
 
-        mvwprintw(_M_windows._M_hold, 0, 3, "Hold");
+        if (_M_user_config.game.mode == user_config::game_mode::puzzle)
+            _M_restart_countdown = 0;
 
-        if (_M_hold) {
-            tetromino __t = *_M_hold;
-            
-            _M_draw_mino(_M_windows._M_hold, __t, 0, 1, true);
-        }
+        _M_renderer.start(_M_frames);
 
-        _M_refresh_marked[2] = true;
-    }
-
-    void _M_draw_stats() {
-        wclear(_M_windows._M_stats);
-        box(_M_windows._M_stats, 0, 0);
-        
-        mvwprintw(_M_windows._M_stats, 0, 3, "Stats");
-
-        if (_M_user_config.game.mode == user_config::game_mode::puzzle) {
-            mvwprintw(_M_windows._M_stats, 2, 1, "Solved count: %d", _M_solved_count);
-        } else {
-            mvwprintw(_M_windows._M_stats, 2, 1, "Lines: %d", _M_stats._M_lines);
-            mvwprintw(_M_windows._M_stats, 3, 1, "Attack: %d", _M_stats._M_attack);
-            mvwprintw(_M_windows._M_stats, 4, 1, "B2B: %d", _M_stats._M_b2b);
-            mvwprintw(_M_windows._M_stats, 5, 1, "Combo: %d", _M_stats._M_combo);
-            mvwprintw(_M_windows._M_stats, 6, 1, "Placed: %d", _M_stats._M_place_count);
-            mvwprintw(_M_windows._M_stats, 7, 1, "Input: %d", _M_stats._M_input_count);
+        __countdown = std::min(9u, __countdown);
+        for (; __countdown > 0; __countdown--) {
+            _M_publish(__countdown);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
         }
-#ifdef DEBUG
-        mvwprintw(_M_windows._M_stats, 8, 1, "%ld : [%ld, %ld)",
-            _M_save_buffer.current_index(),
-            _M_save_buffer.start_index(),
-            _M_save_buffer.last_index()
-        );
-#endif
 
-        _M_refresh_marked[3] = true;
+        _M_begin_play();
+        _M_after_spawn(_M_engine.spawn());
+        _M_update_hint();
+        _M_publish();
     }
 
-    void _M_draw_current_mino(bool __erase = false) {
-        if (!_M_current) return;
-
-        // Draw current tetromino on the field.
-        // It will be drawn on the field after it is placed.
+    // Starts the clocks and takes input, the game is ready to play.
+    void _M_begin_play() {
+        _M_start_time = clock_type::now();
+        _M_last_pace_time = _M_start_time;
+        _M_last_autosave_time = _M_start_time;
 
-        // mino_y = base of collision_down
-        _M_draw_mino(
-            _M_windows._M_field, *_M_current,
-            _M_field.height() - _M_current_y,
-            _M_current_x * 2 + 1,
-            false,
-            __erase, false, true
-        );
+        _M_perf.start();
+        _M_perf_keys = 0;
+        _M_update_pace();
 
+        _M_finesse_tally = {};
+        _M_finesse_keys = 0;
 
+        _M_keys.discard();
+        _M_running = true;
     }
 
-    void _M_draw_ghost_mino(bool __erase = false) {
-        if (!_M_current) return;
-
-        if (__erase) {
-            _M_draw_mino(
-                _M_windows._M_field, *_M_current,
-                _M_field.height() - _M_ghost_y,
-                _M_ghost_x * 2 + 1,
-                false, true, true
-            );
+    // Starts searching a hint if the tetromino in play, the hold or the
+    // field changed since the last search.
+    void _M_update_hint() {
+        if (!_M_hint) return;
 
+        if (!_M_running || !_M_engine.current()) {
+            _M_hint->cancel();
+            _M_hint_state = 0;
             return;
         }
 
-        _M_ghost_x = _M_current_x;
-        _M_ghost_y = _M_current_y;
+        const auto& __hold = _M_engine.held();
+        u64 __state = state_hash()
+            .add(_M_engine.get_field().version())
+            .add(_M_engine.stats()._M_place_count)
+            .add((u64)_M_engine.current()->type() << 8 | (u64)(__hold ? __hold->type() : mino_type::INVALID))
+            .value();
 
-        while (!_M_is_in_collision(_M_ghost_x, _M_ghost_y - 1, *_M_current))
-            _M_ghost_y -= 1;
+        if (__state == _M_hint_state) return;
 
-        _M_draw_mino(
-            _M_windows._M_field, *_M_current,
-            _M_field.height() - _M_ghost_y,
-            _M_ghost_x * 2 + 1,
-            false, false, true
-        );
+        _M_hint_state = __state;
+        _M_hint_request = _M_hint->request(_M_engine);
     }
 
-    void _M_draw_all() {
-        _M_draw_field();
-        _M_draw_next();
-        _M_draw_hold();
-        _M_draw_stats();
-    }
-
-    bool _M_is_in_collision(
-        i32 __x, i32 __y, const tetromino& __t
-    ) {
-        if (__t == tetromino::INVALID) return true;
-
-        for (u32 __i = 0; __i < __t.size(); ++__i) {
-            for (u32 __j = 0; __j < __t.size(); ++__j) {
-                if (__t.data()[__i][__j] == 0) continue;
-
-                i32 __px = __x + __j,
-                    __py = __y - __i;
+    // Applies a control key, from the player or the bot.
+    void _M_apply(control_key __key) {
+        if (_M_replay) _M_replay->_M_inputs.push_back(__key);
 
-                block_type __bt = _M_field.get_block(__px, __py);
-                if (__bt != block_type::EMPTY) return true;
-            }
+#ifdef DEBUG
+        auto __alloc = alloc_counter::now();
+#endif
+        const auto __before = _M_engine.stats();
+
+        // Counted before `drop()` checks them.
+        switch (__key) {
+            case control_key::LEFT: case control_key::RIGHT: case control_key::DOWN:
+            case control_key::ROTATE_CW: case control_key::ROTATE_CCW: case control_key::ROTATE_180:
+            case control_key::DROP:
+                _M_finesse_keys++;
+                break;
+            default: break;
         }
 
-        return false;
-    }
-
-    /*
-    bool _M_is_in_collision() {
-        if (!_M_current) return true;
-
-        return _M_collision_check(
-            _M_current_x, _M_current_y, *_M_current
-        );
-    }
-    */
-
-    // For spin check.
-    bool _M_is_immobile() {
-        return 
-            _M_is_in_collision(_M_current_x - 1, _M_current_y, *_M_current) &&
-            _M_is_in_collision(_M_current_x + 1, _M_current_y, *_M_current) &&
-            _M_is_in_collision(_M_current_x, _M_current_y + 1, *_M_current) &&
-            _M_is_in_collision(_M_current_x, _M_current_y - 1, *_M_current);
-    }
-
-    bool _M_down_once() {
-        bool __cur = _M_user_config.control.inf_soft_drop;
-        _M_user_config.control.inf_soft_drop = false;
+        switch (__key) {
+            case control_key::LEFT: left(); break;
+            case control_key::RIGHT: right(); break;
+            case control_key::DOWN: down(); break;
+            case control_key::ROTATE_CW: rotate(rotation::cw); break;
+            case control_key::ROTATE_CCW: rotate(rotation::ccw); break;
+            case control_key::ROTATE_180: rotate(rotation::_180); break;
+            case control_key::DROP: drop(); break;
+            case control_key::HOLD: hold(); break;
+            case control_key::RESET: _M_restart_req = true; return;
+            case control_key::QUIT: gameover(); break;
+            case control_key::UNDO: undo(); break;
+            case control_key::REDO: redo(); break;
+            case control_key::EARLIER: earlier(); break;
+            case control_key::LATER: later(); break;
+            default: break;
+        }
 
-        bool __r = down();
+        _M_engine.count_input();
+        _M_actions++;
+        _M_perf_keys++;
+        _M_record_placement(__before);
+        _M_update_hint();
 
-        _M_user_config.control.inf_soft_drop = __cur;
+#ifdef DEBUG
+        _M_alloc_input = alloc_counter::now() - __alloc;
+#endif
 
-        return __r;
+        _M_publish();
     }
 
-    void _M_start(u32 __countdown) {
-        _M_queue = std::list<tetromino>();
-
-        if (_M_user_config.game.mode == user_config::game_mode::puzzle) {
-            if (_M_puzzle_func == nullptr)
-                throw std::runtime_error("Puzzle function is not set.");
-            if (_M_puzzle_sequence.empty())
-                throw std::runtime_error("Puzzle sequence is not set.");
-            
-            if (_M_puzzle_queue.empty())
-                _M_puzzle_queue = *tetromino::gen(_M_puzzle_sequence, _M_rand);
-            _M_queue = std::list<tetromino>(_M_puzzle_queue.begin(), _M_puzzle_queue.end());
-
-            _M_restart_countdown = 0;
-        } else {
-            while (_M_queue.size() < std::max(_M_user_config.game.next_queue_size, 3u))
-                _M_queue.push_back(_M_bag.next());
-        }
-        
-        _M_hold = std::nullopt;
-        _M_holdable = _M_user_config.hold.enabled;
-
-        _M_draw_all();
-        wnoutrefresh(_M_windows._M_field);
-        wnoutrefresh(_M_windows._M_next);
-        wnoutrefresh(_M_windows._M_hold);
-        wnoutrefresh(_M_windows._M_stats);
-        doupdate();
-
-        if (__countdown > 0) {
-            u32 __bw, __bh;
-            getbegyx(_M_windows._M_field, __bh, __bw);
-
-            u32 __w = __bw + converter::center(_M_field.width() * 2 + 2, 6),
-                __h = __bh + converter::center(_M_field.height() + 2, 4);
-            
-            WINDOW* __pw = newwin(5, 7, __h, __w);
-
-            __countdown = std::min(9u, __countdown);
-            for (; __countdown > 0; __countdown--) {
-                mvwprintw(__pw, 0, 0, "%s", converter::i2a[__countdown].data());
-                wrefresh(__pw);
-
-                std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-            }
+    // Applies the next key of the bot, choosing a placement first if it
+    // has none left.
+    void _M_play_bot() {
+        if (_M_bot_next >= _M_bot_keys.size()) {
+            auto __d = _M_bot->think(_M_engine, _S_bot_budget);
+            if (!__d) return;
 
-            delwin(__pw);
+            _M_bot_keys.clear();
+            if (__d->_M_hold) _M_bot_keys.push_back(control_key::HOLD);
+            _M_bot_keys.insert(_M_bot_keys.end(),
+                __d->_M_placement._M_inputs.begin(), __d->_M_placement._M_inputs.end());
+            _M_bot_next = 0;
         }
 
-        _M_start_time = clock_type::now();
-        _M_last_fps_time = _M_start_time;
-
-        flushinp();
-        spawn();
-        _M_draw_all();
-        _M_running = true;
+        _M_apply(_M_bot_keys[_M_bot_next++]);
     }
 
     void _M_reset_meta() { _M_meta_time = 0; }
@@ -613,321 +351,99 @@ private:
         _M_meta_idx = __idx;
         _M_meta_time =
             std::chrono::duration_cast<std::chrono::seconds>(__time).count() * 60;
-        _M_meta_drawn = false;
     }
 
 public:
-    bool left() {
-        if (_M_is_in_collision(_M_current_x - 1, _M_current_y, *_M_current)) return false;
-
-        _M_draw_current_mino(true);
-        _M_draw_ghost_mino(true);
-
-        _M_current_x -= 1;
-
-        _M_draw_ghost_mino();
-
-        _M_draw_current_mino();
-        _M_refresh_marked[0] = true;
-
-        _M_is_last_spin = false;
-
-        return true;
-    }
-
-    bool right() {
-        if (_M_is_in_collision(_M_current_x + 1, _M_current_y, *_M_current)) return false;
-
-        _M_draw_current_mino(true);
-        _M_draw_ghost_mino(true);
-
-        _M_current_x += 1;
-
-        _M_draw_ghost_mino();
-
-        _M_draw_current_mino();
-        _M_refresh_marked[0] = true;
-
-        _M_is_last_spin = false;
-
-        return true;
-    }
-
-    bool down() {
-        if (_M_is_in_collision(_M_current_x, _M_current_y - 1, *_M_current)) return false;
-
-        if (_M_user_config.control.inf_soft_drop) {
-            _M_draw_current_mino(true);
+    bool left() { return _M_engine.left(); }
+    bool right() { return _M_engine.right(); }
+    bool down() { return _M_engine.down(); }
 
-            while (!_M_is_in_collision(_M_current_x, _M_current_y - 1, *_M_current))
-                _M_current_y -= 1;
-            
-        } else {
-            _M_draw_current_mino(true);
-
-            _M_current_y -= 1;
-        }
-
-        _M_is_last_spin = false;
-
-        _M_draw_current_mino();
-        _M_refresh_marked[0] = true;
-
-        return true;
-    }
-
-    void rotate(rotation __r) {
-        if (!_M_current) return;
-        
-        tetromino __t = *_M_current;
-        __t.rotate(__r);
-
-        const auto& __table =
-            _M_kick_table->get(__t, _M_current->direction(), __t.direction());
-        
-        bool __flag = false;
-        i32 __idx = -1;
-        std::pair<i32, i32> __p = { 0, 0 };
-        auto& [__px, __py] = __p;
-        do {
-            if (__idx != -1)
-                __p = __table[__idx];
-
-            if (!_M_is_in_collision(_M_current_x + __px, _M_current_y + __py, __t))
-            { __flag = true; break; }
-
-            __idx++;
-        } while ((u32)__idx < __table.size());
-
-        if (!__flag) return;
-
-        _M_draw_current_mino(true);
-        _M_draw_ghost_mino(true);
-
-        _M_current = __t;
-        _M_current_x += __px;
-        _M_current_y += __py;
-
-        _M_is_last_spin = true;
-        _M_kick_index = __idx;
-
-        _M_draw_ghost_mino();
-        _M_draw_current_mino();
-        _M_refresh_marked[0] = true;
-    }
+    void rotate(rotation __r) { _M_engine.rotate(__r); }
 
     void drop() {
-        if (!_M_current) return;
+        // Checked before the drop, on the board the tetromino lands on.
+        auto __minimal = _M_finesse.minimal(_M_engine);
 
-        _M_draw_current_mino(true);
-        _M_draw_ghost_mino(true);
-
-        while (!_M_is_in_collision(_M_current_x, _M_current_y - 1, *_M_current)) {
-            _M_current_y -= 1;
-            _M_is_last_spin = false;
-        }
+        auto __res = _M_engine.drop();
+        if (!__res) return;
 
-        bool __imm = _M_is_immobile();
-
-        _M_field.put_mino(_M_current_x, _M_current_y, *_M_current);
-
-        spin_type __sp =
-            _M_is_last_spin ?
-            _M_spin_table->get({
-                *_M_current, _M_current_x, _M_current_y,
-                _M_kick_index, __imm,
-                _M_field
-            }) : spin_type::NONE;
-
-        u32 __lines = _M_field.proceed_lines();
-
-        if (__lines > 0) {
-            // Check perfect clear
-            _M_attack_info._M_pc = _M_field.is_empty();
-            _M_attack_info._M_type = static_cast<attack_type>(__lines - 1);
-            _M_attack_info._M_combo++;
-            _M_attack_info._M_spin = __sp;
-            if (_M_attack_info._M_spin == spin_type::NONE && 
-                _M_attack_info._M_type != attack_type::QUAD && !(
-                    _M_user_config.game.enable_pc_b2b &&
-                    _M_attack_info._M_pc
-                ))
-                _M_attack_info._M_btb = -1;
-            else _M_attack_info._M_btb++;
-            
-            u32 __atk = _M_attack_table->get(_M_attack_info);
+        if (_M_replay) _M_replay->_M_checksums.push_back(__res->_M_checksum);
 
-            _M_attack_history.push_back(_M_attack_info.to_string(_M_current->to_char()));
-            _M_save_buffer.current()._M_attck_string = _M_attack_history.back();
+        if (__minimal) {
+            finesse::result __f = { *__minimal, _M_finesse_keys };
+            _M_finesse_tally.add(__f);
 
-            if (_M_attack_info._M_pc)
-                _M_set_meta(3, std::chrono::seconds(2));
-            
-            _M_stats._M_lines += __lines;
-            _M_stats._M_attack += __atk;
-        } else {
-            _M_attack_info._M_pc = false;
-            _M_attack_info._M_type = attack_type::SINGLE;
-            _M_attack_info._M_combo = 0;
-            _M_attack_info._M_spin = spin_type::NONE;
+            if (__f.fault()) _M_set_meta(3, std::chrono::seconds(1));
         }
+        _M_finesse_keys = 0;
 
-        _M_stats._M_b2b = _M_attack_info._M_btb;
-        _M_stats._M_combo = _M_attack_info._M_combo;
-        _M_stats._M_place_count++;
-
-        if (_M_user_config.game.mode == user_config::game_mode::puzzle) {
-            if (_M_puzzle_func) {
-                if (_M_puzzle_func(
-                    _M_field, *_M_current, _M_current_x, _M_current_y,
-                    _M_attack_info
-                )) _M_solved = true;
-            }
-        }
+        if (__res->_M_lines > 0 && __res->_M_attack_info._M_pc)
+            _M_set_meta(2, std::chrono::seconds(2));
 
-        // Draw in spawn.
-        spawn();
-        _M_draw_field();
-    }
-
-    void spawn(bool __new = true, bool __hold = false) {
-        _M_draw_ghost_mino(true);
-
-        if (__new)
-            _M_current = _M_get_next();
-
-        if (_M_user_config.game.mode == user_config::game_mode::puzzle) {
-            if (_M_current == tetromino::INVALID) {
-                if (_M_solved) {
-                    _M_puzzle_queue = *tetromino::gen(_M_puzzle_sequence, _M_rand);
-
-                    _M_solved_count++;
-                    _M_solved = false;
-                    _M_draw_stats();
-                }
-
-                _M_queue = std::list<tetromino>(
-                    _M_puzzle_queue.begin(), _M_puzzle_queue.end()
-                );
-                
-                _M_restart_req = true;
-                return;
-            }
-        }
-
-        _M_current_x = _M_field.width() / 2 - (_M_current->size() + 1) / 2;
-        _M_current_y = _M_user_config.spawn.base_height;
-
-        if (_M_is_in_collision(_M_current_x, _M_current_y, *_M_current)) {
-            if (_M_user_config.spawn.extended) {
-                u32 __i = 0;
-                for (; __i < _M_user_config.spawn.extended_height; ++__i) {
-                    if (!_M_is_in_collision(_M_current_x, _M_current_y + __i, *_M_current))
-                        break;
-                }
-
-                if (__i < _M_user_config.spawn.extended_height) {
-                    _M_current_y += __i;
-                } else { gameover(); return; }
-            } else { gameover(); return; }
-        }
-
-        if (!__hold)
-            _M_holdable = true;
-
-        _M_draw_ghost_mino();
-        _M_draw_current_mino();
-        _M_refresh_marked[0] = true;
-
-        if (!__hold) {
-            save_data __dt;
-
-            __dt._M_field = _M_field;
-            __dt._M_current = _M_current;
-            __dt._M_hold = _M_hold;
-            __dt._M_queue = _M_queue;
-            __dt._M_attack_info = _M_attack_info;
-            __dt._M_attck_string = std::nullopt;
-            __dt._M_bag_data = _M_bag.save();
-            __dt._M_rand = _M_rand;
-            __dt._M_stats = _M_stats;
-
-            _M_save_buffer.push(std::move(__dt));
-        }
-
-        _M_draw_next();
+        _M_after_spawn(__res->_M_spawn);
     }
 
     void hold() {
-        if (!_M_user_config.hold.enabled) return;
-        if (!_M_holdable) return;
+        auto __res = _M_engine.hold();
+        if (!__res) return;
 
-        if (_M_hold) {
-            swap(_M_current, _M_hold);
-            spawn(false, true);
-        }
-        else {
-            if (_M_queue.empty()) return;
+        _M_finesse_keys = 0;
 
-            _M_hold = _M_current;
-            spawn(true, true);
-        }
+        _M_after_spawn(*__res);
+    }
 
-        _M_hold->set_direction(0);
-        
-        if (!_M_user_config.hold.infinite)
-            _M_holdable = false;
+    // Waits up to `__timeout` for a key, `key_code::none` if none came.
+    i32 read_key(std::chrono::milliseconds __timeout) { return _M_keys.read(__timeout); }
 
-        _M_draw_field();
-        _M_draw_hold();
-    }
+    // Drops the keys typed so far.
+    void discard_keys() { _M_keys.discard(); }
 
     void proceed_input(i32 ch) {
         if (!_M_running) return;
             
-        if (ch == ERR) return;
-        if (ch == KEY_RESIZE) {
-            clear(); _M_draw_all();
-            return;
-        }
+        if (ch == key_code::none) return;
+
+        TRACE_SPAN("input");
 
         ch = std::tolower(ch);
 
 #ifdef DEBUG
         if (ch == 'g')  {
             // Debugging: move down once
-            _M_down_once();
+            _M_actions++;
+            if (_M_engine.down_once()) _M_publish();
             return;
         }
 #endif
         if (!_M_user_config.control.key_map.contains(ch)) return;
-            
-        switch (_M_user_config.control.key_map.at(ch)) {
-            case control_key::LEFT: left(); break;
-            case control_key::RIGHT: right(); break;
-            case control_key::DOWN: down(); break;
-            case control_key::ROTATE_CW: rotate(rotation::cw); break;
-            case control_key::ROTATE_CCW: rotate(rotation::ccw); break;
-            case control_key::ROTATE_180: rotate(rotation::_180); break;
-            case control_key::DROP: drop(); break;
-            case control_key::HOLD: hold(); break;
-            case control_key::RESET: _M_restart_req = true; return;
-            case control_key::QUIT: gameover(); break;
-            case control_key::UNDO: undo(); break;
-            case control_key::REDO: redo(); break;
-            default: break;
-        }
 
-        _M_stats._M_input_count++;
+        control_key __key = _M_user_config.control.key_map.at(ch);
+
+        // The player takes over until the bot's next placement.
+        _M_bot_next = _M_bot_keys.size();
+
+        _M_apply(__key);
     }
 
     void garbage(u32 __cnt, i32 __hole = -1) {
-        _M_field.put_garbage(__cnt, __hole);
-        _M_draw_field();
+        _M_engine.garbage(__cnt, __hole);
+        _M_update_hint();
+        _M_publish();
     }
 
     void start() { _M_start(_M_user_config.game.start_countdown); }
 
+    // Continues a saved game instead of starting a new one.
+    void resume(const session& __s) {
+        _M_engine.load_session(__s._M_data);
+
+        _M_renderer.start(_M_frames);
+
+        _M_begin_play();
+        _M_update_hint();
+        _M_publish();
+    }
+
     void restart() {
         reset();
 
@@ -938,162 +454,181 @@ public:
     }
 
     void gameover() {
-        _M_draw_field(true);
-        _M_draw_next();
-        refresh();
-
         _M_running = false;
+        _M_over = true;
 
-        mvwprintw(_M_windows._M_msg, 0, 0, "Game Over! Press any key to exit...");
-        wnoutrefresh(_M_windows._M_msg);
+        _M_publish();
     }
 
     void reset() {
         _M_restart_req = false;
         _M_running = false;
+        _M_over = false;
+        _M_bot_next = _M_bot_keys.size();
 
-        _M_field.clear();
-        _M_bag.reset();
-        
-        _M_queue = std::list<tetromino>();
-        _M_current = std::nullopt;
-        _M_hold = std::nullopt;
-
-        _M_save_buffer.clear();
-
-        _M_attack_info = {
-            attack_type::SINGLE, 0, -1, spin_type::NONE, false
-        };
-        _M_is_last_spin = false;
-
-        _M_stats = {};
-
-        _M_attack_history.clear();
+        _M_engine.reset();
     }
 
     void undo() {
-        if (!_M_save_buffer.prev()) {
+        if (!_M_engine.undo()) {
             _M_set_meta(0, std::chrono::seconds(3));
             return;
         }
 
-        const save_data& __dt = _M_save_buffer.current();
+        _M_finesse_keys = 0;
 
-        _M_field = __dt._M_field;
-        _M_current = __dt._M_current;
-        _M_hold = __dt._M_hold;
-        _M_queue = __dt._M_queue;
-        _M_attack_info = __dt._M_attack_info;
-        if (__dt._M_attck_string.has_value())
-            _M_attack_history.pop_back();
-        _M_bag.load(__dt._M_bag_data);
-        _M_rand = __dt._M_rand;
-        _M_stats = __dt._M_stats;
+        _M_reset_meta();
+    }
 
-        _M_current_x = _M_field.width() / 2 - (_M_current->size() + 1) / 2;
-        _M_current_y = _M_user_config.spawn.base_height;
+    void redo() {
+        if (!_M_engine.redo()) {
+            _M_set_meta(1, std::chrono::seconds(3));
+            return;
+        }
 
-        _M_reset_meta();
+        _M_finesse_keys = 0;
 
-        _M_draw_all();
+        _M_reset_meta();
     }
 
-    void redo() {
-        std::string __atk =
-            _M_save_buffer.current()._M_attck_string.has_value() ?
-            *_M_save_buffer.current()._M_attck_string : "";
+    void earlier() {
+        if (!_M_engine.earlier()) {
+            _M_set_meta(0, std::chrono::seconds(3));
+            return;
+        }
+
+        _M_finesse_keys = 0;
 
-        if (!_M_save_buffer.next()) {
+        _M_reset_meta();
+    }
+
+    void later() {
+        if (!_M_engine.later()) {
             _M_set_meta(1, std::chrono::seconds(3));
             return;
         }
 
-        const save_data& __dt = _M_save_buffer.current();
+        _M_finesse_keys = 0;
+
+        _M_reset_meta();
+    }
+
+    /**
+     * @brief Draws the last frame and stops the render thread, the terminal
+     * can be used again by the caller. Call it before closing the terminal.
+     */
+    void close() { _M_renderer.stop(); }
 
-        _M_field = __dt._M_field;
-        _M_current = __dt._M_current;
-        _M_hold = __dt._M_hold;
-        _M_queue = __dt._M_queue;
-        _M_attack_info = __dt._M_attack_info;
-        if (!__atk.empty())
-            _M_attack_history.push_back(__atk);
-        _M_bag.load(__dt._M_bag_data);
-        _M_rand = __dt._M_rand;
-        _M_stats = __dt._M_stats;
+    /**
+     * @brief Starts recording applied keys, and checksums, as a replay.
+     *
+     * @param __seed Seed the random engine given to this game was created with.
+     */
+    void record(u32 __seed) {
+        _M_replay = replay { __seed, _M_bag_type, _M_user_config, {}, {} };
+        _M_engine.track_checksum(true);
+    }
 
-        _M_current_x = _M_field.width() / 2 - (_M_current->size() + 1) / 2;
-        _M_current_y = _M_user_config.spawn.base_height;
+    const std::optional<replay>& recording() const { return _M_replay; }
 
-        _M_reset_meta();
+    /**
+     * @brief Sends at most `__bytes_per_second` to the terminal, for slow
+     * links: frames published while the budget is spent are merged. Input
+     * is taken as usual meanwhile. Call it before `start()`.
+     */
+    void bandwidth(u64 __bytes_per_second) { _M_renderer.budget(__bytes_per_second); }
 
-        _M_draw_all();
+    /**
+     * @brief Saves the session to `__path` every few seconds, from a
+     * background thread, to resume it later. Not available in puzzle mode.
+     */
+    void autosave(const std::filesystem::path& __path) {
+        if (_M_user_config.game.mode == user_config::game_mode::puzzle) return;
+
+        _M_autosave = std::make_unique<autosaver>(__path, _M_bag_type, _M_user_config.game.mode);
     }
 
-    bool restart_requested() const { return _M_restart_req; }
-    bool is_running() const { return _M_running; }
-    u32 frame_duration() const { return _S_frame_duration; }
+    /**
+     * @brief Saves the session a last time, or deletes the save if the game
+     * topped out, as there is nothing to resume then. Waits for the disk.
+     */
+    void end_autosave() {
+        if (!_M_autosave) return;
 
-    u32 get_fps() {
-        u32 __rate = _M_frame_count;
+        if (_M_engine.is_over()) _M_autosave->remove();
+        else _M_autosave->save(_M_engine);
+    }
+
+    /**
+     * @brief Lets the bot play, one key per frame; keys of the player are
+     * still taken. It looks through the queue for `_S_bot_budget` per
+     * placement, see `anytime_search`. Needs the standard 10 x (20 + 4)
+     * field. With the marathon mode, the game runs until quit.
+     */
+    void autoplay(eval_weights __w = eval_weights{}) {
+        _M_bot = std::make_unique<anytime_search>(_M_user_config, __w);
+        _M_bot_next = _M_bot_keys.size();
+    }
+
+    /**
+     * @brief Shows where the tetromino in play is best placed, as a second
+     * ghost, searched on a background thread after each placement. Needs
+     * the standard 10 x (20 + 4) field, and is not available in puzzles.
+     */
+    void hint() {
+        const field& __f = _M_engine.get_field();
 
-        _M_frame_count = 0;
+        if (_M_user_config.game.mode == user_config::game_mode::puzzle) return;
+        if (!std::holds_alternative<boards::standard>(__f.board())) return;
 
-        return std::min(999u, __rate);
+        _M_hint = std::make_unique<hint_search>(_M_user_config, _M_bag_type);
+        _M_hint_state = 0;
+        _M_update_hint();
     }
 
-    void refresh() {
-        if (!_M_running) return;
+    // Keeps the pace of every placement for `perf().save()`; off by
+    // default, since it grows with the game.
+    void keep_pace_series(bool __keep) { _M_perf.keep_series(__keep); }
 
-        for (i32 __i = 0; __i <  4; ++__i) {
-            if (_M_refresh_marked[__i]) {
-                switch (__i) {
-                    case 0: wnoutrefresh(_M_windows._M_field); break;
-                    case 1: wnoutrefresh(_M_windows._M_next);  break;
-                    case 2: wnoutrefresh(_M_windows._M_hold);  break;
-                    case 3: wnoutrefresh(_M_windows._M_stats); break;
-                }
-                _M_refresh_marked[__i] = false;
-            }
-        }
+    const engine& get_engine() const { return _M_engine; }
+    const perf_stats& perf() const { return _M_perf; }
+    const finesse::tally& finesse_tally() const { return _M_finesse_tally; }
 
-        if (_M_meta_time > 0) {
-            if (!_M_meta_drawn) {
-                _M_meta_drawn = true;
-                box(_M_windows._M_meta, 0, 0);
-                mvwprintw(_M_windows._M_meta, 1, 1, "%s", 
-                    _M_meta_data[_M_meta_idx].data()
-                );
-                wnoutrefresh(_M_windows._M_meta);
-            }
+    bool restart_requested() const { return _M_restart_req; }
+    bool is_running() const { return _M_running; }
+    u32 frame_duration() const { return _S_frame_duration; }
 
-            _M_meta_time--;
-        } else if (_M_meta_time == 0) {
-            werase(_M_windows._M_meta);
-            wnoutrefresh(_M_windows._M_meta);
-        }
+    // Called once per frame: counts down the meta box, updates the pace
+    // every second, autosaves, lets the bot play, and publishes a frame.
+    void refresh() {
+        if (!_M_running) return;
 
-        auto now = clock_type::now();
-        if (now - _M_last_fps_time >= std::chrono::seconds(1)) {
-            _M_last_fps_time = now;
+        TRACE_SPAN("refresh");
 
-            u32 fps = get_fps();
+        if (_M_meta_time > 0) _M_meta_time--;
 
-            mvwprintw(_M_windows._M_msg, 0, 0, "FPS: %3d", fps);
-            wnoutrefresh(_M_windows._M_msg);
+        auto now = clock_type::now();
+        if (now - _M_last_pace_time >= std::chrono::seconds(1)) {
+            _M_last_pace_time = now;
+            _M_update_pace();
         }
 
-        doupdate();
-
-        _M_frame_count++;
-    }
+        if (_M_autosave && now - _M_last_autosave_time >= _S_autosave_interval) {
+            _M_last_autosave_time = now;
+            _M_autosave->capture(_M_engine);
+        }
 
-    void set_puzzle_function(puzzle_function __func) { _M_puzzle_func = __func; }
-    void set_puzzle_sequence(const std::string& __seq) {
-        _M_puzzle_sequence = __seq;
+        if (_M_bot) _M_play_bot();
 
-        auto __test = tetromino::gen(__seq, _M_rand);
+        _M_publish();
 
-        if (!__test)
-            throw std::runtime_error("Invalid puzzle sequence: " + __seq);
+#ifdef DEBUG
+        auto __alloc = alloc_counter::now();
+        _M_alloc_frame = __alloc - _M_alloc_mark;
+        _M_alloc_mark = __alloc;
+#endif
     }
-};
\ No newline at end of file
+
+    void set_puzzle_function(puzzle_function __func) { _M_engine.set_puzzle_function(__func); }
+    void set_puzzle_sequence(const std::string& __seq) { _M_engine.set_puzzle_sequence(__seq); }
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+
+#include <poll.h>
+#include <unistd.h>
+#include <termios.h>
+
+#include <lib/intdef>
+
+#include <key_code.hpp>
+
+/**
+ * @brief Reads keys straight from the terminal, so that input does not go
+ * through ncurses, which only the render thread may use.
+ *
+ * Arrow keys come as escape sequences, `ESC [ A` or `ESC O A` in keypad
+ * mode, and are decoded into the `key_code::*` codes of the key map. A lone ESC
+ * is told apart from a sequence by waiting `$ESCDELAY` ms (25 by default)
+ * for the rest of it, as ncurses does. Other sequences are skipped.
+ */
+class key_reader {
+    int _M_fd;
+    std::chrono::milliseconds _M_escape_delay{25};
+
+    std::array<u8, 64> _M_buf;
+    u32 _M_begin = 0, _M_end = 0;
+
+    // Reads what is available, waiting up to `__timeout` if nothing is buffered.
+    bool _M_fill(std::chrono::milliseconds __timeout) {
+        if (_M_begin < _M_end) return true;
+
+        pollfd __p = { _M_fd, POLLIN, 0 };
+        if (::poll(&__p, 1, (int)__timeout.count()) <= 0) return false;
+
+        ssize_t __n = ::read(_M_fd, _M_buf.data(), _M_buf.size());
+        if (__n <= 0) return false;
+
+        _M_begin = 0;
+        _M_end = __n;
+        return true;
+    }
+
+    // Next byte, waiting up to `__timeout`, or -1.
+    i32 _M_next(std::chrono::milliseconds __timeout) {
+        if (!_M_fill(__timeout)) return -1;
+        return _M_buf[_M_begin++];
+    }
+
+public:
+    explicit key_reader(int __fd = STDIN_FILENO) : _M_fd(__fd) {
+        if (const char* __env = std::getenv("ESCDELAY"); __env && *__env)
+            _M_escape_delay = std::chrono::milliseconds(std::atoi(__env));
+    }
+
+    /**
+     * @brief Waits up to `__timeout` for a key.
+     *
+     * @return The key, with arrow keys as `key_code::*`, or `key_code::none` if none came.
+     */
+    i32 read(std::chrono::milliseconds __timeout) {
+        i32 __c = _M_next(__timeout);
+        if (__c != key_code::escape) return __c < 0 ? key_code::none : __c;
+
+        i32 __intro = _M_next(_M_escape_delay);
+        if (__intro < 0) return key_code::escape;
+        if (__intro != '[' && __intro != 'O') {
+            // Not a sequence, the byte after ESC is the next key.
+            _M_begin--;
+            return key_code::escape;
+        }
+
+        // Parameters, then the final byte.
+        i32 __final;
+        do __final = _M_next(_M_escape_delay);
+        while (__final >= 0x20 && __final < 0x40);
+
+        switch (__final) {
+            case 'A': return key_code::up;
+            case 'B': return key_code::down;
+            case 'C': return key_code::right;
+            case 'D': return key_code::left;
+            default: return key_code::none;
+        }
+    }
+
+    // Drops the keys typed so far.
+    void discard() {
+        _M_begin = _M_end = 0;
+        ::tcflush(_M_fd, TCIFLUSH);
+    }
+};
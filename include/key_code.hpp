@@ -0,0 +1,18 @@
+#pragma once
+
+#include <lib/intdef>
+
+// Key codes of the key map, as `key_reader::read()` returns them.
+// Arrow keys take the values of ncurses' `KEY_*` codes, so that key maps
+// are the same whichever screen the game is built with.
+namespace key_code {
+
+inline constexpr i32 none   = -1;
+inline constexpr i32 escape = 27;
+
+inline constexpr i32 down   = 0402;
+inline constexpr i32 up     = 0403;
+inline constexpr i32 left   = 0404;
+inline constexpr i32 right  = 0405;
+
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <vector>
+#include <chrono>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+
+#include <lib/intdef>
+
+#include <util/ring.hpp>
+
+/**
+ * @brief Pace of a game: pieces per second, attack per minute and keys
+ * per piece, over the whole game and over the last placements.
+ *
+ * Each placement is timestamped with the attack it sent and the keys it
+ * took. Rolling values cover the last `window` placements, kept in a fixed
+ * ring, and the time since the placement before them; lifetime values the
+ * whole game. Both are measured up to the time asked for, so they fall while
+ * the player idles.
+ *
+ * Unless `keep_series(false)`, every placement is also kept, with both
+ * paces at that time, as a time series that `save()` writes as CSV. It
+ * grows with the game, the rest stays the same size.
+ */
+class perf_stats {
+public:
+    using clock_type = std::chrono::steady_clock;
+    using time_type = clock_type::time_point;
+
+    static constexpr std::size_t window = 20;
+
+    struct pace {
+        f64 _M_pps = 0, _M_apm = 0, _M_kpp = 0;
+    };
+
+    struct sample {
+        // Seconds since the start of the game.
+        f64 _M_time;
+        u32 _M_attack, _M_keys;
+        pace _M_lifetime, _M_rolling;
+    };
+
+private:
+    time_type _M_start;
+
+    // One more than the window, the oldest one only marks where it starts.
+    ring<sample, window + 1> _M_recent;
+    std::vector<sample> _M_series;
+    bool _M_keep_series = true;
+
+    u64 _M_pieces = 0, _M_attack = 0, _M_keys = 0;
+
+    f64 _M_seconds(time_type __t) const
+    { return std::chrono::duration<f64>(__t - _M_start).count(); }
+
+    static pace _S_pace(u64 __pieces, u64 __attack, u64 __keys, f64 __seconds) {
+        if (__pieces == 0) return {};
+
+        // Avoids infinite rates for placements right at the start.
+        __seconds = std::max(__seconds, 1e-3);
+
+        return { __pieces / __seconds, __attack * 60 / __seconds, (f64)__keys / __pieces };
+    }
+
+    pace _M_rolling(f64 __now) const {
+        std::size_t __first = 0;
+        f64 __since = 0;
+
+        if (_M_recent.size() > window) {
+            __first = 1;
+            __since = _M_recent.front()._M_time;
+        }
+
+        u64 __attack = 0, __keys = 0;
+        for (std::size_t __i = __first; __i < _M_recent.size(); ++__i) {
+            __attack += _M_recent[__i]._M_attack;
+            __keys += _M_recent[__i]._M_keys;
+        }
+
+        return _S_pace(_M_recent.size() - __first, __attack, __keys, __now - __since);
+    }
+
+public:
+    perf_stats() : _M_start(clock_type::now()) { }
+
+    // Forgets every placement, the game starts at `__t`.
+    void start(time_type __t = clock_type::now()) {
+        _M_start = __t;
+        _M_recent.clear();
+        _M_series.clear();
+        _M_pieces = _M_attack = _M_keys = 0;
+    }
+
+    void place(u32 __attack, u32 __keys, time_type __t = clock_type::now()) {
+        _M_pieces++;
+        _M_attack += __attack;
+        _M_keys += __keys;
+
+        sample __s { _M_seconds(__t), __attack, __keys, {}, {} };
+        _M_recent.push_back(__s);
+
+        if (!_M_keep_series) return;
+
+        __s._M_lifetime = lifetime(__t);
+        __s._M_rolling = rolling(__t);
+        _M_series.push_back(__s);
+    }
+
+    // Whether placements from now on are added to the time series.
+    void keep_series(bool __keep) { _M_keep_series = __keep; }
+
+    pace lifetime(time_type __t = clock_type::now()) const
+    { return _S_pace(_M_pieces, _M_attack, _M_keys, _M_seconds(__t)); }
+
+    pace rolling(time_type __t = clock_type::now()) const
+    { return _M_rolling(_M_seconds(__t)); }
+
+    u64 pieces() const { return _M_pieces; }
+
+    const std::vector<sample>& series() const { return _M_series; }
+
+    /**
+     * @brief Writes the time series as CSV, one row per placement:
+     *
+     *   time,attack,keys,pps,apm,kpp,rolling_pps,rolling_apm,rolling_kpp
+     *
+     * where `time` is in seconds since the start, `attack` and `keys` are
+     * those of that placement, and the paces those at that time.
+     */
+    bool save(const std::filesystem::path& __path) const {
+        std::ofstream __os(__path);
+        if (!__os) return false;
+
+        __os << "time,attack,keys,pps,apm,kpp,rolling_pps,rolling_apm,rolling_kpp\n";
+
+        for (const sample& __s : _M_series) {
+            __os << __s._M_time << ',' << __s._M_attack << ',' << __s._M_keys << ','
+                 << __s._M_lifetime._M_pps << ',' << __s._M_lifetime._M_apm << ','
+                 << __s._M_lifetime._M_kpp << ','
+                 << __s._M_rolling._M_pps << ',' << __s._M_rolling._M_apm << ','
+                 << __s._M_rolling._M_kpp << '\n';
+        }
+
+        return (bool)__os;
+    }
+};
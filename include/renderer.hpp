@@ -0,0 +1,144 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <functional>
+
+#include <csignal>
+
+#include <lib/intdef>
+
+#include <config.hpp>
+#include <frame.hpp>
+
+#ifdef ANSI_ENABLED
+#include <screen/ansi.hpp>
+#else
+#include <screen/curses.hpp>
+#endif
+
+#include <util/snapshot_channel.hpp>
+
+// Screen the game is drawn on: ANSI escape sequences by default, ncurses
+// when built with `-DDISABLE_ANSI=ON`.
+#ifdef ANSI_ENABLED
+using screen_type = ansi_screen;
+#else
+using screen_type = curses_screen;
+#endif
+
+/**
+ * @brief Draws frames on the screen, on its own thread.
+ *
+ * The game publishes a frame after every input and every tick through a
+ * `snapshot_channel`; the render thread draws the latest one and skips
+ * those it had no time for, so a slow terminal never holds up input.
+ * Only the render thread writes to the terminal once it is started.
+ *
+ * With a bandwidth budget, after a frame of n bytes the next one waits
+ * until n bytes' worth of the budget has passed; the frames published
+ * meanwhile are merged into the latest, and only its changes are sent.
+ */
+class renderer {
+    screen_type _M_screen;
+
+    std::thread _M_thread;
+    std::atomic<bool> _M_stop = false;
+    snapshot_channel<frame>* _M_channel = nullptr;
+
+    // Bytes per second sent to the terminal at most, 0 for no limit.
+    u64 _M_budget = 0;
+    // When the budget allows the next frame.
+    std::chrono::steady_clock::time_point _M_ready;
+
+    inline static std::atomic<bool> _S_resized = false;
+
+    static void _S_on_resize(int) { _S_resized.store(true, std::memory_order_relaxed); }
+
+    // Waits until the budget allows the next frame, or until stopped.
+    void _M_throttle() {
+        while (!_M_stop.load(std::memory_order_acquire)) {
+            auto __now = std::chrono::steady_clock::now();
+            if (__now >= _M_ready) return;
+
+            std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(
+                _M_ready - __now, std::chrono::milliseconds(50)
+            ));
+        }
+    }
+
+    void _M_spend(u64 __bytes) {
+        if (_M_budget == 0) return;
+
+        auto __cost = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>((double)__bytes / _M_budget)
+        );
+        _M_ready = std::max(_M_ready, std::chrono::steady_clock::now()) + __cost;
+    }
+
+    void _M_run(snapshot_channel<frame>& __channel) {
+        u64 __seen = 0;
+
+        while (true) {
+            __channel.wait(__seen);
+            _M_throttle();
+            __seen = __channel.published();
+
+            if (_S_resized.exchange(false, std::memory_order_relaxed)) {
+                _M_screen.resize();
+                _M_spend(_M_screen.draw(__channel.front()));
+            }
+
+            // The last frame is drawn before stopping.
+            if (__channel.take()) _M_spend(_M_screen.draw(__channel.front()));
+            if (_M_stop.load(std::memory_order_acquire)) break;
+        }
+    }
+
+public:
+    // Needs the terminal opened, see `screen_type::open_terminal()`.
+    renderer(const user_config& __uconf, block_color::types __color)
+    : _M_screen(__uconf, __color) { }
+
+    ~renderer() { stop(); }
+
+    renderer(const renderer&) = delete;
+    renderer& operator=(const renderer&) = delete;
+
+    // Draws every box again, on the caller's thread. Not while started.
+    u64 redraw(const frame& __f) { return _M_screen.redraw(__f); }
+
+    // Sends at most `__bytes_per_second` to the terminal, 0 for no limit.
+    // Set it before `start()`.
+    void budget(u64 __bytes_per_second) { _M_budget = __bytes_per_second; }
+
+    /**
+     * @brief Draws the frames of `__channel` on the render thread until `stop()`.
+     *
+     * The terminal must not be used by other threads until then.
+     */
+    void start(snapshot_channel<frame>& __channel) {
+        if (_M_thread.joinable()) return;
+
+#ifdef ANSI_ENABLED
+        // ncurses has a handler of its own, and takes the new size itself.
+        struct sigaction __sa = { };
+        __sa.sa_handler = _S_on_resize;
+        sigaction(SIGWINCH, &__sa, nullptr);
+#endif
+
+        _M_stop = false;
+        _M_channel = &__channel;
+        _M_thread = std::thread(&renderer::_M_run, this, std::ref(__channel));
+    }
+
+    // Draws the last published frame and stops the render thread.
+    void stop() {
+        if (!_M_thread.joinable()) return;
+
+        _M_stop.store(true, std::memory_order_release);
+        _M_channel->wake();
+        _M_thread.join();
+    }
+};
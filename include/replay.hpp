@@ -0,0 +1,215 @@
+#pragma once
+
+#include <vector>
+#include <array>
+
+#include <fstream>
+#include <filesystem>
+#include <optional>
+#include <algorithm>
+#include <random>
+
+#include <lib/intdef>
+
+#include <config.hpp>
+#include <engine.hpp>
+#include <rules/bag.hpp>
+
+/**
+ * @brief Seed, rules and control keys of a recorded game.
+ *
+ * Playing `_M_inputs` through `engine::apply()` on an engine built from
+ * `_M_seed`, `_M_config` and `_M_bag` reproduces the game exactly.
+ *
+ * `_M_checksums` holds `engine::checksum()` after each drop, in input order,
+ * so a playback can tell the first placement where it diverges.
+ * It may be empty, version 1 files have none.
+ *
+ * File layout (little endian):
+ *   "TTRP", u32 version, u32 seed, u8 bag,
+ *   rules (see `_S_write_config`), u64 input count, u8 keys,
+ *   u64 checksum count, u64 checksums (version 2).
+ */
+struct replay {
+    using control_key = user_config::control_config::KEYS;
+
+    u32 _M_seed = 0;
+    bags::types _M_bag = bags::types::bag7;
+    user_config _M_config;
+    std::vector<control_key> _M_inputs;
+    std::vector<u64> _M_checksums;
+
+    // First placement whose checksum does not match.
+    struct divergence {
+        u64 _M_placement;
+        // `_M_actual` is 0 if the playback placed fewer tetrominoes.
+        u64 _M_expected, _M_actual;
+    };
+
+private:
+    static constexpr std::array<char, 4> _S_magic = { 'T', 'T', 'R', 'P' };
+    static constexpr u32 _S_version = 2;
+
+    template <typename T>
+    static void _S_write(std::ostream& __os, T __v)
+    { __os.write(reinterpret_cast<const char*>(&__v), sizeof(T)); }
+
+    template <typename T>
+    static bool _S_read(std::istream& __is, T& __v)
+    { return (bool)__is.read(reinterpret_cast<char*>(&__v), sizeof(T)); }
+
+    // Only the options that change the rules, key map is not stored.
+    static void _S_write_config(std::ostream& __os, const user_config& __c) {
+        _S_write<u8>(__os, __c.hold.enabled);
+        _S_write<u8>(__os, __c.hold.infinite);
+        _S_write<u32>(__os, __c.field.width);
+        _S_write<u32>(__os, __c.field.height);
+        _S_write<u32>(__os, __c.field.extra_height);
+        _S_write<u32>(__os, __c.spawn.base_height);
+        _S_write<u8>(__os, __c.spawn.extended);
+        _S_write<u32>(__os, __c.spawn.extended_height);
+        _S_write<u8>(__os, __c.control.inf_soft_drop);
+        _S_write<u8>(__os, static_cast<u8>(__c.game.mode));
+        _S_write<u8>(__os, static_cast<u8>(__c.game.attack_table));
+        _S_write<u8>(__os, static_cast<u8>(__c.game.kick_table));
+        _S_write<u8>(__os, static_cast<u8>(__c.game.spin_table));
+        _S_write<u8>(__os, __c.game.enable_pc_b2b);
+        _S_write<u32>(__os, __c.game.next_queue_size);
+    }
+
+    static bool _S_read_config(std::istream& __is, user_config& __c) {
+        u8 __hold_enabled, __hold_infinite, __extended, __inf_soft_drop,
+           __mode, __attack, __kick, __spin, __pc_b2b;
+
+        bool __ok =
+            _S_read(__is, __hold_enabled) &&
+            _S_read(__is, __hold_infinite) &&
+            _S_read(__is, __c.field.width) &&
+            _S_read(__is, __c.field.height) &&
+            _S_read(__is, __c.field.extra_height) &&
+            _S_read(__is, __c.spawn.base_height) &&
+            _S_read(__is, __extended) &&
+            _S_read(__is, __c.spawn.extended_height) &&
+            _S_read(__is, __inf_soft_drop) &&
+            _S_read(__is, __mode) &&
+            _S_read(__is, __attack) &&
+            _S_read(__is, __kick) &&
+            _S_read(__is, __spin) &&
+            _S_read(__is, __pc_b2b) &&
+            _S_read(__is, __c.game.next_queue_size);
+
+        if (!__ok) return false;
+
+        __c.hold.enabled = __hold_enabled;
+        __c.hold.infinite = __hold_infinite;
+        __c.spawn.extended = __extended;
+        __c.control.inf_soft_drop = __inf_soft_drop;
+        __c.game.mode = static_cast<user_config::game_mode>(__mode);
+        __c.game.attack_table = static_cast<attack_tables::types>(__attack);
+        __c.game.kick_table = static_cast<kick_tables::types>(__kick);
+        __c.game.spin_table = static_cast<spin_tables::types>(__spin);
+        __c.game.enable_pc_b2b = __pc_b2b;
+
+        return true;
+    }
+
+public:
+    bool save(const std::filesystem::path& __path) const {
+        std::ofstream __os(__path, std::ios::binary);
+        if (!__os) return false;
+
+        __os.write(_S_magic.data(), _S_magic.size());
+        _S_write<u32>(__os, _S_version);
+        _S_write<u32>(__os, _M_seed);
+        _S_write<u8>(__os, static_cast<u8>(_M_bag));
+        _S_write_config(__os, _M_config);
+
+        _S_write<u64>(__os, _M_inputs.size());
+        for (auto __k : _M_inputs)
+            _S_write<u8>(__os, static_cast<u8>(__k));
+
+        _S_write<u64>(__os, _M_checksums.size());
+        for (auto __c : _M_checksums)
+            _S_write<u64>(__os, __c);
+
+        return (bool)__os;
+    }
+
+    static std::optional<replay> load(const std::filesystem::path& __path) {
+        std::ifstream __is(__path, std::ios::binary);
+        if (!__is) return std::nullopt;
+
+        std::array<char, 4> __magic;
+        u32 __version;
+        u8 __bag;
+        u64 __count;
+        replay __r;
+
+        if (!__is.read(__magic.data(), __magic.size()) || __magic != _S_magic)
+            return std::nullopt;
+        if (!_S_read(__is, __version) || __version == 0 || __version > _S_version)
+            return std::nullopt;
+        if (!_S_read(__is, __r._M_seed) || !_S_read(__is, __bag))
+            return std::nullopt;
+        if (!_S_read_config(__is, __r._M_config) || !_S_read(__is, __count))
+            return std::nullopt;
+
+        __r._M_bag = static_cast<bags::types>(__bag);
+        __r._M_inputs.resize(__count);
+
+        for (auto& __k : __r._M_inputs) {
+            u8 __v;
+            if (!_S_read(__is, __v)) return std::nullopt;
+            __k = static_cast<control_key>(__v);
+        }
+
+        if (__version >= 2) {
+            if (!_S_read(__is, __count)) return std::nullopt;
+
+            __r._M_checksums.resize(__count);
+            for (auto& __c : __r._M_checksums)
+                if (!_S_read(__is, __c)) return std::nullopt;
+        }
+
+        return __r;
+    }
+
+    /**
+     * @brief Plays the replay back and compares checksums.
+     *
+     * @param __actual If not null, receives every checksum of the playback.
+     * @return The first placement that does not match, nullopt if all match.
+     */
+    std::optional<divergence> verify(std::vector<u64>* __actual = nullptr) const {
+        std::mt19937 __rand(_M_seed);
+        engine __e(__rand, _M_config, _M_bag);
+
+        __e.keep_history(std::any_of(_M_inputs.begin(), _M_inputs.end(), [] (control_key __k) {
+            return __k == control_key::UNDO || __k == control_key::REDO ||
+                   __k == control_key::EARLIER || __k == control_key::LATER;
+        }));
+        __e.track_checksum(true);
+        __e.begin();
+        __e.spawn();
+
+        std::optional<divergence> __div;
+        u64 __index = 0;
+
+        for (auto __k : _M_inputs) {
+            auto __r = __e.apply(__k);
+            if (!__r) continue;
+
+            if (__actual) __actual->push_back(__r->_M_checksum);
+
+            if (!__div && __index < _M_checksums.size() && _M_checksums[__index] != __r->_M_checksum)
+                __div = divergence { __index, _M_checksums[__index], __r->_M_checksum };
+
+            __index++;
+        }
+
+        if (!__div && __index < _M_checksums.size())
+            __div = divergence { __index, _M_checksums[__index], 0 };
+
+        return __div;
+    }
+};
@@ -4,8 +4,10 @@
 
 #include <array>
 #include <string>
+#include <string_view>
 
 #include <memory>
+#include <algorithm>
 
 #include <cmath>
 
@@ -19,6 +21,23 @@ enum class spin_type : u32 {
     NONE, MINI, SPIN
 };
 
+// Text of an attack, e.g. "MINI T-SPIN SINGLE!!", stored in place.
+struct attack_text {
+    std::array<char, 24> _M_data = { 0, };
+    u32 _M_size = 0;
+
+    void append(std::string_view __s) {
+        u32 __n = std::min<u32>(__s.size(), _M_data.size() - _M_size);
+
+        std::copy_n(__s.begin(), __n, _M_data.begin() + _M_size);
+        _M_size += __n;
+    }
+
+    std::string_view view() const { return { _M_data.data(), _M_size }; }
+
+    bool operator==(const attack_text& __t) const { return view() == __t.view(); }
+};
+
 struct attack_info {
     attack_type _M_type;
     i32 _M_combo, _M_btb;
@@ -26,27 +45,58 @@ struct attack_info {
 
     bool _M_pc;
 
-    std::string to_string(char mino) const {
-        std::string __str;
-        
+    // Same as `to_string()`, without allocating.
+    attack_text text(char mino) const {
+        attack_text __str;
+
         if (_M_spin != spin_type::NONE) {
             if (_M_spin == spin_type::MINI)
-                __str += "MINI ";
-            __str += mino + (std::string)"-SPIN ";
+                __str.append("MINI ");
+            __str.append({ &mino, 1 });
+            __str.append("-SPIN ");
         }
 
         switch (_M_type) {
-            case attack_type::SINGLE: __str += "SINGLE"; break;
-            case attack_type::DOUBLE: __str += "DOUBLE"; break;
-            case attack_type::TRIPLE: __str += "TRIPLE"; break;
-            case attack_type::QUAD: __str += "QUAD"; break;
+            case attack_type::SINGLE: __str.append("SINGLE"); break;
+            case attack_type::DOUBLE: __str.append("DOUBLE"); break;
+            case attack_type::TRIPLE: __str.append("TRIPLE"); break;
+            case attack_type::QUAD: __str.append("QUAD"); break;
         }
 
         if (_M_pc)
-            __str += "!!";
+            __str.append("!!");
 
         return __str;
     }
+
+    std::string to_string(char mino) const { return std::string(text(mino).view()); }
+};
+
+// A line clear as the attack history keeps it, in four bytes. Its text is
+// only made by `text()`, when it is shown.
+struct attack_event {
+    u8 _M_type = 0, _M_spin = 0;
+    // Letter of the tetromino placed, e.g. 'T'.
+    char _M_mino = 0;
+    bool _M_pc = false;
+
+    static attack_event of(const attack_info& __atk, char __mino) {
+        return {
+            static_cast<u8>(__atk._M_type), static_cast<u8>(__atk._M_spin),
+            __mino, __atk._M_pc
+        };
+    }
+
+    attack_text text() const {
+        attack_info __atk = {
+            static_cast<attack_type>(_M_type), 0, -1,
+            static_cast<spin_type>(_M_spin), _M_pc
+        };
+
+        return __atk.text(_M_mino);
+    }
+
+    bool operator==(const attack_event&) const = default;
 };
 
 /* interface */ struct Iattack_table
@@ -101,7 +151,7 @@ public:
     }
 };
 
-std::unique_ptr<Iattack_table> create(types __type) {
+inline std::unique_ptr<Iattack_table> create(types __type) {
     switch (__type) {
         case types::tetrio: return std::make_unique<tetrio>();
         default: return nullptr;
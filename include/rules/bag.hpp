@@ -2,6 +2,7 @@
 
 #include <concepts>
 
+#include <array>
 #include <vector>
 
 #include <memory>
@@ -13,7 +14,9 @@
 #include <rules/tetromino.hpp>
 
 /* interface */ struct Ibag {
-    virtual std::vector<tetromino> generate(std::mt19937& __rand) = 0;
+    // Replaces the contents of `__out` with the next bag. `__out` keeps
+    // its storage, so refills do not allocate once it has grown.
+    virtual void generate(std::mt19937& __rand, std::vector<tetromino>& __out) = 0;
 };
 
 namespace bags {
@@ -22,31 +25,37 @@ enum class types {
     bag7, bag14, bag7x, bag_classic
 };
 
+inline constexpr std::array<const tetromino*, 7> all = {
+    &tetromino::I, &tetromino::J, &tetromino::L,
+    &tetromino::O, &tetromino::S, &tetromino::T,
+    &tetromino::Z
+};
+
+// `fill()` is `generate()` for any generator with the outputs of a
+// `std::mt19937`, see `bags::generate()`.
+
 struct bag7 : Ibag {
-    std::vector<tetromino> generate(std::mt19937& __rand) override {
-        std::vector<tetromino> __bag = {
-            tetromino::I, tetromino::J, tetromino::L,
-            tetromino::O, tetromino::S, tetromino::T,
-            tetromino::Z
-        };
+    void generate(std::mt19937& __rand, std::vector<tetromino>& __out) override { fill(__rand, __out); }
+
+    template <typename _Rand>
+    void fill(_Rand& __rand, std::vector<tetromino>& __out) const {
+        __out.clear();
+        for (auto __t : all) __out.push_back(*__t);
 
-        std::shuffle(__bag.begin(), __bag.end(), __rand);
-        return __bag;
+        std::shuffle(__out.begin(), __out.end(), __rand);
     }
 };
 
 struct bag14 : Ibag {
-    std::vector<tetromino> generate(std::mt19937& __rand) override {
-        std::vector<tetromino> __bag = {
-            tetromino::I, tetromino::J, tetromino::L,
-            tetromino::O, tetromino::S, tetromino::T,
-            tetromino::Z, tetromino::I, tetromino::J,
-            tetromino::L, tetromino::O, tetromino::S,
-            tetromino::T, tetromino::Z
-        };
+    void generate(std::mt19937& __rand, std::vector<tetromino>& __out) override { fill(__rand, __out); }
+
+    template <typename _Rand>
+    void fill(_Rand& __rand, std::vector<tetromino>& __out) const {
+        __out.clear();
+        for (u32 __i = 0; __i < 2; __i++)
+            for (auto __t : all) __out.push_back(*__t);
 
-        std::shuffle(__bag.begin(), __bag.end(), __rand);
-        return __bag;
+        std::shuffle(__out.begin(), __out.end(), __rand);
     }
 };
 
@@ -54,39 +63,33 @@ struct bag7x : Ibag {
 public:
     u32 _M_n = 1;
 
-    std::vector<tetromino> generate(std::mt19937& __rand) override {
-        std::vector<tetromino> __bag = {
-            tetromino::I, tetromino::J, tetromino::L,
-            tetromino::O, tetromino::S, tetromino::T,
-            tetromino::Z
-        };
+    void generate(std::mt19937& __rand, std::vector<tetromino>& __out) override { fill(__rand, __out); }
 
-        std::vector<tetromino> __extra;
+    template <typename _Rand>
+    void fill(_Rand& __rand, std::vector<tetromino>& __out) const {
+        __out.clear();
+        for (auto __t : all) __out.push_back(*__t);
 
         std::uniform_int_distribution<std::size_t> __idx(0, 6);
 
         for (u32 __i = 0; __i < _M_n; __i++)
-            __extra.push_back(__bag[__idx(__rand)]);
+            __out.push_back(*all[__idx(__rand)]);
 
-        __bag.insert(__bag.end(), __extra.begin(), __extra.end());
-        std::shuffle(__bag.begin(), __bag.end(), __rand);
-        return __bag;
+        std::shuffle(__out.begin(), __out.end(), __rand);
     }
 };
 
 struct bag_classic : Ibag {
-    std::vector<tetromino> generate(std::mt19937& __rand) override {
-        std::vector<tetromino> __bag = {
-            tetromino::I, tetromino::J, tetromino::L,
-            tetromino::O, tetromino::S, tetromino::T,
-            tetromino::Z
-        };
+    void generate(std::mt19937& __rand, std::vector<tetromino>& __out) override { fill(__rand, __out); }
 
-        return { __bag[std::uniform_int_distribution<std::size_t>(0, 6)(__rand)] };
+    template <typename _Rand>
+    void fill(_Rand& __rand, std::vector<tetromino>& __out) const {
+        __out.clear();
+        __out.push_back(*all[std::uniform_int_distribution<std::size_t>(0, 6)(__rand)]);
     }
 };
 
-std::unique_ptr<Ibag> create(types __type) {
+inline std::unique_ptr<Ibag> create(types __type) {
     switch (__type) {
         case types::bag7:        return std::make_unique<bag7>();
         case types::bag14:       return std::make_unique<bag14>();
@@ -96,12 +99,29 @@ std::unique_ptr<Ibag> create(types __type) {
     }
 }
 
+/**
+ * @brief The bag `create(__type)->generate()` makes, from any generator
+ * with the outputs of a `std::mt19937`: one that replays only the start
+ * of a sequence can skip the rest of the state.
+ */
+template <typename _Rand>
+void generate(types __type, _Rand& __rand, std::vector<tetromino>& __out) {
+    switch (__type) {
+        case types::bag7:        return bag7{}.fill(__rand, __out);
+        case types::bag14:       return bag14{}.fill(__rand, __out);
+        case types::bag7x:       return bag7x{}.fill(__rand, __out);
+        case types::bag_classic: return bag_classic{}.fill(__rand, __out);
+        default:                 __out.clear();
+    }
+}
+
 }
 
 struct bag_save_data {
     std::mt19937 _M_rand;
     std::vector<tetromino> _M_queue;
     u32 _M_current;
+    u64 _M_refills;
 };
 
 struct bag_generator {
@@ -135,12 +155,16 @@ private:
     container_type _M_queue;
     container_type::const_iterator _M_current;
     std::unique_ptr<Ibag> _M_bag;
+    // Bags generated so far. With the index in the current bag,
+    // this is the position in the random sequence.
+    u64 _M_refills = 0;
 
 public:
     tetromino next() {
         if (_M_current == _M_queue.end()) {
-            _M_queue = _M_bag->generate(_M_rand);
+            _M_bag->generate(_M_rand, _M_queue);
             _M_current = _M_queue.begin();
+            _M_refills++;
         }
         
         tetromino __next = *_M_current;
@@ -153,17 +177,37 @@ public:
         _M_current = _M_queue.end();
     }
 
+    // Starts the sequence again from `__rand`, as a new generator would.
+    void seed(const std::mt19937& __rand) {
+        _M_rand = __rand;
+        _M_refills = 0;
+        reset();
+    }
+
     bag_save_data save() const {
         return bag_save_data {
             _M_rand,
             _M_queue,
-            (u32)std::distance(_M_queue.begin(), _M_current)
+            (u32)std::distance(_M_queue.begin(), _M_current),
+            _M_refills
         };
     }
 
+    // Same as `save()`, into `__out`, reusing its storage.
+    void save(bag_save_data& __out) const {
+        __out._M_rand = _M_rand;
+        __out._M_queue = _M_queue;
+        __out._M_current = std::distance(_M_queue.begin(), _M_current);
+        __out._M_refills = _M_refills;
+    }
+
     void load(const bag_save_data& __data) {
         _M_rand = __data._M_rand;
         _M_queue = __data._M_queue;
         _M_current = _M_queue.begin() + __data._M_current;
+        _M_refills = __data._M_refills;
     }
+
+    u64 refills() const { return _M_refills; }
+    u32 index() const { return std::distance(_M_queue.begin(), _M_current); }
 };
\ No newline at end of file
@@ -0,0 +1,277 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <type_traits>
+
+#include <algorithm>
+#include <bit>
+
+#include <lib/intdef>
+
+#include <rules/tetromino.hpp>
+
+/*
+ * Occupancy of the field, one bit per cell.
+ *
+ * Bit `x` of a row is column `x`, row 0 is the bottom of the field.
+ * `field` keeps one of these next to its cells, and uses it for
+ * collision, line clear and column height queries.
+ *
+ * Two layouts exist:
+ * - fixed_board<W, H> : compile-time size, a row is a single integer.
+ * - dynamic_board     : any size, a row is ceil(width / 64) words.
+ */
+
+namespace boards::detail {
+    template <u32 _Width>
+    using row_t =
+        std::conditional_t<_Width <= 16, u16,
+        std::conditional_t<_Width <= 32, u32, u64>>;
+
+    // Tests bounds of a tetromino row placed at column `__x`.
+    // Returns false if some block is out of [0, __width).
+    inline bool in_columns(i32 __x, u8 __m, u32 __width) {
+        i32 __lo = std::countr_zero(__m),
+            __hi = 7 - std::countl_zero(__m);
+
+        return __x + __lo >= 0 && __x + __hi < (i32)__width;
+    }
+}
+
+template <u32 _Width, u32 _Height>
+requires (_Width <= 64)
+struct fixed_board {
+    using row_type = boards::detail::row_t<_Width>;
+
+    static constexpr row_type full_row =
+        _Width == sizeof(row_type) * 8 ? (row_type)~row_type(0) :
+        (row_type)((row_type(1) << _Width) - 1);
+
+private:
+    std::array<row_type, _Height> _M_rows = { 0, };
+
+public:
+    fixed_board() = default;
+
+    static constexpr u32 width() { return _Width; }
+    static constexpr u32 height() { return _Height; }
+
+    bool test(u32 __x, u32 __y) const
+    { return (_M_rows[__y] >> __x) & 1; }
+
+    void set(u32 __x, u32 __y, bool __v) {
+        if (__v) _M_rows[__y] |= (row_type)(row_type(1) << __x);
+        else     _M_rows[__y] &= (row_type)~(row_type(1) << __x);
+    }
+
+    bool collides(i32 __x, i32 __y, const tetromino& __t) const {
+        for (u32 __i = 0; __i < __t.size(); ++__i) {
+            u8 __m = __t.row_mask(__i);
+            if (__m == 0) continue;
+
+            i32 __py = __y - (i32)__i;
+            if (__py < 0 || __py >= (i32)_Height) return true;
+            if (!boards::detail::in_columns(__x, __m, _Width)) return true;
+
+            u64 __bits = __x >= 0 ? (u64)__m << __x : (u64)__m >> -__x;
+            if (_M_rows[__py] & __bits) return true;
+        }
+
+        return false;
+    }
+
+    // Sets the blocks of `__t` at (__x, __y), which must not collide.
+    void put(i32 __x, i32 __y, const tetromino& __t) {
+        for (u32 __i = 0; __i < __t.size(); ++__i) {
+            u8 __m = __t.row_mask(__i);
+            if (__m == 0) continue;
+
+            _M_rows[__y - __i] |= (row_type)(__x >= 0 ? (u64)__m << __x : (u64)__m >> -__x);
+        }
+    }
+
+    // Removes every full row, returns how many were removed.
+    u32 clear_lines() {
+        u32 __cnt = 0;
+
+        for (u32 __y = 0; __y < _Height; ++__y) {
+            if (_M_rows[__y] == full_row) ++__cnt;
+            else _M_rows[__y - __cnt] = _M_rows[__y];
+        }
+
+        std::fill(_M_rows.end() - __cnt, _M_rows.end(), 0);
+        return __cnt;
+    }
+
+    bool is_full(u32 __y) const { return _M_rows[__y] == full_row; }
+    bool is_empty() const
+    { return std::all_of(_M_rows.begin(), _M_rows.end(), [] (row_type __r) { return __r == 0; }); }
+
+    void clear() { _M_rows.fill(0); }
+
+    // Removes row `__y` and pushes an empty row on the top.
+    void remove_row(u32 __y) {
+        std::copy(_M_rows.begin() + __y + 1, _M_rows.end(), _M_rows.begin() + __y);
+        _M_rows.back() = 0;
+    }
+
+    // Pushes `__cnt` garbage rows with a hole at `__hole` on the bottom.
+    void insert_garbage(u32 __cnt, u32 __hole) {
+        std::copy_backward(_M_rows.begin(), _M_rows.end() - __cnt, _M_rows.end());
+        std::fill(_M_rows.begin(), _M_rows.begin() + __cnt,
+            (row_type)(full_row & ~(row_type(1) << __hole)));
+    }
+
+    void column_heights(std::vector<u32>& __out) const {
+        __out.assign(_Width, 0);
+
+        row_type __seen = 0;
+        for (u32 __y = _Height; __y > 0 && __seen != full_row; --__y) {
+            row_type __new = _M_rows[__y - 1] & ~__seen;
+            __seen |= __new;
+
+            for (; __new; __new &= __new - 1)
+                __out[std::countr_zero(__new)] = __y;
+        }
+    }
+
+    const row_type* rows() const { return _M_rows.data(); }
+    // Size of `rows()` in bytes.
+    static constexpr std::size_t bytes() { return sizeof(row_type) * _Height; }
+};
+
+struct dynamic_board {
+private:
+    u32 _M_width = 0, _M_height = 0, _M_words = 0;
+    std::vector<u64> _M_rows;
+
+    u64* _M_row(u32 __y) { return _M_rows.data() + __y * _M_words; }
+    const u64* _M_row(u32 __y) const { return _M_rows.data() + __y * _M_words; }
+
+    u64 _M_last_mask() const {
+        u32 __r = _M_width % 64;
+        return __r == 0 ? ~0ull : (1ull << __r) - 1;
+    }
+
+public:
+    dynamic_board() = default;
+    dynamic_board(u32 __width, u32 __height)
+    : _M_width(__width), _M_height(__height), _M_words((__width + 63) / 64),
+      _M_rows((size_t)_M_words * __height, 0) { }
+
+    u32 width() const { return _M_width; }
+    u32 height() const { return _M_height; }
+    u32 words() const { return _M_words; }
+
+    bool test(u32 __x, u32 __y) const
+    { return (_M_row(__y)[__x / 64] >> (__x % 64)) & 1; }
+
+    void set(u32 __x, u32 __y, bool __v) {
+        u64& __w = _M_row(__y)[__x / 64];
+        if (__v) __w |= 1ull << (__x % 64);
+        else     __w &= ~(1ull << (__x % 64));
+    }
+
+    bool collides(i32 __x, i32 __y, const tetromino& __t) const {
+        for (u32 __i = 0; __i < __t.size(); ++__i) {
+            u8 __m = __t.row_mask(__i);
+            if (__m == 0) continue;
+
+            i32 __py = __y - (i32)__i;
+            if (__py < 0 || __py >= (i32)_M_height) return true;
+            if (!boards::detail::in_columns(__x, __m, _M_width)) return true;
+
+            // Shift the blocks so the window starts at a non-negative column.
+            i32 __base = std::max(__x, 0);
+            u64 __bits = __x >= 0 ? __m : (u64)__m >> -__x;
+
+            const u64* __row = _M_row(__py);
+            u32 __w = __base / 64, __off = __base % 64;
+
+            u64 __window = __row[__w] >> __off;
+            if (__off > 60 && __w + 1 < _M_words)
+                __window |= __row[__w + 1] << (64 - __off);
+
+            if (__window & __bits) return true;
+        }
+
+        return false;
+    }
+
+    void put(i32 __x, i32 __y, const tetromino& __t) {
+        for (u32 __i = 0; __i < __t.size(); ++__i)
+            for (u32 __j = 0; __j < __t.size(); ++__j)
+                if ((__t.row_mask(__i) >> __j) & 1) set(__x + __j, __y - __i, true);
+    }
+
+    u32 clear_lines() {
+        u32 __cnt = 0;
+
+        for (u32 __y = 0; __y < _M_height; ++__y) {
+            if (is_full(__y)) ++__cnt;
+            else if (__cnt > 0) std::copy_n(_M_row(__y), _M_words, _M_row(__y - __cnt));
+        }
+
+        std::fill(_M_row(_M_height - __cnt), _M_rows.data() + _M_rows.size(), 0);
+        return __cnt;
+    }
+
+    bool is_full(u32 __y) const {
+        const u64* __row = _M_row(__y);
+
+        for (u32 __w = 0; __w + 1 < _M_words; ++__w)
+            if (__row[__w] != ~0ull) return false;
+
+        return __row[_M_words - 1] == _M_last_mask();
+    }
+
+    bool is_empty() const
+    { return std::all_of(_M_rows.begin(), _M_rows.end(), [] (u64 __r) { return __r == 0; }); }
+
+    void clear() { std::fill(_M_rows.begin(), _M_rows.end(), 0); }
+
+    void remove_row(u32 __y) {
+        std::copy(_M_row(__y + 1), _M_rows.data() + _M_rows.size(), _M_row(__y));
+        std::fill(_M_row(_M_height - 1), _M_rows.data() + _M_rows.size(), 0);
+    }
+
+    void insert_garbage(u32 __cnt, u32 __hole) {
+        std::copy_backward(_M_rows.data(), _M_row(_M_height - __cnt), _M_rows.data() + _M_rows.size());
+
+        for (u32 __y = 0; __y < __cnt; ++__y) {
+            u64* __row = _M_row(__y);
+            std::fill(__row, __row + _M_words, ~0ull);
+            __row[_M_words - 1] = _M_last_mask();
+            __row[__hole / 64] &= ~(1ull << (__hole % 64));
+        }
+    }
+
+    void column_heights(std::vector<u32>& __out) const {
+        __out.assign(_M_width, 0);
+
+        for (u32 __w = 0; __w < _M_words; ++__w) {
+            u64 __seen = 0;
+            u64 __all = __w + 1 == _M_words ? _M_last_mask() : ~0ull;
+
+            for (u32 __y = _M_height; __y > 0 && __seen != __all; --__y) {
+                u64 __new = _M_row(__y - 1)[__w] & ~__seen;
+                __seen |= __new;
+
+                for (; __new; __new &= __new - 1)
+                    __out[__w * 64 + std::countr_zero(__new)] = __y;
+            }
+        }
+    }
+
+    const u64* rows() const { return _M_rows.data(); }
+    std::size_t bytes() const { return _M_rows.size() * sizeof(u64); }
+};
+
+namespace boards {
+
+// Standard 10 x (20 + 4) field.
+using standard = fixed_board<10, 24>;
+using dynamic = dynamic_board;
+
+}
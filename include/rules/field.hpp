@@ -6,13 +6,18 @@
 
 #include <memory>
 #include <random>
+#include <atomic>
 #include <algorithm>
 
 #include <cmath>
+#include <variant>
 
 #include <lib/intdef>
 
 #include <rules/tetromino.hpp>
+#include <rules/board.hpp>
+
+#include <util/trace.hpp>
 
 enum class block_type : u8
 { I, J, L, O, S, T, Z, GARBAGE, WALL, EMPTY };
@@ -65,7 +70,7 @@ struct bright : Iblock_color {
     }
 };
 
-std::unique_ptr<Iblock_color> create(types __type) {
+inline std::unique_ptr<Iblock_color> create(types __type) {
     switch (__type) {
         case types::classic: return std::make_unique<classic>();
         case types::bright:  return std::make_unique<bright>();
@@ -85,12 +90,95 @@ private:
 
     field_type _M_field;
 
+    // Occupancy of `_M_field`, used for collision and line checks.
+    // The standard size uses a fixed board, any other size a dynamic one.
+    using board_type = std::variant<boards::standard, boards::dynamic>;
+    board_type _M_board;
+
+    // Guide cells, which the board leaves out: they do not collide, as
+    // `get_block()` has it, but they fill a line and keep the field from
+    // being empty, as they always did. Counted so those checks only look
+    // at the cells when there are some.
+    u32 _M_guide_cells = 0;
+
+    // Stamp of the last modification. Stamps are unique across all fields,
+    // so a copy (e.g. restored by undo) keeps the stamp of identical content.
+    u64 _M_version = 0;
+
+    mutable std::vector<u32> _M_heights;
+    mutable u64 _M_heights_version = -1;
+
+    // Fields are created and modified on several threads (hint search,
+    // task pool workers), so each thread takes stamps from a block of its
+    // own and only goes to the shared counter for a new block.
+    static constexpr u64 _S_version_block = 1 << 16;
+    inline static std::atomic<u64> _S_version_counter = 1;
+
+    static u64 _S_next_version() {
+        thread_local u64 __next = 0, __end = 0;
+
+        if (__next == __end) {
+            __next = _S_version_counter.fetch_add(_S_version_block, std::memory_order_relaxed);
+            __end = __next + _S_version_block;
+        }
+
+        return __next++;
+    }
+
 public:
-    field(u32 __width = 10, u32 __height = 24)
+    // Board used for occupancy. `automatic` uses the fixed board for the
+    // standard size; `dynamic` forces the dynamic one, to compare both.
+    enum class layout { automatic, dynamic };
+
+    field(u32 __width = 10, u32 __height = 24, layout __layout = layout::automatic)
     : _M_width(__width), _M_height(__height),
-      _M_field(__height, std::vector<cell_type>(__width, { block_type::EMPTY, block_attribute::NORMAL })) { }
+      _M_field(__height, std::vector<cell_type>(__width, { block_type::EMPTY, block_attribute::NORMAL })),
+      _M_board(_S_make_board(__width, __height, __layout)),
+      _M_version(_S_next_version()) { }
 
 private:
+    void _M_modified() { _M_version = _S_next_version(); }
+
+    static board_type _S_make_board(u32 __width, u32 __height, layout __layout) {
+        if (__layout == layout::automatic &&
+            __width == boards::standard::width() && __height == boards::standard::height())
+            return boards::standard{};
+        
+        return boards::dynamic(__width, __height);
+    }
+
+    template <typename _Func>
+    decltype(auto) _M_visit(_Func&& __func)
+    { return std::visit(std::forward<_Func>(__func), _M_board); }
+
+    template <typename _Func>
+    decltype(auto) _M_visit(_Func&& __func) const
+    { return std::visit(std::forward<_Func>(__func), _M_board); }
+
+    static bool _S_is_guide(cell_type __c)
+    { return __c.first != block_type::EMPTY && __c.second == block_attribute::GUIDE; }
+
+    u32 _M_count_guides(u32 __y) const
+    { return std::count_if(_M_field[__y].begin(), _M_field[__y].end(), _S_is_guide); }
+
+    void _M_set_cell(u32 __x, u32 __y, cell_type __c) {
+        _M_guide_cells += _S_is_guide(__c) - _S_is_guide(_M_field[__y][__x]);
+        _M_field[__y][__x] = __c;
+
+        bool __filled = __c.first != block_type::EMPTY && __c.second != block_attribute::GUIDE;
+        _M_visit([&] (auto& __b) { __b.set(__x, __y, __filled); });
+    }
+
+    // Whether row `__y` has no empty cell, guide cells included.
+    bool _M_is_full(u32 __y) const {
+        if (_M_visit([&] (const auto& __b) { return __b.is_full(__y); })) return true;
+        if (_M_guide_cells == 0) return false;
+
+        return std::all_of(_M_field[__y].begin(), _M_field[__y].end(), [] (cell_type __c) {
+            return __c.first != block_type::EMPTY;
+        });
+    }
+
     void _M_calcuate_attribute() {
         for (auto& __f : _M_field) {
             if (std::all_of(__f.begin(), __f.end(), [] (cell_type __bt) {
@@ -116,6 +204,10 @@ public:
         for (auto& row : _M_field) {
             std::fill(row.begin(), row.end(), cell_type { block_type::EMPTY, block_attribute::NORMAL });
         }
+
+        _M_visit([] (auto& __b) { __b.clear(); });
+        _M_guide_cells = 0;
+        _M_modified();
     }
 
     void set_block(
@@ -123,7 +215,16 @@ public:
         block_attribute __attr = block_attribute::NORMAL
     ) {
         if (__x < _M_width && __y < _M_height) {
-            _M_field[__y][__x] = { _S_tetromino_to_block_type(__t), __attr };
+            _M_set_cell(__x, __y, { _S_tetromino_to_block_type(__t), __attr });
+            _M_modified();
+        }
+    }
+
+    // Sets a cell as `data()` holds it, to restore a saved field.
+    void set_cell(u32 __x, u32 __y, block_type __b, block_attribute __attr) {
+        if (__x < _M_width && __y < _M_height) {
+            _M_set_cell(__x, __y, { __b, __attr });
+            _M_modified();
         }
     }
 
@@ -144,18 +245,23 @@ public:
 
     void remove_row(u32 __y) {
         if (__y < _M_height) {
-            _M_field.erase(_M_field.begin() + __y);
-            _M_field.emplace_back(_M_width, cell_type { block_type::EMPTY, block_attribute::NORMAL });
+            _M_guide_cells -= _M_count_guides(__y);
+
+            // The removed row is reused as the new top row, rows are never reallocated.
+            std::rotate(_M_field.begin() + __y, _M_field.begin() + __y + 1, _M_field.end());
+            std::fill(_M_field.back().begin(), _M_field.back().end(), cell_type { block_type::EMPTY, block_attribute::NORMAL });
+            _M_visit([&] (auto& __b) { __b.remove_row(__y); });
+            _M_modified();
         }
     }
 
     u32 proceed_lines() {
+        TRACE_SPAN("line clear");
+
         u32 cnt = 0;
 
         for (u32 __y = 0; __y < _M_height; ++__y) {
-            if (std::all_of(_M_field[__y].begin(), _M_field[__y].end(), [] (cell_type __bt) {
-                return __bt.first != block_type::EMPTY;
-            })) {
+            if (_M_is_full(__y)) {
                 remove_row(__y); __y--; cnt++;
             }
         }
@@ -181,8 +287,15 @@ public:
         
         _M_field.insert(_M_field.begin(), nr.begin(), nr.end());
 
+        // Rows pushed out at the top take their guide cells along.
+        for (u32 __y = _M_height; __y < _M_field.size(); ++__y)
+            _M_guide_cells -= _M_count_guides(__y);
+
         if (_M_field.size() > _M_height)
             _M_field.resize(_M_height);
+
+        _M_visit([&] (auto& __b) { __b.insert_garbage(__cnt, __hole); });
+        _M_modified();
     }
 
     // start point is left, top of tetromino.
@@ -194,30 +307,48 @@ public:
                 if (__y - j < 0 || __y - j >= (i32)_M_height) continue;
 
                 if (__t.data()[j][i] != 0) {
-                    _M_field[__y - j][__x + i].first = _S_tetromino_to_block_type(__t);
-
-                    if (__guide) {
-                        _M_field[__y - j][__x + i].second = block_attribute::GUIDE;
-                    } else {
-                        _M_field[__y - j][__x + i].second = block_attribute::NORMAL;
-                    }
+                    _M_set_cell(__x + i, __y - j, {
+                        _S_tetromino_to_block_type(__t),
+                        __guide ? block_attribute::GUIDE : block_attribute::NORMAL
+                    });
                 }
             }
         }
+
+        _M_modified();
     }
 
-    bool is_empty() const {
-        return std::all_of(_M_field.begin(), _M_field.end(), [] (const std::vector<cell_type>& row) {
-            return std::all_of(row.begin(), row.end(), [] (const cell_type& cell) {
-                return cell.first == block_type::EMPTY;
-            });
-        });
+    // Guide cells count, as for line clears.
+    bool is_empty() const
+    { return _M_guide_cells == 0 && _M_visit([] (const auto& __b) { return __b.is_empty(); }); }
+
+    // Whether tetromino `__t` at (__x, __y) overlaps a block or a wall.
+    // Same as testing `get_block()` of every block, but row at a time.
+    bool collides(i32 __x, i32 __y, const tetromino& __t) const
+    { return _M_visit([&] (const auto& __b) { return __b.collides(__x, __y, __t); }); }
+
+    /**
+     * @brief Returns the height of each column.
+     *
+     * The height of a column is one above its highest non-empty cell,
+     * so every cell at or above it is empty. Guide cells are ignored,
+     * same as `get_block()`. The result is cached until the field changes.
+     */
+    const std::vector<u32>& column_heights() const {
+        if (_M_heights_version == _M_version) return _M_heights;
+
+        _M_visit([&] (const auto& __b) { __b.column_heights(_M_heights); });
+
+        _M_heights_version = _M_version;
+        return _M_heights;
     }
 
     u32 width() const { return _M_width; }
     u32 height() const { return _M_height; }
+    u64 version() const { return _M_version; }
 
     const field_type& data() const { return _M_field; }
+    const board_type& board() const { return _M_board; }
 
 private:
     static block_type _S_tetromino_to_block_type(tetromino __t) {
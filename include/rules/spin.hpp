@@ -116,7 +116,7 @@ struct all_mini_plus : Ispin_table {
     }
 };
 
-std::unique_ptr<Ispin_table> create(types __type) {
+inline std::unique_ptr<Ispin_table> create(types __type) {
     switch (__type) {
         case types::tspin: return std::make_unique<tspin>();
         case types::tspin_plus: return std::make_unique<tspin_plus>();
@@ -2,6 +2,7 @@
 
 #include <compare>
 
+#include <array>
 #include <vector>
 #include <string>
 
@@ -39,21 +40,29 @@ private:
         mino_type __type,
         const std::vector<std::vector<i8>>& __mino
     )
-    : _M_mino(__mino), _M_type(__type), _M_size(__mino.size())
-    { _M_calculate_collision(); }
+    : _M_mino{}, _M_type(__type), _M_size(__mino.size()) {
+        for (u32 __i = 0; __i < _M_size; __i++)
+            std::copy(__mino[__i].begin(), __mino[__i].end(), _M_mino[__i].begin());
+
+        _M_calculate_collision();
+    }
 
 public:
     tetromino(const tetromino&) = default;
     tetromino(tetromino&&) = default;
 
 private:
-    using container_type = std::vector<std::vector<i8>>;
+    // Blocks in the top left `_M_size` x `_M_size` cells, stored in place
+    // so that copies and rotations never allocate.
+    using container_type = std::array<std::array<i8, 4>, 4>;
 
     container_type _M_mino;
     mino_type _M_type;
     u32 _M_size, _M_direction = 0;
 
     collision_t _M_collision;
+    // Blocks of each row as a bit mask, bit j is column j.
+    std::array<u8, 4> _M_row_mask = { 0, };
 
 private:
     static u32 _S_get_char_priority(char __t) {
@@ -102,10 +111,13 @@ private:
     void _M_calculate_collision() {
         _M_collision.left = _M_collision.up = _M_size;
         _M_collision.right = _M_collision.down = 0;
+        _M_row_mask = { 0, };
 
         for (u32 __i = 0; __i < _M_size; __i++) {
             for (u32 __j = 0; __j < _M_size; __j++) {
                 if (_M_mino[__i][__j] != 0) {
+                    _M_row_mask[__i] |= 1u << __j;
+
                     _M_collision.left  = std::min(_M_collision.left,  __j);
                     _M_collision.right = std::max(_M_collision.right, __j);
                     _M_collision.down  = std::max(_M_collision.down,  __i);
@@ -141,11 +153,14 @@ public:
     constexpr mino_type type() const { return _M_type; }
     constexpr u32 direction() const { return _M_direction; }
     constexpr u32 size() const { return _M_size; }
-    const std::vector<std::vector<i8>>& data() const { return _M_mino; }
+    const container_type& data() const { return _M_mino; }
 
     constexpr collision_t collision() const
     { return _M_collision; }
 
+    constexpr u8 row_mask(u32 __i) const
+    { return __i < _M_row_mask.size() ? _M_row_mask[__i] : 0; }
+
     constexpr char to_char() const { return static_cast<char>(*this); }
 
     tetromino& operator=(const tetromino&) = default;
@@ -239,4 +254,16 @@ public:
      */
     static std::optional<std::vector<tetromino>> gen(const std::string& __s, std::mt19937& __r);
     static bool sequence_match(const std::vector<tetromino>& __v, const std::string& __s);
+
+    /**
+     * @brief Tetrominoes each position of a sequence matching `__s` may
+     * hold, as bits of their `mino_type`.
+     *
+     * `sequence_match()` holds only for sequences of this length with the
+     * bit of every tetromino set; the tetrominoes of one bracket must also
+     * differ, which the masks do not tell. A cheap filter before it.
+     *
+     * @return nullopt if `__s` is invalid.
+     */
+    static std::optional<std::vector<u8>> sequence_masks(const std::string& __s);
 };
\ No newline at end of file
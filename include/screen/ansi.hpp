@@ -0,0 +1,486 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <string_view>
+
+#include <chrono>
+
+#include <csignal>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <termios.h>
+#include <unistd.h>
+
+#include <lib/intdef>
+
+#include <config.hpp>
+#include <frame.hpp>
+#include <rules/tetromino.hpp>
+#include <rules/field.hpp>
+#include <screen/layout.hpp>
+#include <screen/palette.hpp>
+#include <screen/wire.hpp>
+
+#include <util/conv.hpp>
+#include <util/trace.hpp>
+
+/**
+ * @brief Draws frames with ANSI escape sequences, colors in 24-bit from
+ * the block color theme, without ncurses. The default screen.
+ *
+ * A frame is composed into a grid of character cells, compared with the
+ * grid on the terminal, and the cells that changed are written into one
+ * byte buffer, allocated for the worst case up front, then sent with a
+ * single `write()`. The cursor is moved, and the background color set,
+ * only where the previous cell written does not leave them right.
+ *
+ * Box borders are drawn with Unicode box characters, the terminal is
+ * expected to take UTF-8.
+ */
+class ansi_screen {
+    // Background of a cell: 0 for the terminal default, else `_S_rgb` | 0xRRGGBB.
+    inline static constexpr u32 _S_rgb = 1u << 24;
+
+    struct cell {
+        u32 _M_glyph = ' ';
+        u32 _M_bg = 0;
+        // Part of the screen the cell is drawn by, for the wire stats.
+        wire_stats::part _M_part = wire_stats::other;
+
+        bool operator==(const cell& __o) const
+        { return _M_glyph == __o._M_glyph && _M_bg == __o._M_bg; }
+    };
+
+    inline static constexpr u32 _S_horizontal = 0x2500, _S_vertical = 0x2502,
+        _S_top_left = 0x250c, _S_top_right = 0x2510,
+        _S_bottom_left = 0x2514, _S_bottom_right = 0x2518;
+
+    // Longest cursor move, background and glyph, for the worst case.
+    inline static constexpr size_t _S_cell_bytes =
+        sizeof("\033[999;999H") + sizeof("\033[48;2;255;255;255m") + 4;
+
+    layout _M_layout;
+    palette _M_palette;
+    int _M_fd;
+
+    u32 _M_rows, _M_cols;
+    // Composed frame and what the terminal shows, row by row.
+    std::vector<cell> _M_grid, _M_shown;
+    // false when the terminal must be cleared and everything written again.
+    bool _M_valid = false;
+    // Background the terminal writes with now.
+    u32 _M_bg = 0;
+
+    std::vector<char> _M_out;
+    char* _M_end = nullptr;
+
+    // Part the cells composed now belong to.
+    wire_stats::part _M_part = wire_stats::other;
+    wire_stats _M_wire;
+
+    // Field cells of the frame being drawn, kept to reuse their storage.
+    std::vector<u16> _M_cells;
+    // Stats lines, formatted again only where values change; the cells
+    // they are composed into are only sent where they differ.
+    layout::stats_text _M_stats;
+
+    std::array<char, 40> _M_message = { };
+    u32 _M_frame_count = 0;
+    std::chrono::steady_clock::time_point _M_last_fps_time;
+
+    /* Composition */
+
+    void _M_put(i32 __y, i32 __x, u32 __glyph, u32 __bg = 0) {
+        if (__y < 0 || __x < 0 || (u32)__y >= _M_rows || (u32)__x >= _M_cols) return;
+        _M_grid[__y * _M_cols + __x] = { __glyph, __bg, _M_part };
+    }
+
+    void _M_text(i32 __y, i32 __x, std::string_view __s) {
+        for (char __c : __s) {
+            if (__c == '\n') return;
+            _M_put(__y, __x++, (u8)__c);
+        }
+    }
+
+    void _M_box(const layout::box& __b, std::string_view __title = { }) {
+        i32 __bottom = __b._M_y + __b._M_height - 1, __right = __b._M_x + __b._M_width - 1;
+
+        for (i32 __x = __b._M_x + 1; __x < __right; ++__x) {
+            _M_put(__b._M_y, __x, _S_horizontal);
+            _M_put(__bottom, __x, _S_horizontal);
+        }
+        for (i32 __y = __b._M_y + 1; __y < __bottom; ++__y) {
+            _M_put(__y, __b._M_x, _S_vertical);
+            _M_put(__y, __right, _S_vertical);
+        }
+
+        _M_put(__b._M_y, __b._M_x, _S_top_left);
+        _M_put(__b._M_y, __right, _S_top_right);
+        _M_put(__bottom, __b._M_x, _S_bottom_left);
+        _M_put(__bottom, __right, _S_bottom_right);
+
+        if (!__title.empty()) _M_text(__b._M_y, __b._M_x + 3, __title);
+    }
+
+    u32 _M_background(u16 __code) const {
+        if (__code == 0) return 0;
+
+        auto [__r, __g, __b] = _M_palette.color(__code);
+        return _S_rgb | (u32)__r << 16 | (u32)__g << 8 | __b;
+    }
+
+    void _M_preview(const layout::box& __b, const tetromino& __t, u32 __slot) {
+        u32 __bg = _M_background(palette::code(palette::look::normal, static_cast<block_type>(__t.type())));
+
+        layout::preview(__t, [&] (u32 __py, u32 __px) {
+            i32 __y = __b._M_y + __slot * 4 + __py, __x = __b._M_x + 1 + __px;
+            _M_put(__y, __x, ' ', __bg);
+            _M_put(__y, __x + 1, ' ', __bg);
+        });
+    }
+
+    void _M_compose_field(const frame& __f) {
+        TRACE_SPAN("draw field");
+        _M_part = wire_stats::field;
+
+        const auto& __b = _M_layout._M_field;
+        _M_box(__b);
+
+        palette::compose(__f, _M_cells);
+
+        for (u32 __y = 0; __y < __f._M_height; ++__y)
+            for (u32 __x = 0; __x < __f._M_width; ++__x) {
+                u32 __bg = _M_background(_M_cells[(size_t)__y * __f._M_width + __x]);
+                i32 __ty = __b._M_y + (i32)(__f._M_height - __y), __tx = __b._M_x + 1 + __x * 2;
+
+                _M_put(__ty, __tx, ' ', __bg);
+                _M_put(__ty, __tx + 1, ' ', __bg);
+            }
+    }
+
+    void _M_compose_next(const frame& __f) {
+        TRACE_SPAN("draw next");
+        _M_part = wire_stats::next;
+
+        _M_box(_M_layout._M_next, "Next");
+        for (u32 __i = 0; __i < __f._M_next.size(); ++__i)
+            _M_preview(_M_layout._M_next, __f._M_next[__i], __i);
+    }
+
+    void _M_compose_hold(const frame& __f) {
+        TRACE_SPAN("draw hold");
+        _M_part = wire_stats::hold;
+
+        _M_box(_M_layout._M_hold, "Hold");
+        if (__f._M_hold) _M_preview(_M_layout._M_hold, *__f._M_hold, 0);
+    }
+
+    void _M_compose_stats(const frame& __f) {
+        TRACE_SPAN("draw stats");
+        _M_part = wire_stats::stats;
+
+        const auto& __b = _M_layout._M_stats;
+        _M_box(__b, "Stats");
+
+        layout::stats(__f, _M_stats);
+        for (u32 __i = 1; __i < layout::_S_stats_rows; ++__i)
+            _M_text(__b._M_y + __i, __b._M_x + 1, _M_stats[__i]);
+
+#ifdef DEBUG
+        // The wire lines change every frame, their own cost goes to `other`.
+        _M_part = wire_stats::other;
+        layout::wire(_M_wire, _M_stats);
+        for (u32 __i = layout::_S_wire_row; __i < layout::_S_stats_rows; ++__i)
+            _M_text(__b._M_y + __i, __b._M_x + 1, _M_stats[__i]);
+#endif
+    }
+
+    void _M_compose_message(const frame& __f) {
+        _M_part = wire_stats::message;
+
+        auto __now = std::chrono::steady_clock::now();
+
+        if (__f._M_over) {
+            std::snprintf(_M_message.data(), _M_message.size(), "Game Over! Press any key to exit...");
+        } else if (__now - _M_last_fps_time >= std::chrono::seconds(1) || _M_message[0] != 'F') {
+            _M_last_fps_time = __now;
+
+            std::snprintf(_M_message.data(), _M_message.size(), "FPS: %3d", std::min(999u, _M_frame_count));
+            _M_frame_count = 0;
+        }
+
+        _M_text(_M_layout._M_msg._M_y, _M_layout._M_msg._M_x, _M_message.data());
+    }
+
+    void _M_compose(const frame& __f) {
+        std::fill(_M_grid.begin(), _M_grid.end(), cell{});
+
+        _M_compose_message(__f);
+        _M_compose_field(__f);
+        _M_compose_next(__f);
+        _M_compose_hold(__f);
+        _M_compose_stats(__f);
+
+        _M_part = wire_stats::message;
+        if (!__f._M_meta.empty()) {
+            const auto& __b = _M_layout._M_meta;
+            _M_box(__b);
+            _M_text(__b._M_y + 1, __b._M_x + 1, __f._M_meta);
+        }
+
+        // Big digits over the field, on a blank box, until the game starts.
+        _M_part = wire_stats::other;
+        if (__f._M_countdown > 0) {
+            const auto& __b = _M_layout._M_countdown;
+
+            for (u32 __y = 0; __y < __b._M_height; ++__y)
+                for (u32 __x = 0; __x < __b._M_width; ++__x)
+                    _M_put(__b._M_y + __y, __b._M_x + __x, ' ');
+
+            std::string_view __digit = converter::i2a[std::min(9u, __f._M_countdown)];
+            for (u32 __y = 0; !__digit.empty(); ++__y) {
+                size_t __n = __digit.find('\n');
+                _M_text(__b._M_y + __y, __b._M_x, __digit.substr(0, __n));
+                __digit.remove_prefix(__n == std::string_view::npos ? __digit.size() : __n + 1);
+            }
+        }
+    }
+
+    /* Output */
+
+    void _M_append(std::string_view __s) {
+        std::memcpy(_M_end, __s.data(), __s.size());
+        _M_end += __s.size();
+    }
+
+    void _M_append(u32 __n) {
+        char __digits[10];
+        u32 __len = 0;
+        do __digits[__len++] = '0' + __n % 10, __n /= 10; while (__n);
+        while (__len) *_M_end++ = __digits[--__len];
+    }
+
+    void _M_append_utf8(u32 __c) {
+        if (__c < 0x80) {
+            *_M_end++ = (char)__c;
+        } else if (__c < 0x800) {
+            *_M_end++ = (char)(0xc0 | __c >> 6);
+            *_M_end++ = (char)(0x80 | (__c & 0x3f));
+        } else {
+            *_M_end++ = (char)(0xe0 | __c >> 12);
+            *_M_end++ = (char)(0x80 | (__c >> 6 & 0x3f));
+            *_M_end++ = (char)(0x80 | (__c & 0x3f));
+        }
+    }
+
+    void _M_append_background(u32 __bg) {
+        if (__bg == 0) {
+            _M_append("\033[49m");
+            return;
+        }
+
+        _M_append("\033[48;2;");
+        _M_append(__bg >> 16 & 0xff); *_M_end++ = ';';
+        _M_append(__bg >> 8 & 0xff); *_M_end++ = ';';
+        _M_append(__bg & 0xff); *_M_end++ = 'm';
+    }
+
+    // Counts what was written into the buffer from `__begin`, for part `__p`.
+    void _M_count(wire_stats::part __p, const char* __begin) {
+        _M_wire.add(__p, { (u64)(_M_end - __begin), (u64)std::count(__begin, (const char*)_M_end, '\033') });
+    }
+
+    // Writes the cells that differ from the terminal into the buffer.
+    void _M_diff() {
+        _M_end = _M_out.data();
+
+        if (!_M_valid) {
+            _M_append("\033[0m\033[2J");
+            _M_count(wire_stats::other, _M_out.data());
+
+            _M_bg = 0;
+            std::fill(_M_shown.begin(), _M_shown.end(), cell{});
+        }
+
+        // Where the cursor is, unknown at first.
+        u32 __cy = -1, __cx = -1;
+
+        for (u32 __y = 0; __y < _M_rows; ++__y) {
+            for (u32 __x = 0; __x < _M_cols; ++__x) {
+                size_t __i = (size_t)__y * _M_cols + __x;
+                const cell& __c = _M_grid[__i];
+                if (__c == _M_shown[__i]) continue;
+
+                const char* __begin = _M_end;
+
+                if (__y != __cy || __x != __cx) {
+                    _M_append("\033[");
+                    _M_append(__y + 1); *_M_end++ = ';';
+                    _M_append(__x + 1); *_M_end++ = 'H';
+                }
+
+                if (__c._M_bg != _M_bg) {
+                    _M_append_background(__c._M_bg);
+                    _M_bg = __c._M_bg;
+                }
+
+                _M_append_utf8(__c._M_glyph);
+
+                // A cell erased is counted for the part that drew it.
+                bool __erased = __c._M_part == wire_stats::other;
+                _M_count(__erased ? _M_shown[__i]._M_part : __c._M_part, __begin);
+                _M_shown[__i] = __c;
+
+                __cy = __y;
+                __cx = __x + 1;
+            }
+        }
+    }
+
+    // Returns the number of `write()` calls.
+    u64 _M_flush() {
+        TRACE_SPAN("flush");
+
+        const char* __p = _M_out.data();
+        size_t __n = _M_end - __p;
+        u64 __writes = 0;
+
+        while (__n > 0) {
+            ssize_t __w = ::write(_M_fd, __p, __n);
+            __writes++;
+            if (__w < 0) {
+                if (errno == EINTR) continue;
+                // The terminal is gone, the next frame is written whole.
+                _M_valid = false;
+                return __writes;
+            }
+
+            __p += __w;
+            __n -= __w;
+        }
+
+        _M_valid = true;
+        return __writes;
+    }
+
+public:
+    ansi_screen(const user_config& __uconf, block_color::types __color, int __fd = STDOUT_FILENO)
+    : _M_layout(__uconf), _M_palette(*block_color::create(__color)), _M_fd(__fd),
+      _M_rows(_M_layout.height()), _M_cols(_M_layout.width()),
+      _M_grid((size_t)_M_rows * _M_cols), _M_shown((size_t)_M_rows * _M_cols),
+      _M_out(sizeof("\033[0m\033[2J") + (size_t)_M_rows * _M_cols * _S_cell_bytes) { }
+
+    ansi_screen(const ansi_screen&) = delete;
+    ansi_screen& operator=(const ansi_screen&) = delete;
+
+    /**
+     * @brief Writes what changed since the last frame to the terminal, in
+     * one `write()`.
+     *
+     * @return The number of bytes written.
+     */
+    u64 draw(const frame& __f) {
+        // Composed first, so the stats show the frames before this one.
+        _M_compose(__f);
+
+        _M_wire.begin(__f._M_action);
+        _M_diff();
+        _M_wire.end(_M_flush());
+
+        _M_frame_count++;
+        return _M_wire._M_frame._M_bytes;
+    }
+
+    // Clears the terminal and writes everything again.
+    u64 redraw(const frame& __f) {
+        _M_valid = false;
+        return draw(__f);
+    }
+
+    const wire_stats& wire() const { return _M_wire; }
+
+    // The terminal may have lost what it showed, the next frame is written whole.
+    void resize() { _M_valid = false; }
+
+    /* Terminal */
+
+private:
+    inline static termios _S_saved_mode;
+    // Whether the terminal is in the mode of `open_terminal()`.
+    inline static volatile std::sig_atomic_t _S_open = 0;
+
+    static void _S_write(std::string_view __s) {
+        while (!__s.empty()) {
+            ssize_t __w = ::write(STDOUT_FILENO, __s.data(), __s.size());
+            if (__w < 0 && errno == EINTR) continue;
+            if (__w <= 0) return;
+            __s.remove_prefix(__w);
+        }
+    }
+
+    // Only `write()` and `tcsetattr()`, so that signal handlers may call it.
+    static void _S_restore() {
+        if (!_S_open) return;
+        _S_open = 0;
+
+        _S_write("\033[0m\033[?25h\033[?1049l");
+        ::tcsetattr(STDIN_FILENO, TCSAFLUSH, &_S_saved_mode);
+    }
+
+    // Puts the terminal back, then dies of the signal as it would have.
+    static void _S_on_signal(int __sig) {
+        _S_restore();
+
+        struct sigaction __sa = { };
+        __sa.sa_handler = SIG_DFL;
+        ::sigaction(__sig, &__sa, nullptr);
+        ::raise(__sig);
+    }
+
+public:
+    /**
+     * @brief Takes keys one by one without echo, and switches to the
+     * alternate screen with the cursor hidden, as `initscr()` would.
+     *
+     * Ctrl-C still interrupts. As ncurses does, the terminal is put back
+     * when the process is ended by SIGINT, SIGTERM, SIGHUP or SIGQUIT, or
+     * exits without `close_terminal()`.
+     */
+    static bool open_terminal() {
+        if (::tcgetattr(STDIN_FILENO, &_S_saved_mode) != 0) return false;
+
+        termios __mode = _S_saved_mode;
+        __mode.c_lflag &= ~(ICANON | ECHO);
+        __mode.c_cc[VMIN] = 1;
+        __mode.c_cc[VTIME] = 0;
+        if (::tcsetattr(STDIN_FILENO, TCSAFLUSH, &__mode) != 0) return false;
+
+        static bool __hooked = false;
+        if (!__hooked) {
+            __hooked = true;
+            std::atexit(_S_restore);
+
+            struct sigaction __sa = { };
+            __sa.sa_handler = _S_on_signal;
+            for (int __sig : { SIGINT, SIGTERM, SIGHUP, SIGQUIT }) ::sigaction(__sig, &__sa, nullptr);
+        }
+
+        _S_open = 1;
+        _S_write("\033[?1049h\033[?25l\033[2J");
+        return true;
+    }
+
+    // Puts the terminal back as it was before `open_terminal()`.
+    static void close_terminal() { _S_restore(); }
+
+    // Shows `__s` alone on the first line, outside of frames.
+    static void show_message(std::string_view __s) {
+        _S_write("\033[H\033[2K");
+        _S_write(__s);
+    }
+};
@@ -0,0 +1,371 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <memory>
+#include <optional>
+#include <string_view>
+
+#include <chrono>
+
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <ncurses.h>
+
+#include <lib/intdef>
+
+#include <config.hpp>
+#include <frame.hpp>
+#include <rules/tetromino.hpp>
+#include <rules/field.hpp>
+#include <screen/layout.hpp>
+#include <screen/palette.hpp>
+#include <screen/wire.hpp>
+
+#include <util/conv.hpp>
+#include <util/trace.hpp>
+
+/**
+ * @brief Draws frames with ncurses, one window per box, colors as color
+ * pairs. Built with `-DDISABLE_ANSI=ON`.
+ *
+ * Each frame is compared with the one drawn before: only the field cells,
+ * windows and stats lines that changed are written.
+ *
+ * ncurses writes to the terminal itself, so what it sends is not counted:
+ * `wire()` stays empty and the bandwidth budget does not apply.
+ */
+class curses_screen {
+    using rgb_t = palette::rgb_t;
+
+    layout _M_layout;
+    palette _M_palette;
+
+    struct {
+        WINDOW* _M_field = nullptr;
+        WINDOW* _M_next = nullptr;
+        WINDOW* _M_hold = nullptr;
+        WINDOW* _M_stats = nullptr;
+        WINDOW* _M_msg = nullptr;
+        WINDOW* _M_meta = nullptr;
+        WINDOW* _M_countdown = nullptr;
+    } _M_windows;
+
+    std::array<bool, 6> _M_refresh_marked = { false, };
+
+    // What is on the screen, to draw only what changes.
+    // `_M_valid` is false when everything must be drawn again.
+    bool _M_valid = false;
+    // Color code of each field cell, 0 if empty. Row 0 at the bottom.
+    std::vector<u16> _M_shown_cells;
+    std::vector<tetromino> _M_shown_next;
+    std::optional<tetromino> _M_shown_hold;
+    std::string_view _M_shown_meta;
+    u32 _M_shown_countdown = 0;
+    bool _M_shown_over = false;
+
+    // Cells of the frame being drawn, kept to reuse their storage.
+    std::vector<u16> _M_cells;
+    // Stats lines as shown, formatted again only where values change.
+    layout::stats_text _M_stats;
+
+    u32 _M_frame_count = 0;
+    std::chrono::steady_clock::time_point _M_last_fps_time;
+
+    // Terminal size the windows were drawn for.
+    i32 _M_lines = 0, _M_cols = 0;
+
+    wire_stats _M_wire;
+
+    // ncurses takes colors from 0 to 1000.
+    inline static bool _M_init_color(u16 __idx, rgb_t __value) {
+        auto [__r, __g, __b] = __value;
+        return
+            init_color(__idx, (u32)__r * 1000 / 255, (u32)__g * 1000 / 255, (u32)__b * 1000 / 255) == OK &&
+            init_pair(__idx, __idx, __idx) == OK;
+    }
+
+    static WINDOW* _S_window(const layout::box& __b)
+    { return newwin(__b._M_height, __b._M_width, __b._M_y, __b._M_x); }
+
+    void _M_init() {
+        for (u16 __i = palette::_S_normal_color; __i < palette::_S_gray_color + 1; ++__i)
+            _M_init_color(__i, _M_palette.color(__i));
+
+        _M_windows._M_field = _S_window(_M_layout._M_field);
+        _M_windows._M_next = _S_window(_M_layout._M_next);
+        _M_windows._M_hold = _S_window(_M_layout._M_hold);
+        _M_windows._M_stats = _S_window(_M_layout._M_stats);
+        _M_windows._M_msg = _S_window(_M_layout._M_msg);
+        _M_windows._M_meta = _S_window(_M_layout._M_meta);
+    }
+
+    // Draws a tetromino in the next or hold box, in its 4x4 slot.
+    void _M_draw_preview(WINDOW* __win, const tetromino& __t, u32 __y, u32 __x) {
+        auto __attr = COLOR_PAIR(palette::code(palette::look::normal, static_cast<block_type>(__t.type())));
+
+        layout::preview(__t, [&] (u32 __py, u32 __px) {
+            wmove(__win, __y + __py, __x + __px);
+            wattron(__win, __attr);
+            wprintw(__win, "  ");
+            wattroff(__win, __attr);
+        });
+    }
+
+    void _M_draw_field(const frame& __f) {
+        TRACE_SPAN("draw field");
+
+        palette::compose(__f, _M_cells);
+
+        if (!_M_valid || _M_shown_cells.size() != _M_cells.size()) {
+            // Erased cells are blank, only the others are drawn below.
+            werase(_M_windows._M_field);
+            box(_M_windows._M_field, 0, 0);
+            _M_shown_cells.assign(_M_cells.size(), 0);
+            _M_refresh_marked[0] = true;
+        }
+
+        for (u32 __y = 0; __y < __f._M_height; ++__y) {
+            for (u32 __x = 0; __x < __f._M_width; ++__x) {
+                size_t __i = (size_t)__y * __f._M_width + __x;
+                if (_M_cells[__i] == _M_shown_cells[__i]) continue;
+
+                _M_shown_cells[__i] = _M_cells[__i];
+
+                wmove(_M_windows._M_field, __f._M_height - __y, 1 + __x * 2);
+                if (_M_cells[__i]) wattron(_M_windows._M_field, COLOR_PAIR(_M_cells[__i]));
+                wprintw(_M_windows._M_field, "  ");
+                if (_M_cells[__i]) wattroff(_M_windows._M_field, COLOR_PAIR(_M_cells[__i]));
+
+                _M_refresh_marked[0] = true;
+            }
+        }
+    }
+
+    void _M_draw_next(const frame& __f) {
+        if (_M_valid && __f._M_next == _M_shown_next) return;
+
+        TRACE_SPAN("draw next");
+
+        _M_shown_next = __f._M_next;
+
+        werase(_M_windows._M_next);
+        box(_M_windows._M_next, 0, 0);
+
+        mvwprintw(_M_windows._M_next, 0, 3, "Next");
+
+        for (u32 __i = 0; __i < __f._M_next.size(); ++__i)
+            _M_draw_preview(_M_windows._M_next, __f._M_next[__i], __i * 4, 1);
+
+        _M_refresh_marked[1] = true;
+    }
+
+    void _M_draw_hold(const frame& __f) {
+        if (_M_valid && __f._M_hold == _M_shown_hold) return;
+
+        TRACE_SPAN("draw hold");
+
+        _M_shown_hold = __f._M_hold;
+
+        werase(_M_windows._M_hold);
+        box(_M_windows._M_hold, 0, 0);
+
+        mvwprintw(_M_windows._M_hold, 0, 3, "Hold");
+
+        if (__f._M_hold) _M_draw_preview(_M_windows._M_hold, *__f._M_hold, 0, 1);
+
+        _M_refresh_marked[2] = true;
+    }
+
+    // Writes the stats lines whose text changed.
+    void _M_draw_stats(const frame& __f) {
+        TRACE_SPAN("draw stats");
+
+        layout::stats(__f, _M_stats);
+
+        if (!_M_valid) {
+            werase(_M_windows._M_stats);
+            box(_M_windows._M_stats, 0, 0);
+            mvwprintw(_M_windows._M_stats, 0, 3, "Stats");
+            _M_refresh_marked[3] = true;
+        }
+
+        for (u32 __i = 1; __i < layout::_S_stats_rows; ++__i) {
+            if (_M_valid && !(_M_stats._M_changed >> __i & 1)) continue;
+
+            mvwprintw(_M_windows._M_stats, __i, 1, "%-28s", _M_stats[__i]);
+            _M_refresh_marked[3] = true;
+        }
+    }
+
+    void _M_draw_meta(const frame& __f) {
+        if (_M_valid && __f._M_meta == _M_shown_meta) return;
+
+        _M_shown_meta = __f._M_meta;
+
+        werase(_M_windows._M_meta);
+        if (!__f._M_meta.empty()) {
+            box(_M_windows._M_meta, 0, 0);
+            mvwprintw(_M_windows._M_meta, 1, 1, "%.*s", (int)__f._M_meta.size(), __f._M_meta.data());
+        }
+
+        _M_refresh_marked[4] = true;
+    }
+
+    void _M_draw_message(const frame& __f) {
+        auto __now = std::chrono::steady_clock::now();
+
+        if (__f._M_over) {
+            if (_M_valid && _M_shown_over) return;
+
+            werase(_M_windows._M_msg);
+            mvwprintw(_M_windows._M_msg, 0, 0, "Game Over! Press any key to exit...");
+            _M_refresh_marked[5] = true;
+        } else if (__now - _M_last_fps_time >= std::chrono::seconds(1) || _M_shown_over || !_M_valid) {
+            _M_last_fps_time = __now;
+
+            werase(_M_windows._M_msg);
+            mvwprintw(_M_windows._M_msg, 0, 0, "FPS: %3d", std::min(999u, _M_frame_count));
+            _M_frame_count = 0;
+            _M_refresh_marked[5] = true;
+        }
+
+        _M_shown_over = __f._M_over;
+    }
+
+    // Big digits over the field, until the game starts.
+    void _M_draw_countdown(const frame& __f) {
+        if (__f._M_countdown == _M_shown_countdown) return;
+
+        _M_shown_countdown = __f._M_countdown;
+
+        if (__f._M_countdown == 0) {
+            if (_M_windows._M_countdown) delwin(_M_windows._M_countdown);
+            _M_windows._M_countdown = nullptr;
+
+            touchwin(_M_windows._M_field);
+            _M_refresh_marked[0] = true;
+            return;
+        }
+
+        if (!_M_windows._M_countdown)
+            _M_windows._M_countdown = _S_window(_M_layout._M_countdown);
+
+        werase(_M_windows._M_countdown);
+        mvwprintw(_M_windows._M_countdown, 0, 0, "%s", converter::i2a[std::min(9u, __f._M_countdown)].data());
+    }
+
+    void _M_flush() {
+        TRACE_SPAN("flush");
+
+        WINDOW* __wins[] = {
+            _M_windows._M_field, _M_windows._M_next, _M_windows._M_hold,
+            _M_windows._M_stats, _M_windows._M_meta, _M_windows._M_msg
+        };
+
+        for (u32 __i = 0; __i < _M_refresh_marked.size(); ++__i) {
+            if (!_M_refresh_marked[__i]) continue;
+
+            wnoutrefresh(__wins[__i]);
+            _M_refresh_marked[__i] = false;
+        }
+
+        if (_M_windows._M_countdown) wnoutrefresh(_M_windows._M_countdown);
+
+        doupdate();
+    }
+
+public:
+    // Needs ncurses initialized, with colors.
+    curses_screen(const user_config& __uconf, block_color::types __color)
+    : _M_layout(__uconf), _M_palette(*block_color::create(__color)) {
+        _M_init();
+    }
+
+    ~curses_screen() {
+        if (_M_windows._M_field) delwin(_M_windows._M_field);
+        if (_M_windows._M_next) delwin(_M_windows._M_next);
+        if (_M_windows._M_hold) delwin(_M_windows._M_hold);
+        if (_M_windows._M_stats) delwin(_M_windows._M_stats);
+        if (_M_windows._M_msg) delwin(_M_windows._M_msg);
+        if (_M_windows._M_meta) delwin(_M_windows._M_meta);
+        if (_M_windows._M_countdown) delwin(_M_windows._M_countdown);
+    }
+
+    curses_screen(const curses_screen&) = delete;
+    curses_screen& operator=(const curses_screen&) = delete;
+
+    // Draws what changed since the last frame and sends it to the terminal.
+    // Returns the number of bytes written, which ncurses does not tell: 0.
+    u64 draw(const frame& __f) {
+        // ncurses takes a new terminal size on its own, in `doupdate()`
+        // after its SIGWINCH handler; the frame after it is drawn whole.
+        if (LINES != _M_lines || COLS != _M_cols) {
+            _M_lines = LINES;
+            _M_cols = COLS;
+
+            clear();
+            wnoutrefresh(stdscr);
+            _M_valid = false;
+        }
+
+        _M_draw_field(__f);
+        _M_draw_next(__f);
+        _M_draw_hold(__f);
+        _M_draw_stats(__f);
+        _M_draw_meta(__f);
+        _M_draw_message(__f);
+        _M_draw_countdown(__f);
+
+        _M_valid = true;
+        _M_frame_count++;
+
+        _M_flush();
+        return 0;
+    }
+
+    // Draws every window again.
+    u64 redraw(const frame& __f) {
+        _M_valid = false;
+        return draw(__f);
+    }
+
+    const wire_stats& wire() const { return _M_wire; }
+
+    // Takes the new size of the terminal, the next frame is drawn whole.
+    void resize() {
+        winsize __ws;
+        if (::ioctl(STDOUT_FILENO, TIOCGWINSZ, &__ws) == 0)
+            resizeterm(__ws.ws_row, __ws.ws_col);
+
+        clear();
+        wnoutrefresh(stdscr);
+        _M_valid = false;
+    }
+
+    /* Terminal */
+
+    // Starts ncurses, with colors.
+    static bool open_terminal() {
+        if (initscr() == nullptr) return false;
+        if (start_color() == ERR) return false;
+        if (curs_set(0) == ERR) return false;
+        if (noecho() == ERR) return false;
+        if (cbreak() == ERR) return false;
+        if (use_default_colors() == ERR) return false;
+
+        refresh();
+        return true;
+    }
+
+    static void close_terminal() { endwin(); }
+
+    // Shows `__s` alone on the first line, outside of frames.
+    static void show_message(std::string_view __s) {
+        move(0, 0);
+        clrtoeol();
+        printw("%.*s", (int)__s.size(), __s.data());
+        refresh();
+    }
+};
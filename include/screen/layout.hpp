@@ -0,0 +1,195 @@
+#pragma once
+
+#include <array>
+#include <algorithm>
+#include <bit>
+#include <type_traits>
+
+#include <cstdio>
+
+#include <lib/intdef>
+
+#include <config.hpp>
+#include <frame.hpp>
+#include <rules/tetromino.hpp>
+#include <screen/wire.hpp>
+
+#include <util/conv.hpp>
+
+/**
+ * @brief Where the boxes of the game are on the terminal, in character
+ * cells, and the text they show. Shared by the screens, which only differ
+ * in how they put it on the terminal.
+ */
+struct layout {
+    struct box {
+        i32 _M_y = 0, _M_x = 0;
+        u32 _M_height = 0, _M_width = 0;
+    };
+
+    box _M_msg, _M_field, _M_next, _M_hold, _M_stats, _M_meta, _M_countdown;
+
+    // Lines of the stats box from its top border, which is line 0.
+    // Debug builds show what is sent to the terminal on four more.
+#ifdef DEBUG
+    inline static constexpr u32 _S_stats_rows = 19;
+    inline static constexpr u32 _S_wire_row = 15;
+#else
+    inline static constexpr u32 _S_stats_rows = 15;
+#endif
+
+    /**
+     * @brief Lines of the stats box, kept from frame to frame with the
+     * values each was formatted from. A line is only formatted again when
+     * its values change, and `_M_changed` has a bit for each line that did
+     * in the last `stats()` (or `wire()`).
+     */
+    struct stats_text {
+        using line = std::array<char, 29>;
+
+        std::array<line, _S_stats_rows> _M_lines = { };
+        // Format and arguments of each line, all 0 for an empty one.
+        std::array<std::array<u64, 4>, _S_stats_rows> _M_keys = { };
+        u32 _M_changed = 0;
+
+        const char* operator[](u32 __row) const { return _M_lines[__row].data(); }
+    };
+
+    explicit layout(const user_config& __uconf) {
+        u32 __width = __uconf.field.width,
+            __height = __uconf.field.height + __uconf.field.extra_height;
+
+        i32 __left_space_width = 30;
+        i32 __next_left_pos = __left_space_width + __width * 2 + 4;
+
+        _M_field = { 1, __left_space_width + 1, __height + 2, __width * 2 + 2 };
+        _M_next = { 1, __next_left_pos, __uconf.game.next_queue_size * 4 + 2, 10 };
+        _M_hold = { 1, __left_space_width - 10, 6, 10 };
+        _M_stats = { 12, 0, _S_stats_rows + 1, (u32)__left_space_width };
+        _M_msg = { 0, 0, 1, (u32)__next_left_pos };
+        _M_meta = { 8, 0, 3, (u32)__left_space_width };
+
+        // Big digits, centered over the field.
+        _M_countdown = {
+            _M_field._M_y + (i32)converter::center(_M_field._M_height, 4),
+            _M_field._M_x + (i32)converter::center(_M_field._M_width, 6),
+            5, 7
+        };
+    }
+
+    // Rows and columns the boxes take.
+    u32 height() const {
+        u32 __h = 0;
+        for (const box* __b : { &_M_msg, &_M_field, &_M_next, &_M_hold, &_M_stats, &_M_meta })
+            __h = std::max(__h, __b->_M_y + __b->_M_height);
+        return __h;
+    }
+
+    u32 width() const { return _M_next._M_x + _M_next._M_width; }
+
+    /**
+     * @brief Calls `__f(y, x)` for each block of `__t` as shown in the next
+     * and hold boxes, from the top left of its 4x4 slot, x in columns.
+     */
+    template <typename _Func>
+    static void preview(const tetromino& __t, _Func&& __f) {
+        u32 __px = __t.type() == mino_type::O ? 2 : 1,
+            __py = __t.type() == mino_type::I ? 1 : 2;
+
+        u32 __tx = std::min(__t.size(), 3u);
+
+        for (u32 __j = 0; __j < __t.size(); ++__j)
+            for (u32 __k = 0; __k < __tx; ++__k)
+                if (__t.data()[__j][__k] != 0) __f(__py + __j, __px + __k * 2);
+    }
+
+private:
+    template <typename _Tp>
+    static u64 _S_key(_Tp __v) {
+        if constexpr (std::is_floating_point_v<_Tp>) return std::bit_cast<u64>((f64)__v);
+        else return (u64)__v;
+    }
+
+    // Formats line `__row` unless it was formatted from the same values.
+    template <typename... _Args>
+    static void _S_line(stats_text& __text, u32 __row, const char* __fmt, _Args... __args) {
+        static_assert(sizeof...(_Args) < 4);
+
+        std::array<u64, 4> __key = { (u64)__fmt, _S_key(__args)... };
+        if (__text._M_keys[__row] == __key) return;
+
+        __text._M_keys[__row] = __key;
+        std::snprintf(__text._M_lines[__row].data(), __text._M_lines[__row].size(), __fmt, __args...);
+        __text._M_changed |= 1u << __row;
+    }
+
+public:
+    // Lines of the stats box for `__f`, empty where there is nothing to show.
+    static void stats(const frame& __f, stats_text& __text) {
+        __text._M_changed = 0;
+        u32 __shown = 0;
+
+        auto __line = [&] (u32 __row, const char* __fmt, auto... __args) {
+            _S_line(__text, __row, __fmt, __args...);
+            __shown |= 1u << __row;
+        };
+
+        const auto& __stats = __f._M_stats;
+
+        if (__f._M_puzzle) {
+            __line(2, "Solved count: %d", __f._M_solved);
+        } else {
+            if (__stats._M_topouts > 0) __line(1, "Topped: %lu", __stats._M_topouts);
+            __line(2, "Lines: %lu", __stats._M_lines);
+            __line(3, "Attack: %lu", __stats._M_attack);
+            __line(4, "B2B: %d", __stats._M_b2b);
+            __line(5, "Combo: %d", __stats._M_combo);
+            __line(6, "Placed: %lu", __stats._M_place_count);
+            __line(7, "Input: %lu", __stats._M_input_count);
+        }
+
+        __line(9, "PPS: %6.2f  avg %6.2f", __f._M_rolling._M_pps, __f._M_lifetime._M_pps);
+        __line(10, "APM: %6.1f  avg %6.1f", __f._M_rolling._M_apm, __f._M_lifetime._M_apm);
+        __line(11, "KPP: %6.2f  avg %6.2f", __f._M_rolling._M_kpp, __f._M_lifetime._M_kpp);
+        __line(12, "Finesse: %.1f%% (%u faults)", __f._M_finesse.rate() * 100, __f._M_finesse._M_faults);
+
+#ifdef DEBUG
+        __line(8, "Undo: %lu (%lu kept)", __f._M_history_node, __f._M_history_size);
+
+        if (alloc_counter::enabled) {
+            __line(13, "Alloc/frame: %lu (%lu B)", __f._M_alloc_frame._M_count, __f._M_alloc_frame._M_bytes);
+            __line(14, "Alloc/input: %lu (%lu B)", __f._M_alloc_input._M_count, __f._M_alloc_input._M_bytes);
+        }
+
+        // Lines of `wire()`, left as they are.
+        __shown |= ~0u << _S_wire_row;
+#endif
+
+        // Lines shown before and not now, e.g. out of puzzle mode.
+        for (u32 __i = 0; __i < _S_stats_rows; ++__i) {
+            if (__shown >> __i & 1 || __text._M_keys[__i][0] == 0) continue;
+
+            __text._M_keys[__i] = { };
+            __text._M_lines[__i] = { };
+            __text._M_changed |= 1u << __i;
+        }
+    }
+
+#ifdef DEBUG
+    // Lines of the stats box for what the screen sent to the terminal.
+    static void wire(const wire_stats& __w, stats_text& __text) {
+        auto __line = [&] (u32 __row, const char* __fmt, auto... __args) {
+            _S_line(__text, __row, __fmt, __args...);
+        };
+
+        const auto& __p = __w._M_action_parts;
+
+        __line(_S_wire_row, "Frame: %lu B, %lu esc", __w._M_frame._M_bytes, __w._M_frame._M_escapes);
+        __line(_S_wire_row + 1, "Action: %lu B, %lu esc", __w._M_action._M_bytes, __w._M_action._M_escapes);
+        __line(_S_wire_row + 2, "fld %lu nxt %lu hld %lu",
+            __p[wire_stats::field]._M_bytes, __p[wire_stats::next]._M_bytes, __p[wire_stats::hold]._M_bytes);
+        __line(_S_wire_row + 3, "sts %lu msg %lu etc %lu",
+            __p[wire_stats::stats]._M_bytes, __p[wire_stats::message]._M_bytes, __p[wire_stats::other]._M_bytes);
+    }
+#endif
+};
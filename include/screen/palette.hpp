@@ -0,0 +1,141 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <tuple>
+
+#include <cmath>
+
+#include <lib/intdef>
+
+#include <frame.hpp>
+#include <rules/field.hpp>
+
+/**
+ * @brief Colors of the blocks as drawn, from a block color theme.
+ *
+ * Each block is drawn in one of four looks: normal (placed), guide (the
+ * ghost), locked (the tetromino in play) and gray (everything, once the
+ * game is over). A look of a block is a color code, which the ncurses
+ * screen uses as its color pair; code 0 is an empty cell.
+ */
+struct palette {
+    using rgb_t = std::tuple<u8, u8, u8>;
+
+    enum class look : u8 { normal, guide, locked, gray };
+
+    inline static constexpr u16 _S_color_interval = 16;
+    inline static constexpr u16 _S_color_start = 30;
+    inline static constexpr u16 _S_normal_color = _S_color_start;
+    inline static constexpr u16 _S_guide_color = _S_color_start + _S_color_interval;
+    inline static constexpr u16 _S_locked_color = _S_guide_color + _S_color_interval;
+    inline static constexpr u16 _S_gray_color = _S_locked_color + _S_color_interval;
+    inline static constexpr u16 _S_color_end = _S_gray_color + _S_color_interval;
+
+    // normal = color * (4/5)
+    inline static rgb_t _S_normal_coloring(rgb_t __c) {
+        auto [__r, __g, __b] = __c;
+        __r -= __r / 5;
+        __g -= __g / 5;
+        __b -= __b / 5;
+        return {__r, __g, __b};
+    }
+
+    // guide = color * (5/10)
+    inline static rgb_t _S_guide_coloring(rgb_t __c) {
+        auto [__r, __g, __b] = __c;
+        __r = __r / 2;
+        __g = __g / 2;
+        __b = __b / 2;
+        return {__r, __g, __b};
+    }
+
+    // locked = color
+    inline static rgb_t _S_locked_coloring(rgb_t __c)
+    { return __c; }
+
+    // gray = grayscale(color)
+    // TODO : grayscale issue
+    inline static rgb_t _S_gray_coloring(rgb_t __c) {
+        auto [__r, __g, __b] = __c;
+        u8 __gray = (u8)std::rint(
+            std::pow(
+                0.2126 * std::pow(__r, 2.2) +
+                0.7152 * std::pow(__g, 2.2) +
+                0.0722 * std::pow(__b, 2.2),
+                1.0 / 2.2
+            ) * 76
+        );
+        return {__gray, __gray, __gray};
+    }
+
+    // Color of each code, from `_S_color_start`.
+    std::array<rgb_t, _S_color_end - _S_color_start> _M_colors = { };
+
+    explicit palette(Iblock_color& __theme) {
+        for (u8 __i = 0; __i < 9u; __i++) {
+            auto __color = __theme.color(static_cast<block_type>(__i));
+            _M_colors[_S_normal_color - _S_color_start + __i] = _S_normal_coloring(__color);
+            _M_colors[_S_guide_color  - _S_color_start + __i] = _S_guide_coloring (__color);
+            _M_colors[_S_locked_color - _S_color_start + __i] = _S_locked_coloring(__color);
+            // _M_colors[_S_gray_color - _S_color_start + __i] = _S_gray_coloring(__color);
+        }
+
+        // Use single gray color instead of grayscale.
+        _M_colors[_S_gray_color - _S_color_start] = { 76, 76, 76 };
+    }
+
+    static u16 code(look __l, block_type __b) {
+        if (__l == look::gray) return _S_gray_color;
+        return _S_color_start + static_cast<u16>(__l) * _S_color_interval + static_cast<u8>(__b);
+    }
+
+    // Color of a code other than 0.
+    rgb_t color(u16 __code) const { return _M_colors[__code - _S_color_start]; }
+
+    /**
+     * @brief Color codes of the field cells of `__f`, row 0 at the bottom,
+     * with the hint, the ghost and the tetromino in play over them.
+     */
+    static void compose(const frame& __f, std::vector<u16>& __cells) {
+        __cells.assign(__f._M_cells.size(), 0);
+
+        for (size_t __i = 0; __i < __f._M_cells.size(); ++__i) {
+            auto [__block, __attr] = __f._M_cells[__i];
+            if (__block == block_type::EMPTY) continue;
+
+            switch (__attr) {
+                case block_attribute::NORMAL:
+                    __cells[__i] = code(__f._M_over ? look::gray : look::normal, __block);
+                    break;
+                case block_attribute::GUIDE:
+                    __cells[__i] = code(look::guide, __block);
+                    break;
+                case block_attribute::LOCKED:
+                    __cells[__i] = code(look::locked, __block);
+                    break;
+            }
+        }
+
+        if (__f._M_over || !__f._M_current) return;
+
+        auto __put = [&] (const tetromino& __t, i32 __x, i32 __y, look __l) {
+            u16 __code = code(__l, static_cast<block_type>(__t.type()));
+
+            for (u32 __j = 0; __j < __t.size(); ++__j)
+                for (u32 __k = 0; __k < __t.size(); ++__k) {
+                    if (__t.data()[__j][__k] == 0) continue;
+
+                    i32 __cx = __x + (i32)__k, __cy = __y - (i32)__j;
+                    if (__cx < 0 || __cy < 0 || (u32)__cx >= __f._M_width || (u32)__cy >= __f._M_height)
+                        continue;
+
+                    __cells[__cy * __f._M_width + __cx] = __code;
+                }
+        };
+
+        if (__f._M_hint) __put(*__f._M_hint, __f._M_hint_x, __f._M_hint_y, look::guide);
+        __put(*__f._M_current, __f._M_x, __f._M_ghost_y, look::guide);
+        __put(*__f._M_current, __f._M_x, __f._M_y, look::locked);
+    }
+};
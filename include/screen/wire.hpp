@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+
+#include <lib/intdef>
+
+/**
+ * @brief Bytes and escape sequences a screen sent to the terminal, for the
+ * debug stats panel and the bandwidth budget.
+ *
+ * Counted per frame, and per action: from the first frame showing an input
+ * until the next input, so the ticks in between are part of its cost. The
+ * action cost is also split by part of the screen.
+ */
+struct wire_stats {
+    struct counts {
+        u64 _M_bytes = 0, _M_escapes = 0;
+
+        counts& operator+=(const counts& __o) {
+            _M_bytes += __o._M_bytes;
+            _M_escapes += __o._M_escapes;
+            return *this;
+        }
+    };
+
+    // Parts of the screen. `other` is what no part owns, such as clearing
+    // the terminal or erasing the meta box.
+    enum part : u8 { field, next, hold, stats, message, other, parts };
+
+    counts _M_frame, _M_action, _M_total;
+    std::array<counts, parts> _M_action_parts;
+    u64 _M_frames = 0, _M_writes = 0;
+
+    // Input count of the action being counted.
+    u64 _M_last_action = 0;
+
+    // Starts counting a frame, showing the inputs up to `__action`.
+    void begin(u64 __action) {
+        _M_frame = { };
+
+        if (__action != _M_last_action) {
+            _M_last_action = __action;
+            _M_action = { };
+            _M_action_parts = { };
+        }
+    }
+
+    void add(part __p, const counts& __c) {
+        _M_frame += __c;
+        _M_action += __c;
+        _M_action_parts[__p] += __c;
+        _M_total += __c;
+    }
+
+    // Ends the frame, sent in `__writes` system calls.
+    void end(u64 __writes) {
+        _M_frames++;
+        _M_writes += __writes;
+    }
+};
@@ -0,0 +1,585 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <algorithm>
+#include <utility>
+
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <optional>
+#include <random>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <lib/intdef>
+
+#include <engine.hpp>
+#include <rules/bag.hpp>
+#include <rules/field.hpp>
+#include <rules/tetromino.hpp>
+
+/**
+ * @brief A game saved to continue later: `engine::session_data`, and the bag
+ * and the mode it was played with.
+ *
+ * `save()` writes to a temporary file next to the target and renames it
+ * over the target once it is synced, so a crash leaves the previous save
+ * or the new one, never a torn file.
+ *
+ * File layout (little endian):
+ *   "TTRS", u32 version, u8 bag, u8 mode, u32 field width, u32 field height,
+ *   state (see `_S_write_state`), i32 x, i32 y, u8 flags, u32 kick index,
+ *   u32 attack count, attacks, undo history (see `_S_write_history`).
+ *
+ * Version 1 kept attacks as texts and 32-bit counters, versions 1 and 2
+ * a line of states instead of a tree; both are still read. Versions before
+ * 4 have no mode, they are read as games of the default one.
+ */
+struct session {
+    using game_mode = user_config::game_mode;
+
+    bags::types _M_bag = bags::types::bag7;
+    game_mode _M_mode = user_config{}.game.mode;
+    engine::session_data _M_data;
+
+private:
+    static constexpr std::array<char, 4> _S_magic = { 'T', 'T', 'R', 'S' };
+    static constexpr u32 _S_version = 4;
+
+    // No tetromino.
+    static constexpr u8 _S_none = 0xff;
+
+    template <typename T>
+    static void _S_write(std::ostream& __os, T __v)
+    { __os.write(reinterpret_cast<const char*>(&__v), sizeof(T)); }
+
+    template <typename T>
+    static bool _S_read(std::istream& __is, T& __v)
+    { return (bool)__is.read(reinterpret_cast<char*>(&__v), sizeof(T)); }
+
+    static void _S_write_mino(std::ostream& __os, const std::optional<tetromino>& __t) {
+        _S_write<u8>(__os, __t ? static_cast<u8>(__t->type()) : _S_none);
+        _S_write<u8>(__os, __t ? __t->direction() : 0);
+    }
+
+    static bool _S_read_mino(std::istream& __is, std::optional<tetromino>& __t) {
+        u8 __type, __dir;
+        if (!_S_read(__is, __type) || !_S_read(__is, __dir)) return false;
+
+        if (__type == _S_none) { __t = std::nullopt; return true; }
+        if (__type >= bags::all.size()) return false;
+
+        __t = *bags::all[__type];
+        __t->set_direction(__dir % 4);
+        return true;
+    }
+
+    // The generator as its words of state, instead of the text of `operator<<`.
+    static void _S_write_rand(std::ostream& __os, const std::mt19937& __r) {
+        std::stringstream __ss;
+        __ss << __r;
+
+        std::vector<u32> __words;
+        for (u32 __w; __ss >> __w; ) __words.push_back(__w);
+
+        _S_write<u32>(__os, __words.size());
+        __os.write(reinterpret_cast<const char*>(__words.data()), __words.size() * sizeof(u32));
+    }
+
+    static bool _S_read_rand(std::istream& __is, std::mt19937& __r) {
+        u32 __n;
+        if (!_S_read(__is, __n) || __n > std::mt19937::state_size + 1) return false;
+
+        std::vector<u32> __words(__n);
+        if (!__is.read(reinterpret_cast<char*>(__words.data()), __n * sizeof(u32))) return false;
+
+        std::stringstream __ss;
+        for (u32 __w : __words) __ss << __w << ' ';
+        return (bool)(__ss >> __r);
+    }
+
+    // One byte per cell: block type, and attribute in the high bits.
+    static void _S_write_field(std::ostream& __os, const field& __f) {
+        const auto& __data = __f.data();
+
+        for (u32 __y = 0; __y < __f.height(); ++__y)
+            for (u32 __x = 0; __x < __f.width(); ++__x) {
+                auto [__b, __attr] = __data[__y][__x];
+                _S_write<u8>(__os, static_cast<u8>(__b) | static_cast<u8>(__attr) << 4);
+            }
+    }
+
+    static bool _S_read_field(std::istream& __is, field& __f) {
+        __f.clear();
+
+        for (u32 __y = 0; __y < __f.height(); ++__y)
+            for (u32 __x = 0; __x < __f.width(); ++__x) {
+                u8 __c;
+                if (!_S_read(__is, __c)) return false;
+
+                auto __b = static_cast<block_type>(__c & 0xf);
+                auto __attr = static_cast<block_attribute>(__c >> 4);
+                if (__b != block_type::EMPTY || __attr != block_attribute::NORMAL)
+                    __f.set_cell(__x, __y, __b, __attr);
+            }
+
+        return true;
+    }
+
+    static void _S_write_state(std::ostream& __os, const engine::save_data& __dt) {
+        _S_write_field(__os, __dt._M_field);
+        _S_write_mino(__os, __dt._M_current);
+        _S_write_mino(__os, __dt._M_hold);
+
+        _S_write<u32>(__os, __dt._M_queue.size());
+        for (const auto& __t : __dt._M_queue) _S_write<u8>(__os, static_cast<u8>(__t.type()));
+
+        _S_write_info(__os, __dt._M_attack_info);
+
+        _S_write<u8>(__os, __dt._M_attack_event.has_value());
+        if (__dt._M_attack_event) _S_write_event(__os, *__dt._M_attack_event);
+
+        const bag_save_data& __b = __dt._M_bag_data;
+        _S_write_rand(__os, __b._M_rand);
+        _S_write<u32>(__os, __b._M_queue.size());
+        for (const auto& __t : __b._M_queue) _S_write<u8>(__os, static_cast<u8>(__t.type()));
+        _S_write<u32>(__os, __b._M_current);
+        _S_write<u64>(__os, __b._M_refills);
+
+        _S_write_rand(__os, __dt._M_rand);
+        _S_write_stats(__os, __dt._M_stats);
+        _S_write<u64>(__os, __dt._M_checksum);
+    }
+
+    static void _S_write_info(std::ostream& __os, const attack_info& __a) {
+        _S_write<u8>(__os, static_cast<u8>(__a._M_type));
+        _S_write<i32>(__os, __a._M_combo);
+        _S_write<i32>(__os, __a._M_btb);
+        _S_write<u8>(__os, static_cast<u8>(__a._M_spin));
+        _S_write<u8>(__os, __a._M_pc);
+    }
+
+    static bool _S_read_info(std::istream& __is, attack_info& __a) {
+        u8 __type, __spin, __pc;
+        bool __ok =
+            _S_read(__is, __type) && _S_read(__is, __a._M_combo) && _S_read(__is, __a._M_btb) &&
+            _S_read(__is, __spin) && _S_read(__is, __pc);
+
+        __a._M_type = static_cast<attack_type>(__type);
+        __a._M_spin = static_cast<spin_type>(__spin);
+        __a._M_pc = __pc;
+        return __ok;
+    }
+
+    static void _S_write_stats(std::ostream& __os, const engine::stats_data& __s) {
+        _S_write<u64>(__os, __s._M_lines);
+        _S_write<u64>(__os, __s._M_attack);
+        _S_write<u32>(__os, __s._M_b2b);
+        _S_write<u32>(__os, __s._M_combo);
+        _S_write<u64>(__os, __s._M_place_count);
+        _S_write<u64>(__os, __s._M_input_count);
+        _S_write<u64>(__os, __s._M_topouts);
+    }
+
+    static bool _S_read_queue(std::istream& __is, auto& __out) {
+        u32 __n;
+        if (!_S_read(__is, __n)) return false;
+
+        __out.clear();
+        for (u32 __i = 0; __i < __n; ++__i) {
+            u8 __type;
+            if (!_S_read(__is, __type) || __type >= bags::all.size()) return false;
+            __out.push_back(*bags::all[__type]);
+        }
+
+        return true;
+    }
+
+    // Counters of version 1 are 32 bits, and it has no top outs.
+    static bool _S_read_stats(std::istream& __is, u32 __version, engine::stats_data& __s) {
+        if (__version >= 2)
+            return
+                _S_read(__is, __s._M_lines) && _S_read(__is, __s._M_attack) &&
+                _S_read(__is, __s._M_b2b) && _S_read(__is, __s._M_combo) &&
+                _S_read(__is, __s._M_place_count) && _S_read(__is, __s._M_input_count) &&
+                _S_read(__is, __s._M_topouts);
+
+        u32 __lines = 0, __attack = 0, __place_count = 0, __input_count = 0;
+        bool __ok =
+            _S_read(__is, __lines) && _S_read(__is, __attack) &&
+            _S_read(__is, __s._M_b2b) && _S_read(__is, __s._M_combo) &&
+            _S_read(__is, __place_count) && _S_read(__is, __input_count);
+
+        __s = { __lines, __attack, __s._M_b2b, __s._M_combo, __place_count, __input_count, 0 };
+        return __ok;
+    }
+
+    static bool _S_read_state(std::istream& __is, u32 __version, engine::save_data& __dt) {
+        bag_save_data& __b = __dt._M_bag_data;
+        engine::stats_data& __s = __dt._M_stats;
+        u8 __has_text;
+
+        bool __ok =
+            _S_read_field(__is, __dt._M_field) &&
+            _S_read_mino(__is, __dt._M_current) &&
+            _S_read_mino(__is, __dt._M_hold) &&
+            _S_read_queue(__is, __dt._M_queue) &&
+            _S_read_info(__is, __dt._M_attack_info) &&
+            _S_read(__is, __has_text);
+        if (!__ok) return false;
+
+        __dt._M_attack_event = std::nullopt;
+        if (__has_text && !_S_read_event(__is, __version, __dt._M_attack_event.emplace())) return false;
+
+        return
+            _S_read_rand(__is, __b._M_rand) &&
+            _S_read_queue(__is, __b._M_queue) &&
+            _S_read(__is, __b._M_current) && __b._M_current <= __b._M_queue.size() &&
+            _S_read(__is, __b._M_refills) &&
+            _S_read_rand(__is, __dt._M_rand) &&
+            _S_read_stats(__is, __version, __s) &&
+            _S_read(__is, __dt._M_checksum);
+    }
+
+    static void _S_write_event(std::ostream& __os, const attack_event& __a) {
+        _S_write<u8>(__os, __a._M_type);
+        _S_write<u8>(__os, __a._M_spin);
+        _S_write<u8>(__os, __a._M_mino);
+        _S_write<u8>(__os, __a._M_pc);
+    }
+
+    // The clear whose text is `__text`, as version 1 kept them. The letter
+    // is only in the text of spins, others get 'I'.
+    static std::optional<attack_event> _S_parse_text(std::string_view __text) {
+        for (char __mino : std::string_view("IJLOSTZ"))
+        for (u8 __type = 0; __type < 4; ++__type)
+        for (u8 __spin = 0; __spin < 3; ++__spin)
+        for (bool __pc : { false, true }) {
+            attack_event __a = { __type, __spin, __mino, __pc };
+            if (__a.text().view() == __text) return __a;
+        }
+
+        return std::nullopt;
+    }
+
+    static bool _S_read_event(std::istream& __is, u32 __version, attack_event& __a) {
+        if (__version < 2) {
+            u8 __n;
+            std::array<char, sizeof(attack_text::_M_data)> __buf;
+            if (!_S_read(__is, __n) || __n > __buf.size() || !__is.read(__buf.data(), __n)) return false;
+
+            auto __parsed = _S_parse_text({ __buf.data(), __n });
+            if (!__parsed) return false;
+
+            __a = *__parsed;
+            return true;
+        }
+
+        u8 __mino, __pc;
+        bool __ok =
+            _S_read(__is, __a._M_type) && _S_read(__is, __a._M_spin) &&
+            _S_read(__is, __mino) && _S_read(__is, __pc);
+
+        __a._M_mino = __mino;
+        __a._M_pc = __pc;
+        return __ok && __a._M_type < 4 && __a._M_spin < 3;
+    }
+
+    /*
+     * The rows and generators of the tree, each once, then its nodes in
+     * the order they were pushed, so a parent comes before its children.
+     * Nodes refer to rows, generators and other nodes by index.
+     */
+    static void _S_write_history(std::ostream& __os, const engine::history_type& __h) {
+        using node_id = engine::history_type::node_id;
+        const auto& __t = __h.tree();
+
+        std::vector<node_id> __nodes;
+        for (node_id __i = 0; __i < __t.id_limit(); ++__i)
+            if (__t.contains(__i)) __nodes.push_back(__i);
+        std::sort(__nodes.begin(), __nodes.end(), [&__t] (node_id __a, node_id __b) { return __t.at(__a)._M_serial < __t.at(__b)._M_serial; });
+
+        std::vector<u32> __index(__t.id_limit(), engine::history_type::npos);
+        for (u32 __i = 0; __i < __nodes.size(); ++__i) __index[__nodes[__i]] = __i;
+
+        std::unordered_map<intern_pool::id_type, u32> __rows, __rands;
+        std::vector<intern_pool::id_type> __row_order, __rand_order;
+
+        auto __add = [] (auto& __map, auto& __order, intern_pool::id_type __id) {
+            if (__map.try_emplace(__id, __order.size()).second) __order.push_back(__id);
+        };
+
+        for (node_id __n : __nodes) {
+            const auto& __v = __t.value(__n);
+            for (auto __id : __v._M_rows) __add(__rows, __row_order, __id);
+            __add(__rands, __rand_order, __v._M_bag_rand);
+            __add(__rands, __rand_order, __v._M_rand);
+        }
+
+        _S_write<u32>(__os, __h.row_size());
+        _S_write<u32>(__os, __row_order.size());
+        for (auto __id : __row_order) __os.write(reinterpret_cast<const char*>(__h.row(__id)), __h.row_size());
+
+        _S_write<u32>(__os, __rand_order.size());
+        for (auto __id : __rand_order) _S_write_rand(__os, __h.rand(__id));
+
+        _S_write<u32>(__os, __nodes.size());
+        _S_write<u32>(__os, __nodes.empty() ? 0 : __index[__h.current()]);
+
+        for (node_id __n : __nodes) {
+            const auto& __node = __t.at(__n);
+            const auto& __v = __node._M_value;
+
+            _S_write<u32>(__os, __node._M_parent == __t.npos ? __t.npos : __index[__node._M_parent]);
+            _S_write<u32>(__os, __node._M_redo == __t.npos ? __t.npos : __index[__node._M_redo]);
+
+            for (auto __id : __v._M_rows) _S_write<u32>(__os, __rows[__id]);
+
+            _S_write_mino(__os, __v._M_current);
+            _S_write_mino(__os, __v._M_hold);
+            _S_write<u32>(__os, __v._M_queue.size());
+            for (const auto& __m : __v._M_queue) _S_write<u8>(__os, static_cast<u8>(__m.type()));
+
+            _S_write_info(__os, __v._M_attack_info);
+            _S_write<u8>(__os, __v._M_attack_event.has_value());
+            if (__v._M_attack_event) _S_write_event(__os, *__v._M_attack_event);
+
+            _S_write<u32>(__os, __rands[__v._M_bag_rand]);
+            _S_write<u32>(__os, __v._M_bag_queue.size());
+            for (const auto& __m : __v._M_bag_queue) _S_write<u8>(__os, static_cast<u8>(__m.type()));
+            _S_write<u32>(__os, __v._M_bag_current);
+            _S_write<u64>(__os, __v._M_bag_refills);
+            _S_write<u32>(__os, __rands[__v._M_rand]);
+
+            _S_write_stats(__os, __v._M_stats);
+            _S_write<u64>(__os, __v._M_checksum);
+        }
+    }
+
+    static bool _S_read_history(std::istream& __is, u32 __w, u32 __h, engine::history_type& __out) {
+        using node_id = engine::history_type::node_id;
+        constexpr u32 __none = engine::history_type::npos;
+
+        u32 __row_size, __row_count, __rand_count, __count, __current;
+
+        if (!_S_read(__is, __row_size) || __row_size != __w || !_S_read(__is, __row_count)) return false;
+        // Grown as rows are read, so a damaged count ends with the file instead of allocating.
+        std::vector<u8> __rows;
+        for (u32 __i = 0; __i < __row_count; ++__i) {
+            __rows.resize(__rows.size() + __w);
+            if (!__is.read(reinterpret_cast<char*>(__rows.data() + __i * __w), __w)) return false;
+        }
+
+        if (!_S_read(__is, __rand_count)) return false;
+        std::vector<std::mt19937> __rands;
+        for (u32 __i = 0; __i < __rand_count; ++__i)
+            if (!_S_read_rand(__is, __rands.emplace_back())) return false;
+
+        if (!_S_read(__is, __count) || !_S_read(__is, __current) || (__count && __current >= __count))
+            return false;
+        if (__count > __out.capacity()) __out.set_capacity(__count);
+
+        std::vector<node_id> __ids;
+        std::vector<u32> __redo;
+        engine::save_data __dt;
+        __dt._M_field = field(__w, __h);
+
+        for (u32 __i = 0; __i < __count; ++__i) {
+            u32 __parent, __r;
+            if (!_S_read(__is, __parent) || !_S_read(__is, __r)) return false;
+            if ((__i == 0) != (__parent == __none) || (__i && __parent >= __i)) return false;
+
+            for (u32 __y = 0; __y < __h; ++__y) {
+                u32 __row;
+                if (!_S_read(__is, __row) || __row >= __row_count) return false;
+
+                const u8* __cells = __rows.data() + __row * __w;
+                for (u32 __x = 0; __x < __w; ++__x)
+                    __dt._M_field.set_cell(__x, __y, static_cast<block_type>(__cells[__x] & 0xf), static_cast<block_attribute>(__cells[__x] >> 4));
+            }
+
+            bag_save_data& __b = __dt._M_bag_data;
+            u32 __bag_rand, __rand;
+            u8 __has_event;
+
+            bool __ok =
+                _S_read_mino(__is, __dt._M_current) && __dt._M_current &&
+                _S_read_mino(__is, __dt._M_hold) &&
+                _S_read_queue(__is, __dt._M_queue) &&
+                _S_read_info(__is, __dt._M_attack_info) &&
+                _S_read(__is, __has_event);
+            if (!__ok) return false;
+
+            std::optional<attack_event> __event;
+            if (__has_event && !_S_read_event(__is, _S_version, __event.emplace())) return false;
+
+            __ok =
+                _S_read(__is, __bag_rand) && __bag_rand < __rand_count &&
+                _S_read_queue(__is, __b._M_queue) &&
+                _S_read(__is, __b._M_current) && __b._M_current <= __b._M_queue.size() &&
+                _S_read(__is, __b._M_refills) &&
+                _S_read(__is, __rand) && __rand < __rand_count &&
+                _S_read_stats(__is, _S_version, __dt._M_stats) &&
+                _S_read(__is, __dt._M_checksum);
+            if (!__ok) return false;
+
+            __b._M_rand = __rands[__bag_rand];
+            __dt._M_rand = __rands[__rand];
+
+            if (__i) __out.jump(__ids[__parent]);
+            __out.push(__dt);
+            __out.current_snapshot()._M_attack_event = __event;
+
+            __ids.push_back(__out.current());
+            __redo.push_back(__r);
+        }
+
+        for (u32 __i = 0; __i < __count; ++__i) {
+            if (__redo[__i] == __none) continue;
+            if (__redo[__i] >= __count || __out.tree().at(__ids[__redo[__i]])._M_parent != __ids[__i]) return false;
+            __out.set_redo(__ids[__i], __ids[__redo[__i]]);
+        }
+
+        if (__count) __out.jump(__ids[__current]);
+        return true;
+    }
+
+    // Versions 1 and 2 kept a line of states, each with the clear that left it.
+    static bool _S_read_line(std::istream& __is, u32 __version, u32 __w, u32 __h, engine::history_type& __out) {
+        u32 __count, __current;
+        if (!_S_read(__is, __count) || !_S_read(__is, __current) || (__count && __current >= __count))
+            return false;
+
+        std::vector<engine::history_type::node_id> __ids;
+        std::optional<attack_event> __event;
+        engine::save_data __dt;
+
+        for (u32 __i = 0; __i < __count; ++__i) {
+            __dt._M_field = field(__w, __h);
+            if (!_S_read_state(__is, __version, __dt) || !__dt._M_current) return false;
+
+            __out.push(__dt);
+            __out.current_snapshot()._M_attack_event = std::exchange(__event, __dt._M_attack_event);
+            __ids.push_back(__out.current());
+        }
+
+        if (__count) __out.jump(__ids[__current]);
+        return true;
+    }
+
+    // Flushes the file to the disk, so the rename can not come first.
+    static bool _S_sync(const std::filesystem::path& __path) {
+        int __fd = ::open(__path.c_str(), O_RDONLY);
+        if (__fd < 0) return false;
+
+        bool __ok = ::fsync(__fd) == 0;
+        ::close(__fd);
+        return __ok;
+    }
+
+public:
+    bool save(const std::filesystem::path& __path) const {
+        std::filesystem::path __tmp = __path;
+        __tmp += ".tmp";
+
+        {
+            std::ofstream __os(__tmp, std::ios::binary | std::ios::trunc);
+            if (!__os) return false;
+
+            const field& __f = _M_data._M_state._M_field;
+
+            __os.write(_S_magic.data(), _S_magic.size());
+            _S_write<u32>(__os, _S_version);
+            _S_write<u8>(__os, static_cast<u8>(_M_bag));
+            _S_write<u8>(__os, static_cast<u8>(_M_mode));
+            _S_write<u32>(__os, __f.width());
+            _S_write<u32>(__os, __f.height());
+
+            _S_write_state(__os, _M_data._M_state);
+            _S_write<i32>(__os, _M_data._M_x);
+            _S_write<i32>(__os, _M_data._M_y);
+            _S_write<u8>(__os,
+                _M_data._M_holdable | _M_data._M_over << 1 | _M_data._M_is_last_spin << 2);
+            _S_write<u32>(__os, _M_data._M_kick_index);
+
+            _S_write<u32>(__os, _M_data._M_attack_history.size());
+            for (const auto& __a : _M_data._M_attack_history) _S_write_event(__os, __a);
+
+            _S_write_history(__os, _M_data._M_history);
+
+            if (!__os.flush()) return false;
+        }
+
+        std::error_code __ec;
+        if (!_S_sync(__tmp)) return false;
+        std::filesystem::rename(__tmp, __path, __ec);
+        return !__ec;
+    }
+
+    /**
+     * @brief Reads a session saved for an engine with a field of
+     * `__width` x `__height`, in mode `__mode`.
+     *
+     * @return nullopt if the file is missing, damaged, or for another field
+     * size or mode.
+     */
+    static std::optional<session> load(
+        const std::filesystem::path& __path, u32 __width, u32 __height, game_mode __mode
+    ) {
+        std::ifstream __is(__path, std::ios::binary);
+        if (!__is) return std::nullopt;
+
+        std::array<char, 4> __magic;
+        u32 __version, __w, __h;
+        u8 __bag, __m = static_cast<u8>(user_config{}.game.mode), __flags;
+
+        if (!__is.read(__magic.data(), __magic.size()) || __magic != _S_magic)
+            return std::nullopt;
+        if (!_S_read(__is, __version) || __version == 0 || __version > _S_version)
+            return std::nullopt;
+        if (!_S_read(__is, __bag) || (__version >= 4 && !_S_read(__is, __m)) ||
+            !_S_read(__is, __w) || !_S_read(__is, __h))
+            return std::nullopt;
+        if (__bag > static_cast<u8>(bags::types::bag_classic)) return std::nullopt;
+        if (__m != static_cast<u8>(__mode)) return std::nullopt;
+        if (__w != __width || __h != __height) return std::nullopt;
+
+        session __s;
+        __s._M_bag = static_cast<bags::types>(__bag);
+        __s._M_mode = __mode;
+
+        engine::session_data& __d = __s._M_data;
+        __d._M_state._M_field = field(__w, __h);
+
+        if (!_S_read_state(__is, __version, __d._M_state) || !__d._M_state._M_current) return std::nullopt;
+        if (!_S_read(__is, __d._M_x) || !_S_read(__is, __d._M_y) || !_S_read(__is, __flags) ||
+            !_S_read(__is, __d._M_kick_index))
+            return std::nullopt;
+
+        __d._M_holdable = __flags & 1;
+        __d._M_over = __flags & 2;
+        __d._M_is_last_spin = __flags & 4;
+
+        u32 __count;
+
+        if (!_S_read(__is, __count)) return std::nullopt;
+        for (u32 __i = 0; __i < __count; ++__i) {
+            attack_event __a;
+            if (!_S_read_event(__is, __version, __a)) return std::nullopt;
+            __d._M_attack_history.push_back(__a);
+        }
+
+        bool __ok = __version >= 3
+            ? _S_read_history(__is, __w, __h, __d._M_history)
+            : _S_read_line(__is, __version, __w, __h, __d._M_history);
+        if (!__ok) return std::nullopt;
+
+        return __s;
+    }
+};
@@ -0,0 +1,150 @@
+#ifndef TETRINAL_H
+#define TETRINAL_H
+
+/*
+ * C API of the rules engine, built as the `tetrinal_c` shared library.
+ *
+ * A `ttr_game` is a headless game: apply actions, then read the board,
+ * queue, hold and stats. Nothing is drawn and no terminal is needed.
+ *
+ * The board is read in place. `ttr_board()` returns a pointer to the
+ * bitboard the engine uses for collision, valid until the next call that
+ * changes the game. Row 0 is the bottom of the field, bit x of a row is
+ * column x; a row is `row_bytes` bytes (u16 for the standard 10 x 24 field,
+ * u64 words otherwise).
+ *
+ * Functions never throw; failures are reported by return values.
+ * The undo history is disabled, so UNDO and REDO do nothing.
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TTR_API_VERSION 2
+
+#if defined(__GNUC__)
+#define TTR_API __attribute__((visibility("default")))
+#else
+#define TTR_API
+#endif
+
+typedef struct ttr_game ttr_game;
+
+/* Same order as the control keys of the game. */
+typedef enum ttr_action {
+    TTR_LEFT, TTR_RIGHT, TTR_DOWN,
+    TTR_ROTATE_CW, TTR_ROTATE_CCW, TTR_ROTATE_180,
+    TTR_DROP, TTR_HOLD, TTR_RESET, TTR_QUIT
+} ttr_action;
+
+/* Tetromino ids, TTR_NONE for an empty slot. */
+typedef enum ttr_mino {
+    TTR_I, TTR_J, TTR_L, TTR_O, TTR_S, TTR_T, TTR_Z, TTR_NONE
+} ttr_mino;
+
+/* Rules, see `user_config`. Enum values are the indices of the C++ enums. */
+typedef struct ttr_config {
+    uint32_t width, height, extra_height;
+
+    uint8_t hold_enabled, hold_infinite;
+
+    uint32_t spawn_base_height;
+    uint8_t spawn_extended;
+    uint32_t spawn_extended_height;
+
+    uint8_t inf_soft_drop;
+
+    uint8_t attack_table, kick_table, spin_table, bag;
+    uint8_t enable_pc_b2b;
+    uint32_t next_queue_size;
+} ttr_config;
+
+/* Counters past 2^32 wrap here, see `ttr_stats64`. */
+typedef struct ttr_stats {
+    uint32_t lines, attack, b2b, combo, place_count, input_count;
+} ttr_stats;
+
+/*
+ * The engine's own 64-bit counters, and `topouts` (fields cleared in
+ * marathon). Since API version 2.
+ */
+typedef struct ttr_stats64 {
+    uint64_t lines, attack;
+    uint32_t b2b, combo;
+    uint64_t place_count, input_count, topouts;
+} ttr_stats64;
+
+/* What a drop did, see `attack_info`. */
+typedef struct ttr_drop {
+    uint8_t mino, direction;
+    int32_t x, y;
+
+    uint32_t lines, attack;
+    /* 0 none, 1 mini, 2 spin. */
+    uint8_t spin;
+
+    /* 0 single .. 3 quad. */
+    uint8_t attack_type;
+    int32_t combo, b2b;
+    uint8_t pc;
+
+    /* The next tetromino could not spawn. */
+    uint8_t topped_out;
+} ttr_drop;
+
+typedef struct ttr_board_view {
+    const void* rows;
+    uint32_t width, height;
+    uint32_t row_bytes;
+} ttr_board_view;
+
+TTR_API uint32_t ttr_api_version(void);
+
+/* Fills `cfg` with the defaults of `user_config`. */
+TTR_API void ttr_default_config(ttr_config* cfg);
+
+/* Returns NULL if the config is invalid. `cfg` may be NULL for defaults. */
+TTR_API ttr_game* ttr_create(const ttr_config* cfg, uint32_t seed);
+TTR_API void ttr_destroy(ttr_game* g);
+
+/* Starts a new game with a new seed. */
+TTR_API void ttr_reset(ttr_game* g, uint32_t seed);
+
+/*
+ * Applies an action.
+ *
+ * Returns 1 if it dropped a tetromino (and fills `out` if not NULL),
+ * 0 if not, and -1 if the game is over or the action is invalid.
+ */
+TTR_API int ttr_apply(ttr_game* g, int action, ttr_drop* out);
+
+TTR_API int ttr_is_over(const ttr_game* g);
+
+/* Current tetromino, its position and direction. Any out pointer may be NULL. */
+TTR_API int ttr_current(const ttr_game* g, int32_t* x, int32_t* y, uint32_t* direction);
+TTR_API int ttr_hold(const ttr_game* g);
+TTR_API int ttr_holdable(const ttr_game* g);
+
+/* Copies up to `cap` queued tetrominoes into `out`, returns the queue size. */
+TTR_API uint32_t ttr_queue(const ttr_game* g, uint8_t* out, uint32_t cap);
+
+TTR_API void ttr_stats_get(const ttr_game* g, ttr_stats* out);
+TTR_API void ttr_stats64_get(const ttr_game* g, ttr_stats64* out);
+
+/*
+ * Checksum of the whole state after the last placement, see
+ * `engine::checksum()`. Equal seeds and actions give equal checksums.
+ */
+TTR_API uint64_t ttr_checksum(const ttr_game* g);
+
+/* Zero copy view of the bitboard, see the top of this file. */
+TTR_API void ttr_board(const ttr_game* g, ttr_board_view* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
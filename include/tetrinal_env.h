@@ -0,0 +1,127 @@
+#ifndef TETRINAL_ENV_H
+#define TETRINAL_ENV_H
+
+/*
+ * Protocol of `tetrinal_server`, a local environment server for learners
+ * in other processes, in the usual reset/step style.
+ *
+ * An action is a placement: the index of one of the placements listed in
+ * the current observation (hold first or not, where the tetromino lands).
+ * The server plays its inputs and the drop, and the reward is the attack
+ * of that drop.
+ *
+ * Observations are written into shared memory, `/dev/shm/tetrinal-NAME`
+ * (`shm_open("/tetrinal-NAME")`): a `ttr_env_header`, then `slots`
+ * `ttr_env_slot`s per environment, environment `e` slot `s` at
+ *
+ *   data_offset + (e * slots + s) * slot_size
+ *
+ * Each environment writes its observations round-robin into its slots,
+ * so an observation is read in place and stays valid until `slots - 1`
+ * more steps (or resets) of the same environment.
+ *
+ * Control goes through the SOCK_SEQPACKET unix socket
+ * `/tmp/tetrinal-NAME.sock`: each `ttr_env_request` datagram is answered
+ * by one `ttr_env_reply` naming the slot the new observation is in.
+ *
+ * All values are in host byte order, both sides are on the same machine.
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TTR_ENV_MAGIC 0x56455454u /* "TTEV" */
+#define TTR_ENV_VERSION 1
+
+/* Standard 10 x (20 + 4) field. */
+#define TTR_ENV_HEIGHT 24
+#define TTR_ENV_QUEUE 5
+#define TTR_ENV_MAX_PLACEMENTS 256
+
+typedef struct ttr_env_header {
+    uint32_t magic, version;
+    uint32_t envs, slots;
+    uint32_t slot_size;
+    uint32_t data_offset;
+} ttr_env_header;
+
+typedef struct ttr_env_placement {
+    /* 1 if the tetromino in hold (or the next one) is swapped in first. */
+    uint8_t hold;
+    /* Tetromino (`ttr_mino`), its direction and final position. */
+    uint8_t mino, direction;
+    int8_t x, y;
+    /* The last move is a rotation, the drop may be a spin. */
+    uint8_t rotated;
+    uint8_t inputs;
+    uint8_t reserved;
+} ttr_env_placement;
+
+typedef struct ttr_env_slot {
+    /* Steps of this environment since its last reset. */
+    uint64_t step;
+
+    /* Board, row 0 at the bottom, bit x is column x. */
+    uint16_t rows[TTR_ENV_HEIGHT];
+
+    /* `ttr_mino` ids, TTR_NONE for an empty hold. */
+    uint8_t current, hold, holdable;
+    uint8_t queue[TTR_ENV_QUEUE];
+
+    /* The game topped out, only a reset is accepted. */
+    uint8_t done;
+
+    /* Outcome of the step that produced this observation (0 after a reset). */
+    uint8_t lines;
+    /* 0 none, 1 mini, 2 spin. */
+    uint8_t spin;
+    /* 0 single .. 3 quad. */
+    uint8_t attack_type;
+    uint8_t pc;
+    int32_t reward;
+
+    /* Current combo and back-to-back, see `attack_info` (-1 for no b2b). */
+    int32_t combo, b2b;
+
+    /* Actions of the next step. */
+    uint32_t placement_count;
+    ttr_env_placement placements[TTR_ENV_MAX_PLACEMENTS];
+} ttr_env_slot;
+
+typedef enum ttr_env_op {
+    /* Starts a new game, `arg` is the seed. */
+    TTR_ENV_RESET,
+    /* Plays placement `arg` of the current observation. */
+    TTR_ENV_STEP,
+    /* Writes the current observation again, e.g. after connecting. */
+    TTR_ENV_OBSERVE
+} ttr_env_op;
+
+typedef struct ttr_env_request {
+    uint32_t op;
+    uint32_t env;
+    uint32_t arg;
+} ttr_env_request;
+
+typedef enum ttr_env_status {
+    TTR_ENV_OK = 0,
+    TTR_ENV_BAD_REQUEST = -1,
+    TTR_ENV_BAD_ENV = -2,
+    TTR_ENV_BAD_ACTION = -3,
+    /* The game is over, reset it first. */
+    TTR_ENV_DONE = -4
+} ttr_env_status;
+
+typedef struct ttr_env_reply {
+    int32_t status;
+    uint32_t slot;
+} ttr_env_reply;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+
+#include <lib/intdef>
+
+/**
+ * @brief Heap allocations counted by a replaced global `operator new`.
+ *
+ * Opt-in: `-DALLOC_COUNTER=ON` links `src/util/alloc_counter.cpp` into the
+ * game and defines `ALLOC_COUNTER_ENABLED`. Without it `enabled` is false
+ * and every count is 0, at no cost.
+ *
+ * Counts are process-wide; the difference of two `now()` is what was
+ * allocated in between, e.g. in a frame or by an input.
+ */
+namespace alloc_counter {
+
+struct counts {
+    u64 _M_count = 0;
+    u64 _M_bytes = 0;
+
+    counts operator-(const counts& __c) const
+    { return { _M_count - __c._M_count, _M_bytes - __c._M_bytes }; }
+};
+
+#ifdef ALLOC_COUNTER_ENABLED
+
+inline constexpr bool enabled = true;
+
+// Defined with the replaced `operator new`.
+extern std::atomic<u64> allocations, allocated_bytes;
+
+inline counts now() {
+    return {
+        allocations.load(std::memory_order_relaxed),
+        allocated_bytes.load(std::memory_order_relaxed)
+    };
+}
+
+#else
+
+inline constexpr bool enabled = false;
+
+inline counts now() { return {}; }
+
+#endif
+
+}
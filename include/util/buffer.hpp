@@ -104,8 +104,8 @@ public:
     public:
         using difference_type = buffer::difference_type;
         using value_type = buffer::value_type;
-        using reference = const buffer::reference;
-        using pointer = const buffer::pointer;
+        using reference = buffer::const_reference;
+        using pointer = const T*;
         using iterator_category = std::random_access_iterator_tag;
 
         const_iterator() = default;
@@ -171,11 +171,11 @@ public:
         difference_type operator-(const const_iterator& other) const
         { return _M_index - other._M_index; }
 
-        reference operator*()
+        reference operator*() const
         { return _M_buf->_M_data[_M_index % _M_buf->capacity()]; }
-        pointer operator->()
+        pointer operator->() const
         { return &_M_buf->_M_data[_M_index % _M_buf->capacity()]; }
-        reference operator[](difference_type n)
+        reference operator[](difference_type n) const
         { return _M_buf->_M_data[(_M_index + n) % _M_buf->capacity()]; }
     };
 
@@ -183,6 +183,8 @@ public:
     constexpr buffer() = default;
     constexpr buffer(const buffer&) = default;
     constexpr buffer(buffer&&) = default;
+    constexpr buffer& operator=(const buffer&) = default;
+    constexpr buffer& operator=(buffer&&) = default;
 
     /**
      * @brief Constructs a buffer with the given data and initial state.
@@ -251,6 +253,26 @@ public:
         if (_M_current == _M_last && size() == N) _M_start++;
     }
 
+    /**
+     * @brief Adds a new value to the buffer, to be assigned in place.
+     * 
+     * Same as `push()`, but returns the slot of the new value, which still
+     * holds the value that was stored there before (the oldest one if the
+     * buffer is full). Assigning into it reuses the storage of that value,
+     * where `push()` replaces it.
+     * 
+     * All iterators (including the `end()` iterator) and
+     * all references to the elements are invalidated.
+     */
+    reference push_slot() {
+        _M_current++;
+        _M_last = _M_current;
+
+        if (_M_current == _M_last && size() == N) _M_start++;
+
+        return _M_data[_M_current % N];
+    }
+
     /**
      * @brief Removes the last value from the buffer.
      * 
@@ -362,10 +384,17 @@ public:
     const_iterator cbegin() const { return const_iterator(this, _M_start); }
     const_iterator cend() const { return const_iterator(this, _M_last + 1); }
 
-#ifdef DEBUG
+    /**
+     * @brief Positions of the current, oldest and newest elements.
+     *
+     * Elements are in [start, last], current is -1 if nothing was pushed.
+     * Positions only grow, `% capacity()` is the slot of an element.
+     */
     size_type current_index() const noexcept { return _M_current; }
     size_type start_index() const noexcept { return _M_start; }
     size_type last_index() const noexcept { return _M_last; }
+
+#ifdef DEBUG
     const std::array<T, N>& data() const noexcept { return _M_data; }
 #endif
 };
\ No newline at end of file
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <deque>
+#include <string>
+
+#include <fstream>
+#include <filesystem>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include <cstring>
+#include <stdexcept>
+
+#include <lib/intdef>
+
+/**
+ * @brief Writes fixed-width records column by column, on a background thread.
+ *
+ * Records are gathered in chunks, each column of a chunk is contiguous.
+ * A full chunk is handed to the writer thread and the producer moves on to
+ * a free one. Chunks come from a pool allocated once, so memory is bounded by
+ * `pool size * chunk size`; the producer waits only if every chunk is still
+ * being written, and that time is reported by `stall_time()`.
+ *
+ * File layout (little endian):
+ *   "TTRX", u32 version, u32 column count,
+ *   columns { u8 name length, name, u32 width in bytes },
+ *   chunks  { "CHNK", u32 record count, column data in column order },
+ *   "TEND", u64 total record count.
+ */
+class chunk_writer {
+public:
+    struct column {
+        std::string _M_name;
+        u32 _M_width;
+    };
+
+    using clock_type = std::chrono::steady_clock;
+
+private:
+    struct chunk {
+        std::vector<u8> _M_data;
+        u32 _M_count = 0;
+    };
+
+    static constexpr std::array<char, 4> _S_magic = { 'T', 'T', 'R', 'X' };
+    static constexpr u32 _S_version = 1;
+
+    std::ofstream _M_os;
+
+    std::vector<column> _M_columns;
+    // Offset of each column in a chunk.
+    std::vector<std::size_t> _M_offsets;
+    u32 _M_chunk_records;
+
+    std::vector<chunk> _M_pool;
+    // Chunks the producer may take, and chunks waiting to be written.
+    std::deque<chunk*> _M_free, _M_full;
+    chunk* _M_current = nullptr;
+
+    std::mutex _M_mutex;
+    std::condition_variable _M_cv;
+    bool _M_closing = false;
+    std::thread _M_thread;
+
+    // A write failed (full disk, I/O error): the file is incomplete.
+    bool _M_failed = false;
+
+    u64 _M_records = 0, _M_chunks = 0;
+    clock_type::duration _M_stall { 0 };
+
+    template <typename T>
+    void _M_write(T __v)
+    { _M_os.write(reinterpret_cast<const char*>(&__v), sizeof(T)); }
+
+    void _M_write_chunk(const chunk& __c) {
+        _M_os.write("CHNK", 4);
+        _M_write<u32>(__c._M_count);
+
+        for (u32 __i = 0; __i < _M_columns.size(); ++__i)
+            _M_os.write(
+                reinterpret_cast<const char*>(__c._M_data.data() + _M_offsets[__i]),
+                (std::streamsize)__c._M_count * _M_columns[__i]._M_width
+            );
+    }
+
+    void _M_run() {
+        std::unique_lock __lock(_M_mutex);
+
+        while (true) {
+            _M_cv.wait(__lock, [this] { return _M_closing || !_M_full.empty(); });
+            if (_M_full.empty()) break;
+
+            chunk* __c = _M_full.front();
+            _M_full.pop_front();
+
+            __lock.unlock();
+            _M_write_chunk(*__c);
+            bool __failed = !_M_os;
+            __lock.lock();
+
+            _M_failed = _M_failed || __failed;
+
+            __c->_M_count = 0;
+            _M_free.push_back(__c);
+            _M_cv.notify_all();
+        }
+    }
+
+    // Hands the current chunk to the writer thread and takes a free one.
+    void _M_flush() {
+        std::unique_lock __lock(_M_mutex);
+
+        if (_M_current->_M_count > 0) {
+            _M_full.push_back(_M_current);
+            _M_chunks++;
+            _M_cv.notify_all();
+        } else _M_free.push_back(_M_current);
+
+        if (_M_free.empty()) {
+            auto __begin = clock_type::now();
+            _M_cv.wait(__lock, [this] { return !_M_free.empty(); });
+            _M_stall += clock_type::now() - __begin;
+        }
+
+        _M_current = _M_free.front();
+        _M_free.pop_front();
+    }
+
+public:
+    /**
+     * @param __chunk_records Records per chunk.
+     * @param __pool_size Chunks allocated, at least 2.
+     */
+    chunk_writer(
+        const std::filesystem::path& __path, std::vector<column> __columns,
+        u32 __chunk_records = 1 << 16, u32 __pool_size = 4
+    ) : _M_os(__path, std::ios::binary), _M_columns(std::move(__columns)),
+        _M_chunk_records(__chunk_records), _M_pool(std::max(__pool_size, 2u)) {
+        if (!_M_os)
+            throw std::runtime_error("Cannot open " + __path.string());
+
+        std::size_t __size = 0;
+        for (const auto& __c : _M_columns) {
+            _M_offsets.push_back(__size);
+            __size += (std::size_t)__c._M_width * __chunk_records;
+        }
+
+        for (auto& __c : _M_pool) {
+            __c._M_data.assign(__size, 0);
+            _M_free.push_back(&__c);
+        }
+
+        _M_current = _M_free.front();
+        _M_free.pop_front();
+
+        _M_os.write(_S_magic.data(), _S_magic.size());
+        _M_write<u32>(_S_version);
+        _M_write<u32>(_M_columns.size());
+        for (const auto& __c : _M_columns) {
+            _M_write<u8>(__c._M_name.size());
+            _M_os.write(__c._M_name.data(), __c._M_name.size());
+            _M_write<u32>(__c._M_width);
+        }
+
+        _M_thread = std::thread(&chunk_writer::_M_run, this);
+    }
+
+    chunk_writer(const chunk_writer&) = delete;
+    chunk_writer& operator=(const chunk_writer&) = delete;
+
+    ~chunk_writer() { close(); }
+
+    /**
+     * @brief Sets column `__col` of the record being built.
+     *
+     * `sizeof(T)` must be the width of the column.
+     */
+    template <typename T>
+    void put(u32 __col, const T& __v) {
+        std::memcpy(
+            _M_current->_M_data.data() + _M_offsets[__col] +
+                (std::size_t)_M_current->_M_count * sizeof(T),
+            &__v, sizeof(T)
+        );
+    }
+
+    // Raw storage of column `__col` of the record being built.
+    u8* slot(u32 __col) {
+        return _M_current->_M_data.data() + _M_offsets[__col] +
+            (std::size_t)_M_current->_M_count * _M_columns[__col]._M_width;
+    }
+
+    // Finishes the record being built.
+    void commit() {
+        _M_records++;
+        if (++_M_current->_M_count == _M_chunk_records) _M_flush();
+    }
+
+    /**
+     * @brief Writes what is left and closes the file. Called by the destructor.
+     *
+     * @return false if a write failed, the file is then incomplete.
+     */
+    bool close() {
+        if (!_M_thread.joinable()) return !_M_failed;
+
+        _M_flush();
+
+        {
+            std::lock_guard __lock(_M_mutex);
+            _M_closing = true;
+        }
+        _M_cv.notify_all();
+        _M_thread.join();
+
+        _M_os.write("TEND", 4);
+        _M_write<u64>(_M_records);
+        _M_os.close();
+
+        // Buffered data is written by `close()`, which can fail too.
+        if (!_M_os) _M_failed = true;
+        return !_M_failed;
+    }
+
+    u64 records() const { return _M_records; }
+    u64 chunks() const { return _M_chunks; }
+    // Time the producer spent waiting for a free chunk.
+    clock_type::duration stall_time() const { return _M_stall; }
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstring>
+
+#include <lib/intdef>
+
+/**
+ * @brief Incremental 64-bit hash of plain values, for state checksums.
+ *
+ * A multiply-xorshift mix per 64-bit word, fast enough to run after every
+ * placement. It detects accidental differences, it is not cryptographic.
+ */
+class state_hash {
+    static constexpr u64 _S_mul = 0x9E3779B97F4A7C15ull;
+
+    u64 _M_value;
+
+    static constexpr u64 _S_mix(u64 __x) {
+        __x *= _S_mul;
+        return __x ^ (__x >> 29);
+    }
+
+public:
+    constexpr explicit state_hash(u64 __seed = 0) : _M_value(__seed) { }
+
+    constexpr state_hash& add(u64 __v) {
+        _M_value = _S_mix(_M_value ^ __v);
+        return *this;
+    }
+
+    state_hash& add_bytes(const void* __p, std::size_t __n) {
+        const u8* __b = static_cast<const u8*>(__p);
+
+        for (; __n >= 8; __n -= 8, __b += 8) {
+            u64 __v;
+            std::memcpy(&__v, __b, 8);
+            add(__v);
+        }
+
+        if (__n > 0) {
+            u64 __v = 0;
+            std::memcpy(&__v, __b, __n);
+            add(__v ^ ((u64)__n << 56));
+        }
+
+        return *this;
+    }
+
+    constexpr u64 value() const { return _S_mix(_M_value); }
+};
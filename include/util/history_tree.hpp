@@ -0,0 +1,272 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include <lib/intdef>
+
+/**
+ * @brief Undo history as a tree: every state pushed is a node, a child of
+ * the state that was current.
+ *
+ * `undo()` goes to the parent and `redo()` to the child it came from, or
+ * the one created last, so after an undo a push starts a new branch next
+ * to the line undone instead of dropping it. `jump()` goes to any node.
+ * Nodes are also numbered in the order they were pushed, `earlier()` and
+ * `later()` step through every node in that order whatever the branch.
+ *
+ * Holds at most `capacity()` nodes. A push into a full tree drops the
+ * root, with the branches that leave it for other lines than the current
+ * one; with the root current, its oldest branch. The values removed are
+ * given to the `release` function of the push, for what they hold
+ * elsewhere. Nodes are linked by ids and their storage is reused, so a
+ * full tree does not allocate.
+ *
+ * Nodes are addressed by ids, which a copy of the tree keeps.
+ */
+template <typename T>
+class history_tree {
+public:
+    using node_id = u32;
+    static constexpr node_id npos = -1;
+
+    struct node {
+        node_id _M_parent = npos;
+        // Children, oldest first, linked through their siblings.
+        node_id _M_first = npos, _M_last = npos;
+        node_id _M_prev = npos, _M_next = npos;
+        // Where `redo()` goes from here.
+        node_id _M_redo = npos;
+        // Order of the push, from 1.
+        u64 _M_serial = 0;
+
+        T _M_value;
+    };
+
+private:
+    std::vector<node> _M_nodes;
+    // Free nodes have serial 0, and are chained through their parent.
+    node_id _M_free = npos;
+    node_id _M_root = npos, _M_current = npos;
+
+    std::size_t _M_size = 0, _M_capacity;
+    u64 _M_serial = 0;
+
+    // Nodes of a subtree being removed.
+    std::vector<node_id> _M_stack;
+
+    void _M_unlink(node_id __parent, node_id __child) {
+        node& __p = _M_nodes[__parent];
+        node& __c = _M_nodes[__child];
+
+        (__c._M_prev == npos ? __p._M_first : _M_nodes[__c._M_prev]._M_next) = __c._M_next;
+        (__c._M_next == npos ? __p._M_last : _M_nodes[__c._M_next]._M_prev) = __c._M_prev;
+        __c._M_prev = __c._M_next = npos;
+
+        if (__p._M_redo == __child) __p._M_redo = __p._M_last;
+    }
+
+    template <typename _Release>
+    void _M_free_node(node_id __id, _Release& __release) {
+        node& __n = _M_nodes[__id];
+
+        __release(__n._M_value);
+        __n._M_first = __n._M_last = __n._M_prev = __n._M_next = npos;
+        __n._M_redo = npos;
+        __n._M_serial = 0;
+        __n._M_parent = _M_free;
+        _M_free = __id;
+        _M_size--;
+    }
+
+    template <typename _Release>
+    void _M_remove_subtree(node_id __id, _Release& __release) {
+        if (_M_nodes[__id]._M_parent != npos) _M_unlink(_M_nodes[__id]._M_parent, __id);
+
+        _M_stack.push_back(__id);
+        while (!_M_stack.empty()) {
+            node_id __n = _M_stack.back();
+            _M_stack.pop_back();
+
+            for (node_id __c = _M_nodes[__n]._M_first; __c != npos; __c = _M_nodes[__c]._M_next) _M_stack.push_back(__c);
+            _M_free_node(__n, __release);
+        }
+    }
+
+    // Makes room for one more node, never removing the current one.
+    template <typename _Release>
+    void _M_evict(_Release& __release) {
+        node& __root = _M_nodes[_M_root];
+
+        if (_M_root == _M_current) {
+            _M_remove_subtree(__root._M_first, __release);
+            return;
+        }
+
+        // The child of the root towards the current node stays, as the root.
+        node_id __keep = _M_current;
+        while (_M_nodes[__keep]._M_parent != _M_root) __keep = _M_nodes[__keep]._M_parent;
+
+        while (__root._M_first != __root._M_last)
+            _M_remove_subtree(__root._M_first == __keep ? __root._M_last : __root._M_first, __release);
+
+        node_id __old = _M_root;
+        _M_nodes[__keep]._M_parent = npos;
+        _M_root = __keep;
+        _M_free_node(__old, __release);
+    }
+
+public:
+    explicit history_tree(std::size_t __capacity) : _M_capacity(std::max<std::size_t>(__capacity, 2)) { }
+
+    std::size_t size() const { return _M_size; }
+    std::size_t capacity() const { return _M_capacity; }
+    bool empty() const { return _M_size == 0; }
+
+    // Removes nodes as a push into a full tree does, until at most `__capacity` are left.
+    template <typename _Release>
+    void set_capacity(std::size_t __capacity, _Release&& __release) {
+        _M_capacity = std::max<std::size_t>(__capacity, 2);
+        while (_M_size > _M_capacity) _M_evict(__release);
+    }
+
+    node_id root() const { return _M_root; }
+    node_id current() const { return _M_current; }
+
+    // Whether `__id` is a node of the tree.
+    bool contains(node_id __id) const { return __id < _M_nodes.size() && _M_nodes[__id]._M_serial != 0; }
+
+    const node& at(node_id __id) const { return _M_nodes[__id]; }
+    T& value(node_id __id) { return _M_nodes[__id]._M_value; }
+    const T& value(node_id __id) const { return _M_nodes[__id]._M_value; }
+
+    // Ids are below it, some may be free (see `contains()`).
+    node_id id_limit() const { return _M_nodes.size(); }
+
+    /**
+     * @brief Adds a node as the last child of the current one, or as the
+     * root if the tree is empty, and makes it current.
+     *
+     * @param __release Called with the value of every node removed to make room.
+     * @return The value of the new node, to assign. It holds what a removed
+     * node held, whose storage it can reuse.
+     */
+    template <typename _Release>
+    T& push(_Release&& __release) {
+        if (_M_nodes.empty()) {
+            _M_nodes.reserve(_M_capacity);
+            _M_stack.reserve(_M_capacity);
+        }
+
+        while (_M_size >= _M_capacity) _M_evict(__release);
+
+        node_id __id = _M_free;
+        if (__id != npos) _M_free = _M_nodes[__id]._M_parent;
+        else {
+            __id = _M_nodes.size();
+            _M_nodes.emplace_back();
+        }
+
+        node& __n = _M_nodes[__id];
+        __n._M_parent = _M_current;
+        __n._M_serial = ++_M_serial;
+        _M_size++;
+
+        if (_M_current == npos) _M_root = __id;
+        else {
+            node& __p = _M_nodes[_M_current];
+            __n._M_prev = __p._M_last;
+            (__p._M_last == npos ? __p._M_first : _M_nodes[__p._M_last]._M_next) = __id;
+            __p._M_last = __p._M_redo = __id;
+        }
+
+        _M_current = __id;
+        return __n._M_value;
+    }
+
+    bool undo() {
+        if (_M_current == npos || _M_nodes[_M_current]._M_parent == npos) return false;
+
+        _M_current = _M_nodes[_M_current]._M_parent;
+        return true;
+    }
+
+    bool redo() {
+        if (_M_current == npos || _M_nodes[_M_current]._M_redo == npos) return false;
+
+        _M_current = _M_nodes[_M_current]._M_redo;
+        return true;
+    }
+
+    // Makes `__id` current, and the line to it the one `redo()` follows.
+    bool jump(node_id __id) {
+        if (!contains(__id)) return false;
+
+        for (node_id __n = __id; _M_nodes[__n]._M_parent != npos; __n = _M_nodes[__n]._M_parent)
+            _M_nodes[_M_nodes[__n]._M_parent]._M_redo = __n;
+
+        _M_current = __id;
+        return true;
+    }
+
+    // Node pushed right before / after `__id`, npos if none is left.
+    node_id earlier(node_id __id) const {
+        node_id __best = npos;
+        for (node_id __i = 0; __i < _M_nodes.size(); ++__i) {
+            u64 __s = _M_nodes[__i]._M_serial;
+            if (__s != 0 && __s < _M_nodes[__id]._M_serial && (__best == npos || __s > _M_nodes[__best]._M_serial)) __best = __i;
+        }
+        return __best;
+    }
+
+    node_id later(node_id __id) const {
+        node_id __best = npos;
+        for (node_id __i = 0; __i < _M_nodes.size(); ++__i) {
+            u64 __s = _M_nodes[__i]._M_serial;
+            if (__s > _M_nodes[__id]._M_serial && (__best == npos || __s < _M_nodes[__best]._M_serial)) __best = __i;
+        }
+        return __best;
+    }
+
+    // Last node that `__a` and `__b` both descend from, or are.
+    node_id common_ancestor(node_id __a, node_id __b) const {
+        auto __depth = [this] (node_id __n) {
+            u32 __d = 0;
+            for (; _M_nodes[__n]._M_parent != npos; __n = _M_nodes[__n]._M_parent) __d++;
+            return __d;
+        };
+
+        u32 __da = __depth(__a), __db = __depth(__b);
+        for (; __da > __db; --__da) __a = _M_nodes[__a]._M_parent;
+        for (; __db > __da; --__db) __b = _M_nodes[__b]._M_parent;
+
+        while (__a != __b) {
+            __a = _M_nodes[__a]._M_parent;
+            __b = _M_nodes[__b]._M_parent;
+        }
+
+        return __a;
+    }
+
+    // Sets where `redo()` goes from `__id`, one of its children.
+    void set_redo(node_id __id, node_id __child) { _M_nodes[__id]._M_redo = __child; }
+
+    // Removes every node, keeping the storage.
+    template <typename _Release>
+    void clear(_Release&& __release) {
+        for (node& __n : _M_nodes)
+            if (__n._M_serial != 0) __release(__n._M_value);
+
+        for (node_id __i = 0; __i < _M_nodes.size(); ++__i) {
+            node& __n = _M_nodes[__i];
+            __n._M_first = __n._M_last = __n._M_prev = __n._M_next = npos;
+            __n._M_redo = npos;
+            __n._M_serial = 0;
+            __n._M_parent = __i + 1 < _M_nodes.size() ? __i + 1 : npos;
+        }
+
+        _M_free = _M_nodes.empty() ? npos : 0;
+        _M_root = _M_current = npos;
+        _M_size = 0;
+    }
+};
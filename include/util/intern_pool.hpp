@@ -0,0 +1,141 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
+
+#include <lib/intdef>
+
+#include <util/hash.hpp>
+
+/**
+ * @brief Hash-consed, reference counted values of a fixed number of bytes.
+ *
+ * `intern()` returns the id of the value equal to the bytes given, adding
+ * it if there is none, so equal values are stored once however many
+ * holders share them. Values never change once added: a holder that wants
+ * another value interns it. An id stays valid until every reference taken
+ * with `intern()` or `retain()` is given back with `release()`.
+ *
+ * Values live in one array, and ids of released values are reused, so
+ * once the pool has held as many values as it will hold at once it no
+ * longer allocates.
+ */
+class intern_pool {
+public:
+    using id_type = u32;
+    static constexpr id_type npos = -1;
+
+private:
+    struct entry {
+        u64 _M_hash = 0;
+        u32 _M_refs = 0;
+        // Next in the bucket while held, next free one once released.
+        id_type _M_next = npos;
+    };
+
+    std::size_t _M_size = 0;
+    std::vector<std::byte> _M_data;
+    std::vector<entry> _M_entries;
+    // Chains of entries by hash, a power of 2 of them.
+    std::vector<id_type> _M_buckets;
+    id_type _M_free = npos;
+    std::size_t _M_held = 0;
+
+    static u64 _S_hash(const void* __p, std::size_t __n) { return state_hash(__n).add_bytes(__p, __n).value(); }
+
+    id_type& _M_bucket(u64 __hash) { return _M_buckets[__hash & (_M_buckets.size() - 1)]; }
+
+    void _M_rehash(std::size_t __count) {
+        _M_buckets.assign(__count, npos);
+
+        for (id_type __i = 0; __i < _M_entries.size(); ++__i) {
+            entry& __e = _M_entries[__i];
+            if (__e._M_refs == 0) continue;
+
+            id_type& __b = _M_bucket(__e._M_hash);
+            __e._M_next = __b;
+            __b = __i;
+        }
+    }
+
+public:
+    explicit intern_pool(std::size_t __size = 0) : _M_size(__size) { }
+
+    // Bytes of a value.
+    std::size_t value_size() const { return _M_size; }
+    // Values held.
+    std::size_t size() const { return _M_held; }
+
+    // Storage for `__n` values, so that holding that many does not allocate.
+    void reserve(std::size_t __n) {
+        _M_data.reserve(__n * _M_size);
+        _M_entries.reserve(__n);
+
+        std::size_t __count = 16;
+        while (__count < __n) __count *= 2;
+        if (__count > _M_buckets.size()) _M_rehash(__count);
+    }
+
+    const std::byte* data(id_type __id) const { return _M_data.data() + __id * _M_size; }
+
+    bool equals(id_type __id, const void* __p) const { return std::memcmp(data(__id), __p, _M_size) == 0; }
+
+    // Id of the value of the `value_size()` bytes at `__p`, one more reference to it.
+    id_type intern(const void* __p) {
+        u64 __hash = _S_hash(__p, _M_size);
+
+        if (!_M_buckets.empty())
+            for (id_type __i = _M_bucket(__hash); __i != npos; __i = _M_entries[__i]._M_next)
+                if (_M_entries[__i]._M_hash == __hash && equals(__i, __p)) return retain(__i);
+
+        id_type __id = _M_free;
+        if (__id != npos) _M_free = _M_entries[__id]._M_next;
+        else {
+            __id = _M_entries.size();
+            _M_entries.emplace_back();
+            _M_data.resize(_M_data.size() + _M_size);
+        }
+
+        std::memcpy(_M_data.data() + __id * _M_size, __p, _M_size);
+
+        if (++_M_held > _M_buckets.size()) _M_rehash(std::max<std::size_t>(16, _M_buckets.size() * 2));
+
+        entry& __e = _M_entries[__id];
+        id_type& __b = _M_bucket(__hash);
+        __e = { __hash, 1, __b };
+        __b = __id;
+
+        return __id;
+    }
+
+    // One more reference to a value held.
+    id_type retain(id_type __id) {
+        _M_entries[__id]._M_refs++;
+        return __id;
+    }
+
+    // Gives back a reference, the value is removed with the last one.
+    void release(id_type __id) {
+        entry& __e = _M_entries[__id];
+        if (--__e._M_refs > 0) return;
+
+        id_type* __link = &_M_bucket(__e._M_hash);
+        while (*__link != __id) __link = &_M_entries[*__link]._M_next;
+        *__link = __e._M_next;
+
+        __e._M_next = _M_free;
+        _M_free = __id;
+        _M_held--;
+    }
+
+    // Removes every value, keeping the storage; ids held are no longer valid.
+    void clear() {
+        _M_data.clear();
+        _M_entries.clear();
+        std::fill(_M_buckets.begin(), _M_buckets.end(), npos);
+        _M_free = npos;
+        _M_held = 0;
+    }
+};
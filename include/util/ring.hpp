@@ -0,0 +1,102 @@
+#pragma once
+
+#include <array>
+#include <iterator>
+
+#include <lib/intdef>
+
+/**
+ * @brief Fixed-capacity FIFO of the last `N` values, stored in place.
+ *
+ * `push_back()` overwrites the oldest value once the ring is full, so a
+ * ring never allocates and holds at most `N` values. Index 0 is the
+ * oldest value kept, `size() - 1` (`back()`) the newest.
+ *
+ * `total()` counts the values pushed since the last `clear()` and not
+ * popped, including the ones already overwritten.
+ */
+template <typename T, std::size_t N>
+class ring {
+    static_assert(N > 0);
+
+public:
+    using value_type = T;
+    using size_type = std::size_t;
+    using const_reference = const T&;
+
+    class const_iterator {
+    public:
+        using difference_type = std::ptrdiff_t;
+        using value_type = ring::value_type;
+        using reference = const T&;
+        using pointer = const T*;
+        using iterator_category = std::random_access_iterator_tag;
+
+        const_iterator() = default;
+        const_iterator(const ring* __r, size_type __i) : _M_ring(__r), _M_index(__i) { }
+
+    private:
+        const ring* _M_ring = nullptr;
+        size_type _M_index = 0;
+
+    public:
+        bool operator==(const const_iterator& __o) const { return _M_index == __o._M_index; }
+        auto operator<=>(const const_iterator& __o) const { return _M_index <=> __o._M_index; }
+
+        const_iterator& operator++() { _M_index++; return *this; }
+        const_iterator operator++(int) { const_iterator __t = *this; ++*this; return __t; }
+        const_iterator& operator--() { _M_index--; return *this; }
+        const_iterator operator--(int) { const_iterator __t = *this; --*this; return __t; }
+
+        const_iterator& operator+=(difference_type __n) { _M_index += __n; return *this; }
+        const_iterator& operator-=(difference_type __n) { _M_index -= __n; return *this; }
+        const_iterator operator+(difference_type __n) const { return { _M_ring, _M_index + __n }; }
+        const_iterator operator-(difference_type __n) const { return { _M_ring, _M_index - __n }; }
+        friend const_iterator operator+(difference_type __n, const const_iterator& __it) { return __it + __n; }
+        difference_type operator-(const const_iterator& __o) const { return _M_index - __o._M_index; }
+
+        reference operator*() const { return (*_M_ring)[_M_index]; }
+        pointer operator->() const { return &(*_M_ring)[_M_index]; }
+        reference operator[](difference_type __n) const { return (*_M_ring)[_M_index + __n]; }
+    };
+
+private:
+    std::array<T, N> _M_data = {};
+    // Values pushed so far, the next one goes to `_M_total % N`.
+    u64 _M_total = 0;
+    size_type _M_size = 0;
+
+public:
+    void push_back(const T& __v) {
+        _M_data[_M_total++ % N] = __v;
+        if (_M_size < N) _M_size++;
+    }
+
+    // Removes the newest value.
+    void pop_back() {
+        if (_M_size == 0) return;
+
+        _M_total--;
+        _M_size--;
+    }
+
+    void clear() {
+        _M_total = 0;
+        _M_size = 0;
+    }
+
+    const_reference operator[](size_type __i) const
+    { return _M_data[(_M_total - _M_size + __i) % N]; }
+
+    const_reference front() const { return (*this)[0]; }
+    const_reference back() const { return (*this)[_M_size - 1]; }
+
+    size_type size() const { return _M_size; }
+    bool empty() const { return _M_size == 0; }
+    static constexpr size_type capacity() { return N; }
+
+    u64 total() const { return _M_total; }
+
+    const_iterator begin() const { return { this, 0 }; }
+    const_iterator end() const { return { this, _M_size }; }
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+
+#include <lib/intdef>
+
+/**
+ * @brief Hands the latest value of one producer thread to one consumer
+ * thread, without locks.
+ *
+ * Three slots, as a triple buffer: the producer fills its own slot
+ * (`back()`) and `publish()` swaps it with the shared middle slot, the
+ * consumer `take()`s the middle slot by swapping it with its own
+ * (`front()`). Neither side ever waits for the other. A value the consumer
+ * did not take before the next `publish()` is overwritten, so it always
+ * gets the latest one and skips the stale ones.
+ *
+ * Slots are reused, the producer assigns over what its slot held three
+ * values ago, so values that own storage are not reallocated once warm.
+ */
+template <typename T>
+class snapshot_channel {
+    // Middle slot index, and whether it holds a value not taken yet.
+    static constexpr u32 _S_index = 3;
+    static constexpr u32 _S_fresh = 4;
+
+    std::array<T, 3> _M_slots;
+
+    std::atomic<u32> _M_middle = 2;
+    // Values published so far, to wait on.
+    std::atomic<u64> _M_published = 0;
+
+    // Owned by the producer and by the consumer.
+    u32 _M_back = 0;
+    u32 _M_front = 1;
+
+public:
+    // Slot the producer fills before `publish()`, with a value of three publishes ago.
+    T& back() { return _M_slots[_M_back]; }
+
+    void publish() {
+        u32 __old = _M_middle.exchange(_M_back | _S_fresh, std::memory_order_acq_rel);
+        _M_back = __old & _S_index;
+
+        _M_published.fetch_add(1, std::memory_order_release);
+        _M_published.notify_one();
+    }
+
+    // Takes the latest value as `front()`, false if there is no new one.
+    bool take() {
+        if (!(_M_middle.load(std::memory_order_relaxed) & _S_fresh)) return false;
+
+        u32 __old = _M_middle.exchange(_M_front, std::memory_order_acq_rel);
+        _M_front = __old & _S_index;
+        return true;
+    }
+
+    // Value the consumer took last.
+    const T& front() const { return _M_slots[_M_front]; }
+
+    // Consumer side: blocks until `published()` is not `__seen`.
+    void wait(u64 __seen) const { _M_published.wait(__seen, std::memory_order_acquire); }
+
+    u64 published() const { return _M_published.load(std::memory_order_acquire); }
+
+    // Wakes a consumer blocked in `wait()`, e.g. to stop it.
+    void wake() {
+        _M_published.fetch_add(1, std::memory_order_release);
+        _M_published.notify_one();
+    }
+};
@@ -0,0 +1,338 @@
+#pragma once
+
+#include <array>
+#include <deque>
+#include <vector>
+
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <exception>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <cstddef>
+
+#include <lib/intdef>
+
+/**
+ * @brief Bump allocator of one thread, for scratch memory of its tasks.
+ *
+ * Memory comes from chunks kept until the arena is destroyed, and a
+ * `scope` gives back everything allocated since it was opened. A worker
+ * runs tasks nested, one inside the `wait()` of another, so scopes opened
+ * by tasks close in reverse order and never take memory still in use.
+ * Nothing allocated here is destroyed: only for trivially destructible types.
+ */
+class arena {
+public:
+    static constexpr std::size_t chunk_size = 64 * 1024;
+
+private:
+    struct chunk {
+        std::unique_ptr<std::byte[]> _M_data;
+        std::size_t _M_size;
+    };
+
+    std::vector<chunk> _M_chunks;
+    // Chunk allocated from, and bytes of it in use.
+    std::size_t _M_chunk = 0, _M_offset = 0;
+
+public:
+    arena() = default;
+    arena(const arena&) = delete;
+    arena& operator=(const arena&) = delete;
+
+    void* allocate(std::size_t __bytes, std::size_t __align = alignof(std::max_align_t));
+
+    // `__n` value-initialized `T`s.
+    template <typename T>
+    T* make_array(std::size_t __n) {
+        static_assert(std::is_trivially_destructible_v<T>);
+
+        T* __p = static_cast<T*>(allocate(sizeof(T) * __n, alignof(T)));
+        for (std::size_t __i = 0; __i < __n; ++__i) new (__p + __i) T();
+        return __p;
+    }
+
+    // Gives back what was allocated while it was open.
+    class scope {
+        arena& _M_arena;
+        std::size_t _M_chunk, _M_offset;
+
+    public:
+        explicit scope(arena& __a) : _M_arena(__a), _M_chunk(__a._M_chunk), _M_offset(__a._M_offset) { }
+        ~scope() { _M_arena._M_chunk = _M_chunk; _M_arena._M_offset = _M_offset; }
+
+        scope(const scope&) = delete;
+        scope& operator=(const scope&) = delete;
+    };
+
+    // Bytes held in chunks, used or not.
+    std::size_t capacity() const;
+};
+
+class task_group;
+
+/**
+ * @brief Work-stealing scheduler for fork/join parallelism.
+ *
+ * A pool of n threads has n - 1 workers; the thread that waits on a
+ * `task_group` is the n-th, and runs tasks until the group is done. Each
+ * worker has its own deque: it pushes and pops the tasks it forks at the
+ * bottom, newest first, and idle threads steal the oldest from the top
+ * of the others', usually the largest part of a split. A thread of no
+ * pool gets a deque of its own while it waits, so it forks and runs tasks
+ * as a worker does; what it forks outside of a wait goes to a shared
+ * queue. Threads with nothing to run sleep
+ * on a counter that every push and every group finished bumps, so an idle
+ * pool takes no CPU.
+ *
+ * Tasks are kept in blocks, closures up to `task::inline_size` bytes
+ * within the block. A block goes back to the thread that forked it,
+ * whichever ran it, so forking does not allocate once warm. Each worker
+ * also has an `arena` for its tasks' scratch memory, see `local_arena()`.
+ *
+ * Groups must be waited on before the pool is destroyed.
+ */
+class task_pool {
+    class slab;
+
+public:
+    struct task {
+        static constexpr std::size_t inline_size = 96;
+
+        // Runs the closure and destroys it.
+        void (*_M_invoke)(task*) = nullptr;
+        task_group* _M_group = nullptr;
+        // Next free block.
+        task* _M_next = nullptr;
+        // Slab the block belongs to.
+        slab* _M_owner = nullptr;
+
+        alignas(std::max_align_t) std::byte _M_storage[inline_size];
+    };
+
+private:
+    // Chase-Lev deque of fixed capacity: the owner pushes and pops at the
+    // bottom, thieves take from the top. A full deque refuses the push.
+    class deque {
+    public:
+        static constexpr i64 capacity = 8192;
+        static_assert((capacity & (capacity - 1)) == 0);
+
+    private:
+        alignas(64) std::atomic<i64> _M_top = 0;
+        alignas(64) std::atomic<i64> _M_bottom = 0;
+        std::array<std::atomic<task*>, capacity> _M_buffer;
+
+    public:
+        bool push(task* __t);
+        task* pop();
+        task* steal();
+        bool empty() const;
+    };
+
+    // Free task blocks of one thread. Other threads give blocks back to a
+    // list of their own, which the owner takes whole once its list is empty.
+    class slab {
+        std::vector<std::unique_ptr<task[]>> _M_chunks;
+        task* _M_free = nullptr;
+        std::atomic<task*> _M_returned = nullptr;
+
+    public:
+        static constexpr std::size_t chunk_size = 64;
+
+        task* get();
+        void put(task* __t) { __t->_M_next = _M_free; _M_free = __t; }
+        // From any thread.
+        void give_back(task* __t);
+    };
+
+    struct worker {
+        deque _M_deque;
+        slab _M_slab;
+        arena _M_arena;
+        u64 _M_rand;
+        std::thread _M_thread;
+
+        // For a guest slot, whether a thread waiting has it.
+        std::atomic<bool> _M_taken = false;
+    };
+
+    std::vector<std::unique_ptr<worker>> _M_workers;
+    // Slots lent to threads of no pool while they wait, see `_M_wait()`.
+    std::vector<std::unique_ptr<worker>> _M_guests;
+    // Workers and guests, to steal from.
+    std::vector<worker*> _M_victims;
+
+    // Tasks forked by threads that are not workers, and their blocks.
+    std::mutex _M_shared_mutex;
+    std::deque<task*> _M_shared;
+    std::atomic<u64> _M_shared_size = 0;
+    slab _M_shared_slab;
+
+    std::atomic<bool> _M_stop = false;
+    // Bumped when there may be something new to do; sleepers wait on it.
+    std::atomic<u32> _M_epoch = 0;
+    std::atomic<u32> _M_sleeping = 0;
+
+    inline static thread_local task_pool* _S_pool = nullptr;
+    inline static thread_local worker* _S_worker = nullptr;
+    // Pool whose tasks the thread runs: its own for a worker, the one it
+    // waits on otherwise.
+    inline static thread_local task_pool* _S_current = nullptr;
+
+    worker* _M_self() const { return _S_pool == this ? _S_worker : nullptr; }
+
+    task* _M_allocate();
+    void _M_free(task* __t);
+
+    void _M_push(task* __t);
+    void _M_notify(bool __all);
+
+    // A task to run: own deque, then the shared queue, then stolen.
+    task* _M_find(worker* __self);
+    void _M_execute(task* __t);
+
+    // Sleeps until the epoch moves, unless `__ready()` or work shows up
+    // meanwhile. Returns a task found instead, if any.
+    template <typename _Pred>
+    task* _M_idle(worker* __self, _Pred&& __ready);
+
+    void _M_run(worker* __self);
+    void _M_wait(task_group& __g);
+
+    worker* _M_take_guest();
+    void _M_return_guest(worker* __guest);
+
+    friend class task_group;
+
+public:
+    // Threads of no pool that can wait on the pool at once with their own
+    // deque; more wait with the shared queue only.
+    static constexpr u32 guest_slots = 8;
+
+    // `__threads` counts the thread that waits, 0 for one per core.
+    explicit task_pool(u32 __threads = 0);
+    ~task_pool();
+
+    task_pool(const task_pool&) = delete;
+    task_pool& operator=(const task_pool&) = delete;
+
+    // Threads running tasks while a group is waited on.
+    u32 size() const { return _M_workers.size() + 1; }
+
+    // Pool for the whole process, one thread per core, made on first use.
+    static task_pool& shared();
+
+    // Pool running the calling task, `shared()` outside of tasks. Groups
+    // forked by tasks go there by default.
+    static task_pool& current() { return _S_current ? *_S_current : shared(); }
+
+    // Arena of the calling worker, or of the calling thread if not a worker.
+    static arena& local_arena();
+};
+
+/**
+ * @brief Tasks forked together and joined with `wait()`.
+ *
+ * `run()` may be called from any thread, tasks of the group included.
+ * The first exception thrown by a task is rethrown by `wait()`; the other
+ * tasks still run. Groups waited on while another one is waited on by the
+ * same thread must be done first, as with any nesting.
+ */
+class task_group {
+    task_pool& _M_pool;
+    std::atomic<u64> _M_pending = 0;
+
+    std::mutex _M_error_mutex;
+    std::exception_ptr _M_error;
+
+    friend class task_pool;
+
+    // Whether a closure is kept within its task block.
+    template <typename _Func>
+    static constexpr bool _S_fits =
+        sizeof(_Func) <= task_pool::task::inline_size && alignof(_Func) <= alignof(std::max_align_t);
+
+    template <typename _Func>
+    static void _S_invoke(task_pool::task* __t) {
+        _Func* __f;
+        if constexpr (_S_fits<_Func>) __f = std::launder(reinterpret_cast<_Func*>(__t->_M_storage));
+        else __f = *std::launder(reinterpret_cast<_Func**>(__t->_M_storage));
+
+        struct guard {
+            _Func* _M_f;
+            ~guard() {
+                if constexpr (_S_fits<_Func>) _M_f->~_Func();
+                else delete _M_f;
+            }
+        } __g { __f };
+
+        (*__f)();
+    }
+
+public:
+    explicit task_group(task_pool& __pool = task_pool::current()) : _M_pool(__pool) { }
+
+    // Joins what is left, without rethrowing.
+    ~task_group() { if (_M_pending.load(std::memory_order_acquire) > 0) _M_pool._M_wait(*this); }
+
+    task_group(const task_group&) = delete;
+    task_group& operator=(const task_group&) = delete;
+
+    // Forks `__f`, which runs once on some thread of the pool.
+    template <typename _Func>
+    void run(_Func&& __f) {
+        using _Fn = std::decay_t<_Func>;
+
+        task_pool::task* __t = _M_pool._M_allocate();
+
+        if constexpr (_S_fits<_Fn>)
+            new (__t->_M_storage) _Fn(std::forward<_Func>(__f));
+        else
+            new (__t->_M_storage) _Fn*(new _Fn(std::forward<_Func>(__f)));
+
+        __t->_M_invoke = &_S_invoke<_Fn>;
+        __t->_M_group = this;
+
+        _M_pending.fetch_add(1, std::memory_order_relaxed);
+        _M_pool._M_push(__t);
+    }
+
+    // Runs tasks of the pool until every task of the group is done.
+    void wait();
+
+    task_pool& pool() const { return _M_pool; }
+};
+
+namespace detail {
+
+template <typename _Func>
+void parallel_split(task_group& __g, u64 __begin, u64 __end, u64 __grain, const _Func& __f) {
+    while (__end - __begin > __grain) {
+        u64 __mid = __begin + (__end - __begin) / 2;
+        __g.run([&__g, __mid, __end, __grain, &__f] { parallel_split(__g, __mid, __end, __grain, __f); });
+        __end = __mid;
+    }
+
+    for (u64 __i = __begin; __i < __end; ++__i) __f(__i);
+}
+
+}
+
+/**
+ * @brief Calls `__f(i)` for every i in [__begin, __end) on the threads of
+ * `__pool`, split in halves down to `__grain` indices per task.
+ */
+template <typename _Func>
+void parallel_for(u64 __begin, u64 __end, u64 __grain, const _Func& __f,
+                  task_pool& __pool = task_pool::current()) {
+    if (__begin >= __end) return;
+
+    task_group __g(__pool);
+    detail::parallel_split(__g, __begin, __end, __grain == 0 ? 1 : __grain, __f);
+    __g.wait();
+}
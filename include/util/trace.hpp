@@ -0,0 +1,129 @@
+#pragma once
+
+/**
+ * @brief Scoped trace spans, written as Chrome trace events.
+ *
+ * `TRACE_SPAN("name")` records the time from that line to the end of the
+ * enclosing scope. Built with `-DTRACE=ON` (which defines `TRACE_ENABLED`),
+ * the spans of every thread are written at exit to `$TETRINAL_TRACE`
+ * (`tetrinal_trace.json` by default), to open in a trace viewer such as
+ * Perfetto or `chrome://tracing`. Otherwise `TRACE_SPAN` expands to nothing.
+ *
+ * Each thread appends to its own buffer, without locks: a span costs two
+ * clock reads and a store. Buffers are made when a thread records its
+ * first span, so recording never allocates; spans past the end of a full
+ * buffer are dropped, and counted at exit. Names must be string literals (or otherwise
+ * outlive the program), only the pointer is kept.
+ */
+
+#ifdef TRACE_ENABLED
+
+#include <array>
+#include <atomic>
+#include <chrono>
+
+#include <lib/intdef>
+
+namespace tracing {
+
+struct event {
+    const char* _M_name;
+    // Nanoseconds since the start of the program.
+    u64 _M_begin, _M_end;
+};
+
+/**
+ * @brief Events of one thread, appended by that thread only.
+ *
+ * Chunks are all made and linked when the thread registers, never freed
+ * or moved, and sizes are published with release stores, so the writer at
+ * exit can read them while threads still run.
+ */
+struct thread_buffer {
+    static constexpr std::size_t chunk_size = 1 << 14;
+    // 3 MB, about 130k spans per thread.
+    static constexpr std::size_t chunk_count = 8;
+
+    struct chunk {
+        std::array<event, chunk_size> _M_events;
+        std::atomic<std::size_t> _M_size = 0;
+        std::atomic<chunk*> _M_next = nullptr;
+    };
+
+    u32 _M_thread_id;
+    chunk* _M_head;
+    chunk* _M_tail;
+    // Spans recorded once every chunk was full.
+    std::atomic<u64> _M_dropped = 0;
+    // Next buffer of `buffers()`.
+    thread_buffer* _M_next = nullptr;
+
+    // Moves on to the next chunk once the last one is full, nullptr if
+    // there is none left.
+    chunk* grow() {
+        chunk* __c = _M_tail->_M_next.load(std::memory_order_relaxed);
+        if (__c) _M_tail = __c;
+        return __c;
+    }
+};
+
+// Buffer of the calling thread, registered on its first span.
+thread_buffer& register_thread();
+
+inline thread_buffer& local() {
+    thread_local thread_buffer* __b = &register_thread();
+    return *__b;
+}
+
+inline u64 now() {
+    static const auto __start = std::chrono::steady_clock::now();
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - __start
+    ).count();
+}
+
+inline void record(const char* __name, u64 __begin, u64 __end) {
+    thread_buffer& __b = local();
+    thread_buffer::chunk* __c = __b._M_tail;
+
+    std::size_t __n = __c->_M_size.load(std::memory_order_relaxed);
+    if (__n == thread_buffer::chunk_size) {
+        if (!(__c = __b.grow())) {
+            __b._M_dropped.store(__b._M_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return;
+        }
+
+        __n = 0;
+    }
+
+    __c->_M_events[__n] = { __name, __begin, __end };
+    __c->_M_size.store(__n + 1, std::memory_order_release);
+}
+
+// Writes the events recorded so far, done at exit.
+void flush();
+
+class span {
+    const char* _M_name;
+    u64 _M_begin;
+
+public:
+    explicit span(const char* __name) : _M_name(__name), _M_begin(now()) { }
+    ~span() { record(_M_name, _M_begin, now()); }
+
+    span(const span&) = delete;
+    span& operator=(const span&) = delete;
+};
+
+}
+
+#define TRACE_CONCAT_(__a, __b) __a##__b
+#define TRACE_CONCAT(__a, __b) TRACE_CONCAT_(__a, __b)
+#define TRACE_SPAN(__name) ::tracing::span TRACE_CONCAT(__trace_span_, __LINE__)(__name)
+
+#else
+
+#define TRACE_SPAN(__name) ((void)0)
+
+#endif
@@ -0,0 +1,246 @@
+#include <variant>
+#include <stdexcept>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+
+#include <ai/anytime.hpp>
+
+#include <util/hash.hpp>
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+// Value of a state with nowhere to place, below any board.
+constexpr f32 lost = -10000.0f;
+
+f32 total(f32 __sent, f32 __board) { return __sent + __board; }
+
+}
+
+u64 anytime_search::_M_key(const state& __s, u32 __depth) const {
+    state_hash __h(__depth);
+
+    __h.add_bytes(__s._M_board.rows(), __s._M_board.bytes());
+
+    const attack_info& __a = __s._M_attack_info;
+    __h.add((u64)(u32)__a._M_combo << 32 | (u32)__a._M_btb);
+
+    __h.add((u64)_M_pieces[__s._M_hold].type() << 1 | __s._M_holdable);
+
+    // The tetromino in play, the one a hold brings if none is held, and one
+    // more per tetromino placed after the first.
+    std::size_t __end = std::min<std::size_t>(_M_pieces.size(), __s._M_next + 2 + (__depth > 0 ? __depth - 1 : 0));
+
+    u64 __types = 0;
+    for (std::size_t __i = __s._M_next; __i < __end; ++__i)
+        __types = __types << 3 | static_cast<u64>(_M_pieces[__i].type());
+    __h.add(__types ^ (u64)(__end - __s._M_next) << 58);
+
+    return __h.value();
+}
+
+void anytime_search::_M_children(
+    const state& __s, const field& __f, bool __hold,
+    const std::vector<placement>& __ps, expansion& __out
+) {
+    // Where the tetrominoes go after the placement, see `state`.
+    u32 __hold_index = __hold ? __s._M_next : __s._M_hold;
+    u32 __next = __s._M_next + 1 + (__hold && _M_pieces[__s._M_hold] == tetromino::INVALID);
+
+    std::size_t __first = __out.size();
+    _M_batch.clear();
+
+    for (u32 __i = 0; __i < __ps.size(); ++__i) {
+        const placement& __p = __ps[__i];
+        i32 __x = __p._M_x, __y = __p._M_y;
+
+        // Same as `bot`, checked on the field without the tetromino.
+        spin_type __sp = spin_type::NONE;
+        if (__p._M_rotated) {
+            bool __imm =
+                __f.collides(__x - 1, __y, __p._M_mino) && __f.collides(__x + 1, __y, __p._M_mino) &&
+                __f.collides(__x, __y + 1, __p._M_mino) && __f.collides(__x, __y - 1, __p._M_mino);
+
+            __sp = _M_spin_table->get({
+                __p._M_mino, __x, __y, (u32)__p._M_kick_index, __imm, __f
+            });
+        }
+
+        boards::standard __b = __s._M_board;
+        __b.put(__x, __y, __p._M_mino);
+        u32 __lines = __b.clear_lines();
+
+        attack_info __atk = engine::next_attack_info(
+            __s._M_attack_info, __lines, __sp,
+            __lines > 0 && __b.is_empty(),
+            _M_user_config.game.enable_pc_b2b
+        );
+        u32 __attack = __lines > 0 ? _M_attack_table->get(__atk) : 0;
+
+        child& __c = __out.emplace_back();
+        __c._M_hold = __hold;
+        __c._M_index = __i;
+        __c._M_sent = bot::clear_score(_M_weights, __lines, __attack, __atk);
+        __c._M_state = { __b, __atk, __hold_index, __next, _M_user_config.hold.enabled };
+
+        _M_batch.push(__b);
+    }
+
+    _M_batch.extract(_M_features);
+    for (std::size_t __i = 0; __i < __ps.size(); ++__i)
+        __out[__first + __i]._M_board = bot::board_score(_M_weights, _M_features[__i]);
+}
+
+const anytime_search::expansion& anytime_search::_M_expand(const state& __s) {
+    u64 __key = _M_key(__s, 0);
+
+    if (auto __it = _M_expansions.find(__key); __it != _M_expansions.end()) return __it->second;
+
+    _M_expanded++;
+    _M_all.clear();
+
+    // Spin checks read cells, so the board is copied into a field once.
+    for (u32 __y = 0; __y < boards::standard::height(); ++__y)
+        for (u32 __x = 0; __x < boards::standard::width(); ++__x)
+            _M_scratch.set_cell(__x, __y,
+                __s._M_board.test(__x, __y) ? block_type::GARBAGE : block_type::EMPTY,
+                block_attribute::NORMAL);
+
+    const user_config& __c = _M_user_config;
+
+    for (bool __hold : { false, true }) {
+        if (__hold && !__s._M_holdable) continue;
+
+        u32 __index = __s._M_next;
+        if (__hold) __index = _M_pieces[__s._M_hold] == tetromino::INVALID ? __s._M_next + 1 : __s._M_hold;
+        if (__index >= _M_pieces.size()) continue;
+
+        const tetromino& __t = _M_pieces[__index];
+        auto [__x, __y] = movegen::spawn_position(*_M_engine, __s._M_board, __t);
+
+        auto __ps = movegen::generate(
+            __s._M_board, _M_engine->kick_table(), __t, __x, __y, __c.control.inf_soft_drop
+        );
+        _M_children(__s, _M_scratch, __hold, __ps, _M_all);
+    }
+
+    std::size_t __kept = std::min<std::size_t>(width, _M_all.size());
+    std::partial_sort(_M_all.begin(), _M_all.begin() + __kept, _M_all.end(), [] (const child& __a, const child& __b)
+    { return total(__a._M_sent, __a._M_board) > total(__b._M_sent, __b._M_board); });
+
+    return _M_expansions.emplace(__key, expansion(_M_all.begin(), _M_all.begin() + __kept)).first->second;
+}
+
+f32 anytime_search::_M_value(const state& __s, u32 __depth) {
+    u64 __key = _M_key(__s, __depth);
+
+    if (auto __it = _M_values.find(__key); __it != _M_values.end()) return __it->second;
+    if (_M_expired()) return 0;
+
+    // Entries of `_M_expansions` stay where they are as it grows.
+    const expansion& __e = _M_expand(__s);
+    f32 __best = __e.empty() ? lost : std::numeric_limits<f32>::lowest();
+
+    for (const child& __c : __e) {
+        f32 __v = __depth > 1 && _M_has_next(__c._M_state)
+            ? __c._M_sent + _M_value(__c._M_state, __depth - 1)
+            : total(__c._M_sent, __c._M_board);
+
+        if (_M_stopped) return 0;
+        __best = std::max(__best, __v);
+    }
+
+    _M_values.emplace(__key, __best);
+    return __best;
+}
+
+std::optional<anytime_search::result> anytime_search::think(
+    const engine& __e, std::chrono::nanoseconds __budget
+) {
+    _M_deadline = clock_type::now() + __budget;
+    _M_stopped = false;
+    _M_expanded = 0;
+    _M_engine = &__e;
+
+    if (__e.is_over() || !__e.current()) return std::nullopt;
+
+    const field& __f = __e.get_field();
+
+    if (!std::holds_alternative<boards::standard>(__f.board()))
+        throw std::runtime_error("anytime_search needs the standard 10 x (20 + 4) field.");
+
+    if (_M_expansions.size() + _M_values.size() > table_capacity) clear();
+
+    _M_pieces.clear();
+    _M_pieces.push_back(__e.held().value_or(tetromino::INVALID));
+    _M_pieces.push_back(*__e.current());
+    _M_pieces.insert(_M_pieces.end(), __e.queue().begin(), __e.queue().end());
+
+    // As they spawn, the one in play is only searched from where it is.
+    for (auto& __t : _M_pieces) if (__t != tetromino::INVALID) __t.set_direction(0);
+
+    state __root { std::get<boards::standard>(__f.board()), __e.last_attack(), 0, 1, __e.holdable() };
+
+    // Every placement of the root, from where the tetromino in play is.
+    expansion __first;
+
+    for (bool __hold : { false, true }) {
+        _M_root_placements[__hold] = movegen::generate(__e, __hold);
+        _M_children(__root, __f, __hold, _M_root_placements[__hold], __first);
+    }
+
+    if (__first.empty()) return std::nullopt;
+
+    // Depth 1: every placement by its own score.
+    std::vector<f32> __values(__first.size());
+    for (std::size_t __i = 0; __i < __first.size(); ++__i)
+        __values[__i] = total(__first[__i]._M_sent, __first[__i]._M_board);
+
+    std::vector<u32> __order(__first.size());
+    std::iota(__order.begin(), __order.end(), 0);
+    std::stable_sort(__order.begin(), __order.end(), [&] (u32 __a, u32 __b) { return __values[__a] > __values[__b]; });
+    __order.resize(std::min<std::size_t>(width, __order.size()));
+
+    u32 __best = __order.front(), __depth = 1;
+    f32 __best_value = __values[__best];
+
+    // The tetromino in play, then the queue.
+    u32 __max_depth = _M_pieces.size() - 1;
+
+    for (u32 __d = 2; __d <= __max_depth && !_M_stopped; ++__d) {
+        std::size_t __done = 0;
+
+        for (u32 __i : __order) {
+            const child& __c = __first[__i];
+            f32 __v = _M_has_next(__c._M_state)
+                ? __c._M_sent + _M_value(__c._M_state, __d - 1)
+                : total(__c._M_sent, __c._M_board);
+
+            if (_M_stopped) break;
+            __values[__i] = __v;
+            __done++;
+        }
+
+        // An iteration cut short counts only if it finished the previous
+        // answer, the first one searched.
+        if (__done == 0) break;
+
+        auto __it = std::max_element(__order.begin(), __order.begin() + __done,
+            [&] (u32 __a, u32 __b) { return __values[__a] < __values[__b]; });
+
+        __best = *__it;
+        __best_value = __values[__best];
+        __depth = __d;
+
+        std::stable_sort(__order.begin(), __order.begin() + __done,
+            [&] (u32 __a, u32 __b) { return __values[__a] > __values[__b]; });
+    }
+
+    const child& __c = __first[__best];
+    return result {
+        __c._M_hold, _M_root_placements[__c._M_hold][__c._M_index],
+        __best_value, __depth, _M_expanded
+    };
+}
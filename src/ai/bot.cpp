@@ -0,0 +1,101 @@
+#include <variant>
+#include <stdexcept>
+#include <algorithm>
+
+#include <ai/bot.hpp>
+
+void bot::_M_evaluate(
+    const engine& __e, const std::vector<placement>& __ps,
+    bool __hold, std::optional<decision>& __best
+) {
+    const field& __f = __e.get_field();
+    const auto& __board = std::get<boards::standard>(__f.board());
+
+    _M_batch.clear();
+    _M_outcomes.clear();
+
+    for (const auto& __p : __ps) {
+        const tetromino& __t = __p._M_mino;
+        i32 __x = __p._M_x, __y = __p._M_y;
+
+        // Same as `engine::drop()`, the spin is checked on the field
+        // without the tetromino since corners never overlap it.
+        spin_type __sp = spin_type::NONE;
+        if (__p._M_rotated) {
+            bool __imm =
+                __f.collides(__x - 1, __y, __t) && __f.collides(__x + 1, __y, __t) &&
+                __f.collides(__x, __y + 1, __t) && __f.collides(__x, __y - 1, __t);
+
+            __sp = _M_spin_table->get({
+                __t, __x, __y, (u32)__p._M_kick_index, __imm, __f
+            });
+        }
+
+        boards::standard __b = __board;
+        __b.put(__x, __y, __t);
+        u32 __lines = __b.clear_lines();
+
+        attack_info __atk = engine::next_attack_info(
+            __e.last_attack(), __lines, __sp,
+            __lines > 0 && __b.is_empty(),
+            _M_user_config.game.enable_pc_b2b
+        );
+
+        _M_outcomes.push_back({
+            __lines, __lines > 0 ? _M_attack_table->get(__atk) : 0, __atk
+        });
+        _M_batch.push(__b);
+    }
+
+    _M_batch.extract(_M_features);
+
+    const auto& __w = _M_weights;
+
+    for (std::size_t __i = 0; __i < __ps.size(); ++__i) {
+        const auto& __ft = _M_features[__i];
+        const auto& __o = _M_outcomes[__i];
+
+        f32 __score =
+            board_score(__w, __ft) +
+            clear_score(__w, __o._M_lines, __o._M_attack, __o._M_attack_info);
+
+        if (!__best || __score > __best->_M_score)
+            __best = decision { __hold, __ps[__i], __score };
+    }
+}
+
+f32 bot::board_score(const eval_weights& __w, const board_features& __ft) {
+    return
+        __w._M_aggregate_height * __ft._M_aggregate_height +
+        __w._M_max_height * __ft._M_max_height +
+        __w._M_holes * __ft._M_holes +
+        __w._M_covered * __ft._M_covered +
+        __w._M_bumpiness * __ft._M_bumpiness +
+        __w._M_well_depth * std::min<u16>(__ft._M_well_depth, 4) +
+        __w._M_row_transitions * __ft._M_row_transitions +
+        __w._M_column_transitions * __ft._M_column_transitions +
+        __w._M_tslots * __ft._M_tslots;
+}
+
+f32 bot::clear_score(const eval_weights& __w, u32 __lines, u32 __attack, const attack_info& __atk) {
+    return
+        __w._M_attack * __attack +
+        __w._M_b2b * (__atk._M_btb > 0) +
+        __w._M_wasted_clear * (__attack == 0 ? __lines : 0);
+}
+
+std::optional<bot::decision> bot::think(const engine& __e) {
+    if (__e.is_over() || !__e.current()) return std::nullopt;
+
+    const field& __f = __e.get_field();
+
+    if (!std::holds_alternative<boards::standard>(__f.board()))
+        throw std::runtime_error("bot needs the standard 10 x (20 + 4) field.");
+
+    std::optional<decision> __best;
+
+    _M_evaluate(__e, movegen::generate(__e, false), false, __best);
+    _M_evaluate(__e, movegen::generate(__e, true), true, __best);
+
+    return __best;
+}
@@ -0,0 +1,96 @@
+#include <ai/features.hpp>
+#include <ai/detail/feature_kernel.hpp>
+
+namespace {
+
+struct scalar_v {
+    using reg = u16;
+    static constexpr std::size_t lanes = 1;
+
+    static reg load(const u16* __p) { return *__p; }
+    static void store(u16* __p, reg __a) { *__p = __a; }
+    static reg set1(u32 __v) { return (reg)__v; }
+    static reg zero() { return 0; }
+
+    static reg and_(reg __a, reg __b) { return __a & __b; }
+    static reg or_(reg __a, reg __b) { return __a | __b; }
+    static reg xor_(reg __a, reg __b) { return __a ^ __b; }
+    static reg andnot(reg __a, reg __b) { return ~__a & __b; }
+    static reg shl(reg __a, u32 __n) { return (reg)(__a << __n); }
+    static reg shr(reg __a, u32 __n) { return (reg)(__a >> __n); }
+
+    static reg add(reg __a, reg __b) { return __a + __b; }
+    static reg subs(reg __a, reg __b) { return __a > __b ? __a - __b : 0; }
+    static reg min(reg __a, reg __b) { return __a < __b ? __a : __b; }
+    static reg max(reg __a, reg __b) { return __a > __b ? __a : __b; }
+    static reg cmpgt(reg __a, reg __b) { return __a > __b ? 0xFFFF : 0; }
+};
+
+}
+
+namespace features {
+
+namespace detail {
+
+static_assert(COUNT == output_count);
+
+bool kernel_scalar(const u16* __rows, std::size_t __stride, std::size_t __end, u16* __out) {
+    feature_kernel<scalar_v>(__rows, __stride, 0, __end, __out);
+    return true;
+}
+
+}
+
+isa detect() {
+#if defined(__x86_64__) || defined(__i386__)
+    static const isa __isa =
+        __builtin_cpu_supports("avx2") ? isa::avx2 :
+        __builtin_cpu_supports("sse2") ? isa::sse2 : isa::scalar;
+    return __isa;
+#else
+    return isa::scalar;
+#endif
+}
+
+void extract(
+    const u16* __rows, std::size_t __stride, std::size_t __count,
+    board_features* __out, u16* __soa, isa __isa
+) {
+    using namespace detail;
+
+    if (__count == 0) return;
+    if (static_cast<u32>(__isa) > static_cast<u32>(detect())) __isa = detect();
+
+    // Kernels run on whole vectors, lanes past `__count` are padding.
+    std::size_t __end = (__count + 15) / 16 * 16;
+
+    bool __done = false;
+    switch (__isa) {
+        case isa::avx2: __done = kernel_avx2(__rows, __stride, __end, __soa); if (__done) break;
+        [[fallthrough]];
+        case isa::sse2: __done = kernel_sse2(__rows, __stride, __end, __soa); if (__done) break;
+        [[fallthrough]];
+        case isa::scalar: kernel_scalar(__rows, __stride, __count, __soa); break;
+    }
+
+    for (std::size_t __b = 0; __b < __count; ++__b) {
+        auto __get = [&] (std::size_t __f) { return __soa[__f * __stride + __b]; };
+
+        board_features& __f = __out[__b];
+        for (u32 __x = 0; __x < __f._M_heights.size(); ++__x)
+            __f._M_heights[__x] = (u8)__get(HEIGHTS + __x);
+
+        __f._M_max_height = __get(MAX_HEIGHT);
+        __f._M_aggregate_height = __get(AGGREGATE_HEIGHT);
+        __f._M_holes = __get(HOLES);
+        __f._M_covered = __get(COVERED);
+        __f._M_bumpiness = __get(BUMPINESS);
+        __f._M_well_depth = __get(WELL_DEPTH);
+        __f._M_well_column = __get(WELL_COLUMN);
+        __f._M_row_transitions = __get(ROW_TRANSITIONS);
+        __f._M_column_transitions = __get(COLUMN_TRANSITIONS);
+        __f._M_tslots = __get(TSLOTS);
+    }
+}
+
+}
@@ -0,0 +1,46 @@
+#include <ai/detail/feature_kernel.hpp>
+
+// Built with -mavx2, only called after a runtime check.
+#ifdef __AVX2__
+
+#include <immintrin.h>
+
+namespace {
+
+struct avx2_v {
+    using reg = __m256i;
+    static constexpr std::size_t lanes = 16;
+
+    static reg load(const u16* __p) { return _mm256_loadu_si256((const __m256i*)__p); }
+    static void store(u16* __p, reg __a) { _mm256_storeu_si256((__m256i*)__p, __a); }
+    static reg set1(u32 __v) { return _mm256_set1_epi16((short)__v); }
+    static reg zero() { return _mm256_setzero_si256(); }
+
+    static reg and_(reg __a, reg __b) { return _mm256_and_si256(__a, __b); }
+    static reg or_(reg __a, reg __b) { return _mm256_or_si256(__a, __b); }
+    static reg xor_(reg __a, reg __b) { return _mm256_xor_si256(__a, __b); }
+    static reg andnot(reg __a, reg __b) { return _mm256_andnot_si256(__a, __b); }
+    static reg shl(reg __a, u32 __n) { return _mm256_sll_epi16(__a, _mm_cvtsi32_si128(__n)); }
+    static reg shr(reg __a, u32 __n) { return _mm256_srl_epi16(__a, _mm_cvtsi32_si128(__n)); }
+
+    static reg add(reg __a, reg __b) { return _mm256_add_epi16(__a, __b); }
+    static reg subs(reg __a, reg __b) { return _mm256_subs_epu16(__a, __b); }
+    static reg min(reg __a, reg __b) { return _mm256_min_epu16(__a, __b); }
+    static reg max(reg __a, reg __b) { return _mm256_max_epu16(__a, __b); }
+    // Values never reach the sign bit, so a signed compare is fine.
+    static reg cmpgt(reg __a, reg __b) { return _mm256_cmpgt_epi16(__a, __b); }
+};
+
+}
+
+bool features::detail::kernel_avx2(const u16* __rows, std::size_t __stride, std::size_t __end, u16* __out) {
+    feature_kernel<avx2_v>(__rows, __stride, 0, __end, __out);
+    return true;
+}
+
+#else
+
+bool features::detail::kernel_avx2(const u16*, std::size_t, std::size_t, u16*)
+{ return false; }
+
+#endif
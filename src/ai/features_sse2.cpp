@@ -0,0 +1,45 @@
+#include <ai/detail/feature_kernel.hpp>
+
+#ifdef __SSE2__
+
+#include <emmintrin.h>
+
+namespace {
+
+struct sse2_v {
+    using reg = __m128i;
+    static constexpr std::size_t lanes = 8;
+
+    static reg load(const u16* __p) { return _mm_loadu_si128((const __m128i*)__p); }
+    static void store(u16* __p, reg __a) { _mm_storeu_si128((__m128i*)__p, __a); }
+    static reg set1(u32 __v) { return _mm_set1_epi16((short)__v); }
+    static reg zero() { return _mm_setzero_si128(); }
+
+    static reg and_(reg __a, reg __b) { return _mm_and_si128(__a, __b); }
+    static reg or_(reg __a, reg __b) { return _mm_or_si128(__a, __b); }
+    static reg xor_(reg __a, reg __b) { return _mm_xor_si128(__a, __b); }
+    static reg andnot(reg __a, reg __b) { return _mm_andnot_si128(__a, __b); }
+    static reg shl(reg __a, u32 __n) { return _mm_sll_epi16(__a, _mm_cvtsi32_si128(__n)); }
+    static reg shr(reg __a, u32 __n) { return _mm_srl_epi16(__a, _mm_cvtsi32_si128(__n)); }
+
+    static reg add(reg __a, reg __b) { return _mm_add_epi16(__a, __b); }
+    static reg subs(reg __a, reg __b) { return _mm_subs_epu16(__a, __b); }
+    // Values never reach the sign bit, so signed compares are fine.
+    static reg min(reg __a, reg __b) { return _mm_min_epi16(__a, __b); }
+    static reg max(reg __a, reg __b) { return _mm_max_epi16(__a, __b); }
+    static reg cmpgt(reg __a, reg __b) { return _mm_cmpgt_epi16(__a, __b); }
+};
+
+}
+
+bool features::detail::kernel_sse2(const u16* __rows, std::size_t __stride, std::size_t __end, u16* __out) {
+    feature_kernel<sse2_v>(__rows, __stride, 0, __end, __out);
+    return true;
+}
+
+#else
+
+bool features::detail::kernel_sse2(const u16*, std::size_t, std::size_t, u16*)
+{ return false; }
+
+#endif
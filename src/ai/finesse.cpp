@@ -0,0 +1,175 @@
+#include <algorithm>
+
+#include <ai/finesse.hpp>
+#include <engine.hpp>
+
+namespace {
+
+using control_key = finesse::control_key;
+
+// Cells covered by `__t` at (__x, __y), sorted, to compare placements.
+using cells_type = std::array<i32, 4>;
+
+cells_type cells(const tetromino& __t, i32 __x, i32 __y) {
+    cells_type __c = { 0, };
+    u32 __n = 0;
+
+    for (u32 __i = 0; __i < __t.size(); ++__i)
+        for (u32 __j = 0; __j < __t.size(); ++__j)
+            if (((__t.row_mask(__i) >> __j) & 1) && __n < __c.size())
+                __c[__n++] = (__y - (i32)__i) * 256 + __x + (i32)__j;
+
+    std::sort(__c.begin(), __c.end());
+    return __c;
+}
+
+struct position {
+    tetromino _M_mino;
+    i32 _M_x, _M_y;
+};
+
+// Where `__t` spawns on `__f`, as in `engine::spawn()`.
+std::optional<position> spawn(const engine& __e, const field& __f, tetromino __t) {
+    const user_config& __c = __e.config();
+
+    __t.set_direction(0);
+    auto [__x, __y] = __e.spawn_position(__t);
+
+    if (__f.collides(__x, __y, __t)) {
+        if (!__c.spawn.extended) return std::nullopt;
+
+        u32 __i = 1;
+        for (; __i < __c.spawn.extended_height; ++__i)
+            if (!__f.collides(__x, __y + __i, __t)) break;
+
+        if (__i >= __c.spawn.extended_height) return std::nullopt;
+        __y += __i;
+    }
+
+    return position { __t, __x, __y };
+}
+
+i32 drop_distance(const field& __f, const position& __p) {
+    i32 __d = 0;
+    while (!__f.collides(__p._M_x, __p._M_y - __d - 1, __p._M_mino)) ++__d;
+    return __d;
+}
+
+// Plays `__keys` from `__p` as `engine` would, then hard drops.
+position play(
+    const field& __f, const Ikick_table& __kicks, bool __inf_soft_drop,
+    position __p, const control_key* __keys, u32 __size
+) {
+    auto& [__t, __x, __y] = __p;
+
+    for (u32 __i = 0; __i < __size; ++__i) {
+        switch (__keys[__i]) {
+            case control_key::LEFT:
+                if (!__f.collides(__x - 1, __y, __t)) __x--;
+                break;
+            case control_key::RIGHT:
+                if (!__f.collides(__x + 1, __y, __t)) __x++;
+                break;
+            case control_key::DOWN:
+                if (i32 __d = drop_distance(__f, __p); __d > 0)
+                    __y -= __inf_soft_drop ? __d : 1;
+                break;
+            case control_key::ROTATE_CW:
+                engine::rotate_with_kicks(__f, __kicks, __t, __x, __y, rotation::cw);
+                break;
+            case control_key::ROTATE_CCW:
+                engine::rotate_with_kicks(__f, __kicks, __t, __x, __y, rotation::ccw);
+                break;
+            case control_key::ROTATE_180:
+                engine::rotate_with_kicks(__f, __kicks, __t, __x, __y, rotation::_180);
+                break;
+            default: break;
+        }
+    }
+
+    __y -= drop_distance(__f, __p);
+    return __p;
+}
+
+}
+
+namespace finesse {
+
+checker::checker(const engine& __e)
+: _M_columns(__e.get_field().width() + _S_margin * 2),
+  _M_ways((size_t)7 * 4 * _M_columns) {
+    const user_config& __c = __e.config();
+    const field __empty(__e.get_field().width(), __e.get_field().height());
+
+    for (const tetromino* __t : {
+        &tetromino::I, &tetromino::J, &tetromino::L, &tetromino::O,
+        &tetromino::S, &tetromino::T, &tetromino::Z
+    }) {
+        auto __start = spawn(__e, __empty, *__t);
+        if (!__start) continue;
+
+        auto __ps = movegen::generate(
+            __empty, __e.kick_table(),
+            __start->_M_mino, __start->_M_x, __start->_M_y,
+            __c.control.inf_soft_drop
+        );
+
+        // Every placement takes the shortest inputs of any placement on the same cells.
+        for (const placement& __p : __ps) {
+            const placement* __best = &__p;
+            cells_type __pc = cells(__p._M_mino, __p._M_x, __p._M_y);
+
+            for (const placement& __q : __ps)
+                if (__q._M_inputs.size() < __best->_M_inputs.size() &&
+                    cells(__q._M_mino, __q._M_x, __q._M_y) == __pc)
+                    __best = &__q;
+
+            // Inputs end with the DROP.
+            u32 __size = __best->_M_inputs.size() - 1;
+            if (__size > max_inputs) continue;
+
+            way& __w = _M_way(__t->type(), __p._M_mino.direction(), __p._M_x);
+            if (__w._M_valid && __w._M_size <= __size) continue;
+
+            __w._M_valid = true;
+            __w._M_size = __size;
+            std::copy_n(__best->_M_inputs.begin(), __size, __w._M_keys.begin());
+        }
+    }
+}
+
+std::optional<u32> checker::minimal(const engine& __e) const {
+    if (__e.is_over() || !__e.current()) return std::nullopt;
+
+    const field& __f = __e.get_field();
+    const tetromino& __t = *__e.current();
+    const cells_type __target = cells(__t, __e.x(), __e.ghost_y());
+
+    auto __start = spawn(__e, __f, __t);
+    if (!__start) return std::nullopt;
+
+    const bool __inf_soft_drop = __e.config().control.inf_soft_drop;
+
+    if (const way* __w = _M_find(__t.type(), __t.direction(), __e.x())) {
+        position __end = play(__f, __e.kick_table(), __inf_soft_drop, *__start, __w->_M_keys.data(), __w->_M_size);
+
+        if (cells(__end._M_mino, __end._M_x, __end._M_y) == __target)
+            return __w->_M_size + 1;
+    }
+
+    auto __ps = movegen::generate(
+        __f, __e.kick_table(),
+        __start->_M_mino, __start->_M_x, __start->_M_y,
+        __inf_soft_drop
+    );
+
+    std::optional<u32> __res;
+    for (const placement& __p : __ps)
+        if ((!__res || __p._M_inputs.size() < *__res) &&
+            cells(__p._M_mino, __p._M_x, __p._M_y) == __target)
+            __res = __p._M_inputs.size();
+
+    return __res;
+}
+
+}
@@ -0,0 +1,240 @@
+#include <variant>
+#include <algorithm>
+
+#include <ai/hint.hpp>
+#include <ai/movegen.hpp>
+
+#include <util/hash.hpp>
+
+namespace {
+
+using control_key = engine::control_key;
+using clock_type = std::chrono::steady_clock;
+
+}
+
+hint_search::hint_search(
+    const user_config& __uconf, bags::types __bag_type,
+    eval_weights __w, std::chrono::milliseconds __budget
+) : _M_user_config(__uconf), _M_weights(__w), _M_budget(__budget),
+    _M_engine(_M_rand, __uconf, __bag_type) {
+    _M_engine.keep_history(false);
+    _M_thread = std::thread(&hint_search::_M_run, this);
+}
+
+hint_search::~hint_search() {
+    {
+        std::lock_guard __lock(_M_mutex);
+        _M_stop = true;
+        _M_request++;
+    }
+
+    _M_wake.notify_one();
+    _M_thread.join();
+}
+
+// What the placements from a state depend on. The bag position stands
+// for the tetrominoes it will bring, which the queue does not show yet.
+u64 hint_search::_S_key(const engine::save_data& __dt, bool __holdable) {
+    state_hash __h;
+
+    std::visit([&] (const auto& __b) { __h.add_bytes(__b.rows(), __b.bytes()); }, __dt._M_field.board());
+
+    __h.add((u64)(__dt._M_current ? __dt._M_current->type() : mino_type::INVALID) |
+            (u64)(__dt._M_hold ? __dt._M_hold->type() : mino_type::INVALID) << 8 |
+            (u64)__holdable << 16);
+
+    u64 __queue = 0;
+    for (const auto& __t : __dt._M_queue) __queue = __queue << 3 | static_cast<u64>(__t.type());
+    __h.add(__queue ^ (u64)__dt._M_queue.size() << 58);
+
+    __h.add(__dt._M_bag_data._M_refills << 8 | __dt._M_bag_data._M_current);
+
+    const attack_info& __a = __dt._M_attack_info;
+    __h.add((u64)(u32)__a._M_combo << 32 | (u32)__a._M_btb);
+
+    return __h.value();
+}
+
+std::shared_ptr<const hint_search::expansion> hint_search::_M_expand(
+    const engine::save_data& __s, bool __holdable, u64 __request
+) {
+    u64 __key = _S_key(__s, __holdable);
+
+    if (auto __it = _M_cache.find(__key); __it != _M_cache.end()) return __it->second;
+
+    if (auto __it = _M_previous.find(__key); __it != _M_previous.end()) {
+        auto __e = __it->second;
+        _M_cache.emplace(__key, __e);
+        return __e;
+    }
+
+    _M_children.clear();
+    _M_batch.clear();
+
+    u64 __topouts = __s._M_stats._M_topouts;
+
+    for (bool __hold : { false, true }) {
+        _M_engine.load_state(__s, __holdable);
+
+        for (const placement& __p : movegen::generate(_M_engine, __hold)) {
+            if (!_M_current(__request)) return nullptr;
+
+            _M_engine.load_state(__s, __holdable);
+            if (__hold) _M_engine.apply(control_key::HOLD);
+
+            std::optional<engine::drop_result> __r;
+            for (auto __k : __p._M_inputs) __r = _M_engine.apply(__k);
+
+            // Topping out is never a hint, even where marathon goes on.
+            if (!__r || _M_engine.is_over() || _M_engine.stats()._M_topouts > __topouts) continue;
+
+            child& __c = _M_children.emplace_back();
+            __c._M_hold = __hold;
+            __c._M_mino = __r->_M_mino;
+            __c._M_x = __r->_M_x;
+            __c._M_y = __r->_M_y;
+            __c._M_sent = bot::clear_score(_M_weights, __r->_M_lines, __r->_M_attack, __r->_M_attack_info);
+            _M_engine.save_state(__c._M_state);
+
+            _M_batch.push(std::get<boards::standard>(_M_engine.get_field().board()));
+        }
+    }
+
+    _M_batch.extract(_M_features);
+    for (std::size_t __i = 0; __i < _M_children.size(); ++__i)
+        _M_children[__i]._M_board = bot::board_score(_M_weights, _M_features[__i]);
+
+    auto __better = [] (const child& __a, const child& __b)
+    { return __a._M_sent + __a._M_board > __b._M_sent + __b._M_board; };
+
+    std::size_t __kept = std::min<std::size_t>(beam, _M_children.size());
+    std::partial_sort(_M_children.begin(), _M_children.begin() + __kept, _M_children.end(), __better);
+
+    auto __e = std::make_shared<expansion>(
+        std::make_move_iterator(_M_children.begin()),
+        std::make_move_iterator(_M_children.begin() + __kept)
+    );
+
+    _M_cache.emplace(__key, __e);
+    return __e;
+}
+
+void hint_search::_M_publish(const line& __best, u64 __request, u32 __depth) {
+    std::lock_guard __lock(_M_mutex);
+    if (!_M_current(__request)) return;
+
+    _M_result = result {
+        __request, __best._M_hold, __best._M_mino, __best._M_x, __best._M_y, __depth
+    };
+}
+
+void hint_search::_M_search(const engine::save_data& __root, bool __holdable, u64 __request) {
+    auto __deadline = clock_type::now() + _M_budget;
+
+    _M_previous = std::move(_M_cache);
+    _M_cache.clear();
+
+    // The queue shown, the search does not look at what the bag will bring.
+    u32 __depth_limit = std::max(1u, _M_user_config.game.next_queue_size);
+
+    std::vector<line> __frontier, __next;
+
+    auto __first = _M_expand(__root, __holdable, __request);
+    if (!__first || __first->empty()) return;
+
+    for (u32 __i = 0; __i < __first->size(); ++__i) {
+        const child& __c = (*__first)[__i];
+        __frontier.push_back({
+            __first, __i, __c._M_sent, __c._M_sent + __c._M_board,
+            __c._M_hold, __c._M_mino, __c._M_x, __c._M_y
+        });
+    }
+
+    _M_publish(__frontier.front(), __request, 1);
+
+    for (u32 __depth = 2; __depth <= __depth_limit; ++__depth) {
+        __next.clear();
+
+        for (const line& __l : __frontier) {
+            // A depth cut short would favor the lines expanded first.
+            if (clock_type::now() >= __deadline) return;
+
+            auto __e = _M_expand(__l.state(), true, __request);
+            if (!__e) return;
+
+            for (u32 __i = 0; __i < __e->size(); ++__i) {
+                const child& __c = (*__e)[__i];
+                f32 __sent = __l._M_sent + __c._M_sent;
+
+                __next.push_back({
+                    __e, __i, __sent, __sent + __c._M_board,
+                    __l._M_hold, __l._M_mino, __l._M_x, __l._M_y
+                });
+            }
+        }
+
+        if (__next.empty()) return;
+
+        std::size_t __kept = std::min<std::size_t>(beam, __next.size());
+        std::partial_sort(__next.begin(), __next.begin() + __kept, __next.end(),
+            [] (const line& __a, const line& __b) { return __a._M_value > __b._M_value; });
+        __next.resize(__kept);
+
+        __frontier.swap(__next);
+        _M_publish(__frontier.front(), __request, __depth);
+    }
+}
+
+void hint_search::_M_run() {
+    engine::save_data __root;
+    bool __holdable = true;
+
+    while (true) {
+        u64 __request;
+
+        {
+            std::unique_lock __lock(_M_mutex);
+            _M_wake.wait(__lock, [&] { return _M_stop || _M_pending.has_value(); });
+            if (_M_stop) break;
+
+            __root = std::move(*_M_pending);
+            __holdable = _M_pending_holdable;
+            _M_pending.reset();
+            __request = _M_request.load(std::memory_order_relaxed);
+        }
+
+        _M_search(__root, __holdable, __request);
+    }
+}
+
+u64 hint_search::request(const engine& __e) {
+    u64 __request;
+
+    {
+        std::lock_guard __lock(_M_mutex);
+
+        if (!_M_pending) _M_pending.emplace();
+        __e.save_state(*_M_pending);
+        _M_pending_holdable = __e.holdable();
+
+        __request = ++_M_request;
+        _M_result.reset();
+    }
+
+    _M_wake.notify_one();
+    return __request;
+}
+
+void hint_search::cancel() {
+    std::lock_guard __lock(_M_mutex);
+
+    _M_request++;
+    _M_pending.reset();
+    _M_result.reset();
+}
+
+std::optional<hint_search::result> hint_search::latest() const {
+    std::lock_guard __lock(_M_mutex);
+    return _M_result;
+}
@@ -0,0 +1,247 @@
+#include <utility>
+#include <algorithm>
+#include <limits>
+#include <variant>
+
+#include <ai/movegen.hpp>
+#include <engine.hpp>
+
+namespace {
+
+using control_key = placement::control_key;
+
+struct node {
+    i32 _M_x, _M_y;
+    u32 _M_direction;
+    bool _M_rotated;
+    i32 _M_kick_index;
+
+    // Index of the node this one was reached from, and the key used.
+    // The root has no parent and its key is not used.
+    i32 _M_parent;
+    control_key _M_key;
+};
+
+// Tetromino rows stay in [0, height), so y is in [0, height + 4).
+// Columns may start up to 4 cells left of the field.
+constexpr i32 margin = 4;
+
+// The search on `__b`, whose column heights are `__heights`.
+template <typename _Board>
+std::vector<placement> search(
+    const _Board& __b, const std::vector<u32>& __heights, const Ikick_table& __kicks,
+    const tetromino& __t, i32 __x, i32 __y,
+    bool __inf_soft_drop
+) {
+    std::vector<placement> __res;
+
+    if (__t == tetromino::INVALID || __b.collides(__x, __y, __t)) return __res;
+
+    // Every direction of the tetromino, indexed by direction.
+    std::array<tetromino, 4> __rots = { __t, __t, __t, __t };
+    for (u32 __d = 0; __d < 4; ++__d) __rots[__d].set_direction(__d);
+
+    const i32 __xs = __b.width() + margin * 2, __ys = __b.height() + margin;
+
+    auto __key = [&] (i32 __px, i32 __py, u32 __d, bool __r) -> i32 {
+        if (__px + margin < 0 || __px + margin >= __xs || __py < 0 || __py >= __ys)
+            return -1;
+        return (((i32)__d * __ys + __py) * __xs + __px + margin) * 2 + __r;
+    };
+
+    // Visited search states, and placements already found.
+    std::vector<bool> __seen((size_t)__xs * __ys * 4 * 2, false);
+    std::vector<bool> __found(__seen.size(), false);
+
+    std::vector<node> __nodes;
+    __nodes.reserve(256);
+
+    auto __push = [&] (const node& __n) {
+        i32 __k = __key(__n._M_x, __n._M_y, __n._M_direction, __n._M_rotated);
+        if (__k < 0 || __seen[__k]) return;
+
+        __seen[__k] = true;
+        __nodes.push_back(__n);
+    };
+
+    // Landing y of each direction and column when dropped from above the
+    // stack, where every cell is empty. Below that it is searched cell by cell.
+    std::vector<i32> __surface((size_t)4 * __xs, std::numeric_limits<i32>::max());
+
+    for (u32 __d = 0; __d < 4; ++__d) {
+        const tetromino& __m = __rots[__d];
+
+        for (i32 __px = -margin; __px < __xs - margin; ++__px) {
+            i32 __y = std::numeric_limits<i32>::min();
+            bool __ok = true;
+
+            for (u32 __i = 0; __i < __m.size() && __ok; ++__i) {
+                for (u32 __j = 0; __j < __m.size(); ++__j) {
+                    if (!((__m.row_mask(__i) >> __j) & 1)) continue;
+
+                    i32 __c = __px + (i32)__j;
+                    if (__c < 0 || __c >= (i32)__heights.size()) { __ok = false; break; }
+
+                    __y = std::max(__y, (i32)__heights[__c] + (i32)__i);
+                }
+            }
+
+            if (__ok) __surface[__d * __xs + __px + margin] = __y;
+        }
+    }
+
+    auto __drop_distance = [&] (const node& __n) {
+        i32 __s = __surface[__n._M_direction * __xs + __n._M_x + margin];
+        if (__n._M_y >= __s) return __n._M_y - __s;
+
+        const tetromino& __m = __rots[__n._M_direction];
+
+        i32 __d = 0;
+        while (!__b.collides(__n._M_x, __n._M_y - __d - 1, __m)) ++__d;
+        return __d;
+    };
+
+    // Kick tests of every rotation, they only depend on the directions.
+    std::array<std::array<const kick_tables::detail::kick_table_t*, 4>, 4> __tables;
+    for (u32 __from = 0; __from < 4; ++__from)
+        for (u32 __to = 0; __to < 4; ++__to)
+            __tables[__from][__to] = &__kicks.get(__rots[__to], __from, __to);
+
+    __push({ __x, __y, __t.direction(), false, -1, -1, control_key::DROP });
+
+    for (size_t __i = 0; __i < __nodes.size(); ++__i) {
+        const node __n = __nodes[__i];
+        const tetromino& __m = __rots[__n._M_direction];
+
+        i32 __d = __drop_distance(__n);
+
+        // Hard drop from here.
+        {
+            bool __rotated = __n._M_rotated && __d == 0;
+            i32 __k = __key(__n._M_x, __n._M_y - __d, __n._M_direction, __rotated);
+
+            if (__k >= 0 && !__found[__k]) {
+                __found[__k] = true;
+
+                placement __p = {
+                    __m, __n._M_x, __n._M_y - __d,
+                    __rotated, __rotated ? __n._M_kick_index : -1,
+                    { control_key::DROP }
+                };
+
+                for (i32 __j = __i; __nodes[__j]._M_parent >= 0; __j = __nodes[__j]._M_parent)
+                    __p._M_inputs.push_back(__nodes[__j]._M_key);
+                std::reverse(__p._M_inputs.begin(), __p._M_inputs.end());
+
+                __res.push_back(std::move(__p));
+            }
+        }
+
+        i32 __self = (i32)__i;
+
+        if (!__b.collides(__n._M_x - 1, __n._M_y, __m))
+            __push({ __n._M_x - 1, __n._M_y, __n._M_direction, false, -1, __self, control_key::LEFT });
+        if (!__b.collides(__n._M_x + 1, __n._M_y, __m))
+            __push({ __n._M_x + 1, __n._M_y, __n._M_direction, false, -1, __self, control_key::RIGHT });
+        if (__d > 0)
+            __push({
+                __n._M_x, __n._M_y - (__inf_soft_drop ? __d : 1),
+                __n._M_direction, false, -1, __self, control_key::DOWN
+            });
+
+        // Same kick search as `engine::rotate_with_kicks()`.
+        for (auto [__r, __k] : {
+            std::pair { rotation::cw, control_key::ROTATE_CW },
+            std::pair { rotation::ccw, control_key::ROTATE_CCW },
+            std::pair { rotation::_180, control_key::ROTATE_180 }
+        }) {
+            u32 __to = (__n._M_direction + static_cast<u32>(__r)) % 4;
+            const tetromino& __rm = __rots[__to];
+
+            const auto& __table = *__tables[__n._M_direction][__to];
+
+            for (i32 __idx = -1; __idx < (i32)__table.size(); ++__idx) {
+                auto [__px, __py] = __idx < 0 ? std::pair { 0, 0 } : __table[__idx];
+
+                if (!__b.collides(__n._M_x + __px, __n._M_y + __py, __rm)) {
+                    __push({
+                        __n._M_x + __px, __n._M_y + __py, __to,
+                        true, __idx, __self, __k
+                    });
+                    break;
+                }
+            }
+        }
+    }
+
+    return __res;
+}
+
+// Spawn position of `__t` on `__f`, as in `engine::spawn()`.
+template <typename _Field>
+std::pair<i32, i32> spawn_at(const engine& __e, const _Field& __f, const tetromino& __t) {
+    const user_config& __c = __e.config();
+    auto [__x, __y] = __e.spawn_position(__t);
+
+    if (__f.collides(__x, __y, __t) && __c.spawn.extended) {
+        for (u32 __i = 1; __i < __c.spawn.extended_height; ++__i) {
+            if (!__f.collides(__x, __y + __i, __t)) {
+                __y += __i;
+                break;
+            }
+        }
+    }
+
+    return { __x, __y };
+}
+
+}
+
+namespace movegen {
+
+std::pair<i32, i32> spawn_position(const engine& __e, const boards::standard& __b, const tetromino& __t)
+{ return spawn_at(__e, __b, __t); }
+
+std::vector<placement> generate(
+    const field& __f, const Ikick_table& __kicks,
+    const tetromino& __t, i32 __x, i32 __y,
+    bool __inf_soft_drop
+) {
+    return std::visit([&] (const auto& __b) {
+        return search(__b, __f.column_heights(), __kicks, __t, __x, __y, __inf_soft_drop);
+    }, __f.board());
+}
+
+std::vector<placement> generate(
+    const boards::standard& __b, const Ikick_table& __kicks,
+    const tetromino& __t, i32 __x, i32 __y,
+    bool __inf_soft_drop
+) {
+    std::vector<u32> __heights;
+    __b.column_heights(__heights);
+
+    return search(__b, __heights, __kicks, __t, __x, __y, __inf_soft_drop);
+}
+
+std::vector<placement> generate(const engine& __e, bool __hold) {
+    const user_config& __c = __e.config();
+    const field& __f = __e.get_field();
+
+    if (__e.is_over() || !__e.current()) return {};
+
+    if (!__hold)
+        return generate(__f, __e.kick_table(), *__e.current(), __e.x(), __e.y(), __c.control.inf_soft_drop);
+
+    if (!__c.hold.enabled || !__e.holdable()) return {};
+
+    std::optional<tetromino> __t = __e.held();
+    if (!__t && !__e.queue().empty()) __t = __e.queue().front();
+    if (!__t) return {};
+
+    __t->set_direction(0);
+    auto [__x, __y] = spawn_at(__e, __f, *__t);
+
+    return generate(__f, __e.kick_table(), *__t, __x, __y, __c.control.inf_soft_drop);
+}
+
+}
@@ -0,0 +1,194 @@
+#include <new>
+#include <random>
+#include <variant>
+
+#include <tetrinal.h>
+
+#include <config.hpp>
+#include <engine.hpp>
+
+struct ttr_game {
+    // Declared before the engine, which keeps a reference to it.
+    std::mt19937 _M_rand;
+    engine _M_engine;
+
+    ttr_game(const user_config& __c, bags::types __bag, u32 __seed)
+    : _M_rand(__seed), _M_engine(_M_rand, __c, __bag) {
+        _M_engine.keep_history(false);
+        _M_engine.track_checksum(true);
+        _M_engine.begin();
+        _M_engine.spawn();
+    }
+};
+
+namespace {
+
+user_config to_user_config(const ttr_config& __c) {
+    user_config __u;
+
+    __u.field.width = __c.width;
+    __u.field.height = __c.height;
+    __u.field.extra_height = __c.extra_height;
+    __u.hold.enabled = __c.hold_enabled;
+    __u.hold.infinite = __c.hold_infinite;
+    __u.spawn.base_height = __c.spawn_base_height;
+    __u.spawn.extended = __c.spawn_extended;
+    __u.spawn.extended_height = __c.spawn_extended_height;
+    __u.control.inf_soft_drop = __c.inf_soft_drop;
+    __u.game.attack_table = static_cast<attack_tables::types>(__c.attack_table);
+    __u.game.kick_table = static_cast<kick_tables::types>(__c.kick_table);
+    __u.game.spin_table = static_cast<spin_tables::types>(__c.spin_table);
+    __u.game.enable_pc_b2b = __c.enable_pc_b2b;
+    __u.game.next_queue_size = __c.next_queue_size;
+
+    return __u;
+}
+
+bool is_valid(const ttr_config& __c) {
+    u32 __total = __c.height + __c.extra_height;
+
+    return
+        __c.width >= 4 && __c.height > 0 &&
+        __c.spawn_base_height < __total &&
+        __c.attack_table <= static_cast<u8>(attack_tables::types::tetrio) &&
+        __c.kick_table <= static_cast<u8>(kick_tables::types::srs_x) &&
+        __c.spin_table <= static_cast<u8>(spin_tables::types::all_mini_plus) &&
+        __c.bag <= static_cast<u8>(bags::types::bag_classic);
+}
+
+int mino_id(const std::optional<tetromino>& __t)
+{ return static_cast<int>(__t ? __t->type() : mino_type::INVALID); }
+
+}
+
+extern "C" {
+
+uint32_t ttr_api_version(void) { return TTR_API_VERSION; }
+
+void ttr_default_config(ttr_config* __cfg) {
+    user_config __u;
+
+    *__cfg = {
+        __u.field.width, __u.field.height, __u.field.extra_height,
+        __u.hold.enabled, __u.hold.infinite,
+        __u.spawn.base_height, __u.spawn.extended, __u.spawn.extended_height,
+        __u.control.inf_soft_drop,
+        static_cast<u8>(__u.game.attack_table),
+        static_cast<u8>(__u.game.kick_table),
+        static_cast<u8>(__u.game.spin_table),
+        static_cast<u8>(bags::types::bag7),
+        __u.game.enable_pc_b2b,
+        __u.game.next_queue_size
+    };
+}
+
+ttr_game* ttr_create(const ttr_config* __cfg, uint32_t __seed) {
+    ttr_config __c;
+    if (__cfg) __c = *__cfg;
+    else ttr_default_config(&__c);
+
+    if (!is_valid(__c)) return nullptr;
+
+    try {
+        return new ttr_game(to_user_config(__c), static_cast<bags::types>(__c.bag), __seed);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void ttr_destroy(ttr_game* __g) { delete __g; }
+
+void ttr_reset(ttr_game* __g, uint32_t __seed) {
+    __g->_M_engine.seed(__seed);
+
+    __g->_M_engine.reset();
+    __g->_M_engine.begin();
+    __g->_M_engine.spawn();
+}
+
+int ttr_apply(ttr_game* __g, int __action, ttr_drop* __out) {
+    if (__action < TTR_LEFT || __action > TTR_QUIT) return -1;
+    if (__g->_M_engine.is_over() && __action != TTR_RESET) return -1;
+
+    auto __res = __g->_M_engine.apply(static_cast<engine::control_key>(__action));
+    if (!__res) return 0;
+
+    if (__out) {
+        const auto& __atk = __res->_M_attack_info;
+
+        *__out = {
+            static_cast<u8>(__res->_M_mino.type()),
+            static_cast<u8>(__res->_M_mino.direction()),
+            __res->_M_x, __res->_M_y,
+            __res->_M_lines, __res->_M_attack,
+            static_cast<u8>(__res->_M_spin),
+            static_cast<u8>(__atk._M_type),
+            __atk._M_combo, __atk._M_btb,
+            __atk._M_pc,
+            __res->_M_spawn == engine::spawn_result::topped_out
+        };
+    }
+
+    return 1;
+}
+
+int ttr_is_over(const ttr_game* __g) { return __g->_M_engine.is_over(); }
+
+int ttr_current(const ttr_game* __g, int32_t* __x, int32_t* __y, uint32_t* __direction) {
+    const engine& __e = __g->_M_engine;
+
+    if (__x) *__x = __e.x();
+    if (__y) *__y = __e.y();
+    if (__direction) *__direction = __e.current() ? __e.current()->direction() : 0;
+
+    return mino_id(__e.current());
+}
+
+int ttr_hold(const ttr_game* __g) { return mino_id(__g->_M_engine.held()); }
+int ttr_holdable(const ttr_game* __g) { return __g->_M_engine.holdable(); }
+
+uint32_t ttr_queue(const ttr_game* __g, uint8_t* __out, uint32_t __cap) {
+    const auto& __queue = __g->_M_engine.queue();
+
+    u32 __i = 0;
+    for (auto __it = __queue.begin(); __i < __cap && __it != __queue.end(); ++__it, ++__i)
+        __out[__i] = static_cast<u8>(__it->type());
+
+    return __queue.size();
+}
+
+void ttr_stats_get(const ttr_game* __g, ttr_stats* __out) {
+    const auto& __s = __g->_M_engine.stats();
+
+    // The C struct keeps 32-bit counters, they wrap past 2^32.
+    *__out = {
+        (u32)__s._M_lines, (u32)__s._M_attack, __s._M_b2b, __s._M_combo,
+        (u32)__s._M_place_count, (u32)__s._M_input_count
+    };
+}
+
+void ttr_stats64_get(const ttr_game* __g, ttr_stats64* __out) {
+    const auto& __s = __g->_M_engine.stats();
+
+    *__out = {
+        __s._M_lines, __s._M_attack, __s._M_b2b, __s._M_combo,
+        __s._M_place_count, __s._M_input_count, __s._M_topouts
+    };
+}
+
+uint64_t ttr_checksum(const ttr_game* __g) { return __g->_M_engine.checksum(); }
+
+void ttr_board(const ttr_game* __g, ttr_board_view* __out) {
+    std::visit([&] <typename B> (const B& __b) {
+        __out->rows = __b.rows();
+        __out->width = __b.width();
+        __out->height = __b.height();
+
+        if constexpr (std::is_same_v<B, boards::dynamic>)
+            __out->row_bytes = __b.words() * sizeof(u64);
+        else
+            __out->row_bytes = sizeof(typename B::row_type);
+    }, __g->_M_engine.get_field().board());
+}
+
+}
@@ -1,8 +1,11 @@
 #include <iostream>
 
 #include <random>
+#include <string>
+#include <optional>
+#include <filesystem>
 
-#include <ncurses.h>
+#include <cstdlib>
 
 #include <lib/intdef>
 #include <rules/tetromino.hpp>
@@ -10,33 +13,33 @@
 #include <rules/attack_table.hpp>
 #include <rules/field.hpp>
 
+#include <key_code.hpp>
+#include <input.hpp>
+#include <renderer.hpp>
 #include <game.hpp>
 #include <env.hpp>
 
-bool init() {
-    if (initscr() == nullptr) return false;
-    if (start_color() == ERR) return false;
-    if (curs_set(0) == ERR) return false;
-    if (noecho() == ERR) return false;
-    if (cbreak() == ERR) return false;
-    if (keypad(stdscr, TRUE) == ERR) return false;
-    if (use_default_colors() == ERR) return false;
-    
-    nodelay(stdscr, TRUE);
+// Asks whether to continue the saved game.
+bool ask_resume() {
+    screen_type::show_message("Resume the autosaved game? (y/n)");
+
+    key_reader __keys;
+    i32 ch;
+    do ch = __keys.read(std::chrono::milliseconds(100));
+    while (ch != 'y' && ch != 'Y' && ch != 'n' && ch != 'N' && ch != key_code::escape);
 
-    return true;
+    screen_type::show_message("");
+    return ch == 'y' || ch == 'Y';
 }
 
 int main(int argc, char** argv) {
     env::initialize(argc, argv);
 
-    if (!init()) {
-        std::cerr << "Failed to initialize ncurses.\n";
+    if (!screen_type::open_terminal()) {
+        std::cerr << "Failed to initialize the terminal.\n";
         return 1;
     }
 
-    refresh();
-
     user_config __config;
     __config.hold.infinite = true;
     __config.control.inf_soft_drop = true;
@@ -44,8 +47,62 @@ int main(int argc, char** argv) {
     __config.game.restart_countdown = 0;
     // __config.game.mode = user_config::game_mode::puzzle;
 
-    std::mt19937 engine(std::random_device{}());
-    game g(engine, __config);
+    // --record FILE   : save the keys of this game as a replay on exit.
+    // --stats FILE    : save the pace of this game, per placement, as CSV on exit.
+    // --autosave FILE : where the session is saved to resume it (autosave in `env::state_dir()`).
+    // --no-autosave   : do not save the session.
+    // --bandwidth N   : send at most N bytes per second to the terminal, for slow links.
+    // --marathon      : endless, topping out clears the field.
+    // --bot           : the bot plays, keys are still taken.
+    // --hint          : show where the tetromino in play is best placed.
+    std::optional<std::string> __record, __stats;
+    bool __bot = false, __hint = false;
+    std::optional<std::filesystem::path> __autosave;
+    if (auto __dir = env::state_dir(); !__dir.empty()) __autosave = __dir / "autosave";
+    u64 __bandwidth = 0;
+    const auto& __args = env::arguments();
+    for (std::size_t __i = 0; __i < __args.size(); ++__i) {
+        bool __has_value = __i + 1 < __args.size();
+
+        if (__args[__i] == "--record" && __has_value) __record = __args[++__i];
+        else if (__args[__i] == "--stats" && __has_value) __stats = __args[++__i];
+        else if (__args[__i] == "--autosave" && __has_value) __autosave = __args[++__i];
+        else if (__args[__i] == "--no-autosave") __autosave = std::nullopt;
+        else if (__args[__i] == "--bandwidth" && __has_value) __bandwidth = std::strtoull(__args[++__i].c_str(), nullptr, 10);
+        else if (__args[__i] == "--marathon") __config.game.mode = user_config::game_mode::marathon;
+        else if (__args[__i] == "--bot") __bot = true;
+        else if (__args[__i] == "--hint") __hint = true;
+    }
+
+    // Made on first use, the default one does not exist yet.
+    if (__autosave && __autosave->has_parent_path()) {
+        std::error_code __ec;
+        std::filesystem::create_directories(__autosave->parent_path(), __ec);
+    }
+
+    // A recording starts from the seed, so it can not resume a saved game.
+    // A save of another mode is not offered, e.g. a marathon without --marathon.
+    std::optional<session> __saved;
+    if (__autosave && !__record) {
+        __saved = session::load(
+            *__autosave, __config.field.width, __config.field.height + __config.field.extra_height,
+            __config.game.mode
+        );
+
+        if (__saved && (__saved->_M_data._M_over || !ask_resume())) __saved = std::nullopt;
+    }
+
+    // Seed is kept so the game can be saved as a replay.
+    u32 __seed = std::random_device{}();
+    std::mt19937 __rand(__seed);
+    game g(__rand, __config, block_color::types::bright, __saved ? __saved->_M_bag : bags::types::bag7);
+
+    if (__record) g.record(__seed);
+    if (__autosave) g.autosave(*__autosave);
+    if (__bandwidth) g.bandwidth(__bandwidth);
+    if (__stats) g.keep_pace_series(true);
+    if (__bot) g.autoplay();
+    if (__hint) g.hint();
 
     // For puzzle mode.
     /*
@@ -61,26 +118,48 @@ int main(int argc, char** argv) {
     g.set_puzzle_sequence("*p4*!");
     */
     
-    g.start();
-    refresh();
+    if (__saved) g.resume(*__saved);
+    else g.start();
 
-    while (true) {
-        if (!g.is_running()) break;
+    // Keys are taken as they come, frames are published once per tick.
+    auto __frame = std::chrono::milliseconds(g.frame_duration());
+    auto __tick = std::chrono::steady_clock::now() + __frame;
 
-        i32 ch = getch();
-        g.proceed_input(ch);
+    while (g.is_running()) {
+        auto __left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            __tick - std::chrono::steady_clock::now()
+        );
 
-        if (g.restart_requested())
-            g.restart();
+        i32 ch = __left.count() > 0 ? g.read_key(__left) : key_code::none;
+        if (ch != key_code::none) {
+            g.proceed_input(ch);
 
-        g.refresh();
+            if (g.restart_requested()) {
+                g.restart();
+                __tick = std::chrono::steady_clock::now();
+            }
+            continue;
+        }
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(g.frame_duration()));
+        g.refresh();
+        __tick = std::max(__tick + __frame, std::chrono::steady_clock::now());
     }
 
-    refresh();
-    flushinp();
-    while (getch() == ERR);
+    g.discard_keys();
+    while (g.read_key(std::chrono::milliseconds(100)) == key_code::none);
+
+    g.close();
+    screen_type::close_terminal();
+
+    g.end_autosave();
 
-    endwin();
+    if (__record && !g.recording()->save(*__record)) {
+        std::cerr << "Failed to save replay to " << *__record << ".\n";
+        return 1;
+    }
+
+    if (__stats && !g.perf().save(*__stats)) {
+        std::cerr << "Failed to save stats to " << *__stats << ".\n";
+        return 1;
+    }
 }
\ No newline at end of file
@@ -0,0 +1,504 @@
+#include <batch_engine.hpp>
+
+#include <stdexcept>
+#include <algorithm>
+
+namespace {
+
+using control_key = batch_engine::control_key;
+
+bool is_key(u8 __a, control_key __k) { return __a == static_cast<u8>(__k); }
+
+}
+
+batch_engine::batch_engine(
+    std::size_t __count, u32 __seed, user_config __uconf, bags::types __bag_type
+) : _M_user_config(__uconf),
+    _M_count(__count), _M_stride(std::max<std::size_t>((__count + 15) / 16 * 16, 16)),
+    _M_queue_size(std::max(__uconf.game.next_queue_size, 3u)),
+    _M_attack_table(attack_tables::create(__uconf.game.attack_table)) {
+    if (__uconf.field.width != _S_width || __uconf.field.height + __uconf.field.extra_height != _S_height)
+        throw std::runtime_error("batch_engine needs the standard 10 x (20 + 4) field.");
+    if (__uconf.game.mode == user_config::game_mode::puzzle)
+        throw std::runtime_error("batch_engine does not support puzzle mode.");
+
+    auto __kick_table = kick_tables::create(__uconf.game.kick_table);
+
+    const tetromino* __minos[] = {
+        &tetromino::I, &tetromino::J, &tetromino::L, &tetromino::O,
+        &tetromino::S, &tetromino::T, &tetromino::Z
+    };
+
+    for (u32 __type = 0; __type < 7; ++__type) {
+        tetromino __t = *__minos[__type];
+        _M_sizes[__type] = __t.size();
+
+        for (u32 __d = 0; __d < 4; ++__d) {
+            for (u32 __i = 0; __i < 4; ++__i) {
+                _M_shapes[_S_shape(__type, __d)][__i] = __t.row_mask(__i);
+                if (__t.row_mask(__i)) _M_bottoms[_S_shape(__type, __d)] = __i;
+            }
+
+            for (u32 __r = 1; __r <= 3; ++__r) {
+                tetromino __to = __t;
+                __to.rotate(static_cast<rotation>(__r));
+
+                const auto& __table = __kick_table->get(__to, __d, __to.direction());
+
+                _M_kick_ranges[_S_shape(__type, __d) * 3 + __r - 1] = { (u16)_M_kicks.size(), (u16)__table.size() };
+                for (auto [__dx, __dy] : __table) _M_kicks.push_back({ (i8)__dx, (i8)__dy });
+
+                _M_max_kicks = std::max<u32>(_M_max_kicks, __table.size());
+            }
+
+            __t.rotate(rotation::cw);
+        }
+    }
+
+    _M_rows.assign(_S_height * _M_stride, 0);
+    _M_top.assign(__count, 0);
+
+    _M_type.assign(__count, 0);
+    _M_direction.assign(__count, 0);
+    _M_x.assign(__count, 0);
+    _M_y.assign(__count, 0);
+    _M_hold.assign(__count, 0);
+    _M_holdable.assign(__count, 0);
+    _M_queue.assign(__count * _M_queue_size, 0);
+    _M_over.assign(__count, 0);
+    _M_last_spin.assign(__count, 0);
+    _M_kick_index.assign(__count, 0);
+    _M_atk_type.assign(__count, 0);
+    _M_atk_spin.assign(__count, 0);
+    _M_atk_pc.assign(__count, 0);
+    _M_combo.assign(__count, 0);
+    _M_btb.assign(__count, 0);
+    _M_lines.assign(__count, 0);
+    _M_attack.assign(__count, 0);
+    _M_place_count.assign(__count, 0);
+    _M_input_count.assign(__count, 0);
+    _M_topouts.assign(__count, 0);
+
+    _M_sel.reserve(__count);
+    _M_next_sel.reserve(__count);
+    _M_cand_dir.assign(__count, 0);
+    _M_cand_kicks.assign(__count, 0);
+    _M_cand_x.assign(__count, 0);
+    _M_cand_y.assign(__count, 0);
+    _M_hit.assign(__count, 0);
+    _M_step_dropped.assign(__count, 0);
+    _M_step_lines.assign(__count, 0);
+    _M_step_spin.assign(__count, 0);
+    _M_step_attack.assign(__count, 0);
+
+    // Generators keep an iterator into their own bag, so they are never moved.
+    _M_bags.reserve(__count);
+    for (std::size_t __g = 0; __g < __count; ++__g) {
+        std::mt19937 __rand(__seed + __g);
+        _M_bags.emplace_back(__rand, bags::create(__bag_type));
+
+        _M_restart(__g);
+    }
+}
+
+void batch_engine::_M_collide_selected() {
+    for (u32 __g : _M_sel)
+        _M_hit[__g] = _M_collides(__g, _S_shape(_M_type[__g], _M_cand_dir[__g]), _M_cand_x[__g], _M_cand_y[__g]);
+}
+
+i32 batch_engine::_M_drop_distance(std::size_t __g) const {
+    u32 __shape = _S_shape(_M_type[__g], _M_direction[__g]);
+
+    // Rows above the top are empty, the tetromino falls through them.
+    i32 __d = std::max(0, _M_y[__g] - _M_bottoms[__shape] - _M_top[__g]);
+    while (!_M_collides(__g, __shape, _M_x[__g], _M_y[__g] - __d - 1)) ++__d;
+
+    return __d;
+}
+
+// Same rules as `spin_tables`, on the bitboard.
+spin_type batch_engine::_M_spin(std::size_t __g, bool __immobile) const {
+    using types = spin_tables::types;
+
+    types __table = _M_user_config.game.spin_table;
+    bool __plus = __table == types::tspin_plus || __table == types::all_spin_plus || __table == types::all_mini_plus;
+
+    if (_M_type[__g] == static_cast<u8>(mino_type::T)) {
+        i32 __x = _M_x[__g], __y = _M_y[__g];
+
+        // left_top, right_top, right_bottom, left_bottom, seen from the T.
+        bool __c[4] = {
+            _M_filled(__g, __x, __y), _M_filled(__g, __x + 2, __y),
+            _M_filled(__g, __x + 2, __y - 2), _M_filled(__g, __x, __y - 2)
+        };
+
+        u32 __d = _M_direction[__g];
+        u32 __cnt = __c[0] + __c[1] + __c[2] + __c[3];
+
+        if (__cnt >= 3)
+            return __c[__d] && __c[(__d + 1) % 4] ? spin_type::SPIN : spin_type::MINI;
+
+        return __plus && __immobile ? spin_type::MINI : spin_type::NONE;
+    }
+
+    if (__table == types::tspin || __table == types::tspin_plus || !__immobile)
+        return spin_type::NONE;
+
+    return __table == types::all_spin || __table == types::all_spin_plus ?
+        spin_type::SPIN : spin_type::MINI;
+}
+
+void batch_engine::_M_move(const u8* __actions) {
+    _M_sel.clear();
+
+    for (u32 __g = 0; __g < _M_count; ++__g) {
+        if (_M_over[__g]) continue;
+
+        u8 __a = __actions[__g];
+        i32 __dx = is_key(__a, control_key::LEFT) ? -1 : is_key(__a, control_key::RIGHT) ? 1 : 0;
+        i32 __dy = is_key(__a, control_key::DOWN) ? -1 : 0;
+
+        if (__dx == 0 && __dy == 0) continue;
+
+        _M_cand_dir[__g] = _M_direction[__g];
+        _M_cand_x[__g] = _M_x[__g] + __dx;
+        _M_cand_y[__g] = _M_y[__g] + __dy;
+        _M_sel.push_back(__g);
+    }
+
+    _M_collide_selected();
+
+    for (u32 __g : _M_sel) {
+        if (_M_hit[__g]) continue;
+
+        _M_x[__g] = _M_cand_x[__g];
+        _M_y[__g] = _M_cand_y[__g];
+        _M_last_spin[__g] = false;
+    }
+
+    // Soft drop goes all the way down with infinite soft drop.
+    if (_M_user_config.control.inf_soft_drop)
+        for (u32 __g : _M_sel)
+            if (!_M_hit[__g] && is_key(__actions[__g], control_key::DOWN))
+                _M_y[__g] -= _M_drop_distance(__g);
+}
+
+void batch_engine::_M_rotate(const u8* __actions) {
+    _M_sel.clear();
+
+    for (u32 __g = 0; __g < _M_count; ++__g) {
+        if (_M_over[__g]) continue;
+
+        u8 __a = __actions[__g];
+        u32 __r =
+            is_key(__a, control_key::ROTATE_CW) ? static_cast<u32>(rotation::cw) :
+            is_key(__a, control_key::ROTATE_180) ? static_cast<u32>(rotation::_180) :
+            is_key(__a, control_key::ROTATE_CCW) ? static_cast<u32>(rotation::ccw) : 0;
+
+        if (__r == 0) continue;
+
+        _M_cand_kicks[__g] = _S_shape(_M_type[__g], _M_direction[__g]) * 3 + __r - 1;
+        _M_cand_dir[__g] = (_M_direction[__g] + __r) % 4;
+        _M_sel.push_back(__g);
+    }
+
+    // Every rotating game tries its next kick at once, until each one fits or runs out.
+    for (i32 __k = -1; !_M_sel.empty() && __k < (i32)_M_max_kicks; ++__k) {
+        _M_next_sel.clear();
+
+        for (u32 __g : _M_sel) {
+            auto [__begin, __size] = _M_kick_ranges[_M_cand_kicks[__g]];
+            if (__k >= (i32)__size) continue;
+
+            auto [__dx, __dy] = __k < 0 ? std::pair<i8, i8> { 0, 0 } : _M_kicks[__begin + __k];
+            _M_cand_x[__g] = _M_x[__g] + __dx;
+            _M_cand_y[__g] = _M_y[__g] + __dy;
+            _M_next_sel.push_back(__g);
+        }
+
+        std::swap(_M_sel, _M_next_sel);
+        _M_collide_selected();
+
+        _M_next_sel.clear();
+
+        for (u32 __g : _M_sel) {
+            if (_M_hit[__g]) {
+                _M_next_sel.push_back(__g);
+                continue;
+            }
+
+            _M_direction[__g] = _M_cand_dir[__g];
+            _M_x[__g] = _M_cand_x[__g];
+            _M_y[__g] = _M_cand_y[__g];
+            _M_last_spin[__g] = true;
+            _M_kick_index[__g] = __k;
+        }
+
+        std::swap(_M_sel, _M_next_sel);
+    }
+}
+
+void batch_engine::_M_hold_piece(std::size_t __g) {
+    if (!_M_user_config.hold.enabled || !_M_holdable[__g]) return;
+
+    u8 __held = _M_hold[__g];
+    _M_hold[__g] = _M_type[__g];
+    _M_type[__g] = __held != static_cast<u8>(mino_type::INVALID) ? __held : _M_next(__g);
+
+    _M_spawn(__g);
+
+    if (!_M_user_config.hold.infinite) _M_holdable[__g] = false;
+}
+
+void batch_engine::_M_drop(const u8* __actions) {
+    _M_sel.clear();
+
+    for (u32 __g = 0; __g < _M_count; ++__g)
+        if (!_M_over[__g] && is_key(__actions[__g], control_key::DROP))
+            _M_sel.push_back(__g);
+
+    for (u32 __g : _M_sel)
+        if (i32 __d = _M_drop_distance(__g); __d > 0) {
+            _M_y[__g] -= __d;
+            _M_last_spin[__g] = false;
+        }
+
+    for (u32 __g : _M_sel) {
+        u32 __shape = _S_shape(_M_type[__g], _M_direction[__g]);
+        i32 __x = _M_x[__g], __y = _M_y[__g];
+
+        bool __immobile =
+            _M_collides(__g, __shape, __x - 1, __y) && _M_collides(__g, __shape, __x + 1, __y) &&
+            _M_collides(__g, __shape, __x, __y + 1) && _M_collides(__g, __shape, __x, __y - 1);
+
+        bool __full = false;
+        for (u32 __i = 0; __i < 4; ++__i) {
+            u8 __m = _M_shapes[__shape][__i];
+            if (__m == 0) continue;
+
+            u16& __row = _M_rows[(__y - __i) * _M_stride + __g];
+            __row |= (u16)((u64)__m << (__x + 8) >> 8);
+            __full |= __row == _S_full_row;
+        }
+
+        _M_top[__g] = std::max<i32>(_M_top[__g], __y + 1);
+
+        spin_type __sp = _M_last_spin[__g] ? _M_spin(__g, __immobile) : spin_type::NONE;
+
+        u32 __lines = 0;
+        bool __pc = false;
+
+        if (__full) {
+            u16 __any = 0;
+
+            for (u32 __r = 0; __r < _S_height; ++__r) {
+                u16 __row = _M_rows[__r * _M_stride + __g];
+
+                if (__row == _S_full_row) ++__lines;
+                else _M_rows[(__r - __lines) * _M_stride + __g] = __row;
+
+                __any |= __row != _S_full_row ? __row : 0;
+            }
+
+            for (u32 __r = _S_height - __lines; __r < _S_height; ++__r)
+                _M_rows[__r * _M_stride + __g] = 0;
+
+            _M_top[__g] -= __lines;
+
+            __pc = __any == 0;
+        }
+
+        attack_info __atk = engine::next_attack_info(
+            last_attack(__g), __lines, __sp, __pc, _M_user_config.game.enable_pc_b2b
+        );
+
+        _M_atk_type[__g] = static_cast<u8>(__atk._M_type);
+        _M_atk_spin[__g] = static_cast<u8>(__atk._M_spin);
+        _M_atk_pc[__g] = __atk._M_pc;
+        _M_combo[__g] = __atk._M_combo;
+        _M_btb[__g] = __atk._M_btb;
+
+        u32 __attack = __lines > 0 ? _M_attack_table->get(__atk) : 0;
+
+        _M_lines[__g] += __lines;
+        _M_attack[__g] += __attack;
+        _M_place_count[__g]++;
+
+        _M_step_dropped[__g] = true;
+        _M_step_lines[__g] = __lines;
+        _M_step_attack[__g] = __attack;
+        _M_step_spin[__g] = static_cast<u8>(__sp);
+    }
+
+    _M_spawn_selected();
+}
+
+u8 batch_engine::_M_next(std::size_t __g) {
+    u8* __q = _M_queue.data() + __g * _M_queue_size;
+
+    u8 __next = __q[0];
+    std::copy(__q + 1, __q + _M_queue_size, __q);
+    __q[_M_queue_size - 1] = static_cast<u8>(_M_bags[__g].next().type());
+
+    return __next;
+}
+
+void batch_engine::_M_spawn_selected() {
+    for (u32 __g : _M_sel) {
+        _M_type[__g] = _M_next(__g);
+
+        _M_cand_dir[__g] = _M_direction[__g] = 0;
+        _M_cand_x[__g] = _M_x[__g] = (i32)_S_width / 2 - (i32)(_M_sizes[_M_type[__g]] + 1) / 2;
+        _M_cand_y[__g] = _M_y[__g] = _M_user_config.spawn.base_height;
+    }
+
+    _M_collide_selected();
+
+    for (u32 __g : _M_sel)
+        if (!_M_hit[__g] || _M_spawn_blocked(__g))
+            _M_holdable[__g] = true;
+}
+
+bool batch_engine::_M_spawn(std::size_t __g) {
+    _M_direction[__g] = 0;
+    _M_x[__g] = (i32)_S_width / 2 - (i32)(_M_sizes[_M_type[__g]] + 1) / 2;
+    _M_y[__g] = _M_user_config.spawn.base_height;
+
+    if (!_M_collides(__g, _S_shape(_M_type[__g], 0), _M_x[__g], _M_y[__g])) return true;
+
+    return _M_spawn_blocked(__g);
+}
+
+bool batch_engine::_M_spawn_blocked(std::size_t __g) {
+    const auto& __spawn = _M_user_config.spawn;
+
+    if (__spawn.extended) {
+        u32 __shape = _S_shape(_M_type[__g], 0);
+
+        for (u32 __i = 0; __i < __spawn.extended_height; ++__i)
+            if (!_M_collides(__g, __shape, _M_x[__g], _M_y[__g] + __i)) {
+                _M_y[__g] += __i;
+                return true;
+            }
+    }
+
+    if (_M_user_config.game.mode != user_config::game_mode::marathon) {
+        _M_over[__g] = true;
+        return false;
+    }
+
+    // An empty field always has room, as in `engine::spawn()`.
+    for (u32 __y = 0; __y < _S_height; ++__y) _M_rows[__y * _M_stride + __g] = 0;
+    _M_top[__g] = 0;
+    _M_topouts[__g]++;
+
+    return true;
+}
+
+void batch_engine::_M_restart(std::size_t __g) {
+    for (u32 __y = 0; __y < _S_height; ++__y) _M_rows[__y * _M_stride + __g] = 0;
+    _M_top[__g] = 0;
+
+    _M_bags[__g].reset();
+
+    u8* __q = _M_queue.data() + __g * _M_queue_size;
+    for (u32 __i = 0; __i < _M_queue_size; ++__i)
+        __q[__i] = static_cast<u8>(_M_bags[__g].next().type());
+
+    _M_hold[__g] = static_cast<u8>(mino_type::INVALID);
+    _M_over[__g] = false;
+    _M_last_spin[__g] = false;
+
+    _M_atk_type[__g] = static_cast<u8>(attack_type::SINGLE);
+    _M_atk_spin[__g] = static_cast<u8>(spin_type::NONE);
+    _M_atk_pc[__g] = false;
+    _M_combo[__g] = 0;
+    _M_btb[__g] = -1;
+
+    _M_lines[__g] = _M_attack[__g] = _M_place_count[__g] = _M_input_count[__g] = 0;
+    _M_topouts[__g] = 0;
+
+    _M_type[__g] = _M_next(__g);
+    _M_holdable[__g] = _M_user_config.hold.enabled;
+    if (_M_spawn(__g)) _M_holdable[__g] = true;
+}
+
+void batch_engine::step(const u8* __actions, batch_observation* __out) {
+    std::fill(_M_step_dropped.begin(), _M_step_dropped.end(), 0);
+    std::fill(_M_step_lines.begin(), _M_step_lines.end(), 0);
+    std::fill(_M_step_spin.begin(), _M_step_spin.end(), 0);
+    std::fill(_M_step_attack.begin(), _M_step_attack.end(), 0);
+
+    for (u32 __g = 0; __g < _M_count; ++__g) {
+        if (_M_over[__g]) continue;
+
+        if (is_key(__actions[__g], control_key::RESET)) {
+            _M_restart(__g);
+            // The restarted game sits out the rest of this step.
+            continue;
+        }
+
+        if (is_key(__actions[__g], control_key::QUIT)) _M_over[__g] = true;
+        _M_input_count[__g]++;
+    }
+
+    _M_move(__actions);
+    _M_rotate(__actions);
+
+    for (u32 __g = 0; __g < _M_count; ++__g)
+        if (!_M_over[__g] && is_key(__actions[__g], control_key::HOLD))
+            _M_hold_piece(__g);
+
+    _M_drop(__actions);
+
+    if (__out) observe(__out);
+}
+
+void batch_engine::observe(batch_observation* __out) const {
+    for (u32 __g = 0; __g < _M_count; ++__g) {
+        batch_observation& __o = __out[__g];
+
+        for (u32 __y = 0; __y < _S_height; ++__y)
+            __o._M_rows[__y] = _M_rows[__y * _M_stride + __g];
+
+        __o._M_current = _M_type[__g];
+        __o._M_direction = _M_direction[__g];
+        __o._M_x = _M_x[__g];
+        __o._M_y = _M_y[__g];
+        __o._M_ghost_y = _M_over[__g] ? _M_y[__g] : ghost_y(__g);
+
+        __o._M_hold = _M_hold[__g];
+        __o._M_holdable = _M_holdable[__g];
+
+        __o._M_queue.fill(static_cast<u8>(mino_type::INVALID));
+        std::copy_n(queue(__g), std::min<std::size_t>(_M_queue_size, __o._M_queue.size()), __o._M_queue.begin());
+
+        __o._M_over = _M_over[__g];
+
+        __o._M_dropped = _M_step_dropped[__g];
+        __o._M_lines = _M_step_lines[__g];
+        __o._M_spin = _M_step_spin[__g];
+        __o._M_attack = _M_step_attack[__g];
+
+        __o._M_combo = _M_combo[__g];
+        __o._M_b2b = _M_btb[__g];
+    }
+}
+
+void batch_engine::reset(std::size_t __g, u32 __seed) {
+    _M_bags[__g].seed(std::mt19937(__seed));
+
+    _M_restart(__g);
+}
+
+void batch_engine::garbage(std::size_t __g, u32 __cnt, u32 __hole) {
+    if (__cnt == 0 || __cnt > _S_height || __hole >= _S_width) return;
+
+    for (u32 __y = _S_height; __y-- > __cnt; )
+        _M_rows[__y * _M_stride + __g] = _M_rows[(__y - __cnt) * _M_stride + __g];
+
+    for (u32 __y = 0; __y < __cnt; ++__y)
+        _M_rows[__y * _M_stride + __g] = _S_full_row & ~(1u << __hole);
+
+    _M_top[__g] = std::min(_M_top[__g] + __cnt, _S_height);
+}
@@ -69,6 +69,7 @@ struct seqinfo {
 
     std::optional<std::vector<tetromino>> generate(std::mt19937& __r) const;
     bool match(const std::vector<tetromino>& __v) const;
+    std::vector<u8> masks() const;
 };
 
 seqinfo::seqinfo(const std::string& __s) {
@@ -277,6 +278,27 @@ bool seqinfo::match(const std::vector<tetromino>& __v) const {
     return true;
 }
 
+std::vector<u8> seqinfo::masks() const {
+    std::vector<u8> __result;
+
+    for (const auto& __expr : expressions) {
+        std::visit([&](const auto& __e) {
+            using T = std::decay_t<decltype(__e)>;
+            if constexpr (std::is_same_v<T, single_t>) {
+                __result.push_back(1 << static_cast<u32>(tetromino::from_char(__e.t)->type()));
+            } else if constexpr (std::is_same_v<T, set_t>) {
+                u8 __mask = 0;
+                for (const auto& __t : __e.set) __mask |= 1 << static_cast<u32>(__t.type());
+                if (__e.exclude) __mask ^= 0x7f;
+
+                __result.insert(__result.end(), __e.count, __mask);
+            }
+        }, __expr);
+    }
+
+    return __result;
+}
+
 std::optional<std::vector<tetromino>> tetromino::gen(const std::string& __s, std::mt19937& __r) {
     seqinfo __seq(__s);
 
@@ -291,4 +313,12 @@ bool tetromino::sequence_match(const std::vector<tetromino>& __v, const std::str
     if (!__seq.is_valid) return false;
 
     return __seq.match(__v);
-}
\ No newline at end of file
+}
+
+std::optional<std::vector<u8>> tetromino::sequence_masks(const std::string& __s) {
+    seqinfo __seq(__s);
+
+    if (!__seq.is_valid) return std::nullopt;
+
+    return __seq.masks();
+}
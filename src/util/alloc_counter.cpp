@@ -0,0 +1,45 @@
+/*
+ * Replaced global allocation functions, counting every allocation into
+ * `alloc_counter`. The array and nothrow forms of the standard library
+ * call these, so they are counted as well.
+ */
+
+#include <new>
+#include <cstdlib>
+
+#include <util/alloc_counter.hpp>
+
+namespace alloc_counter {
+
+std::atomic<u64> allocations = 0, allocated_bytes = 0;
+
+}
+
+namespace {
+
+void count(std::size_t __n) {
+    alloc_counter::allocations.fetch_add(1, std::memory_order_relaxed);
+    alloc_counter::allocated_bytes.fetch_add(__n, std::memory_order_relaxed);
+}
+
+}
+
+void* operator new(std::size_t __n) {
+    count(__n);
+
+    if (void* __p = std::malloc(__n ? __n : 1)) return __p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t __n, std::align_val_t __a) {
+    count(__n);
+
+    std::size_t __align = static_cast<std::size_t>(__a);
+    if (void* __p = std::aligned_alloc(__align, (__n + __align - 1) / __align * __align ?: __align)) return __p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* __p) noexcept { std::free(__p); }
+void operator delete(void* __p, std::size_t) noexcept { std::free(__p); }
+void operator delete(void* __p, std::align_val_t) noexcept { std::free(__p); }
+void operator delete(void* __p, std::size_t, std::align_val_t) noexcept { std::free(__p); }
@@ -0,0 +1,366 @@
+#include <algorithm>
+
+#include <util/task_pool.hpp>
+
+namespace {
+
+// Tries before a thread with nothing to run goes to sleep.
+constexpr u32 spin_rounds = 64;
+
+u64 xorshift(u64& __s) {
+    __s ^= __s << 13;
+    __s ^= __s >> 7;
+    __s ^= __s << 17;
+    return __s;
+}
+
+}
+
+/* arena */
+
+void* arena::allocate(std::size_t __bytes, std::size_t __align) {
+    while (_M_chunk < _M_chunks.size()) {
+        chunk& __c = _M_chunks[_M_chunk];
+        std::size_t __at = (_M_offset + __align - 1) & ~(__align - 1);
+
+        if (__at + __bytes <= __c._M_size) {
+            _M_offset = __at + __bytes;
+            return __c._M_data.get() + __at;
+        }
+
+        // The rest of this chunk is left for after the scope that moved on.
+        ++_M_chunk;
+        _M_offset = 0;
+    }
+
+    std::size_t __size = std::max(chunk_size, __bytes + __align);
+    _M_chunks.push_back({ std::make_unique<std::byte[]>(__size), __size });
+    _M_chunk = _M_chunks.size() - 1;
+    _M_offset = 0;
+
+    return allocate(__bytes, __align);
+}
+
+std::size_t arena::capacity() const {
+    std::size_t __n = 0;
+    for (const chunk& __c : _M_chunks) __n += __c._M_size;
+    return __n;
+}
+
+/* deque */
+
+bool task_pool::deque::push(task* __t) {
+    i64 __b = _M_bottom.load(std::memory_order_relaxed);
+    i64 __top = _M_top.load(std::memory_order_acquire);
+    if (__b - __top >= capacity) return false;
+
+    _M_buffer[__b & (capacity - 1)].store(__t, std::memory_order_relaxed);
+    // Publishes the task to thieves, which read the bottom with acquire.
+    _M_bottom.store(__b + 1, std::memory_order_release);
+
+    return true;
+}
+
+task_pool::task* task_pool::deque::pop() {
+    i64 __b = _M_bottom.load(std::memory_order_relaxed) - 1;
+    _M_bottom.store(__b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    i64 __top = _M_top.load(std::memory_order_relaxed);
+
+    if (__top > __b) {
+        _M_bottom.store(__b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    task* __t = _M_buffer[__b & (capacity - 1)].load(std::memory_order_relaxed);
+
+    // The last one, a thief may be taking it too.
+    if (__top == __b) {
+        if (!_M_top.compare_exchange_strong(__top, __top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            __t = nullptr;
+        _M_bottom.store(__b + 1, std::memory_order_relaxed);
+    }
+
+    return __t;
+}
+
+task_pool::task* task_pool::deque::steal() {
+    i64 __top = _M_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    i64 __b = _M_bottom.load(std::memory_order_acquire);
+
+    if (__top >= __b) return nullptr;
+
+    task* __t = _M_buffer[__top & (capacity - 1)].load(std::memory_order_relaxed);
+    if (!_M_top.compare_exchange_strong(__top, __top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return nullptr;
+
+    return __t;
+}
+
+bool task_pool::deque::empty() const {
+    return _M_bottom.load(std::memory_order_acquire) <= _M_top.load(std::memory_order_acquire);
+}
+
+/* slab */
+
+task_pool::task* task_pool::slab::get() {
+    if (!_M_free) _M_free = _M_returned.exchange(nullptr, std::memory_order_acquire);
+
+    if (!_M_free) {
+        _M_chunks.push_back(std::make_unique<task[]>(chunk_size));
+
+        for (std::size_t __i = 0; __i < chunk_size; ++__i) {
+            _M_chunks.back()[__i]._M_owner = this;
+            put(&_M_chunks.back()[__i]);
+        }
+    }
+
+    task* __t = _M_free;
+    _M_free = __t->_M_next;
+    return __t;
+}
+
+void task_pool::slab::give_back(task* __t) {
+    // Only pushed to here, and taken whole: no ABA.
+    task* __head = _M_returned.load(std::memory_order_relaxed);
+    do __t->_M_next = __head;
+    while (!_M_returned.compare_exchange_weak(__head, __t, std::memory_order_release, std::memory_order_relaxed));
+}
+
+/* task_pool */
+
+task_pool::task_pool(u32 __threads) {
+    if (__threads == 0) __threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (u32 __i = 1; __i < __threads; ++__i) {
+        auto& __w = _M_workers.emplace_back(std::make_unique<worker>());
+        __w->_M_rand = 0x9E3779B97F4A7C15ull * __i;
+    }
+
+    for (u32 __i = 0; __i < guest_slots; ++__i) {
+        auto& __w = _M_guests.emplace_back(std::make_unique<worker>());
+        __w->_M_rand = 0xD1B54A32D192ED03ull * (__i + 1);
+    }
+
+    for (auto& __w : _M_workers) _M_victims.push_back(__w.get());
+    for (auto& __w : _M_guests) _M_victims.push_back(__w.get());
+
+    // Started once all are made, they steal from each other.
+    for (auto& __w : _M_workers)
+        __w->_M_thread = std::thread(&task_pool::_M_run, this, __w.get());
+}
+
+task_pool::~task_pool() {
+    _M_stop.store(true, std::memory_order_release);
+    _M_notify(true);
+
+    for (auto& __w : _M_workers) __w->_M_thread.join();
+}
+
+task_pool& task_pool::shared() {
+    static task_pool __pool;
+    return __pool;
+}
+
+arena& task_pool::local_arena() {
+    if (_S_worker) return _S_worker->_M_arena;
+
+    thread_local arena __own;
+    return __own;
+}
+
+task_pool::task* task_pool::_M_allocate() {
+    if (worker* __self = _M_self()) return __self->_M_slab.get();
+
+    std::lock_guard __lock(_M_shared_mutex);
+    return _M_shared_slab.get();
+}
+
+// Blocks go back to the slab they came from, or a thread that forks
+// more than it runs (e.g. the shared slab) would allocate forever.
+void task_pool::_M_free(task* __t) {
+    worker* __self = _M_self();
+
+    if (__self && __t->_M_owner == &__self->_M_slab) __self->_M_slab.put(__t);
+    else __t->_M_owner->give_back(__t);
+}
+
+void task_pool::_M_notify(bool __all) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_M_sleeping.load(std::memory_order_relaxed) == 0) return;
+
+    _M_epoch.fetch_add(1, std::memory_order_release);
+    if (__all) _M_epoch.notify_all();
+    else _M_epoch.notify_one();
+}
+
+void task_pool::_M_push(task* __t) {
+    worker* __self = _M_self();
+
+    if (__self) {
+        // A full deque runs the task right away, as a call would.
+        if (!__self->_M_deque.push(__t)) return _M_execute(__t);
+    } else {
+        std::lock_guard __lock(_M_shared_mutex);
+        _M_shared.push_back(__t);
+        _M_shared_size.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    _M_notify(false);
+}
+
+task_pool::task* task_pool::_M_find(worker* __self) {
+    if (__self)
+        if (task* __t = __self->_M_deque.pop()) return __t;
+
+    if (_M_shared_size.load(std::memory_order_acquire) > 0) {
+        std::lock_guard __lock(_M_shared_mutex);
+
+        if (!_M_shared.empty()) {
+            task* __t = _M_shared.front();
+            _M_shared.pop_front();
+            _M_shared_size.fetch_sub(1, std::memory_order_relaxed);
+            return __t;
+        }
+    }
+
+    // From a random victim on, so thieves spread out.
+    thread_local u64 __outsider = 0x2545F4914F6CDD1Dull;
+    std::size_t __n = _M_victims.size();
+    std::size_t __start = xorshift(__self ? __self->_M_rand : __outsider) % __n;
+
+    for (std::size_t __i = 0; __i < __n; ++__i) {
+        worker* __victim = _M_victims[(__start + __i) % __n];
+        if (__victim == __self) continue;
+
+        if (task* __t = __victim->_M_deque.steal()) return __t;
+    }
+
+    return nullptr;
+}
+
+void task_pool::_M_execute(task* __t) {
+    task_group* __g = __t->_M_group;
+
+    try {
+        __t->_M_invoke(__t);
+    } catch (...) {
+        std::lock_guard __lock(__g->_M_error_mutex);
+        if (!__g->_M_error) __g->_M_error = std::current_exception();
+    }
+
+    _M_free(__t);
+
+    // The group may be gone once its count is 0, only the pool is used after.
+    if (__g->_M_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) _M_notify(true);
+}
+
+template <typename _Pred>
+task_pool::task* task_pool::_M_idle(worker* __self, _Pred&& __ready) {
+    for (u32 __i = 0; __i < spin_rounds; ++__i) {
+        if (__ready()) return nullptr;
+        if (task* __t = _M_find(__self)) return __t;
+        std::this_thread::yield();
+    }
+
+    u32 __epoch = _M_epoch.load(std::memory_order_acquire);
+    _M_sleeping.fetch_add(1, std::memory_order_seq_cst);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    // Checked again once counted as sleeping, a push meanwhile bumps the epoch.
+    task* __t = nullptr;
+    if (!__ready() && !(__t = _M_find(__self)))
+        _M_epoch.wait(__epoch, std::memory_order_acquire);
+
+    _M_sleeping.fetch_sub(1, std::memory_order_relaxed);
+    return __t;
+}
+
+void task_pool::_M_run(worker* __self) {
+    _S_pool = this;
+    _S_worker = __self;
+    _S_current = this;
+
+    auto __stopped = [this] { return _M_stop.load(std::memory_order_acquire); };
+
+    while (!__stopped()) {
+        task* __t = _M_find(__self);
+        if (!__t) __t = _M_idle(__self, __stopped);
+        if (__t) _M_execute(__t);
+    }
+}
+
+task_pool::worker* task_pool::_M_take_guest() {
+    for (auto& __w : _M_guests) {
+        bool __free = false;
+        if (__w->_M_taken.compare_exchange_strong(__free, true, std::memory_order_acquire)) return __w.get();
+    }
+
+    return nullptr;
+}
+
+void task_pool::_M_return_guest(worker* __guest) {
+    // Forked by tasks it ran into groups it did not wait on, e.g. by a
+    // `parallel_for()` of another thread: left for the others.
+    while (task* __t = __guest->_M_deque.pop()) {
+        std::lock_guard __lock(_M_shared_mutex);
+        _M_shared.push_back(__t);
+        _M_shared_size.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    __guest->_M_taken.store(false, std::memory_order_release);
+    _M_notify(false);
+}
+
+/*
+ * A thread of no pool, or of another one, runs tasks as a guest worker
+ * while it waits: with a deque of its own, it runs what it forks newest
+ * first, as deep as the tasks nest. Taking from the shared queue instead,
+ * oldest first, every wait would start another task and nest further.
+ */
+void task_pool::_M_wait(task_group& __g) {
+    auto __done = [&__g] { return __g._M_pending.load(std::memory_order_acquire) == 0; };
+    if (__done()) return;
+
+    worker* __self = _M_self();
+    worker* __guest = nullptr;
+
+    task_pool* __outer_pool = _S_pool;
+    worker* __outer_worker = _S_worker;
+
+    if (!__self && (__guest = _M_take_guest())) {
+        _S_pool = this;
+        _S_worker = __self = __guest;
+    }
+
+    task_pool* __outer = std::exchange(_S_current, this);
+
+    while (!__done()) {
+        task* __t = _M_find(__self);
+        if (!__t) __t = _M_idle(__self, __done);
+        if (__t) _M_execute(__t);
+    }
+
+    _S_current = __outer;
+
+    if (__guest) {
+        _S_pool = __outer_pool;
+        _S_worker = __outer_worker;
+        _M_return_guest(__guest);
+    }
+}
+
+/* task_group */
+
+void task_group::wait() {
+    _M_pool._M_wait(*this);
+
+    std::exception_ptr __e;
+    {
+        std::lock_guard __lock(_M_error_mutex);
+        std::swap(__e, _M_error);
+    }
+
+    if (__e) std::rethrow_exception(__e);
+}
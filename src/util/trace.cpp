@@ -0,0 +1,97 @@
+/*
+ * Registry of the per-thread trace buffers, and the Chrome trace-event
+ * writer run at exit. Only built with -DTRACE=ON.
+ */
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include <cstdlib>
+
+#include <unistd.h>
+
+#include <nlohmann/json.hpp>
+
+#include <util/trace.hpp>
+
+namespace tracing {
+
+namespace {
+
+// Buffers of every thread that recorded a span, newest first.
+std::atomic<thread_buffer*> buffers = nullptr;
+std::atomic<u32> thread_count = 0;
+
+struct writer {
+    // Starts the clock before the first span.
+    writer() { now(); }
+    ~writer() { flush(); }
+} at_exit;
+
+}
+
+thread_buffer& register_thread() {
+    // Never freed, events of finished threads are written at exit.
+    thread_buffer* __b = new thread_buffer;
+    __b->_M_thread_id = ++thread_count;
+    __b->_M_head = __b->_M_tail = new thread_buffer::chunk;
+
+    // All made now, recording spans never allocates.
+    auto* __c = __b->_M_head;
+    for (std::size_t __i = 1; __i < thread_buffer::chunk_count; ++__i) {
+        auto* __next = new thread_buffer::chunk;
+        __c->_M_next.store(__next, std::memory_order_relaxed);
+        __c = __next;
+    }
+
+    __b->_M_next = buffers.load(std::memory_order_relaxed);
+    while (!buffers.compare_exchange_weak(__b->_M_next, __b, std::memory_order_release))
+        ;
+
+    return *__b;
+}
+
+void flush() {
+    const char* __env = std::getenv("TETRINAL_TRACE");
+    std::string __path = __env && *__env ? __env : "tetrinal_trace.json";
+
+    nlohmann::json __events = nlohmann::json::array();
+    auto __pid = getpid();
+
+    __events.push_back({
+        { "name", "process_name" }, { "ph", "M" }, { "pid", __pid },
+        { "args", { { "name", "tetrinal" } } }
+    });
+
+    u64 __dropped = 0;
+
+    for (auto* __b = buffers.load(std::memory_order_acquire); __b; __b = __b->_M_next) {
+        __dropped += __b->_M_dropped.load(std::memory_order_relaxed);
+
+        for (auto* __c = __b->_M_head; __c; __c = __c->_M_next.load(std::memory_order_acquire)) {
+            std::size_t __n = __c->_M_size.load(std::memory_order_acquire);
+
+            for (std::size_t __i = 0; __i < __n; ++__i) {
+                const event& __e = __c->_M_events[__i];
+
+                // Timestamps are in microseconds.
+                __events.push_back({
+                    { "name", __e._M_name }, { "ph", "X" },
+                    { "ts", __e._M_begin / 1e3 }, { "dur", (__e._M_end - __e._M_begin) / 1e3 },
+                    { "pid", __pid }, { "tid", __b->_M_thread_id }
+                });
+            }
+        }
+    }
+
+    std::ofstream __os(__path);
+    __os << nlohmann::json { { "traceEvents", std::move(__events) }, { "displayTimeUnit", "ns" } };
+
+    if (!__os) std::cerr << "Cannot write trace to " << __path << "\n";
+
+    if (__dropped > 0)
+        std::cerr << "Trace buffers were full, " << __dropped << " spans dropped\n";
+}
+
+}
@@ -0,0 +1,172 @@
+/*
+ * Checks that the steady state of the engine does not allocate.
+ *
+ * Plays random inputs (moves, rotations, drops and holds) with every bag,
+ * both board layouts and with and without undo history, and counts the
+ * heap allocations of each input once the engine has warmed up: after
+ * a few placements, and with history once a game has filled the undo
+ * tree, whose nodes get their storage the first time they are used. The
+ * tree is cut down to 20 nodes so that random play fills it:
+ *
+ *   alloc [--pieces N] [--seed S]
+ *
+ * Prints the allocations per key and exits with 1 if any input allocated.
+ * Restarts after a top out are not counted.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <array>
+#include <optional>
+
+#include <random>
+
+#include <lib/intdef>
+
+#include <config.hpp>
+#include <engine.hpp>
+#include <env.hpp>
+
+#include <util/alloc_counter.hpp>
+
+namespace {
+
+using control_key = engine::control_key;
+
+constexpr std::array<control_key, 8> keys = {
+    control_key::LEFT, control_key::RIGHT, control_key::DOWN,
+    control_key::ROTATE_CW, control_key::ROTATE_CCW, control_key::ROTATE_180,
+    control_key::DROP, control_key::HOLD
+};
+
+constexpr std::array<const char*, 8> key_names = {
+    "left", "right", "down", "cw", "ccw", "180", "drop", "hold"
+};
+
+// Placements before counting.
+constexpr u32 warmup = 100;
+// Nodes of the undo tree.
+constexpr std::size_t history_capacity = 20;
+// Gives up if no game fills the undo tree in that many placements.
+constexpr u32 max_warmup = 1000000;
+
+struct tally {
+    std::array<u64, keys.size()> _M_calls = { 0, };
+    std::array<alloc_counter::counts, keys.size()> _M_allocs;
+};
+
+// Plays `__pieces` counted placements, returns the allocations per key,
+// or nullopt if the engine did not warm up.
+std::optional<tally> run(bags::types __bag, field::layout __layout, bool __history, u32 __pieces, u32 __seed) {
+    std::mt19937 __rand(__seed);
+    std::mt19937 __inputs(__seed ^ 0x5eed);
+
+    engine __e(__rand, user_config{}, __bag, __layout);
+    __e.keep_history(__history);
+    __e.set_history_capacity(history_capacity);
+    __e.track_checksum(true);
+    __e.begin();
+    __e.spawn();
+
+    tally __t;
+    u32 __placed = 0, __counted = 0;
+    bool __warm = !__history;
+
+    while (__counted < __pieces) {
+        if (!__warm && __placed >= max_warmup) return std::nullopt;
+
+        if (__e.is_over()) {
+            __e.reset();
+            __e.begin();
+            __e.spawn();
+        }
+
+        std::size_t __k = __inputs() % keys.size();
+
+        auto __before = alloc_counter::now();
+        bool __dropped = __e.apply(keys[__k]).has_value();
+        auto __used = alloc_counter::now() - __before;
+
+        if (__warm && __placed >= warmup) {
+            __t._M_calls[__k]++;
+            __t._M_allocs[__k]._M_count += __used._M_count;
+            __t._M_allocs[__k]._M_bytes += __used._M_bytes;
+
+            __counted += __dropped;
+        }
+
+        __placed += __dropped;
+
+        if (__e.history().size() >= __e.history().capacity()) __warm = true;
+    }
+
+    return __t;
+}
+
+const char* bag_name(bags::types __b) {
+    switch (__b) {
+        case bags::types::bag7: return "bag7";
+        case bags::types::bag14: return "bag14";
+        case bags::types::bag7x: return "bag7x";
+        case bags::types::bag_classic: return "classic";
+        default: return "?";
+    }
+}
+
+}
+
+int main(int argc, char** argv) {
+    env::initialize(argc, argv);
+
+    u32 __pieces = 2000, __seed = 0;
+
+    const auto& __args = env::arguments();
+    for (std::size_t __i = 0; __i < __args.size(); ++__i) {
+        const std::string& __a = __args[__i];
+        bool __has_value = __i + 1 < __args.size();
+
+        if (__a == "--pieces" && __has_value) __pieces = std::stoul(__args[++__i]);
+        else if (__a == "--seed" && __has_value) __seed = std::stoul(__args[++__i]);
+        else {
+            std::cerr << "Usage: " << env::exec_path().filename().string()
+                      << " [--pieces N] [--seed S]\n";
+            return 1;
+        }
+    }
+
+    int __ret = 0;
+
+    for (auto __bag : { bags::types::bag7, bags::types::bag14, bags::types::bag7x, bags::types::bag_classic })
+    for (auto __layout : { field::layout::automatic, field::layout::dynamic })
+    for (bool __history : { true, false }) {
+        auto __r = run(__bag, __layout, __history, __pieces, __seed);
+
+        std::cout << std::left << std::setw(8) << bag_name(__bag)
+                  << std::setw(8) << (__layout == field::layout::dynamic ? "dynamic" : "fixed")
+                  << std::setw(11) << (__history ? "history" : "no history");
+
+        if (!__r) {
+            std::cout << " no game filled the undo tree\n";
+            __ret = 1;
+            continue;
+        }
+
+        const tally& __t = *__r;
+
+        bool __clean = true;
+        for (std::size_t __k = 0; __k < keys.size(); ++__k) {
+            const auto& __a = __t._M_allocs[__k];
+            if (__a._M_count == 0) continue;
+
+            __clean = false;
+            std::cout << " " << key_names[__k] << ": " << __a._M_count << " allocations ("
+                      << __a._M_bytes << " B) in " << __t._M_calls[__k] << " inputs";
+        }
+
+        std::cout << (__clean ? " ok" : "") << "\n";
+        if (!__clean) __ret = 1;
+    }
+
+    return __ret;
+}
@@ -0,0 +1,453 @@
+/*
+ * Micro-benchmarks of the rules kernels, with hardware counters.
+ *
+ *   bench [--ops N] [--seed S] [KERNEL...]
+ *
+ * Runs every kernel (or the ones named) for N operations on random
+ * inputs, prepared beforehand. Cycles, instructions, cache misses and
+ * branch misses are read with perf_event_open around the measured loops
+ * only, and reported per operation with the IPC. Without access to the
+ * counters (perf_event_paranoid, containers) only the time is reported.
+ *
+ * Kernels: collision on the fixed board, the dynamic board and the field
+ * cells (`get_block()`, as the reference rules do), line clear on both
+ * boards, spin check, kick search, bag refill, sequence generation
+ * (`tetromino::gen`) and drawing a full field (with the screen the game
+ * is built with, to /dev/null).
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <array>
+#include <functional>
+#include <algorithm>
+
+#include <random>
+#include <chrono>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include <lib/intdef>
+
+#include <config.hpp>
+#include <engine.hpp>
+#include <frame.hpp>
+#ifdef ANSI_ENABLED
+#include <screen/ansi.hpp>
+#else
+#include <screen/curses.hpp>
+#endif
+#include <env.hpp>
+
+namespace {
+
+/**
+ * @brief Hardware counters of this thread, accumulated over `start()`/`stop()`.
+ */
+class counters {
+public:
+    static constexpr std::size_t size = 4;
+
+private:
+    static constexpr std::array<u64, size> _S_configs = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+    };
+
+    std::array<int, size> _M_fds;
+    bool _M_available = true;
+    // errno of the failed perf_event_open.
+    int _M_error = 0;
+
+    std::array<u64, size> _M_values = { 0, };
+    u64 _M_ns = 0;
+    std::chrono::steady_clock::time_point _M_begin;
+
+public:
+    counters() {
+        _M_fds.fill(-1);
+
+        for (std::size_t __i = 0; __i < size; ++__i) {
+            perf_event_attr __attr;
+            std::memset(&__attr, 0, sizeof(__attr));
+
+            __attr.size = sizeof(__attr);
+            __attr.type = PERF_TYPE_HARDWARE;
+            __attr.config = _S_configs[__i];
+            __attr.disabled = 1;
+            __attr.exclude_kernel = 1;
+            __attr.exclude_hv = 1;
+
+            // The cycle counter leads the group, all count over the same intervals.
+            _M_fds[__i] = syscall(SYS_perf_event_open, &__attr, 0, -1, __i ? _M_fds[0] : -1, 0);
+            if (_M_fds[__i] < 0) {
+                _M_available = false;
+                _M_error = errno;
+                break;
+            }
+        }
+    }
+
+    ~counters() {
+        for (int __fd : _M_fds)
+            if (__fd >= 0) ::close(__fd);
+    }
+
+    counters(const counters&) = delete;
+    counters& operator=(const counters&) = delete;
+
+    bool available() const { return _M_available; }
+    int error() const { return _M_error; }
+
+    void clear() {
+        _M_values.fill(0);
+        _M_ns = 0;
+    }
+
+    void start() {
+        if (_M_available) {
+            ioctl(_M_fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(_M_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+
+        _M_begin = std::chrono::steady_clock::now();
+    }
+
+    void stop() {
+        auto __end = std::chrono::steady_clock::now();
+
+        if (_M_available) {
+            ioctl(_M_fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+            for (std::size_t __i = 0; __i < size; ++__i) {
+                u64 __v = 0;
+                if (::read(_M_fds[__i], &__v, sizeof(__v)) == sizeof(__v)) _M_values[__i] += __v;
+            }
+        }
+
+        _M_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(__end - _M_begin).count();
+    }
+
+    u64 ns() const { return _M_ns; }
+    u64 cycles() const { return _M_values[0]; }
+    u64 instructions() const { return _M_values[1]; }
+    u64 cache_misses() const { return _M_values[2]; }
+    u64 branch_misses() const { return _M_values[3]; }
+};
+
+// Keeps the compiler from dropping results of the measured loops.
+volatile u64 sink;
+
+const std::array<const tetromino*, 7> minos = {
+    &tetromino::I, &tetromino::J, &tetromino::L, &tetromino::O,
+    &tetromino::S, &tetromino::T, &tetromino::Z
+};
+
+// A field of the standard size with a random stack, about `__height` rows high.
+field random_field(std::mt19937& __r, field::layout __layout, u32 __height) {
+    field __f(10, 24, __layout);
+
+    for (u32 __x = 0; __x < 10; ++__x) {
+        u32 __h = __height ? __r() % (__height + 1) : 0;
+
+        for (u32 __y = 0; __y < __h; ++__y)
+            if (__r() % 6) __f.set_block(__x, __y, tetromino::I);
+    }
+
+    return __f;
+}
+
+struct position {
+    tetromino _M_mino;
+    i32 _M_x, _M_y;
+};
+
+std::vector<position> random_positions(std::mt19937& __r, std::size_t __n) {
+    std::vector<position> __ps;
+    __ps.reserve(__n);
+
+    for (std::size_t __i = 0; __i < __n; ++__i) {
+        tetromino __t = *minos[__r() % 7];
+        __t.set_direction(__r() % 4);
+
+        __ps.push_back({ __t, (i32)(__r() % 12) - 1, (i32)(__r() % 14) });
+    }
+
+    return __ps;
+}
+
+struct kernel {
+    const char* _M_name;
+    // Runs `__ops` operations, measured between `start()` and `stop()`.
+    std::function<void (counters&, std::mt19937&, u64 __ops)> _M_run;
+};
+
+// Runs `__op(i)` for every i in [0, __ops), over inputs prepared once.
+template <typename _Op>
+void measure(counters& __c, u64 __ops, _Op&& __op) {
+    u64 __acc = 0;
+
+    __c.start();
+    for (u64 __i = 0; __i < __ops; ++__i) __acc += __op(__i);
+    __c.stop();
+
+    sink = __acc;
+}
+
+constexpr std::size_t inputs = 4096;
+
+void collision(counters& __c, std::mt19937& __r, u64 __ops, field::layout __layout) {
+    field __f = random_field(__r, __layout, 8);
+    auto __ps = random_positions(__r, inputs);
+
+    measure(__c, __ops, [&] (u64 __i) {
+        const auto& __p = __ps[__i % inputs];
+        return __f.collides(__p._M_x, __p._M_y, __p._M_mino);
+    });
+}
+
+void collision_cells(counters& __c, std::mt19937& __r, u64 __ops) {
+    field __f = random_field(__r, field::layout::dynamic, 8);
+    auto __ps = random_positions(__r, inputs);
+
+    measure(__c, __ops, [&] (u64 __i) {
+        const auto& [__t, __x, __y] = __ps[__i % inputs];
+
+        for (u32 __a = 0; __a < __t.size(); ++__a)
+            for (u32 __b = 0; __b < __t.size(); ++__b)
+                if (__t.data()[__a][__b] && __f.get_block(__x + __b, __y - __a) != block_type::EMPTY)
+                    return 1;
+
+        return 0;
+    });
+}
+
+void line_clear(counters& __c, std::mt19937& __r, u64 __ops, field::layout __layout) {
+    // Fields with 4 full rows among the bottom 8, copied before each batch.
+    constexpr std::size_t __batch = 256;
+
+    std::vector<field> __src, __work;
+    for (std::size_t __i = 0; __i < __batch; ++__i) {
+        field __f = random_field(__r, __layout, 10);
+
+        for (u32 __k = 0; __k < 4; ++__k) {
+            u32 __y = __r() % 8;
+            for (u32 __x = 0; __x < 10; ++__x) __f.set_block(__x, __y, tetromino::I);
+        }
+
+        __src.push_back(__f);
+    }
+    __work = __src;
+
+    for (u64 __done = 0; __done < __ops; __done += __batch) {
+        u64 __n = std::min<u64>(__batch, __ops - __done);
+
+        for (std::size_t __i = 0; __i < __n; ++__i) __work[__i] = __src[__i];
+
+        measure(__c, __n, [&] (u64 __i) { return __work[__i].proceed_lines(); });
+    }
+}
+
+void spin_check(counters& __c, std::mt19937& __r, u64 __ops) {
+    user_config __u;
+    auto __table = spin_tables::create(__u.game.spin_table);
+
+    field __f = random_field(__r, field::layout::automatic, 10);
+    auto __ps = random_positions(__r, inputs);
+
+    measure(__c, __ops, [&] (u64 __i) {
+        const auto& __p = __ps[__i % inputs];
+        return (u64)__table->get({ __p._M_mino, __p._M_x, __p._M_y, (u32)(__i % 5), (__i & 1) != 0, __f });
+    });
+}
+
+void kick_search(counters& __c, std::mt19937& __r, u64 __ops) {
+    user_config __u;
+    auto __kicks = kick_tables::create(__u.game.kick_table);
+
+    field __f = random_field(__r, field::layout::automatic, 10);
+    auto __ps = random_positions(__r, inputs);
+
+    measure(__c, __ops, [&] (u64 __i) {
+        auto [__t, __x, __y] = __ps[__i % inputs];
+        auto __idx = engine::rotate_with_kicks(__f, *__kicks, __t, __x, __y, static_cast<rotation>(__i % 3 + 1));
+        return __idx ? (u64)(*__idx + 2) : 0;
+    });
+}
+
+void bag_refill(counters& __c, std::mt19937& __r, u64 __ops) {
+    bags::bag7 __bag;
+    std::vector<tetromino> __out;
+
+    measure(__c, __ops, [&] (u64) {
+        __bag.generate(__r, __out);
+        return (u64)__out.front().type();
+    });
+}
+
+void sequence_gen(counters& __c, std::mt19937& __r, u64 __ops) {
+    const std::string __seq = "T[^O]p3*![SZ]p2";
+
+    measure(__c, __ops, [&] (u64) {
+        auto __v = tetromino::gen(__seq, __r);
+        return __v ? __v->size() : 0;
+    });
+}
+
+// A field with 20 rows of garbage, a tetromino in play and the queue.
+frame render_frame(std::mt19937& __r, const user_config& __u) {
+    engine __e(__r, __u);
+    __e.begin();
+    __e.spawn();
+    __e.garbage(20, 4);
+
+    frame __f;
+    __f.take(__e, __u.game.next_queue_size);
+    return __f;
+}
+
+#ifdef ANSI_ENABLED
+void render_field(counters& __c, std::mt19937& __r, u64 __ops) {
+    int __fd = ::open("/dev/null", O_WRONLY);
+
+    if (__fd < 0) {
+        std::cerr << "render: cannot open /dev/null\n";
+        return;
+    }
+
+    {
+        user_config __u;
+        frame __f = render_frame(__r, __u);
+
+        // The terminal is cleared and every cell written again, in one write().
+        ansi_screen __s(__u, block_color::types::bright, __fd);
+        measure(__c, __ops, [&] (u64) {
+            __s.redraw(__f);
+            return 1;
+        });
+    }
+
+    ::close(__fd);
+}
+#else
+void render_field(counters& __c, std::mt19937& __r, u64 __ops) {
+    // Output goes to /dev/null, as a terminal of the usual size.
+    FILE* __out = std::fopen("/dev/null", "w");
+    SCREEN* __scr = __out ? newterm("xterm-256color", __out, stdin) : nullptr;
+
+    if (!__scr) {
+        std::cerr << "render: cannot open a terminal\n";
+        if (__out) std::fclose(__out);
+        return;
+    }
+
+    start_color();
+    resizeterm(40, 120);
+
+    {
+        user_config __u;
+        frame __f = render_frame(__r, __u);
+
+        // Every window is drawn again, then sent whole to the terminal.
+        curses_screen __s(__u, block_color::types::bright);
+        measure(__c, __ops, [&] (u64) {
+            __s.redraw(__f);
+            return 1;
+        });
+    }
+
+    endwin();
+    delscreen(__scr);
+    std::fclose(__out);
+}
+#endif
+
+const std::vector<kernel> kernels = {
+    { "collision/fixed", [] (counters& __c, std::mt19937& __r, u64 __n) { collision(__c, __r, __n, field::layout::automatic); } },
+    { "collision/dynamic", [] (counters& __c, std::mt19937& __r, u64 __n) { collision(__c, __r, __n, field::layout::dynamic); } },
+    { "collision/cells", collision_cells },
+    { "line-clear/fixed", [] (counters& __c, std::mt19937& __r, u64 __n) { line_clear(__c, __r, __n, field::layout::automatic); } },
+    { "line-clear/dynamic", [] (counters& __c, std::mt19937& __r, u64 __n) { line_clear(__c, __r, __n, field::layout::dynamic); } },
+    { "spin-check", spin_check },
+    { "kick-search", kick_search },
+    { "bag-refill", bag_refill },
+    { "sequence-gen", sequence_gen },
+    { "render-field", render_field },
+};
+
+// Operations of the slower kernels, relative to `--ops`.
+u64 scaled_ops(const std::string& __name, u64 __ops) {
+    if (__name == "render-field") return std::max<u64>(1, __ops / 1000);
+    if (__name == "sequence-gen") return std::max<u64>(1, __ops / 10);
+    return __ops;
+}
+
+}
+
+int main(int argc, char** argv) {
+    env::initialize(argc, argv);
+
+    u64 __ops = 1000000;
+    u32 __seed = 0;
+    std::vector<std::string> __only;
+
+    const auto& __args = env::arguments();
+    for (std::size_t __i = 0; __i < __args.size(); ++__i) {
+        const std::string& __a = __args[__i];
+        bool __has_value = __i + 1 < __args.size();
+
+        if (__a == "--ops" && __has_value) __ops = std::max(1ull, std::stoull(__args[++__i]));
+        else if (__a == "--seed" && __has_value) __seed = std::stoul(__args[++__i]);
+        else if (!__a.starts_with("--")) __only.push_back(__a);
+        else {
+            std::cerr << "Usage: " << env::exec_path().filename().string()
+                      << " [--ops N] [--seed S] [KERNEL...]\n";
+            return 1;
+        }
+    }
+
+    counters __c;
+    if (!__c.available())
+        std::cerr << "Hardware counters unavailable (perf_event_open: " << std::strerror(__c.error())
+                  << "), reporting time only\n";
+
+    std::cout << std::left << std::setw(20) << "kernel" << std::right
+              << std::setw(10) << "ops" << std::setw(10) << "ns/op";
+    if (__c.available())
+        std::cout << std::setw(10) << "cyc/op" << std::setw(8) << "IPC"
+                  << std::setw(12) << "cmiss/op" << std::setw(12) << "bmiss/op";
+    std::cout << "\n";
+
+    for (const auto& __k : kernels) {
+        if (!__only.empty() && std::find(__only.begin(), __only.end(), __k._M_name) == __only.end())
+            continue;
+
+        u64 __n = scaled_ops(__k._M_name, __ops);
+        std::mt19937 __r(__seed);
+
+        __c.clear();
+        __k._M_run(__c, __r, __n);
+        if (__c.ns() == 0) continue;
+
+        auto __per_op = [&] (u64 __v) { return (f64)__v / __n; };
+
+        std::cout << std::left << std::setw(20) << __k._M_name << std::right << std::fixed
+                  << std::setw(10) << __n << std::setw(10) << std::setprecision(1) << __per_op(__c.ns());
+        if (__c.available())
+            std::cout << std::setw(10) << std::setprecision(1) << __per_op(__c.cycles())
+                      << std::setw(8) << std::setprecision(2)
+                      << (__c.cycles() ? (f64)__c.instructions() / __c.cycles() : 0.0)
+                      << std::setw(12) << std::setprecision(4) << __per_op(__c.cache_misses())
+                      << std::setw(12) << std::setprecision(4) << __per_op(__c.branch_misses());
+        std::cout << "\n";
+    }
+}
@@ -0,0 +1,70 @@
+/*
+ * Checks the C API from C, against the library as it is shipped.
+ *
+ *   capi
+ *
+ * Plays hard drops until the game tops out, then checks that the game
+ * refuses actions but TTR_RESET, that TTR_RESET and ttr_reset() both start
+ * a new game, and that the counters start over. Exits with 1 on the first
+ * check that fails.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <tetrinal.h>
+
+static int failures = 0;
+
+static void check(int ok, const char* what) {
+    if (!ok) {
+        fprintf(stderr, "FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+/* Hard drops until the game is over, returns the number of drops. */
+static uint32_t top_out(ttr_game* g) {
+    uint32_t n = 0;
+    while (!ttr_is_over(g) && n < 1000)
+        if (ttr_apply(g, TTR_DROP, NULL) == 1) n++;
+
+    return n;
+}
+
+int main(void) {
+    check(ttr_api_version() == TTR_API_VERSION, "library and header versions match");
+
+    ttr_game* g = ttr_create(NULL, 1);
+    check(g != NULL, "default config is valid");
+    if (!g) return 1;
+
+    check(ttr_apply(g, -1, NULL) == -1, "unknown action is refused");
+
+    check(top_out(g) > 0 && ttr_is_over(g), "hard drops top out");
+    check(ttr_apply(g, TTR_DROP, NULL) == -1, "drop is refused once over");
+    check(ttr_apply(g, TTR_LEFT, NULL) == -1, "move is refused once over");
+
+    check(ttr_apply(g, TTR_RESET, NULL) == 0, "reset is taken once over");
+    check(!ttr_is_over(g), "reset starts a new game");
+    check(ttr_current(g, NULL, NULL, NULL) != TTR_NONE, "reset spawns a tetromino");
+
+    ttr_stats64 s;
+    ttr_stats64_get(g, &s);
+    check(s.place_count == 0 && s.lines == 0, "reset clears the counters");
+
+    ttr_drop d;
+    check(ttr_apply(g, TTR_DROP, &d) == 1, "drop after reset");
+
+    check(top_out(g) > 0 && ttr_is_over(g), "tops out again");
+    ttr_reset(g, 2);
+    check(!ttr_is_over(g), "ttr_reset starts a new game once over");
+    check(ttr_apply(g, TTR_DROP, NULL) == 1, "drop after ttr_reset");
+
+    ttr_destroy(g);
+
+    if (failures) return 1;
+
+    printf("C API checks passed\n");
+    return 0;
+}
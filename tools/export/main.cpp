@@ -0,0 +1,285 @@
+/*
+ * Headless exporter of (state, placement, outcome) records.
+ *
+ * Plays games with the bot, or plays back replays, and writes one record
+ * per placed tetromino through `chunk_writer`:
+ *
+ *   export --out FILE [--games N] [--pieces N] [--seed S] [--chunk N]
+ *   export --out FILE [--chunk N] --replay FILE...
+ *
+ * Runs with different seeds can be spread over processes, one file each.
+ *
+ * The state is taken when the tetromino spawns, before any hold.
+ * Each record carries `engine::checksum()`, so exports of two builds
+ * can be compared to find the first placement where they differ.
+ */
+
+#include <iostream>
+#include <array>
+#include <string>
+#include <vector>
+#include <variant>
+
+#include <cstring>
+
+#include <random>
+#include <chrono>
+#include <optional>
+
+#include <lib/intdef>
+
+#include <config.hpp>
+#include <engine.hpp>
+#include <replay.hpp>
+#include <env.hpp>
+
+#include <ai/bot.hpp>
+
+#include <util/chunk_writer.hpp>
+
+namespace {
+
+using control_key = engine::control_key;
+
+constexpr u32 queue_columns = 5;
+
+enum column : u32 {
+    GAME, PIECE_INDEX,
+    BOARD, PIECE, HOLD, QUEUE, HOLDABLE,
+    HOLD_USED, X, Y, DIRECTION, SPIN,
+    LINES, ATTACK, ATTACK_TYPE, COMBO, B2B, PC,
+    CHECKSUM
+};
+
+std::vector<chunk_writer::column> columns() {
+    return {
+        { "game", 4 }, { "piece_index", 4 },
+        { "board", sizeof(u16) * boards::standard::height() },
+        { "piece", 1 }, { "hold", 1 }, { "queue", queue_columns }, { "holdable", 1 },
+        { "hold_used", 1 }, { "x", 1 }, { "y", 1 }, { "direction", 1 }, { "spin", 1 },
+        { "lines", 1 }, { "attack", 2 }, { "attack_type", 1 },
+        { "combo", 2 }, { "b2b", 2 }, { "pc", 1 },
+        { "checksum", 8 }
+    };
+}
+
+u8 mino_id(const std::optional<tetromino>& __t)
+{ return static_cast<u8>(__t ? __t->type() : mino_type::INVALID); }
+
+// State of the engine when a tetromino spawns.
+struct state {
+    boards::standard _M_board;
+    u8 _M_piece, _M_hold;
+    std::array<u8, queue_columns> _M_queue;
+    bool _M_holdable;
+
+    static state capture(const engine& __e) {
+        state __s;
+
+        __s._M_board = std::get<boards::standard>(__e.get_field().board());
+        __s._M_piece = mino_id(__e.current());
+        __s._M_hold = mino_id(__e.held());
+        __s._M_holdable = __e.holdable();
+
+        __s._M_queue.fill(static_cast<u8>(mino_type::INVALID));
+        auto __it = __e.queue().begin();
+        for (u32 __i = 0; __i < queue_columns && __it != __e.queue().end(); ++__i, ++__it)
+            __s._M_queue[__i] = mino_id(*__it);
+
+        return __s;
+    }
+};
+
+void write_record(
+    chunk_writer& __w, u32 __game, u32 __index,
+    const state& __s, bool __hold_used, const engine::drop_result& __r
+) {
+    __w.put<u32>(GAME, __game);
+    __w.put<u32>(PIECE_INDEX, __index);
+
+    std::memcpy(__w.slot(BOARD), __s._M_board.rows(), sizeof(u16) * boards::standard::height());
+    __w.put<u8>(PIECE, __s._M_piece);
+    __w.put<u8>(HOLD, __s._M_hold);
+    std::memcpy(__w.slot(QUEUE), __s._M_queue.data(), queue_columns);
+    __w.put<u8>(HOLDABLE, __s._M_holdable);
+
+    __w.put<u8>(HOLD_USED, __hold_used);
+    __w.put<i8>(X, __r._M_x);
+    __w.put<i8>(Y, __r._M_y);
+    __w.put<u8>(DIRECTION, __r._M_mino.direction());
+    __w.put<u8>(SPIN, static_cast<u8>(__r._M_spin));
+
+    __w.put<u8>(LINES, __r._M_lines);
+    __w.put<u16>(ATTACK, __r._M_attack);
+    __w.put<u8>(ATTACK_TYPE, static_cast<u8>(__r._M_attack_info._M_type));
+    __w.put<i16>(COMBO, __r._M_attack_info._M_combo);
+    __w.put<i16>(B2B, __r._M_attack_info._M_btb);
+    __w.put<u8>(PC, __r._M_attack_info._M_pc);
+    __w.put<u64>(CHECKSUM, __r._M_checksum);
+
+    __w.commit();
+}
+
+bool is_standard(const user_config& __c) {
+    return __c.field.width == boards::standard::width() &&
+        __c.field.height + __c.field.extra_height == boards::standard::height();
+}
+
+// Returns the number of placements, and how many of them did not land
+// where the bot planned.
+std::pair<u32, u32> self_play(
+    chunk_writer& __w, u32 __game, u32 __seed, u32 __pieces, const user_config& __config
+) {
+    std::mt19937 __rand(__seed);
+    engine __e(__rand, __config);
+    bot __bot(__config);
+
+    __e.keep_history(false);
+    __e.track_checksum(true);
+    __e.begin();
+    __e.spawn();
+
+    u32 __index = 0, __mismatch = 0;
+
+    while (!__e.is_over() && __index < __pieces) {
+        state __s = state::capture(__e);
+
+        auto __d = __bot.think(__e);
+        if (!__d) break;
+
+        if (__d->_M_hold) __e.apply(control_key::HOLD);
+
+        std::optional<engine::drop_result> __r;
+        for (auto __k : __d->_M_placement._M_inputs)
+            __r = __e.apply(__k);
+
+        if (!__r) break;
+
+        if (__r->_M_x != __d->_M_placement._M_x || __r->_M_y != __d->_M_placement._M_y)
+            __mismatch++;
+
+        write_record(__w, __game, __index++, __s, __d->_M_hold, *__r);
+    }
+
+    return { __index, __mismatch };
+}
+
+u32 play_back(chunk_writer& __w, u32 __game, const replay& __rp) {
+    std::mt19937 __rand(__rp._M_seed);
+    engine __e(__rand, __rp._M_config, __rp._M_bag);
+
+    __e.track_checksum(true);
+    __e.begin();
+    __e.spawn();
+
+    u32 __index = 0;
+    state __s = state::capture(__e);
+    bool __hold_used = false, __diverged = false;
+
+    for (auto __k : __rp._M_inputs) {
+        bool __held = __k == control_key::HOLD && __e.holdable();
+
+        auto __r = __e.apply(__k);
+
+        if (__r) {
+            if (!__diverged && __index < __rp._M_checksums.size() &&
+                __rp._M_checksums[__index] != __r->_M_checksum) {
+                std::cerr << "Replay " << __game << " diverges at placement " << __index
+                          << ", records from here on do not match the recorded game.\n";
+                __diverged = true;
+            }
+
+            write_record(__w, __game, __index++, __s, __hold_used, *__r);
+            __hold_used = false;
+        } else __hold_used |= __held;
+
+        // A new tetromino is in play.
+        if (__r || __k == control_key::RESET || __k == control_key::UNDO || __k == control_key::REDO ||
+            __k == control_key::EARLIER || __k == control_key::LATER) {
+            __s = state::capture(__e);
+            if (!__r) __hold_used = false;
+        }
+
+        if (__e.is_over()) break;
+    }
+
+    return __index;
+}
+
+}
+
+int main(int argc, char** argv) {
+    env::initialize(argc, argv);
+
+    std::string __out;
+    std::vector<std::string> __replays;
+    u32 __games = 1, __pieces = 1000, __seed = 0, __chunk = 1 << 16;
+
+    const auto& __args = env::arguments();
+    for (std::size_t __i = 0; __i < __args.size(); ++__i) {
+        const std::string& __a = __args[__i];
+        bool __has_value = __i + 1 < __args.size();
+
+        if (__a == "--out" && __has_value) __out = __args[++__i];
+        else if (__a == "--games" && __has_value) __games = std::stoul(__args[++__i]);
+        else if (__a == "--pieces" && __has_value) __pieces = std::stoul(__args[++__i]);
+        else if (__a == "--seed" && __has_value) __seed = std::stoul(__args[++__i]);
+        else if (__a == "--chunk" && __has_value) __chunk = std::max(1ul, std::stoul(__args[++__i]));
+        else if (__a == "--replay") {
+            while (__i + 1 < __args.size() && __args[__i + 1].rfind("--", 0) != 0)
+                __replays.push_back(__args[++__i]);
+        } else {
+            std::cerr << "Unknown argument: " << __a << "\n";
+            return 1;
+        }
+    }
+
+    if (__out.empty()) {
+        std::cerr << "Usage: " << env::exec_path().filename().string()
+                  << " --out FILE [--games N] [--pieces N] [--seed S] [--chunk N] [--replay FILE...]\n";
+        return 1;
+    }
+
+    auto __begin = std::chrono::steady_clock::now();
+
+    chunk_writer __w(__out, columns(), __chunk);
+
+    if (__replays.empty()) {
+        user_config __config;
+        __config.hold.infinite = false;
+
+        u32 __mismatch = 0;
+        for (u32 __g = 0; __g < __games; ++__g)
+            __mismatch += self_play(__w, __g, __seed + __g, __pieces, __config).second;
+
+        if (__mismatch > 0)
+            std::cerr << __mismatch << " placements did not land where planned.\n";
+    } else {
+        for (u32 __g = 0; __g < __replays.size(); ++__g) {
+            auto __rp = replay::load(__replays[__g]);
+
+            if (!__rp) {
+                std::cerr << "Cannot load replay " << __replays[__g] << "\n";
+                continue;
+            }
+            if (!is_standard(__rp->_M_config)) {
+                std::cerr << "Skipping " << __replays[__g] << ", field is not 10 x (20 + 4).\n";
+                continue;
+            }
+
+            play_back(__w, __g, *__rp);
+        }
+    }
+
+    if (!__w.close()) {
+        std::cerr << "Failed to write " << __out << ", the file is incomplete.\n";
+        return 1;
+    }
+
+    auto __elapsed = std::chrono::duration<f64>(std::chrono::steady_clock::now() - __begin).count();
+    auto __stall = std::chrono::duration<f64>(__w.stall_time()).count();
+
+    std::cerr << __w.records() << " records in " << __w.chunks() << " chunks, "
+              << __elapsed << " s (" << (u64)(__w.records() / std::max(__elapsed, 1e-9)) << " /s), "
+              << "writer stall " << __stall << " s\n";
+}
@@ -0,0 +1,302 @@
+/*
+ * Differential fuzzing of `engine` against `reference_engine`.
+ *
+ * Each case picks rules from its first bytes and applies the rest as
+ * actions (moves, rotations, drops, holds and garbage) to the reference
+ * rules and to every engine variant: the fixed board (standard size only),
+ * the dynamic board and a game of a `batch_engine` (standard size only,
+ * next to games playing other actions). The whole state is compared after every step,
+ * and the first difference aborts with the case and step that caused it.
+ *
+ * Built with -DFUZZ_LIBFUZZER=ON (clang), this is a libFuzzer target.
+ * Otherwise it runs random cases in a loop:
+ *
+ *   fuzz [--seconds N] [--seed S] [--steps N]
+ */
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <optional>
+
+#include <random>
+#include <chrono>
+#include <cstdlib>
+
+#include <lib/intdef>
+
+#include <config.hpp>
+#include <engine.hpp>
+#include <batch_engine.hpp>
+#include <env.hpp>
+
+#include "reference.hpp"
+
+namespace {
+
+using control_key = engine::control_key;
+
+// Case layout: u32 seed, u8 rules, u8 size, then one byte per action.
+constexpr std::size_t header_size = 6;
+
+struct fuzz_case {
+    u32 _M_seed;
+    user_config _M_config;
+    bags::types _M_bag;
+};
+
+fuzz_case make_case(const u8* __data) {
+    fuzz_case __c;
+
+    __c._M_seed = __data[0] | __data[1] << 8 | __data[2] << 16 | (u32)__data[3] << 24;
+
+    u8 __r = __data[4], __s = __data[5];
+    auto& __u = __c._M_config;
+
+    __u.control.inf_soft_drop = __r & 1;
+    __u.hold.enabled = !(__r & 2);
+    __u.hold.infinite = __r & 4;
+    __u.spawn.extended = __r & 8;
+    __u.spawn.extended_height = 2;
+    __u.game.kick_table = static_cast<kick_tables::types>((__r >> 4) % 3);
+    __u.game.spin_table = static_cast<spin_tables::types>((__r >> 6) % 4 + (__s >> 7) * 2);
+    __u.game.enable_pc_b2b = __s & 0x40;
+    __c._M_bag = static_cast<bags::types>((__s >> 4) & 3);
+    // The rule bytes are used up, a bit of the seed picks marathon.
+    if (__c._M_seed & 0x100) __u.game.mode = user_config::game_mode::marathon;
+
+    // Half of the cases use the standard size, so the fixed board is tested.
+    if (__s & 8) {
+        __u.field.width = 4 + (__s & 7) * 3;
+        __u.field.height = 4 + (__s & 7) * 2;
+        __u.spawn.base_height = __u.field.height + 1;
+    }
+
+    return __c;
+}
+
+std::string describe(const tetromino& __t, i32 __x, i32 __y) {
+    std::ostringstream __os;
+    __os << __t.to_char() << "/" << __t.direction() << " at (" << __x << ", " << __y << ")";
+    return __os.str();
+}
+
+// Returns an empty string if the states match, or what differs.
+std::string compare(const reference_engine& __r, const engine& __e) {
+    if (__r._M_over != __e.is_over()) return "game over";
+    if (__r._M_over) return "";
+
+    if (__r._M_field.data() != __e.get_field().data()) return "field cells";
+
+    // The board must agree with the cells it shadows.
+    const field& __f = __e.get_field();
+    for (u32 __y = 0; __y < __f.height(); ++__y)
+        for (u32 __x = 0; __x < __f.width(); ++__x) {
+            bool __filled = __f.get_block(__x, __y) != block_type::EMPTY;
+            bool __bit = std::visit([&] (const auto& __b) { return __b.test(__x, __y); }, __f.board());
+            if (__filled != __bit) return "board occupancy";
+        }
+
+    if (__r._M_current.has_value() != __e.current().has_value() ||
+        (__r._M_current && (
+            __r._M_current->type() != __e.current()->type() ||
+            __r._M_current->direction() != __e.current()->direction() ||
+            __r._M_x != __e.x() || __r._M_y != __e.y())))
+        return "current " + describe(*__r._M_current, __r._M_x, __r._M_y) +
+               " vs " + describe(*__e.current(), __e.x(), __e.y());
+
+    if (__r._M_current && __r.ghost_y() != __e.ghost_y()) return "ghost";
+
+    if (__r._M_hold.has_value() != __e.held().has_value() ||
+        (__r._M_hold && __r._M_hold->type() != __e.held()->type()))
+        return "hold";
+    if (__r._M_holdable != __e.holdable()) return "holdable";
+    if (__r._M_queue != __e.queue()) return "queue";
+
+    const auto& __a = __r._M_attack_info;
+    const auto& __b = __e.last_attack();
+    if (__a._M_type != __b._M_type || __a._M_combo != __b._M_combo ||
+        __a._M_btb != __b._M_btb || __a._M_spin != __b._M_spin || __a._M_pc != __b._M_pc)
+        return "attack info";
+
+    const auto& __s = __e.stats();
+    if (__r._M_lines != __s._M_lines || __r._M_attack != __s._M_attack ||
+        __r._M_place_count != __s._M_place_count || __r._M_topouts != __s._M_topouts)
+        return "stats";
+
+    return "";
+}
+
+// Same as above, for game `__g` of a batch.
+std::string compare(const reference_engine& __r, const batch_engine& __e, std::size_t __g) {
+    if (__r._M_over != __e.is_over(__g)) return "game over";
+    if (__r._M_over) return "";
+
+    for (u32 __y = 0; __y < __r._M_field.height(); ++__y)
+        for (u32 __x = 0; __x < __r._M_field.width(); ++__x) {
+            bool __filled = __r._M_field.get_block(__x, __y) != block_type::EMPTY;
+            bool __bit = (__e.rows()[__y * __e.stride() + __g] >> __x) & 1;
+            if (__filled != __bit) return "board occupancy";
+        }
+
+    if (__r._M_current->type() != __e.current(__g) || __r._M_current->direction() != __e.direction(__g) ||
+        __r._M_x != __e.x(__g) || __r._M_y != __e.y(__g))
+        return "current " + describe(*__r._M_current, __r._M_x, __r._M_y);
+
+    if (__r.ghost_y() != __e.ghost_y(__g)) return "ghost";
+
+    if ((__r._M_hold ? __r._M_hold->type() : mino_type::INVALID) != __e.held(__g)) return "hold";
+    if (__r._M_holdable != __e.holdable(__g)) return "holdable";
+
+    if (__r._M_queue.size() != __e.queue_size()) return "queue";
+    auto __it = __r._M_queue.begin();
+    for (u32 __i = 0; __i < __e.queue_size(); ++__i, ++__it)
+        if (static_cast<u8>(__it->type()) != __e.queue(__g)[__i]) return "queue";
+
+    const auto& __a = __r._M_attack_info;
+    const auto __b = __e.last_attack(__g);
+    if (__a._M_type != __b._M_type || __a._M_combo != __b._M_combo ||
+        __a._M_btb != __b._M_btb || __a._M_spin != __b._M_spin || __a._M_pc != __b._M_pc)
+        return "attack info";
+
+    const auto __s = __e.stats(__g);
+    if (__r._M_lines != __s._M_lines || __r._M_attack != __s._M_attack ||
+        __r._M_place_count != __s._M_place_count || __r._M_topouts != __s._M_topouts)
+        return "stats";
+
+    return "";
+}
+
+[[noreturn]] void fail(const u8* __data, std::size_t __step, const std::string& __variant, const std::string& __what) {
+    std::cerr << "Mismatch at step " << __step << " (" << __variant << "): " << __what << "\ncase:";
+    for (std::size_t __i = 0; __i <= header_size + __step; ++__i)
+        std::cerr << " " << (u32)__data[__i];
+    std::cerr << "\n";
+    std::abort();
+}
+
+// Runs one case, returns the number of steps.
+std::size_t run(const u8* __data, std::size_t __size) {
+    if (__size < header_size) return 0;
+
+    fuzz_case __c = make_case(__data);
+
+    std::mt19937 __ref_rand(__c._M_seed);
+    reference_engine __ref(__ref_rand, __c._M_config, __c._M_bag);
+    __ref.begin();
+    __ref.spawn();
+
+    struct variant {
+        const char* _M_name;
+        std::mt19937 _M_rand;
+        engine _M_engine;
+
+        variant(const char* __n, const fuzz_case& __c, field::layout __l)
+        : _M_name(__n), _M_rand(__c._M_seed), _M_engine(_M_rand, __c._M_config, __c._M_bag, __l) {
+            _M_engine.keep_history(false);
+            _M_engine.begin();
+            _M_engine.spawn();
+        }
+    };
+
+    std::vector<std::unique_ptr<variant>> __variants;
+    __variants.push_back(std::make_unique<variant>("board", __c, field::layout::automatic));
+    if (std::holds_alternative<boards::standard>(__variants[0]->_M_engine.get_field().board()))
+        __variants.push_back(std::make_unique<variant>("dynamic board", __c, field::layout::dynamic));
+
+    // The case is game 1 of the batch, games 0 and 2 play other
+    // actions with other seeds, so state leaking between games shows up.
+    std::optional<batch_engine> __batch;
+    if (__variants.size() > 1) {
+        __batch.emplace(3, __c._M_seed + 1, __c._M_config, __c._M_bag);
+        __batch->reset(1, __c._M_seed);
+    }
+
+    std::size_t __steps = 0;
+
+    for (std::size_t __i = header_size; __i < __size && !__ref._M_over; ++__i, ++__steps) {
+        u8 __op = __data[__i] % 10;
+
+        if (__op < 8) {
+            auto __key = static_cast<control_key>(__op);
+
+            __ref.apply(__key);
+            for (auto& __v : __variants) __v->_M_engine.apply(__key);
+
+            if (__batch) {
+                u8 __actions[3] = { (u8)((__op + 3) % 8), __op, (u8)(__op * 5 % 8) };
+                __batch->step(__actions);
+            }
+        } else {
+            // Garbage, the hole comes from the same byte.
+            u32 __cnt = 1 + __data[__i] / 10 % 3;
+            i32 __hole = __data[__i] / 30 % __c._M_config.field.width;
+
+            __ref._M_field.put_garbage(__cnt, __hole);
+            for (auto& __v : __variants) __v->_M_engine.garbage(__cnt, __hole);
+
+            if (__batch)
+                for (std::size_t __g = 0; __g < __batch->size(); ++__g) __batch->garbage(__g, __cnt, __hole);
+        }
+
+        for (auto& __v : __variants)
+            if (auto __what = compare(__ref, __v->_M_engine); !__what.empty())
+                fail(__data, __steps, __v->_M_name, __what);
+
+        if (__batch)
+            if (auto __what = compare(__ref, *__batch, 1); !__what.empty())
+                fail(__data, __steps, "batch", __what);
+    }
+
+    return __steps;
+}
+
+}
+
+#ifdef TETRINAL_LIBFUZZER
+
+extern "C" int LLVMFuzzerTestOneInput(const u8* __data, std::size_t __size) {
+    run(__data, __size);
+    return 0;
+}
+
+#else
+
+int main(int argc, char** argv) {
+    env::initialize(argc, argv);
+
+    u32 __seconds = 10, __seed = std::random_device{}(), __length = 2000;
+
+    const auto& __args = env::arguments();
+    for (std::size_t __i = 0; __i + 1 < __args.size(); __i += 2) {
+        if (__args[__i] == "--seconds") __seconds = std::stoul(__args[__i + 1]);
+        else if (__args[__i] == "--seed") __seed = std::stoul(__args[__i + 1]);
+        else if (__args[__i] == "--steps") __length = std::stoul(__args[__i + 1]);
+    }
+
+    std::cerr << "seed " << __seed << "\n";
+
+    std::mt19937 __rand(__seed);
+    std::vector<u8> __data(header_size + __length);
+
+    auto __begin = std::chrono::steady_clock::now();
+    auto __end = __begin + std::chrono::seconds(__seconds);
+
+    u64 __cases = 0, __steps = 0;
+
+    while (std::chrono::steady_clock::now() < __end) {
+        // One action in ten is a drop, enough to reach line clears, spins and top outs.
+        for (auto& __b : __data) __b = __rand();
+
+        __steps += run(__data.data(), __data.size());
+        __cases++;
+    }
+
+    f64 __elapsed = std::chrono::duration<f64>(std::chrono::steady_clock::now() - __begin).count();
+
+    std::cerr << __cases << " cases, " << __steps << " steps, "
+              << (u64)(__steps / __elapsed * 60) << " steps/min, no mismatch\n";
+}
+
+#endif
@@ -0,0 +1,257 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <random>
+#include <optional>
+#include <algorithm>
+
+#include <lib/intdef>
+
+#include <config.hpp>
+#include <rules/tetromino.hpp>
+#include <rules/attack_table.hpp>
+#include <rules/kick_table.hpp>
+#include <rules/spin.hpp>
+#include <rules/bag.hpp>
+#include <rules/field.hpp>
+
+/**
+ * @brief The rules written the straightforward way, to check `engine` against.
+ *
+ * Works on field cells only (`get_block()`, `data()`, `remove_row()`), never on
+ * the occupancy board, ghost cache or any other shortcut of `engine`:
+ * collision tests every block, drops move one cell at a time and line
+ * clears scan every row. Puzzle mode and undo are not modeled.
+ */
+class reference_engine {
+public:
+    using control_key = user_config::control_config::KEYS;
+
+    reference_engine(std::mt19937& __rand, user_config __uconf, bags::types __bag_type)
+    : _M_user_config(__uconf), _M_bag(__rand, bags::create(__bag_type)),
+      _M_field(__uconf.field.width, __uconf.field.height + __uconf.field.extra_height, field::layout::dynamic),
+      _M_attack_table(attack_tables::create(__uconf.game.attack_table)),
+      _M_kick_table(kick_tables::create(__uconf.game.kick_table)),
+      _M_spin_table(spin_tables::create(__uconf.game.spin_table)) { }
+
+    user_config _M_user_config;
+    bag_generator _M_bag;
+    field _M_field;
+
+    std::unique_ptr<Iattack_table> _M_attack_table;
+    std::unique_ptr<Ikick_table> _M_kick_table;
+    std::unique_ptr<Ispin_table> _M_spin_table;
+
+    std::optional<tetromino> _M_current, _M_hold;
+    std::list<tetromino> _M_queue;
+    bool _M_holdable = true;
+    i32 _M_x = 0, _M_y = 0;
+
+    attack_info _M_attack_info = { attack_type::SINGLE, 0, -1, spin_type::NONE, false };
+    bool _M_is_last_spin = false;
+    u32 _M_kick_index = 0;
+
+    u32 _M_lines = 0, _M_attack = 0, _M_place_count = 0, _M_topouts = 0;
+    bool _M_over = false;
+
+    bool collides(i32 __x, i32 __y, const tetromino& __t) const {
+        for (u32 __i = 0; __i < __t.size(); ++__i)
+            for (u32 __j = 0; __j < __t.size(); ++__j)
+                if (__t.data()[__i][__j] != 0 &&
+                    _M_field.get_block(__x + __j, __y - __i) != block_type::EMPTY)
+                    return true;
+
+        return false;
+    }
+
+    i32 ghost_y() const {
+        i32 __y = _M_y;
+        while (!collides(_M_x, __y - 1, *_M_current)) __y--;
+        return __y;
+    }
+
+    bool field_empty() const {
+        for (const auto& __row : _M_field.data())
+            for (const auto& [__b, _] : __row)
+                if (__b != block_type::EMPTY) return false;
+
+        return true;
+    }
+
+    void begin() {
+        while (_M_queue.size() < std::max(_M_user_config.game.next_queue_size, 3u))
+            _M_queue.push_back(_M_bag.next());
+
+        _M_holdable = _M_user_config.hold.enabled;
+    }
+
+    tetromino next() {
+        while (_M_queue.size() <= std::max(_M_user_config.game.next_queue_size, 3u))
+            _M_queue.push_back(_M_bag.next());
+
+        tetromino __t = _M_queue.front();
+        _M_queue.pop_front();
+        return __t;
+    }
+
+    bool spawn(bool __new = true, bool __hold = false) {
+        if (__new) _M_current = next();
+
+        _M_x = (i32)_M_field.width() / 2 - (i32)(_M_current->size() + 1) / 2;
+        _M_y = (i32)_M_user_config.spawn.base_height;
+
+        if (collides(_M_x, _M_y, *_M_current)) {
+            u32 __i = 0;
+
+            if (_M_user_config.spawn.extended)
+                for (; __i < _M_user_config.spawn.extended_height; ++__i)
+                    if (!collides(_M_x, _M_y + __i, *_M_current)) break;
+
+            if (!_M_user_config.spawn.extended || __i >= _M_user_config.spawn.extended_height) {
+                if (_M_user_config.game.mode != user_config::game_mode::marathon) {
+                    _M_over = true;
+                    return false;
+                }
+
+                _M_field.clear();
+                _M_topouts++;
+                __i = 0;
+            }
+
+            _M_y += __i;
+        }
+
+        if (!__hold) _M_holdable = true;
+        return true;
+    }
+
+    void move(i32 __dx) {
+        if (collides(_M_x + __dx, _M_y, *_M_current)) return;
+
+        _M_x += __dx;
+        _M_is_last_spin = false;
+    }
+
+    void down() {
+        if (collides(_M_x, _M_y - 1, *_M_current)) return;
+
+        do {
+            _M_y--;
+        } while (_M_user_config.control.inf_soft_drop && !collides(_M_x, _M_y - 1, *_M_current));
+
+        _M_is_last_spin = false;
+    }
+
+    void rotate(rotation __r) {
+        tetromino __t = *_M_current;
+        __t.rotate(__r);
+
+        const auto& __table = _M_kick_table->get(__t, _M_current->direction(), __t.direction());
+
+        for (i32 __idx = -1; __idx < (i32)__table.size(); ++__idx) {
+            auto [__dx, __dy] = __idx < 0 ? std::pair { 0, 0 } : __table[__idx];
+
+            if (!collides(_M_x + __dx, _M_y + __dy, __t)) {
+                _M_current = __t;
+                _M_x += __dx;
+                _M_y += __dy;
+                _M_is_last_spin = true;
+                _M_kick_index = __idx;
+                return;
+            }
+        }
+    }
+
+    void drop() {
+        bool __moved = false;
+        while (!collides(_M_x, _M_y - 1, *_M_current)) {
+            _M_y--;
+            __moved = true;
+        }
+        if (__moved) _M_is_last_spin = false;
+
+        bool __imm =
+            collides(_M_x - 1, _M_y, *_M_current) && collides(_M_x + 1, _M_y, *_M_current) &&
+            collides(_M_x, _M_y + 1, *_M_current) && collides(_M_x, _M_y - 1, *_M_current);
+
+        for (u32 __i = 0; __i < _M_current->size(); ++__i)
+            for (u32 __j = 0; __j < _M_current->size(); ++__j)
+                if (_M_current->data()[__i][__j] != 0)
+                    _M_field.set_block(_M_x + __j, _M_y - __i, *_M_current);
+
+        spin_type __sp = _M_is_last_spin ?
+            _M_spin_table->get({ *_M_current, _M_x, _M_y, _M_kick_index, __imm, _M_field }) :
+            spin_type::NONE;
+
+        u32 __lines = 0;
+        for (u32 __y = 0; __y < _M_field.height(); ) {
+            const auto& __row = _M_field.data()[__y];
+
+            if (std::all_of(__row.begin(), __row.end(), [] (const auto& __c) {
+                return __c.first != block_type::EMPTY;
+            })) {
+                _M_field.remove_row(__y);
+                __lines++;
+            } else ++__y;
+        }
+
+        if (__lines > 0) {
+            _M_attack_info._M_pc = field_empty();
+            _M_attack_info._M_type = static_cast<attack_type>(__lines - 1);
+            _M_attack_info._M_combo++;
+            _M_attack_info._M_spin = __sp;
+
+            if (__sp == spin_type::NONE && _M_attack_info._M_type != attack_type::QUAD &&
+                !(_M_user_config.game.enable_pc_b2b && _M_attack_info._M_pc))
+                _M_attack_info._M_btb = -1;
+            else _M_attack_info._M_btb++;
+
+            _M_lines += __lines;
+            _M_attack += _M_attack_table->get(_M_attack_info);
+        } else {
+            _M_attack_info._M_pc = false;
+            _M_attack_info._M_type = attack_type::SINGLE;
+            _M_attack_info._M_combo = 0;
+            _M_attack_info._M_spin = spin_type::NONE;
+        }
+
+        _M_place_count++;
+
+        spawn();
+    }
+
+    void hold() {
+        if (!_M_user_config.hold.enabled || !_M_holdable) return;
+
+        if (_M_hold) {
+            std::swap(_M_current, _M_hold);
+            spawn(false, true);
+        } else {
+            if (_M_queue.empty()) return;
+
+            _M_hold = _M_current;
+            spawn(true, true);
+        }
+
+        _M_hold->set_direction(0);
+
+        if (!_M_user_config.hold.infinite) _M_holdable = false;
+    }
+
+    void apply(control_key __key) {
+        if (_M_over) return;
+
+        switch (__key) {
+            case control_key::LEFT: move(-1); break;
+            case control_key::RIGHT: move(1); break;
+            case control_key::DOWN: down(); break;
+            case control_key::ROTATE_CW: rotate(rotation::cw); break;
+            case control_key::ROTATE_CCW: rotate(rotation::ccw); break;
+            case control_key::ROTATE_180: rotate(rotation::_180); break;
+            case control_key::DROP: drop(); break;
+            case control_key::HOLD: hold(); break;
+            default: break;
+        }
+    }
+};
@@ -0,0 +1,186 @@
+/*
+ * Scaling benchmark of the task pool on a search workload.
+ *
+ *   scaling [--depth D] [--positions N] [--seed S] [--split D] [--max-threads N]
+ *
+ * Counts every sequence of placements of the next D tetrominoes (no hold)
+ * from N random positions: boards with a few garbage rows and a 7-bag
+ * sequence each. Task sizes are irregular, an O has 9 placements and a
+ * T 34, and lines cleared on the way change what follows. Each node forks
+ * its children while at least `--split` tetrominoes remain (2 by default)
+ * and counts the rest serially; the boards of its children are kept in the
+ * worker's arena until they are joined.
+ *
+ * Runs the same count with 1, 2, 4, ... threads up to one per core, and
+ * reports the time, the speedup over 1 thread and the efficiency (speedup
+ * per thread). Exits with 1 if the counts differ.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <atomic>
+
+#include <random>
+#include <chrono>
+#include <thread>
+
+#include <lib/intdef>
+
+#include <config.hpp>
+#include <engine.hpp>
+#include <env.hpp>
+#include <rules/bag.hpp>
+#include <rules/board.hpp>
+#include <rules/tetromino.hpp>
+
+#include <ai/movegen.hpp>
+
+#include <util/task_pool.hpp>
+
+namespace {
+
+struct position {
+    boards::standard _M_board;
+    std::vector<tetromino> _M_pieces;
+};
+
+struct workload {
+    const engine& _M_engine;
+    const std::vector<position>& _M_positions;
+    u32 _M_depth, _M_split;
+    bool _M_inf_soft_drop;
+
+    // Placement sequences of `_M_pieces[__i...]` from `__b`.
+    u64 count(const position& __p, const boards::standard& __b, u32 __i) const {
+        if (__i == __p._M_pieces.size()) return 1;
+
+        const tetromino& __t = __p._M_pieces[__i];
+        auto [__x, __y] = movegen::spawn_position(_M_engine, __b, __t);
+        auto __ps = movegen::generate(__b, _M_engine.kick_table(), __t, __x, __y, _M_inf_soft_drop);
+
+        if (__i + 1 == __p._M_pieces.size()) return __ps.size();
+
+        arena& __a = task_pool::local_arena();
+        arena::scope __scope(__a);
+
+        boards::standard* __next = __a.make_array<boards::standard>(__ps.size());
+        for (std::size_t __k = 0; __k < __ps.size(); ++__k) {
+            __next[__k] = __b;
+            __next[__k].put(__ps[__k]._M_x, __ps[__k]._M_y, __ps[__k]._M_mino);
+            __next[__k].clear_lines();
+        }
+
+        if (__p._M_pieces.size() - __i < _M_split) {
+            u64 __n = 0;
+            for (std::size_t __k = 0; __k < __ps.size(); ++__k) __n += count(__p, __next[__k], __i + 1);
+            return __n;
+        }
+
+        u64* __counts = __a.make_array<u64>(__ps.size());
+
+        task_group __g;
+        for (std::size_t __k = 0; __k < __ps.size(); ++__k)
+            __g.run([&, __k] { __counts[__k] = count(__p, __next[__k], __i + 1); });
+        __g.wait();
+
+        u64 __n = 0;
+        for (std::size_t __k = 0; __k < __ps.size(); ++__k) __n += __counts[__k];
+        return __n;
+    }
+};
+
+std::vector<position> make_positions(u32 __n, u32 __depth, u32 __seed) {
+    std::mt19937 __rand(__seed);
+    std::vector<position> __res(__n);
+
+    for (auto& __p : __res) {
+        // Up to 6 garbage rows with their holes anywhere.
+        u32 __rows = __rand() % 7;
+        for (u32 __r = 0; __r < __rows; ++__r)
+            __p._M_board.insert_garbage(1, __rand() % boards::standard::width());
+
+        bag_generator __bag(__rand, bags::create(bags::types::bag7));
+        while (__p._M_pieces.size() < __depth) __p._M_pieces.push_back(__bag.next());
+    }
+
+    return __res;
+}
+
+}
+
+int main(int argc, char** argv) {
+    env::initialize(argc, argv);
+
+    u32 __depth = 4, __positions = 8, __seed = 0, __split = 2;
+    u32 __max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    const auto& __args = env::arguments();
+    for (std::size_t __i = 0; __i < __args.size(); ++__i) {
+        const std::string& __a = __args[__i];
+        bool __has_value = __i + 1 < __args.size();
+
+        if (__a == "--depth" && __has_value) __depth = std::stoul(__args[++__i]);
+        else if (__a == "--positions" && __has_value) __positions = std::stoul(__args[++__i]);
+        else if (__a == "--seed" && __has_value) __seed = std::stoul(__args[++__i]);
+        else if (__a == "--split" && __has_value) __split = std::stoul(__args[++__i]);
+        else if (__a == "--max-threads" && __has_value) __max_threads = std::stoul(__args[++__i]);
+        else {
+            std::cerr << "Usage: " << env::exec_path().filename().string()
+                      << " [--depth D] [--positions N] [--seed S] [--split D] [--max-threads N]\n";
+            return 1;
+        }
+    }
+
+    user_config __config;
+    std::mt19937 __rand(__seed);
+    engine __e(__rand, __config);
+
+    auto __ps = make_positions(__positions, std::max(1u, __depth), __seed);
+    workload __w { __e, __ps, __depth, std::max(1u, __split), __config.control.inf_soft_drop };
+
+    std::vector<u32> __counts;
+    for (u32 __t = 1; __t < __max_threads; __t *= 2) __counts.push_back(__t);
+    __counts.push_back(__max_threads);
+
+    std::cout << "depth " << __depth << ", " << __positions << " positions, "
+              << std::thread::hardware_concurrency() << " cores\n"
+              << "threads        time     speedup  efficiency  sequences\n";
+
+    f64 __base = 0;
+    u64 __expected = 0;
+    int __ret = 0;
+
+    for (u32 __threads : __counts) {
+        task_pool __pool(__threads);
+        std::atomic<u64> __total = 0;
+
+        auto __start = std::chrono::steady_clock::now();
+
+        task_group __g(__pool);
+        for (const position& __p : __ps)
+            __g.run([&] { __total += __w.count(__p, __p._M_board, 0); });
+        __g.wait();
+
+        f64 __seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - __start).count();
+
+        if (__threads == 1) {
+            __base = __seconds;
+            __expected = __total;
+        } else if (__total != __expected) {
+            std::cerr << "The count with " << __threads << " threads is " << __total
+                      << ", " << __expected << " with 1.\n";
+            __ret = 1;
+        }
+
+        f64 __speedup = __base / __seconds;
+        std::cout << std::setw(7) << __threads << "  "
+                  << std::setw(9) << std::fixed << std::setprecision(3) << __seconds << " s  "
+                  << std::setw(8) << std::setprecision(2) << __speedup << "x  "
+                  << std::setw(9) << std::setprecision(1) << 100 * __speedup / __threads << "%  "
+                  << __total << "\n";
+    }
+
+    return __ret;
+}
@@ -0,0 +1,209 @@
+/*
+ * Searches the seeds whose games open with a given sequence.
+ *
+ *   seeds PATTERN [--bag bag7|bag14|bag7x|classic] [--from S] [--to S]
+ *                 [--count N] [--threads N]
+ *
+ * PATTERN is written as for `tetromino::gen()`, e.g. "T[IO]S" or "[^O]!".
+ * A seed matches if the first tetrominoes of a game seeded with it (the
+ * one in play, then the queue), drawn from the bag of `--bag` (bag7 by
+ * default), match PATTERN as a whole by `tetromino::sequence_match()`.
+ *
+ * Seeds in [from, to), all 2^32 by default, are scanned in order, by blocks
+ * split across a `task_pool` of `--threads` threads, one per core by
+ * default. The first `--count` matches (10 by default, 0 for all) are
+ * printed with their sequence, one per line; the time and rate go to
+ * stderr. Exits with 1 if none matched.
+ *
+ * Most seeds are rejected on their first bag. Its generator outputs are
+ * computed for 16 seeds at once without seeding the whole state (see
+ * mt_prefix.hpp), and the bag is checked against the tetrominoes each
+ * position may hold (`tetromino::sequence_masks()`). Seeds that fit go on
+ * bag by bag while they do, and are confirmed with a game's own bag
+ * generator.
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <optional>
+#include <mutex>
+
+#include <random>
+#include <chrono>
+
+#include <lib/intdef>
+
+#include <env.hpp>
+#include <rules/bag.hpp>
+#include <rules/tetromino.hpp>
+
+#include <util/task_pool.hpp>
+
+#include "mt_prefix.hpp"
+
+namespace {
+
+constexpr u32 lanes = 16;
+// Outputs of a lane, enough for the first few bags of any type.
+constexpr u32 outputs = 16;
+
+using prefix_type = mt_prefix<lanes, outputs>;
+
+// Seeds of a task, a multiple of `lanes`.
+constexpr u64 grain = 1 << 16;
+// Seeds scanned before the matches so far are printed: blocks double up
+// to the last size, so that a search for the first few stops early and
+// one for all keeps little.
+constexpr u64 first_block = 1 << 20, last_block = 1 << 24;
+
+struct search {
+    std::string _M_pattern;
+    std::vector<u8> _M_masks;
+    bags::types _M_bag;
+
+    // Whether the bags drawn from `__r` fit the masks, bag by bag.
+    template <typename _Rand>
+    bool fits(_Rand& __r, std::vector<tetromino>& __bag) const {
+        std::size_t __i = 0;
+
+        while (__i < _M_masks.size()) {
+            bags::generate(_M_bag, __r, __bag);
+
+            for (std::size_t __j = 0; __j < __bag.size() && __i < _M_masks.size(); ++__j, ++__i)
+                if (!(_M_masks[__i] >> static_cast<u32>(__bag[__j].type()) & 1)) return false;
+        }
+
+        return true;
+    }
+
+    // The opening of a game seeded with `__seed`, as the engine draws it.
+    std::vector<tetromino> opening(u32 __seed) const {
+        std::mt19937 __rand(__seed);
+        bag_generator __gen(__rand, bags::create(_M_bag));
+
+        std::vector<tetromino> __v;
+        for (std::size_t __i = 0; __i < _M_masks.size(); ++__i) __v.push_back(__gen.next());
+        return __v;
+    }
+
+    // Matches in [__begin, __end), in any order.
+    void scan(u64 __begin, u64 __end, std::vector<u32>& __out) const {
+        prefix_type __p;
+        std::vector<tetromino> __bag;
+
+        for (u64 __s = __begin; __s < __end; __s += lanes) {
+            __p.seed(__s);
+
+            for (u32 __l = 0; __l < lanes && __s + __l < __end; ++__l) {
+                prefix_rand<prefix_type> __r(__p, __l);
+                if (!fits(__r, __bag)) continue;
+
+                if (tetromino::sequence_match(opening(__s + __l), _M_pattern)) __out.push_back(__s + __l);
+            }
+        }
+    }
+};
+
+std::optional<bags::types> parse_bag(const std::string& __s) {
+    if (__s == "bag7") return bags::types::bag7;
+    if (__s == "bag14") return bags::types::bag14;
+    if (__s == "bag7x") return bags::types::bag7x;
+    if (__s == "classic") return bags::types::bag_classic;
+    return std::nullopt;
+}
+
+}
+
+int main(int argc, char** argv) {
+    env::initialize(argc, argv);
+
+    std::optional<std::string> __pattern;
+    bags::types __bag = bags::types::bag7;
+    u64 __from = 0, __to = u64(1) << 32, __count = 10;
+    u32 __threads = 0;
+    bool __usage = false;
+
+    const auto& __args = env::arguments();
+    try {
+        for (std::size_t __i = 0; __i < __args.size(); ++__i) {
+            const std::string& __a = __args[__i];
+            bool __has_value = __i + 1 < __args.size();
+
+            if (__a == "--bag" && __has_value) {
+                auto __b = parse_bag(__args[++__i]);
+                if (!__b) __usage = true;
+                else __bag = *__b;
+            }
+            else if (__a == "--from" && __has_value) __from = std::stoull(__args[++__i]);
+            else if (__a == "--to" && __has_value) __to = std::stoull(__args[++__i]);
+            else if (__a == "--count" && __has_value) __count = std::stoull(__args[++__i]);
+            else if (__a == "--threads" && __has_value) __threads = std::stoul(__args[++__i]);
+            else if (!__pattern && __a.rfind("--", 0) != 0) __pattern = __a;
+            else __usage = true;
+        }
+    } catch (const std::logic_error&) {
+        // Bounds or count that are not numbers.
+        __usage = true;
+    }
+
+    std::optional<std::vector<u8>> __masks;
+    if (__pattern) __masks = tetromino::sequence_masks(*__pattern);
+
+    if (__usage || !__masks || __to > u64(1) << 32 || __from > __to) {
+        if (__pattern && !__masks) std::cerr << "Invalid pattern: " << *__pattern << "\n";
+
+        std::cerr << "Usage: " << env::exec_path().filename().string()
+                  << " PATTERN [--bag bag7|bag14|bag7x|classic] [--from S] [--to S]\n"
+                     "       [--count N] [--threads N]\n";
+        return 1;
+    }
+
+    search __search { *__pattern, *__masks, __bag };
+    task_pool __pool(__threads);
+
+    auto __start = std::chrono::steady_clock::now();
+    u64 __scanned = 0, __found = 0;
+
+    std::mutex __mutex;
+    std::vector<u32> __matches;
+
+    for (u64 __b = __from, __block = first_block; __b < __to && (__count == 0 || __found < __count);
+         __b += __block, __block = std::min(__block * 2, last_block)) {
+        u64 __end = std::min(__to, __b + __block);
+
+        parallel_for(0, (__end - __b + grain - 1) / grain, 1, [&] (u64 __t) {
+            std::vector<u32> __local;
+            __search.scan(__b + __t * grain, std::min(__end, __b + (__t + 1) * grain), __local);
+
+            if (__local.empty()) return;
+
+            std::lock_guard __lock(__mutex);
+            __matches.insert(__matches.end(), __local.begin(), __local.end());
+        }, __pool);
+
+        std::sort(__matches.begin(), __matches.end());
+
+        for (u32 __seed : __matches) {
+            if (__count && __found == __count) break;
+
+            std::string __seq;
+            for (const auto& __t : __search.opening(__seed)) __seq += __t.to_char();
+
+            std::cout << __seed << " " << __seq << "\n";
+            __found++;
+        }
+
+        __matches.clear();
+        __scanned += __end - __b;
+    }
+
+    f64 __secs = std::chrono::duration<f64>(std::chrono::steady_clock::now() - __start).count();
+    std::cerr << "Scanned " << __scanned << " seeds in " << __secs << " s ("
+              << __scanned / __secs / 1e6 << " M seeds/s, " << __pool.size() << " threads), "
+              << __found << " found\n";
+
+    return __found ? 0 : 1;
+}
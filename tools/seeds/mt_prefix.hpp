@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <optional>
+
+#include <random>
+
+#include <lib/intdef>
+
+/**
+ * @brief The first `_Count` outputs of `std::mt19937` for `_Lanes`
+ * consecutive seeds at once.
+ *
+ * Output k < 227 of a newly seeded generator only reads words k, k + 1
+ * and k + 397 of the seeded state, none of them twisted yet: seeding
+ * stops at word 397 + `_Count`, and `_Count` words are twisted instead of
+ * 624. Lanes are independent steps side by side, which the compiler
+ * vectorizes.
+ */
+template <u32 _Lanes, u32 _Count>
+struct mt_prefix {
+    static_assert(_Count < 227);
+
+    u32 _M_first = 0;
+    // Output k of lane l, that is of seed `_M_first + l`.
+    std::array<std::array<u32, _Lanes>, _Count> _M_out;
+
+    void seed(u32 __first) {
+        _M_first = __first;
+
+        std::array<u32, _Lanes> __x;
+        std::array<std::array<u32, _Lanes>, _Count + 1> __low;
+        std::array<std::array<u32, _Lanes>, _Count> __high;
+
+        for (u32 __l = 0; __l < _Lanes; ++__l) __x[__l] = __low[0][__l] = __first + __l;
+
+        for (u32 __i = 1; __i < 397 + _Count; ++__i) {
+            for (u32 __l = 0; __l < _Lanes; ++__l) __x[__l] = 1812433253u * (__x[__l] ^ __x[__l] >> 30) + __i;
+
+            if (__i <= _Count) __low[__i] = __x;
+            if (__i >= 397) __high[__i - 397] = __x;
+        }
+
+        for (u32 __k = 0; __k < _Count; ++__k)
+            for (u32 __l = 0; __l < _Lanes; ++__l) {
+                u32 __y = (__low[__k][__l] & 0x80000000u) | (__low[__k + 1][__l] & 0x7fffffffu);
+                u32 __z = __high[__k][__l] ^ __y >> 1 ^ (__y & 1 ? 0x9908b0dfu : 0);
+
+                __z ^= __z >> 11;
+                __z ^= __z << 7 & 0x9d2c5680u;
+                __z ^= __z << 15 & 0xefc60000u;
+                __z ^= __z >> 18;
+                _M_out[__k][__l] = __z;
+            }
+    }
+};
+
+/**
+ * @brief Generator with the outputs of a `std::mt19937` seeded with the
+ * seed of lane `__lane` of an `mt_prefix`. Past the outputs computed it
+ * seeds one for good and skips them, so it can draw any number.
+ */
+template <typename _Prefix>
+class prefix_rand {
+    const _Prefix& _M_prefix;
+    u32 _M_lane, _M_drawn = 0;
+    std::optional<std::mt19937> _M_rest;
+
+public:
+    using result_type = std::mt19937::result_type;
+
+    static constexpr result_type min() { return std::mt19937::min(); }
+    static constexpr result_type max() { return std::mt19937::max(); }
+
+    prefix_rand(const _Prefix& __prefix, u32 __lane) : _M_prefix(__prefix), _M_lane(__lane) { }
+
+    result_type operator()() {
+        if (_M_drawn < _M_prefix._M_out.size()) return _M_prefix._M_out[_M_drawn++][_M_lane];
+
+        if (!_M_rest) {
+            _M_rest.emplace(_M_prefix._M_first + _M_lane);
+            _M_rest->discard(_M_drawn);
+        }
+
+        return (*_M_rest)();
+    }
+};
@@ -0,0 +1,344 @@
+/*
+ * Local environment server for learners in other processes.
+ *
+ * Runs N games with placements as actions, writes observations into
+ * shared memory and takes requests on a unix socket, see
+ * `include/tetrinal_env.h` for the protocol:
+ *
+ *   server [--name NAME] [--envs N] [--slots N]
+ *
+ * At most `max_envs` environments of `max_slots` slots each.
+ * Serves until interrupted, then removes its shared memory and socket.
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <variant>
+#include <algorithm>
+#include <stdexcept>
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+#include <random>
+#include <optional>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <lib/intdef>
+
+#include <tetrinal_env.h>
+
+#include <config.hpp>
+#include <engine.hpp>
+#include <env.hpp>
+
+#include <ai/movegen.hpp>
+
+namespace {
+
+using control_key = engine::control_key;
+
+// Bounds of the shared memory, well within its size type.
+constexpr u32 max_envs = 4096, max_slots = 256;
+
+volatile std::sig_atomic_t stop = 0;
+
+void on_signal(int) { stop = 1; }
+
+struct environment {
+    // Declared before the engine, which keeps a reference to it.
+    std::mt19937 _M_rand;
+    engine _M_engine;
+
+    // Placements listed in the last observation, the hold ones from `_M_hold_from`.
+    std::vector<placement> _M_placements;
+    std::size_t _M_hold_from = 0;
+
+    u64 _M_step = 0;
+    u32 _M_next_slot = 0;
+
+    environment(const user_config& __c, u32 __seed)
+    : _M_rand(__seed), _M_engine(_M_rand, __c) {
+        _M_engine.keep_history(false);
+        reset(__seed);
+    }
+
+    void reset(u32 __seed) {
+        _M_engine.seed(__seed);
+
+        _M_engine.reset();
+        _M_engine.begin();
+        _M_engine.spawn();
+
+        _M_step = 0;
+    }
+};
+
+u8 mino_id(const std::optional<tetromino>& __t)
+{ return static_cast<u8>(__t ? __t->type() : mino_type::INVALID); }
+
+// Writes the state of `__env`, and the outcome of `__r` if it just dropped.
+void observe(environment& __env, ttr_env_slot& __s, const engine::drop_result* __r) {
+    const engine& __e = __env._M_engine;
+
+    __s.step = __env._M_step;
+
+    const auto& __board = std::get<boards::standard>(__e.get_field().board());
+    std::memcpy(__s.rows, __board.rows(), sizeof(__s.rows));
+
+    __s.current = mino_id(__e.current());
+    __s.hold = mino_id(__e.held());
+    __s.holdable = __e.holdable();
+
+    std::memset(__s.queue, static_cast<u8>(mino_type::INVALID), sizeof(__s.queue));
+    auto __it = __e.queue().begin();
+    for (u32 __i = 0; __i < TTR_ENV_QUEUE && __it != __e.queue().end(); ++__i, ++__it)
+        __s.queue[__i] = mino_id(*__it);
+
+    __s.done = __e.is_over();
+
+    __s.lines = __r ? __r->_M_lines : 0;
+    __s.spin = __r ? static_cast<u8>(__r->_M_spin) : 0;
+    __s.attack_type = __r ? static_cast<u8>(__r->_M_attack_info._M_type) : 0;
+    __s.pc = __r ? __r->_M_attack_info._M_pc : 0;
+    __s.reward = __r ? __r->_M_attack : 0;
+
+    __s.combo = __e.last_attack()._M_combo;
+    __s.b2b = __e.last_attack()._M_btb;
+
+    auto& __ps = __env._M_placements;
+    __ps = movegen::generate(__e, false);
+    __env._M_hold_from = __ps.size();
+
+    auto __held = movegen::generate(__e, true);
+    __ps.insert(__ps.end(), __held.begin(), __held.end());
+
+    // Past the end of the table, placements are not offered.
+    if (__ps.size() > TTR_ENV_MAX_PLACEMENTS) __ps.erase(__ps.begin() + TTR_ENV_MAX_PLACEMENTS, __ps.end());
+
+    __s.placement_count = __ps.size();
+    for (std::size_t __i = 0; __i < __ps.size(); ++__i) {
+        const placement& __p = __ps[__i];
+
+        __s.placements[__i] = {
+            __i >= __env._M_hold_from,
+            static_cast<u8>(__p._M_mino.type()), static_cast<u8>(__p._M_mino.direction()),
+            static_cast<i8>(__p._M_x), static_cast<i8>(__p._M_y),
+            __p._M_rotated,
+            static_cast<u8>(__p._M_inputs.size() + (__i >= __env._M_hold_from)),
+            0
+        };
+    }
+}
+
+struct shared_memory {
+    std::string _M_name;
+    void* _M_data = MAP_FAILED;
+    std::size_t _M_size = 0;
+
+    ttr_env_header& header() const { return *static_cast<ttr_env_header*>(_M_data); }
+
+    ttr_env_slot& slot(u32 __env, u32 __slot) const {
+        const auto& __h = header();
+        return *reinterpret_cast<ttr_env_slot*>(
+            static_cast<u8*>(_M_data) + __h.data_offset + ((std::size_t)__env * __h.slots + __slot) * __h.slot_size
+        );
+    }
+
+    bool open(const std::string& __name, u32 __envs, u32 __slots) {
+        _M_name = __name;
+
+        // Slots are cache line aligned, so a reader never shares a line with the next slot.
+        u32 __slot_size = (sizeof(ttr_env_slot) + 63) / 64 * 64;
+        u32 __offset = (sizeof(ttr_env_header) + 63) / 64 * 64;
+        _M_size = __offset + (std::size_t)__envs * __slots * __slot_size;
+
+        shm_unlink(_M_name.c_str());
+        int __fd = shm_open(_M_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (__fd < 0) return false;
+
+        if (ftruncate(__fd, _M_size) != 0) {
+            ::close(__fd);
+            return false;
+        }
+
+        _M_data = mmap(nullptr, _M_size, PROT_READ | PROT_WRITE, MAP_SHARED, __fd, 0);
+        ::close(__fd);
+        if (_M_data == MAP_FAILED) return false;
+
+        header() = { 0, TTR_ENV_VERSION, __envs, __slots, __slot_size, __offset };
+        return true;
+    }
+
+    // Readers wait for the magic, written once every slot is ready.
+    void publish() { __atomic_store_n(&header().magic, TTR_ENV_MAGIC, __ATOMIC_RELEASE); }
+
+    ~shared_memory() {
+        if (_M_data != MAP_FAILED) munmap(_M_data, _M_size);
+        if (!_M_name.empty()) shm_unlink(_M_name.c_str());
+    }
+};
+
+ttr_env_reply handle(
+    const ttr_env_request& __req, std::vector<std::unique_ptr<environment>>& __envs,
+    const shared_memory& __shm
+) {
+    if (__req.env >= __envs.size()) return { TTR_ENV_BAD_ENV, 0 };
+
+    environment& __env = *__envs[__req.env];
+    std::optional<engine::drop_result> __r;
+
+    switch (__req.op) {
+        case TTR_ENV_RESET:
+            __env.reset(__req.arg);
+            break;
+
+        case TTR_ENV_STEP: {
+            if (__env._M_engine.is_over()) return { TTR_ENV_DONE, 0 };
+            if (__req.arg >= __env._M_placements.size()) return { TTR_ENV_BAD_ACTION, 0 };
+
+            const placement& __p = __env._M_placements[__req.arg];
+
+            if (__req.arg >= __env._M_hold_from) __env._M_engine.apply(control_key::HOLD);
+            for (auto __k : __p._M_inputs)
+                __r = __env._M_engine.apply(__k);
+
+            __env._M_step++;
+            break;
+        }
+
+        case TTR_ENV_OBSERVE:
+            break;
+
+        default:
+            return { TTR_ENV_BAD_REQUEST, 0 };
+    }
+
+    u32 __slot = __env._M_next_slot;
+    __env._M_next_slot = (__slot + 1) % __shm.header().slots;
+
+    observe(__env, __shm.slot(__req.env, __slot), __r ? &*__r : nullptr);
+
+    return { TTR_ENV_OK, __slot };
+}
+
+}
+
+int main(int argc, char** argv) {
+    env::initialize(argc, argv);
+
+    std::string __name = "default";
+    u64 __envs = 1, __slots = 4;
+    bool __usage = false;
+
+    const auto& __args = env::arguments();
+    try {
+        for (std::size_t __i = 0; __i < __args.size() && !__usage; ++__i) {
+            const std::string& __a = __args[__i];
+            bool __has_value = __i + 1 < __args.size();
+
+            if (__a == "--name" && __has_value) __name = __args[++__i];
+            else if (__a == "--envs" && __has_value) __envs = std::stoull(__args[++__i]);
+            else if (__a == "--slots" && __has_value) __slots = std::stoull(__args[++__i]);
+            else __usage = true;
+        }
+    } catch (const std::logic_error&) {
+        // Not a number, or out of range.
+        __usage = true;
+    }
+
+    if (__usage || __envs < 1 || __envs > max_envs || __slots < 2 || __slots > max_slots) {
+        std::cerr << "Usage: " << env::exec_path().filename().string()
+                  << " [--name NAME] [--envs 1.." << max_envs << "] [--slots 2.." << max_slots << "]\n";
+        return 1;
+    }
+
+    user_config __config;
+
+    std::vector<std::unique_ptr<environment>> __games;
+    for (u32 __e = 0; __e < __envs; ++__e)
+        __games.push_back(std::make_unique<environment>(__config, __e));
+
+    shared_memory __shm;
+    if (!__shm.open("/tetrinal-" + __name, __envs, __slots)) {
+        std::cerr << "Cannot create shared memory /tetrinal-" << __name << ": " << std::strerror(errno) << "\n";
+        return 1;
+    }
+
+    // Slot 0 of every environment holds its first observation, of seed `env`.
+    for (u32 __e = 0; __e < __envs; ++__e)
+        handle({ TTR_ENV_OBSERVE, __e, 0 }, __games, __shm);
+
+    std::string __path = "/tmp/tetrinal-" + __name + ".sock";
+
+    int __listen = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+
+    sockaddr_un __addr = {};
+    __addr.sun_family = AF_UNIX;
+    std::strncpy(__addr.sun_path, __path.c_str(), sizeof(__addr.sun_path) - 1);
+
+    unlink(__path.c_str());
+    if (__listen < 0 || bind(__listen, (sockaddr*)&__addr, sizeof(__addr)) != 0 || listen(__listen, 16) != 0) {
+        std::cerr << "Cannot listen on " << __path << ": " << std::strerror(errno) << "\n";
+        return 1;
+    }
+
+    struct sigaction __sa = {};
+    __sa.sa_handler = on_signal;
+    sigaction(SIGINT, &__sa, nullptr);
+    sigaction(SIGTERM, &__sa, nullptr);
+
+    __shm.publish();
+    std::cerr << "Serving " << __envs << " environments on " << __path << "\n";
+
+    std::vector<pollfd> __fds = { { __listen, POLLIN, 0 } };
+
+    while (!stop) {
+        if (poll(__fds.data(), __fds.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        if (__fds[0].revents & POLLIN) {
+            int __c = accept(__listen, nullptr, nullptr);
+            if (__c >= 0) __fds.push_back({ __c, POLLIN, 0 });
+        }
+
+        for (std::size_t __i = 1; __i < __fds.size(); ) {
+            pollfd& __p = __fds[__i];
+            bool __closed = __p.revents & (POLLHUP | POLLERR);
+
+            if (__p.revents & POLLIN) {
+                ttr_env_request __req;
+                ssize_t __n = recv(__p.fd, &__req, sizeof(__req), 0);
+
+                if (__n <= 0) __closed = true;
+                else {
+                    ttr_env_reply __rep =
+                        __n == sizeof(__req) ? handle(__req, __games, __shm) :
+                        ttr_env_reply { TTR_ENV_BAD_REQUEST, 0 };
+
+                    if (send(__p.fd, &__rep, sizeof(__rep), MSG_NOSIGNAL) != sizeof(__rep))
+                        __closed = true;
+                }
+            }
+
+            if (__closed) {
+                ::close(__p.fd);
+                __fds.erase(__fds.begin() + __i);
+            } else ++__i;
+        }
+    }
+
+    for (auto& __p : __fds) ::close(__p.fd);
+    unlink(__path.c_str());
+}
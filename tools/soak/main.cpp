@@ -0,0 +1,187 @@
+/*
+ * Soak test of the marathon mode: plays millions of placements headlessly
+ * and checks that memory stays flat.
+ *
+ *   soak [--pieces N] [--seed S] [--random] [--garbage N] [--slack BYTES]
+ *
+ * Plays the bot's placements, with a garbage line every `--garbage N`
+ * placements (5 by default, 0 for none) so the field keeps clearing lines,
+ * taking garbage and now and then topping out. `--random` plays random
+ * moves, rotations, drops and holds instead: about ten times faster, but
+ * it tops out over and over and almost never clears a line. The undo
+ * history, the attack history, the pace and a session snapshot every
+ * `snapshot_interval` placements are kept as the game keeps them. The heap
+ * in use is sampled once warmed up and then every `report_interval`
+ * placements.
+ *
+ * Exits with 1 if the heap grew by more than the slack (64 KiB by default)
+ * since the warm-up, or if the counters do not match the placements played.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <array>
+#include <algorithm>
+
+#include <random>
+#include <chrono>
+
+#include <malloc.h>
+
+#include <lib/intdef>
+
+#include <config.hpp>
+#include <engine.hpp>
+#include <perf_stats.hpp>
+#include <env.hpp>
+#include <ai/bot.hpp>
+
+namespace {
+
+using control_key = engine::control_key;
+
+constexpr std::array<control_key, 8> keys = {
+    control_key::LEFT, control_key::RIGHT, control_key::DOWN,
+    control_key::ROTATE_CW, control_key::ROTATE_CCW, control_key::ROTATE_180,
+    control_key::DROP, control_key::HOLD
+};
+
+// Placements before the first sample, the undo buffer is full by then.
+constexpr u64 warmup = 100000;
+constexpr u64 report_interval = 1000000;
+constexpr u64 snapshot_interval = 10000;
+
+// Bytes allocated and not freed.
+u64 heap_in_use() { return mallinfo2().uordblks; }
+
+// Resident set size in bytes, 0 if unknown.
+u64 resident() {
+    std::ifstream __is("/proc/self/statm");
+    u64 __size = 0, __pages = 0;
+    __is >> __size >> __pages;
+    return __pages * 4096;
+}
+
+}
+
+int main(int argc, char** argv) {
+    env::initialize(argc, argv);
+
+    u64 __pieces = 10000000, __slack = 64 * 1024;
+    u32 __seed = 0, __garbage = 5;
+    bool __use_bot = true;
+
+    const auto& __args = env::arguments();
+    for (std::size_t __i = 0; __i < __args.size(); ++__i) {
+        const std::string& __a = __args[__i];
+        bool __has_value = __i + 1 < __args.size();
+
+        if (__a == "--pieces" && __has_value) __pieces = std::stoull(__args[++__i]);
+        else if (__a == "--seed" && __has_value) __seed = std::stoul(__args[++__i]);
+        else if (__a == "--slack" && __has_value) __slack = std::stoull(__args[++__i]);
+        else if (__a == "--garbage" && __has_value) __garbage = std::stoul(__args[++__i]);
+        else if (__a == "--random") __use_bot = false;
+        else {
+            std::cerr << "Usage: " << env::exec_path().filename().string()
+                      << " [--pieces N] [--seed S] [--random] [--garbage N] [--slack BYTES]\n";
+            return 1;
+        }
+    }
+
+    user_config __config;
+    __config.game.mode = user_config::game_mode::marathon;
+
+    std::mt19937 __rand(__seed);
+    std::mt19937 __inputs(__seed ^ 0x5eed);
+
+    engine __e(__rand, __config);
+    __e.track_checksum(true);
+    __e.begin();
+    __e.spawn();
+
+    bot __bot(__config);
+    perf_stats __perf;
+    __perf.keep_series(false);
+    engine::session_data __snapshot;
+
+    u64 __placed = 0, __inputs_applied = 0;
+    u64 __base = 0, __peak = 0;
+    auto __start = std::chrono::steady_clock::now();
+
+    auto __apply = [&] (control_key __k) {
+        auto __r = __e.apply(__k);
+        __inputs_applied++;
+
+        if (__r) {
+            __placed++;
+            __perf.place(__r->_M_attack, 1);
+        }
+
+        return __r.has_value();
+    };
+
+    while (__placed < __pieces) {
+        if (__e.is_over()) {
+            std::cerr << "The game ended at placement " << __placed << ", marathons do not.\n";
+            return 1;
+        }
+
+        u64 __before = __placed;
+
+        if (__use_bot) {
+            // Garbage can bury the spawn so that nothing fits: the drop tops out.
+            if (auto __d = __bot.think(__e)) {
+                if (__d->_M_hold) __apply(control_key::HOLD);
+                for (auto __k : __d->_M_placement._M_inputs) __apply(__k);
+            } else __apply(control_key::DROP);
+        } else __apply(keys[__inputs() % keys.size()]);
+
+        if (__placed == __before) continue;
+
+        if (__garbage && __placed % __garbage == 0)
+            __e.garbage(1, __inputs() % __config.field.width);
+
+        if (__placed % snapshot_interval == 0) __e.save_session(__snapshot);
+
+        if (__placed == warmup) __base = __peak = heap_in_use();
+
+        if (__placed > warmup) __peak = std::max(__peak, heap_in_use());
+
+        if (__placed % report_interval == 0) {
+            f64 __seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - __start).count();
+
+            std::cout << std::setw(10) << __placed << " pieces  "
+                      << std::setw(8) << std::fixed << std::setprecision(1) << __seconds << " s  "
+                      << "heap " << heap_in_use() << " B  rss " << resident() / 1024 << " KiB  "
+                      << "lines " << __e.stats()._M_lines << "  top outs " << __e.stats()._M_topouts << "\n";
+        }
+    }
+
+    const auto& __s = __e.stats();
+    int __ret = 0;
+
+    std::cout << "placed " << __s._M_place_count << ", inputs " << __s._M_input_count
+              << ", lines " << __s._M_lines << ", attack " << __s._M_attack
+              << ", top outs " << __s._M_topouts << "\n";
+
+    if (__s._M_place_count != __placed || __s._M_input_count != __inputs_applied ||
+        __perf.pieces() != __placed) {
+        std::cerr << "Counters do not match the " << __placed << " placements and "
+                  << __inputs_applied << " inputs played.\n";
+        __ret = 1;
+    }
+
+    if (__placed > warmup) {
+        std::cout << "heap after warm-up " << __base << " B, peak " << __peak << " B\n";
+
+        if (__peak > __base + __slack) {
+            std::cerr << "The heap grew by " << __peak - __base << " B, more than "
+                      << __slack << " B.\n";
+            __ret = 1;
+        }
+    }
+
+    return __ret;
+}
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+
+#include <random>
+
+#include <lib/intdef>
+
+/**
+ * @brief CMA-ES (covariance matrix adaptation) that maximizes a function of
+ * `n` variables, with the default parameters of Hansen's tutorial.
+ *
+ * Each generation `sample()` draws `population()` candidates around the
+ * mean, and `update()` takes their fitness, higher is better: the mean moves
+ * towards the best half, the covariance learns the directions that paid off
+ * and the step size grows or shrinks with the length of the path the mean
+ * took. Every member is public so a run can be saved and continued.
+ */
+struct cma_es {
+    u32 _M_n = 0, _M_lambda = 0, _M_mu = 0;
+    std::vector<f64> _M_weights;
+    f64 _M_mueff = 0;
+    f64 _M_cc = 0, _M_cs = 0, _M_c1 = 0, _M_cmu = 0, _M_damps = 0, _M_chin = 0;
+
+    u32 _M_generation = 0;
+    f64 _M_sigma = 0;
+    std::vector<f64> _M_mean, _M_ps, _M_pc;
+    // Covariance, row major, and its eigenvectors (columns of B) and the
+    // square roots of its eigenvalues (D), from the last update.
+    std::vector<f64> _M_c, _M_b, _M_d;
+
+    std::mt19937_64 _M_rand;
+
+    // Steps of the candidates of the generation, y = B D z.
+    std::vector<std::vector<f64>> _M_steps;
+
+    cma_es() = default;
+
+    // `__lambda` 0 takes the default population, 4 + 3 ln n.
+    cma_es(std::vector<f64> __mean, f64 __sigma, u32 __lambda, u64 __seed)
+    : _M_n(__mean.size()), _M_sigma(__sigma), _M_mean(std::move(__mean)), _M_rand(__seed) {
+        u32 __n = _M_n;
+
+        _M_lambda = __lambda ? __lambda : 4 + (u32)(3 * std::log((f64)__n));
+        _M_mu = _M_lambda / 2;
+
+        for (u32 __i = 0; __i < _M_mu; ++__i)
+            _M_weights.push_back(std::log(_M_mu + 0.5) - std::log(__i + 1.0));
+
+        f64 __sum = std::accumulate(_M_weights.begin(), _M_weights.end(), 0.0), __sq = 0;
+        for (f64& __w : _M_weights) { __w /= __sum; __sq += __w * __w; }
+        _M_mueff = 1 / __sq;
+
+        _M_cc = (4 + _M_mueff / __n) / (__n + 4 + 2 * _M_mueff / __n);
+        _M_cs = (_M_mueff + 2) / (__n + _M_mueff + 5);
+        _M_c1 = 2 / ((__n + 1.3) * (__n + 1.3) + _M_mueff);
+        _M_cmu = std::min(1 - _M_c1, 2 * (_M_mueff - 2 + 1 / _M_mueff) / ((__n + 2.0) * (__n + 2.0) + _M_mueff));
+        _M_damps = 1 + 2 * std::max(0.0, std::sqrt((_M_mueff - 1) / (__n + 1)) - 1) + _M_cs;
+        _M_chin = std::sqrt((f64)__n) * (1 - 1.0 / (4 * __n) + 1.0 / (21.0 * __n * __n));
+
+        _M_ps.assign(__n, 0);
+        _M_pc.assign(__n, 0);
+        _M_c.assign(__n * __n, 0);
+        _M_b.assign(__n * __n, 0);
+        _M_d.assign(__n, 1);
+
+        for (u32 __i = 0; __i < __n; ++__i) _M_c[__i * __n + __i] = _M_b[__i * __n + __i] = 1;
+    }
+
+    u32 dimension() const { return _M_n; }
+    u32 population() const { return _M_lambda; }
+
+    // Candidates of the next generation.
+    std::vector<std::vector<f64>> sample() {
+        std::normal_distribution<f64> __normal;
+        u32 __n = _M_n;
+
+        _M_steps.assign(_M_lambda, std::vector<f64>(__n, 0));
+        std::vector<std::vector<f64>> __xs(_M_lambda, _M_mean);
+
+        for (u32 __k = 0; __k < _M_lambda; ++__k) {
+            std::vector<f64> __z(__n);
+            for (f64& __v : __z) __v = __normal(_M_rand);
+
+            for (u32 __i = 0; __i < __n; ++__i) {
+                f64 __y = 0;
+                for (u32 __j = 0; __j < __n; ++__j) __y += _M_b[__i * __n + __j] * _M_d[__j] * __z[__j];
+
+                _M_steps[__k][__i] = __y;
+                __xs[__k][__i] += _M_sigma * __y;
+            }
+        }
+
+        return __xs;
+    }
+
+    // Fitness of the candidates of the last `sample()`, in its order.
+    void update(const std::vector<f64>& __fitness) {
+        u32 __n = _M_n;
+
+        std::vector<u32> __order(_M_lambda);
+        std::iota(__order.begin(), __order.end(), 0);
+        std::stable_sort(__order.begin(), __order.end(), [&] (u32 __a, u32 __b) { return __fitness[__a] > __fitness[__b]; });
+
+        // Weighted step of the best half.
+        std::vector<f64> __yw(__n, 0);
+        for (u32 __i = 0; __i < _M_mu; ++__i)
+            for (u32 __j = 0; __j < __n; ++__j) __yw[__j] += _M_weights[__i] * _M_steps[__order[__i]][__j];
+
+        for (u32 __j = 0; __j < __n; ++__j) _M_mean[__j] += _M_sigma * __yw[__j];
+
+        // C^-1/2 yw = B D^-1 B^T yw.
+        std::vector<f64> __t(__n, 0), __w(__n, 0);
+        for (u32 __j = 0; __j < __n; ++__j) {
+            for (u32 __i = 0; __i < __n; ++__i) __t[__j] += _M_b[__i * __n + __j] * __yw[__i];
+            __t[__j] /= _M_d[__j];
+        }
+        for (u32 __i = 0; __i < __n; ++__i)
+            for (u32 __j = 0; __j < __n; ++__j) __w[__i] += _M_b[__i * __n + __j] * __t[__j];
+
+        f64 __cs = std::sqrt(_M_cs * (2 - _M_cs) * _M_mueff), __norm = 0;
+        for (u32 __i = 0; __i < __n; ++__i) {
+            _M_ps[__i] = (1 - _M_cs) * _M_ps[__i] + __cs * __w[__i];
+            __norm += _M_ps[__i] * _M_ps[__i];
+        }
+        __norm = std::sqrt(__norm);
+
+        _M_generation++;
+
+        // Stalls the path of C while the step size is growing fast.
+        bool __hsig = __norm / std::sqrt(1 - std::pow(1 - _M_cs, 2.0 * _M_generation)) / _M_chin < 1.4 + 2.0 / (__n + 1);
+
+        f64 __cc = std::sqrt(_M_cc * (2 - _M_cc) * _M_mueff);
+        for (u32 __i = 0; __i < __n; ++__i)
+            _M_pc[__i] = (1 - _M_cc) * _M_pc[__i] + (__hsig ? __cc * __yw[__i] : 0);
+
+        f64 __keep = 1 - _M_c1 - _M_cmu + (__hsig ? 0 : _M_c1 * _M_cc * (2 - _M_cc));
+        for (u32 __i = 0; __i < __n; ++__i)
+            for (u32 __j = 0; __j <= __i; ++__j) {
+                f64 __rank_mu = 0;
+                for (u32 __k = 0; __k < _M_mu; ++__k) {
+                    const auto& __y = _M_steps[__order[__k]];
+                    __rank_mu += _M_weights[__k] * __y[__i] * __y[__j];
+                }
+
+                f64 __v = __keep * _M_c[__i * __n + __j] + _M_c1 * _M_pc[__i] * _M_pc[__j] + _M_cmu * __rank_mu;
+                _M_c[__i * __n + __j] = _M_c[__j * __n + __i] = __v;
+            }
+
+        _M_sigma *= std::exp(_M_cs / _M_damps * (__norm / _M_chin - 1));
+
+        decompose();
+    }
+
+    // B and D from C, by Jacobi rotations.
+    void decompose() {
+        u32 __n = _M_n;
+        std::vector<f64> __a = _M_c;
+
+        _M_b.assign(__n * __n, 0);
+        for (u32 __i = 0; __i < __n; ++__i) _M_b[__i * __n + __i] = 1;
+
+        for (u32 __sweep = 0; __sweep < 64; ++__sweep) {
+            f64 __off = 0;
+            for (u32 __i = 0; __i < __n; ++__i)
+                for (u32 __j = __i + 1; __j < __n; ++__j) __off += __a[__i * __n + __j] * __a[__i * __n + __j];
+            if (__off < 1e-30) break;
+
+            for (u32 __p = 0; __p < __n; ++__p)
+                for (u32 __q = __p + 1; __q < __n; ++__q) {
+                    f64 __apq = __a[__p * __n + __q];
+                    if (std::abs(__apq) < 1e-300) continue;
+
+                    f64 __theta = (__a[__q * __n + __q] - __a[__p * __n + __p]) / (2 * __apq);
+                    f64 __t = (__theta >= 0 ? 1 : -1) / (std::abs(__theta) + std::sqrt(__theta * __theta + 1));
+                    f64 __c = 1 / std::sqrt(__t * __t + 1), __s = __t * __c;
+
+                    for (u32 __k = 0; __k < __n; ++__k) {
+                        f64 __akp = __a[__k * __n + __p], __akq = __a[__k * __n + __q];
+                        __a[__k * __n + __p] = __c * __akp - __s * __akq;
+                        __a[__k * __n + __q] = __s * __akp + __c * __akq;
+                    }
+                    for (u32 __k = 0; __k < __n; ++__k) {
+                        f64 __apk = __a[__p * __n + __k], __aqk = __a[__q * __n + __k];
+                        __a[__p * __n + __k] = __c * __apk - __s * __aqk;
+                        __a[__q * __n + __k] = __s * __apk + __c * __aqk;
+                    }
+                    for (u32 __k = 0; __k < __n; ++__k) {
+                        f64 __bkp = _M_b[__k * __n + __p], __bkq = _M_b[__k * __n + __q];
+                        _M_b[__k * __n + __p] = __c * __bkp - __s * __bkq;
+                        _M_b[__k * __n + __q] = __s * __bkp + __c * __bkq;
+                    }
+                }
+        }
+
+        // Rounding can leave an eigenvalue just below 0.
+        for (u32 __i = 0; __i < __n; ++__i) _M_d[__i] = std::sqrt(std::max(__a[__i * __n + __i], 1e-20));
+    }
+};
@@ -0,0 +1,447 @@
+/*
+ * Tuner of the bot's evaluation weights.
+ *
+ *   tune [--objective app|survival|pc] [--generations N] [--population N]
+ *        [--games N] [--pieces N] [--seed S] [--garbage F] [--sigma F]
+ *        [--weights NAME,...] [--threads N] [--checkpoint FILE]
+ *
+ * Searches the weights of `eval_weights` named by `--weights` (all of them
+ * by default, the others keep their defaults) with CMA-ES. Each candidate
+ * plays the same `--games` games (seeds S, S + 1, ...) of at most
+ * `--pieces` placements with the one piece look-ahead `bot`, under the
+ * rules of the default `user_config` (tetrio attack table, SRS+ kicks,
+ * all-mini+ spins). The games of a generation are played in parallel on a
+ * `task_pool` of `--threads` threads, one per core by default. Its fitness
+ * is the mean over the games of:
+ *
+ *   app       attack per placement, a top out scoring nothing for the
+ *             placements left;
+ *   survival  fraction of the placements played before topping out, under
+ *             `--garbage` rows per placement (0.5 by default);
+ *   pc        perfect clears per 100 placements.
+ *
+ * Garbage, 0 by default for the other objectives, arrives after every
+ * placement and is cancelled by the attack sent. It is pushed in after
+ * placements that clear no line, at most 8 rows at once with one hole
+ * column, and the game is lost if the tetromino in play then collides.
+ *
+ * The run is written to the checkpoint (`tune.json` by default) after
+ * every generation: the state of the search, the best weights found and
+ * their fitness, as JSON. Started again with the same options, it continues
+ * from there, as if it had not stopped; with other options it refuses to.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <array>
+#include <vector>
+#include <filesystem>
+#include <algorithm>
+#include <stdexcept>
+#include <optional>
+#include <cmath>
+
+#include <random>
+#include <chrono>
+
+#include <nlohmann/json.hpp>
+
+#include <lib/intdef>
+
+#include <config.hpp>
+#include <engine.hpp>
+#include <env.hpp>
+#include <ai/bot.hpp>
+
+#include <util/task_pool.hpp>
+
+#include "cma_es.hpp"
+
+namespace {
+
+using json = nlohmann::json;
+using control_key = engine::control_key;
+
+constexpr u32 checkpoint_version = 1;
+
+// Garbage rows pushed in after one placement at most.
+constexpr u32 garbage_cap = 8;
+
+struct weight_info {
+    const char* _M_name;
+    f32 eval_weights::* _M_member;
+};
+
+constexpr std::array<weight_info, 12> all_weights = {{
+    { "aggregate_height", &eval_weights::_M_aggregate_height },
+    { "max_height", &eval_weights::_M_max_height },
+    { "holes", &eval_weights::_M_holes },
+    { "covered", &eval_weights::_M_covered },
+    { "bumpiness", &eval_weights::_M_bumpiness },
+    { "well_depth", &eval_weights::_M_well_depth },
+    { "row_transitions", &eval_weights::_M_row_transitions },
+    { "column_transitions", &eval_weights::_M_column_transitions },
+    { "tslots", &eval_weights::_M_tslots },
+    { "attack", &eval_weights::_M_attack },
+    { "b2b", &eval_weights::_M_b2b },
+    { "wasted_clear", &eval_weights::_M_wasted_clear }
+}};
+
+enum class objective { app, survival, pc };
+
+constexpr std::array<const char*, 3> objective_names = { "app", "survival", "pc" };
+
+struct options {
+    objective _M_objective = objective::app;
+    u32 _M_generations = 50, _M_population = 0;
+    u32 _M_games = 16, _M_pieces = 500, _M_seed = 0;
+    std::optional<f64> _M_garbage;
+    f64 _M_sigma = 0.3;
+    std::vector<u32> _M_weights;
+    u32 _M_threads = 0;
+    std::filesystem::path _M_checkpoint = "tune.json";
+
+    f64 garbage() const { return _M_garbage.value_or(_M_objective == objective::survival ? 0.5 : 0); }
+
+    // What a checkpoint must have been made with to be continued.
+    json setup() const {
+        json __names = json::array();
+        for (u32 __i : _M_weights) __names.push_back(all_weights[__i]._M_name);
+
+        return {
+            { "objective", objective_names[static_cast<u32>(_M_objective)] },
+            { "population", _M_population }, { "games", _M_games }, { "pieces", _M_pieces },
+            { "seed", _M_seed }, { "garbage", garbage() }, { "sigma", _M_sigma },
+            { "weights", __names }
+        };
+    }
+};
+
+/*
+ * The search runs in units of each weight: weight i is
+ * origin_i + scale_i * x_i, with the scale its default size, so a step
+ * of sigma moves every weight by about the same fraction.
+ */
+struct space {
+    std::vector<u32> _M_weights;
+    std::vector<f64> _M_origin, _M_scale;
+
+    explicit space(const std::vector<u32>& __weights) : _M_weights(__weights) {
+        eval_weights __w;
+        for (u32 __i : __weights) {
+            f64 __v = __w.*all_weights[__i]._M_member;
+            _M_origin.push_back(__v);
+            _M_scale.push_back(std::max(std::abs(__v), 0.25));
+        }
+    }
+
+    eval_weights at(const std::vector<f64>& __x) const {
+        eval_weights __w;
+        for (std::size_t __i = 0; __i < _M_weights.size(); ++__i)
+            __w.*all_weights[_M_weights[__i]]._M_member = _M_origin[__i] + _M_scale[__i] * __x[__i];
+        return __w;
+    }
+};
+
+json to_json(const eval_weights& __w) {
+    json __j = json::object();
+    for (const auto& __i : all_weights) __j[__i._M_name] = __w.*__i._M_member;
+    return __j;
+}
+
+// Fitness of one game with `__w`, see the objectives above.
+f64 play(const eval_weights& __w, const options& __o, u32 __seed) {
+    user_config __config;
+    std::mt19937 __rand(__seed);
+    std::mt19937 __holes(__seed ^ 0x6a7ba6e);
+
+    engine __e(__rand, __config);
+    bot __bot(__config, __w);
+
+    __e.keep_history(false);
+    __e.begin();
+    __e.spawn();
+
+    f64 __rate = __o.garbage(), __pending = 0;
+    u64 __placed = 0, __attack = 0, __pcs = 0;
+
+    while (!__e.is_over() && __placed < __o._M_pieces) {
+        auto __d = __bot.think(__e);
+        if (!__d) break;
+
+        if (__d->_M_hold) __e.apply(control_key::HOLD);
+
+        std::optional<engine::drop_result> __r;
+        for (auto __k : __d->_M_placement._M_inputs) __r = __e.apply(__k);
+        if (!__r) break;
+
+        __placed++;
+        __attack += __r->_M_attack;
+        __pcs += __r->_M_lines > 0 && __r->_M_attack_info._M_pc;
+
+        if (__rate == 0) continue;
+
+        __pending = std::max(0.0, __pending + __rate - __r->_M_attack);
+        if (__r->_M_lines > 0 || __pending < 1 || __e.is_over()) continue;
+
+        u32 __rows = std::min<u32>(garbage_cap, (u32)__pending);
+        __pending -= __rows;
+        __e.garbage(__rows, std::uniform_int_distribution<i32>(0, __config.field.width - 1)(__holes));
+
+        if (__e.get_field().collides(__e.x(), __e.y(), *__e.current())) break;
+    }
+
+    switch (__o._M_objective) {
+    case objective::app: return (f64)__attack / __o._M_pieces;
+    case objective::survival: return (f64)__placed / __o._M_pieces;
+    case objective::pc: return 100.0 * __pcs / __o._M_pieces;
+    }
+
+    return 0;
+}
+
+// Mean fitness of every candidate over the games, all played at once.
+std::vector<f64> evaluate(const std::vector<eval_weights>& __ws, const options& __o, task_pool& __pool) {
+    u32 __games = __o._M_games;
+    std::vector<f64> __scores(__ws.size() * __games);
+
+    parallel_for(0, __scores.size(), 1, [&] (u64 __i) {
+        __scores[__i] = play(__ws[__i / __games], __o, __o._M_seed + __i % __games);
+    }, __pool);
+
+    std::vector<f64> __res(__ws.size(), 0);
+    for (std::size_t __i = 0; __i < __scores.size(); ++__i) __res[__i / __games] += __scores[__i] / __games;
+    return __res;
+}
+
+/* Checkpoint */
+
+struct run {
+    cma_es _M_search;
+    f64 _M_start_fitness = 0;
+    f64 _M_best_fitness = 0;
+    std::vector<f64> _M_best;
+};
+
+template <typename T>
+std::string to_text(const T& __v) {
+    std::ostringstream __os;
+    __os << __v;
+    return __os.str();
+}
+
+bool save(const std::filesystem::path& __path, const options& __o, const run& __r) {
+    const cma_es& __s = __r._M_search;
+    space __sp(__o._M_weights);
+
+    json __j = {
+        { "version", checkpoint_version },
+        { "setup", __o.setup() },
+        { "generation", __s._M_generation },
+        { "start_fitness", __r._M_start_fitness },
+        { "best_fitness", __r._M_best_fitness },
+        { "best", __r._M_best },
+        { "best_weights", to_json(__sp.at(__r._M_best)) },
+        { "search", {
+            { "sigma", __s._M_sigma }, { "mean", __s._M_mean },
+            { "ps", __s._M_ps }, { "pc", __s._M_pc }, { "c", __s._M_c },
+            { "rand", to_text(__s._M_rand) }
+        } }
+    };
+
+    // Replaced once complete, a crash leaves the previous generation.
+    std::filesystem::path __tmp = __path;
+    __tmp += ".tmp";
+
+    {
+        std::ofstream __os(__tmp, std::ios::trunc);
+        if (!__os) return false;
+        __os << __j.dump(2) << "\n";
+        if (!__os.flush()) return false;
+    }
+
+    std::error_code __ec;
+    std::filesystem::rename(__tmp, __path, __ec);
+    return !__ec;
+}
+
+// The run saved at `__path` for the same options, or nullopt if there is none.
+// Throws if the file can not be continued.
+std::optional<run> load(const std::filesystem::path& __path, const options& __o, run __fresh) {
+    std::ifstream __is(__path);
+    if (!__is) return std::nullopt;
+
+    json __j = json::parse(__is);
+
+    if (__j.at("version") != checkpoint_version)
+        throw std::runtime_error("it is of another version");
+    if (__j.at("setup") != __o.setup())
+        throw std::runtime_error("it was made with other options: " + __j.at("setup").dump());
+
+    run __r = std::move(__fresh);
+    cma_es& __s = __r._M_search;
+    const json& __search = __j.at("search");
+
+    __s._M_generation = __j.at("generation");
+    __s._M_sigma = __search.at("sigma");
+    __search.at("mean").get_to(__s._M_mean);
+    __search.at("ps").get_to(__s._M_ps);
+    __search.at("pc").get_to(__s._M_pc);
+    __search.at("c").get_to(__s._M_c);
+
+    std::istringstream __rand(__search.at("rand").get<std::string>());
+    __rand >> __s._M_rand;
+
+    std::size_t __n = __s.dimension();
+    if (__s._M_mean.size() != __n || __s._M_ps.size() != __n || __s._M_pc.size() != __n ||
+        __s._M_c.size() != __n * __n || !__rand)
+        throw std::runtime_error("the state of the search is damaged");
+
+    __s.decompose();
+
+    __r._M_start_fitness = __j.at("start_fitness");
+    __r._M_best_fitness = __j.at("best_fitness");
+    __j.at("best").get_to(__r._M_best);
+    if (__r._M_best.size() != __n) throw std::runtime_error("the best weights are damaged");
+
+    return __r;
+}
+
+bool parse_weights(const std::string& __list, std::vector<u32>& __out) {
+    std::istringstream __is(__list);
+    __out.clear();
+
+    for (std::string __name; std::getline(__is, __name, ','); ) {
+        auto __it = std::find_if(all_weights.begin(), all_weights.end(),
+            [&] (const weight_info& __w) { return __name == __w._M_name; });
+        if (__it == all_weights.end()) return false;
+
+        u32 __i = __it - all_weights.begin();
+        if (std::find(__out.begin(), __out.end(), __i) == __out.end()) __out.push_back(__i);
+    }
+
+    return !__out.empty();
+}
+
+}
+
+int main(int argc, char** argv) {
+    env::initialize(argc, argv);
+
+    options __o;
+    for (u32 __i = 0; __i < all_weights.size(); ++__i) __o._M_weights.push_back(__i);
+
+    bool __usage = false;
+
+    const auto& __args = env::arguments();
+    try {
+        for (std::size_t __i = 0; __i < __args.size() && !__usage; ++__i) {
+            const std::string& __a = __args[__i];
+            bool __has_value = __i + 1 < __args.size();
+
+            if (__a == "--objective" && __has_value) {
+                const std::string& __v = __args[++__i];
+                auto __it = std::find(objective_names.begin(), objective_names.end(), __v);
+                if (__it == objective_names.end()) __usage = true;
+                else __o._M_objective = static_cast<objective>(__it - objective_names.begin());
+            }
+            else if (__a == "--generations" && __has_value) __o._M_generations = std::stoul(__args[++__i]);
+            else if (__a == "--population" && __has_value) __o._M_population = std::stoul(__args[++__i]);
+            else if (__a == "--games" && __has_value) __o._M_games = std::max(1ul, std::stoul(__args[++__i]));
+            else if (__a == "--pieces" && __has_value) __o._M_pieces = std::max(1ul, std::stoul(__args[++__i]));
+            else if (__a == "--seed" && __has_value) __o._M_seed = std::stoul(__args[++__i]);
+            else if (__a == "--garbage" && __has_value) __o._M_garbage = std::stod(__args[++__i]);
+            else if (__a == "--sigma" && __has_value) __o._M_sigma = std::stod(__args[++__i]);
+            else if (__a == "--weights" && __has_value) __usage = !parse_weights(__args[++__i], __o._M_weights);
+            else if (__a == "--threads" && __has_value) __o._M_threads = std::stoul(__args[++__i]);
+            else if (__a == "--checkpoint" && __has_value) __o._M_checkpoint = __args[++__i];
+            else __usage = true;
+        }
+    } catch (const std::logic_error&) {
+        // std::sto* on a value that is not a number or does not fit.
+        __usage = true;
+    }
+
+    if (__usage) {
+        std::cerr << "Usage: " << env::exec_path().filename().string()
+                  << " [--objective app|survival|pc] [--generations N] [--population N]\n"
+                     "       [--games N] [--pieces N] [--seed S] [--garbage F] [--sigma F]\n"
+                     "       [--weights NAME,...] [--threads N] [--checkpoint FILE]\n"
+                     "Weights:";
+        for (const auto& __w : all_weights) std::cerr << " " << __w._M_name;
+        std::cerr << "\n";
+        return 1;
+    }
+
+    space __sp(__o._M_weights);
+    task_pool __pool(__o._M_threads);
+
+    run __fresh { cma_es(std::vector<f64>(__o._M_weights.size(), 0), __o._M_sigma, __o._M_population, __o._M_seed) };
+    __fresh._M_best = __fresh._M_search._M_mean;
+
+    std::optional<run> __loaded;
+    try {
+        __loaded = load(__o._M_checkpoint, __o, __fresh);
+    } catch (const std::exception& __ex) {
+        std::cerr << "Can not continue from " << __o._M_checkpoint << ", " << __ex.what() << ".\n";
+        return 1;
+    }
+
+    run __r = __loaded ? std::move(*__loaded) : std::move(__fresh);
+    cma_es& __s = __r._M_search;
+
+    std::cout << "objective " << objective_names[static_cast<u32>(__o._M_objective)]
+              << ", " << __s.dimension() << " weights, population " << __s.population()
+              << ", " << __o._M_games << " games of " << __o._M_pieces << " pieces, "
+              << __pool.size() << " threads\n";
+
+    if (__loaded) std::cout << "continuing from generation " << __s._M_generation << "\n";
+    else {
+        __r._M_start_fitness = __r._M_best_fitness = evaluate({ __sp.at(__r._M_best) }, __o, __pool)[0];
+        if (!save(__o._M_checkpoint, __o, __r))
+            std::cerr << "Could not write " << __o._M_checkpoint << ".\n";
+    }
+
+    std::cout << "default weights " << std::fixed << std::setprecision(4) << __r._M_start_fitness << "\n"
+              << "generation      best      mean     sigma      time\n";
+
+    while (__s._M_generation < __o._M_generations) {
+        auto __start = std::chrono::steady_clock::now();
+
+        auto __xs = __s.sample();
+
+        std::vector<eval_weights> __ws;
+        for (const auto& __x : __xs) __ws.push_back(__sp.at(__x));
+
+        std::vector<f64> __fitness = evaluate(__ws, __o, __pool);
+
+        std::size_t __top = std::max_element(__fitness.begin(), __fitness.end()) - __fitness.begin();
+        if (__fitness[__top] > __r._M_best_fitness) {
+            __r._M_best_fitness = __fitness[__top];
+            __r._M_best = __xs[__top];
+        }
+
+        f64 __mean = 0;
+        for (f64 __f : __fitness) __mean += __f / __fitness.size();
+
+        __s.update(__fitness);
+
+        if (!save(__o._M_checkpoint, __o, __r))
+            std::cerr << "Could not write " << __o._M_checkpoint << ".\n";
+
+        f64 __seconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - __start).count();
+        std::cout << std::setw(10) << __s._M_generation << std::setprecision(4)
+                  << std::setw(10) << __fitness[__top] << std::setw(10) << __mean
+                  << std::setw(10) << __s._M_sigma
+                  << std::setw(8) << std::setprecision(1) << __seconds << " s" << std::endl;
+    }
+
+    std::cout << "best " << std::setprecision(4) << __r._M_best_fitness
+              << " (default weights " << __r._M_start_fitness << ")\n"
+              << to_json(__sp.at(__r._M_best)).dump(2) << "\n";
+
+    return 0;
+}
@@ -0,0 +1,69 @@
+/*
+ * Plays back replays and compares them with their recorded checksums.
+ *
+ *   verify [--dump] FILE...
+ *
+ * Prints the first placement where a playback diverges from the recorded
+ * game, and exits with 1 if any replay diverges. `--dump` prints the
+ * checksum of every placement, to diff runs of two builds.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#include <lib/intdef>
+
+#include <replay.hpp>
+#include <env.hpp>
+
+int main(int argc, char** argv) {
+    env::initialize(argc, argv);
+
+    bool __dump = false;
+    std::vector<std::string> __files;
+
+    for (const auto& __a : env::arguments()) {
+        if (__a == "--dump") __dump = true;
+        else __files.push_back(__a);
+    }
+
+    if (__files.empty()) {
+        std::cerr << "Usage: " << env::exec_path().filename().string() << " [--dump] FILE...\n";
+        return 1;
+    }
+
+    int __ret = 0;
+
+    for (const auto& __f : __files) {
+        auto __rp = replay::load(__f);
+
+        if (!__rp) {
+            std::cerr << __f << ": cannot load replay\n";
+            __ret = 1;
+            continue;
+        }
+
+        std::vector<u64> __actual;
+        auto __div = __rp->verify(__dump ? &__actual : nullptr);
+
+        if (__dump)
+            for (std::size_t __i = 0; __i < __actual.size(); ++__i)
+                std::cout << __i << " " << std::hex << std::setw(16) << std::setfill('0')
+                          << __actual[__i] << std::dec << "\n";
+
+        if (__rp->_M_checksums.empty()) {
+            std::cerr << __f << ": no checksums recorded\n";
+        } else if (__div) {
+            std::cerr << __f << ": diverges at placement " << __div->_M_placement << std::hex
+                      << " (expected " << __div->_M_expected
+                      << ", got " << __div->_M_actual << ")\n" << std::dec;
+            __ret = 1;
+        } else {
+            std::cerr << __f << ": " << __rp->_M_checksums.size() << " placements match\n";
+        }
+    }
+
+    return __ret;
+}